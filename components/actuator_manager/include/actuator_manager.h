@@ -0,0 +1,79 @@
+/**
+ * @file actuator_manager.h
+ * @brief Table-driven manager for all relays of a node.
+ *
+ * Actuators are described by a static table; adding one is a table entry,
+ * not a new task. A single task owns the relay bank and drains one queue of
+ * command batches. Each batch becomes one bank frame, so every relay it
+ * touches switches at the same instant, followed by one combined status
+ * callback. Actuator i is channel i of the bank.
+ */
+
+#ifndef ACTUATOR_MANAGER_H
+#define ACTUATOR_MANAGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver_relay.h"
+#include "relay_bank.h"
+#include "command_parser.h"
+
+#define ACTUATOR_MAX    16
+
+typedef struct {
+    const char *name;       /* used in commands and status reports */
+    relay_type_t type;
+} actuator_def_t;
+
+/**
+ * Called on the actuator task after every batch, including those that
+ * changed nothing (changed is 0) or failed to reach the bank (err, with the
+ * states left as they were). Bit i of states/changed refers to actuator i
+ * of the table.
+ */
+typedef void (*actuator_status_cb_t)(const command_batch_t *batch, esp_err_t err,
+                                     uint32_t states, uint32_t changed);
+
+/**
+ * @brief Initializes the relay bank (all off) and starts the actuator task.
+ * @param [in] defs Actuator table; must stay valid (typically static const).
+ * @param [in] count Number of entries, at most ACTUATOR_MAX.
+ * @param [in] backend Output backend of the bank (GPIO register, 74HC595, ...).
+ * @param [in] status_cb Combined status callback, may be NULL.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t actuator_manager_init(const actuator_def_t *defs, size_t count,
+                                const relay_bank_backend_t *backend, actuator_status_cb_t status_cb);
+
+/**
+ * @brief Queues a batch of commands to be applied together.
+ * @return ESP_OK if queued, ESP_ERR_INVALID_ARG for an unknown device index,
+ *         ESP_ERR_TIMEOUT if the queue is full.
+ */
+esp_err_t actuator_manager_submit(const command_batch_t *batch);
+
+/**
+ * @brief Resolves an actuator name (case-insensitive, not NUL-terminated).
+ *        Matches command_device_lookup_t.
+ * @return Actuator index, or -1 if unknown.
+ */
+int actuator_manager_find(const char *name, size_t len);
+
+/**
+ * @brief Number of registered actuators.
+ */
+size_t actuator_manager_count(void);
+
+/**
+ * @brief Name of actuator i, or NULL if out of range.
+ */
+const char *actuator_manager_name(size_t index);
+
+/**
+ * @brief Current relay states, bit i for actuator i. Read from the bank
+ *        shadow; the pins are not touched.
+ */
+uint32_t actuator_manager_get_states(void);
+
+#endif // ACTUATOR_MANAGER_H
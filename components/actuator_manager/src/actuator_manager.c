@@ -0,0 +1,185 @@
+/**
+ * @file actuator_manager.c
+ * @brief One task, one queue and one relay bank for all actuators.
+ */
+
+#include "actuator_manager.h"
+#include <strings.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "metrics.h"
+#include "event_trace.h"
+#include "deferred_log.h"
+
+#define ACTUATOR_TASK_STACK_SIZE    3584    /* status callback encodes the command ack on this stack */
+#define ACTUATOR_TASK_PRIORITY      5
+#define ACTUATOR_QUEUE_LEN          4
+#define ACTUATOR_SUBMIT_WAIT_MS     10
+
+static const char *TAG = "ACTUATOR";
+static deferred_log_module_t s_log = DEFERRED_LOG_MODULE_INIT("ACTUATOR", DLOG_LEVEL_INFO);
+
+static const actuator_def_t *s_defs = NULL;
+static size_t s_count = 0;
+static relay_bank_t s_bank;
+static actuator_status_cb_t s_status_cb = NULL;
+static QueueHandle_t s_queue = NULL;
+
+static metrics_gauge_t queue_depth = METRICS_GAUGE_INIT("cmd_queue_depth");
+static metrics_gauge_t queue_peak = METRICS_GAUGE_INIT("cmd_queue_peak");
+static metrics_counter_t queue_drops = METRICS_COUNTER_INIT("cmd_queue_drops");
+
+/* Applies a whole batch against the current state word; later commands win */
+static uint32_t resolve_batch(const command_batch_t *batch, uint32_t states)
+{
+    for (uint8_t i = 0; i < batch->count; i++) {
+        uint32_t bit = 1u << batch->cmds[i].device;
+        switch (batch->cmds[i].action) {
+            case RELAY_CMD_ON:
+                states |= bit;
+                break;
+            case RELAY_CMD_OFF:
+                states &= ~bit;
+                break;
+            case RELAY_CMD_TOGGLE:
+                states ^= bit;
+                break;
+            default:
+                break;
+        }
+    }
+    return states;
+}
+
+static void actuator_task(void *pvParameters)
+{
+    command_batch_t batch;
+
+    while (1) {
+        if (xQueueReceive(s_queue, &batch, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        metrics_gauge_set(&queue_depth, (int32_t)uxQueueMessagesWaiting(s_queue));
+        uint32_t batch_start = event_trace_begin();
+
+        uint32_t current = relay_bank_get_states(&s_bank);
+        uint32_t target = resolve_batch(&batch, current);
+
+        // The whole batch is one bank frame: every affected relay switches together
+        uint32_t write_start = event_trace_begin();
+        esp_err_t err = relay_bank_apply(&s_bank, UINT32_MAX, target);
+        event_trace_end(TRACE_RELAY_WRITE, write_start, (uint32_t)err);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to apply batch: %s", esp_err_to_name(err));
+            target = current;
+        } else {
+            event_trace_end(TRACE_ACTUATOR_BATCH, batch_start, target);
+        }
+
+        uint32_t changed = current ^ target;
+        if (changed != 0) {
+            DLOG_I(s_log, "Applied %u commands, states 0x%04lx", batch.count, (unsigned long)target);
+        }
+        if (s_status_cb != NULL) {
+            s_status_cb(&batch, err, target, changed);
+        }
+    }
+}
+
+esp_err_t actuator_manager_init(const actuator_def_t *defs, size_t count,
+                                const relay_bank_backend_t *backend, actuator_status_cb_t status_cb)
+{
+    if (defs == NULL || backend == NULL || count == 0 || count > ACTUATOR_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_queue != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t active_low = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (defs[i].type == RELAY_ACTIVE_LOW) {
+            active_low |= 1u << i;
+        }
+    }
+    esp_err_t err = relay_bank_init(&s_bank, backend, (uint8_t)count, active_low);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize relay bank: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_defs = defs;
+    s_count = count;
+    s_status_cb = status_cb;
+
+    metrics_register_gauge(&queue_depth);
+    metrics_register_gauge(&queue_peak);
+    metrics_register_counter(&queue_drops);
+    deferred_log_register(&s_log);
+
+    s_queue = xQueueCreate(ACTUATOR_QUEUE_LEN, sizeof(command_batch_t));
+    if (s_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(actuator_task, "ACTUATOR TASK", ACTUATOR_TASK_STACK_SIZE, NULL,
+                    ACTUATOR_TASK_PRIORITY, NULL) != pdPASS) {
+        vQueueDelete(s_queue);
+        s_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "%u actuators registered", (unsigned)count);
+    return ESP_OK;
+}
+
+esp_err_t actuator_manager_submit(const command_batch_t *batch)
+{
+    if (batch == NULL || batch->count == 0 || batch->count > COMMAND_BATCH_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (uint8_t i = 0; i < batch->count; i++) {
+        if (batch->cmds[i].device >= s_count) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    if (xQueueSend(s_queue, batch, pdMS_TO_TICKS(ACTUATOR_SUBMIT_WAIT_MS)) != pdTRUE) {
+        metrics_counter_inc(&queue_drops);
+        return ESP_ERR_TIMEOUT;
+    }
+    int32_t depth = (int32_t)uxQueueMessagesWaiting(s_queue);
+    metrics_gauge_set(&queue_depth, depth);
+    metrics_gauge_max(&queue_peak, depth);
+    return ESP_OK;
+}
+
+int actuator_manager_find(const char *name, size_t len)
+{
+    for (size_t i = 0; i < s_count; i++) {
+        if (strlen(s_defs[i].name) == len && strncasecmp(s_defs[i].name, name, len) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+size_t actuator_manager_count(void)
+{
+    return s_count;
+}
+
+const char *actuator_manager_name(size_t index)
+{
+    return index < s_count ? s_defs[index].name : NULL;
+}
+
+uint32_t actuator_manager_get_states(void)
+{
+    return relay_bank_get_states(&s_bank);
+}
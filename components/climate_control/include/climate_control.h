@@ -0,0 +1,77 @@
+/**
+ * @file climate_control.h
+ * @brief Local closed-loop control of the actuators from sensor samples.
+ *
+ * Each loop ties one measured variable to one actuator of the actuator
+ * manager. Samples are fed straight from the sensor task, so control keeps
+ * running without the network; the cloud only changes setpoints and watches
+ * the reported state.
+ *
+ * Setpoints arrive as JSON (see climate_control_configure()) and are stored
+ * in NVS, so they survive a reboot. A loop in mode "off" leaves its actuator
+ * to manual commands; while a loop is active, a manual command on its
+ * actuator only holds until the loop's next decision.
+ */
+
+#ifndef CLIMATE_CONTROL_H
+#define CLIMATE_CONTROL_H
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "control_loop.h"
+#include "telemetry_codec.h"
+
+#define CLIMATE_MAX_LOOPS       4
+/* Worst-case climate_control_status_json() output per loop */
+#define CLIMATE_STATUS_JSON_LOOP_MAX_LEN    256
+
+typedef enum {
+    CLIMATE_TEMPERATURE,
+    CLIMATE_HUMIDITY,
+} climate_variable_t;
+
+typedef struct {
+    const char *name;           /* loop name in config payloads, also the NVS key (<= 15 chars) */
+    const char *actuator;       /* actuator manager name of the driven relay */
+    climate_variable_t variable;
+    control_action_t action;
+    control_params_t defaults;  /* used until a configuration is stored */
+} climate_loop_def_t;
+
+/**
+ * @brief Binds the loops to their actuators and loads stored parameters.
+ *        The actuator manager must be initialized first.
+ * @param [in] defs Loop table; must stay valid (typically static const).
+ * @param [in] count Number of loops, at most CLIMATE_MAX_LOOPS.
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND for an unknown actuator, or
+ *         an error code on failure.
+ */
+esp_err_t climate_control_init(const climate_loop_def_t *defs, size_t count);
+
+/**
+ * @brief Runs every active loop on a new sample and switches the actuators
+ *        that need to change, as one actuator batch. Called by the sensor
+ *        task for valid samples only.
+ */
+void climate_control_feed(const telemetry_sample_t *sample);
+
+/**
+ * @brief Applies and stores a configuration update, e.g.
+ *        {"loop": "humidity", "mode": "pid", "setpoint": 55, "kp": 0.2}.
+ *        Members other than "loop" are optional: mode ("off", "hysteresis",
+ *        "pid"), setpoint, hysteresis, kp, ki, kd, window_s, min_on_s,
+ *        min_off_s. The update is applied only if every member is valid.
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND for an unknown loop,
+ *         ESP_ERR_INVALID_ARG for a malformed or out-of-range value.
+ */
+esp_err_t climate_control_configure(const char *payload, size_t len);
+
+/**
+ * @brief Writes the parameters and current output of every loop as JSON:
+ *        {"loops": [{"loop": .., "actuator": .., "mode": .., "setpoint": ..,
+ *        ..., "output": "on", "duty": 0.42}]}.
+ * @return ESP_OK, or ESP_ERR_INVALID_SIZE if buf is too small.
+ */
+esp_err_t climate_control_status_json(char *buf, size_t len, size_t *out_len);
+
+#endif // CLIMATE_CONTROL_H
@@ -0,0 +1,85 @@
+/**
+ * @file control_loop.h
+ * @brief On/off control law for one actuator, independent of any hardware.
+ *
+ * Two modes drive a relay from a measured value:
+ * - Hysteresis: on when the error exceeds half the band, off once it is
+ *   half the band past the setpoint.
+ * - PID: the controller output is a duty cycle (0..1) applied by time
+ *   proportioning over a fixed window, since a relay cannot be half on.
+ *   The derivative acts on the measurement, and the integral stops growing
+ *   while the output is saturated (anti-windup).
+ *
+ * In both modes the minimum on/off times are enforced last, so no setting
+ * can make the relay chatter. Time is passed in by the caller, which keeps
+ * the law usable from a simulation at any speed.
+ */
+
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    CONTROL_MODE_OFF,           /* the loop does not drive its actuator */
+    CONTROL_MODE_HYSTERESIS,
+    CONTROL_MODE_PID,
+} control_mode_t;
+
+typedef enum {
+    CONTROL_ACTION_RAISE,       /* actuator raises the value (humidifier, heater) */
+    CONTROL_ACTION_LOWER,       /* actuator lowers the value (fan, dehumidifier) */
+} control_action_t;
+
+typedef struct {
+    control_mode_t mode;
+    float setpoint;
+    float hysteresis;           /* full band width, hysteresis mode */
+    float kp;                   /* duty per unit of error */
+    float ki;                   /* duty per unit of error and second */
+    float kd;                   /* duty per unit of error change per second */
+    uint32_t window_ms;         /* PID time-proportioning window */
+    uint32_t min_on_ms;
+    uint32_t min_off_ms;
+} control_params_t;
+
+typedef struct {
+    control_params_t params;
+    control_action_t action;
+    bool output;
+    uint64_t last_switch_ms;
+    float integral;
+    float prev_measurement;
+    uint64_t prev_ms;
+    bool has_prev;
+    uint64_t window_start_ms;
+    float duty;                 /* last PID output, 0..1 */
+} control_loop_t;
+
+/**
+ * @brief Initializes a loop with the actuator off since time 0.
+ */
+void control_loop_init(control_loop_t *loop, control_action_t action, const control_params_t *params);
+
+/**
+ * @brief Replaces the parameters. PID state is reset when the mode changes.
+ */
+void control_loop_set_params(control_loop_t *loop, const control_params_t *params);
+
+/**
+ * @brief Tells the loop its actuator was switched by someone else (e.g. a
+ *        manual command); the minimum on/off time restarts from now_ms.
+ */
+void control_loop_sync(control_loop_t *loop, bool output, uint64_t now_ms);
+
+/**
+ * @brief Runs the loop for one measurement.
+ * @param [in] measurement Current value of the controlled variable.
+ * @param [in] now_ms Monotonic time of the measurement.
+ * @return Desired actuator state. In CONTROL_MODE_OFF the current state is
+ *         returned unchanged.
+ */
+bool control_loop_update(control_loop_t *loop, float measurement, uint64_t now_ms);
+
+#endif // CONTROL_LOOP_H
@@ -0,0 +1,330 @@
+/**
+ * @file climate_control.c
+ * @brief Runs the control loops on the sensor task and persists their
+ *        parameters in NVS.
+ */
+
+#include "climate_control.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "actuator_manager.h"
+#include "json_scan.h"
+
+#define CLIMATE_NVS_NAMESPACE   "climate"
+/* Bump when control_params_t changes layout; older blobs are then ignored */
+#define CLIMATE_NVS_VERSION     1
+
+typedef struct {
+    uint8_t version;
+    control_params_t params;
+} climate_nvs_blob_t;
+
+typedef struct {
+    const climate_loop_def_t *def;
+    uint8_t actuator;
+    control_loop_t loop;
+} climate_loop_t;
+
+static const char *TAG = "CLIMATE";
+
+static climate_loop_t s_loops[CLIMATE_MAX_LOOPS];
+static size_t s_count = 0;
+static SemaphoreHandle_t s_lock = NULL;
+
+static const char *const mode_names[] = {
+    [CONTROL_MODE_OFF] = "off",
+    [CONTROL_MODE_HYSTERESIS] = "hysteresis",
+    [CONTROL_MODE_PID] = "pid",
+};
+
+static void load_params(const climate_loop_def_t *def, control_params_t *params)
+{
+    nvs_handle_t nvs;
+    climate_nvs_blob_t blob;
+    size_t size = sizeof(blob);
+
+    *params = def->defaults;
+    if (nvs_open(CLIMATE_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_blob(nvs, def->name, &blob, &size) == ESP_OK &&
+        size == sizeof(blob) && blob.version == CLIMATE_NVS_VERSION) {
+        *params = blob.params;
+    }
+    nvs_close(nvs);
+}
+
+static esp_err_t store_params(const climate_loop_def_t *def, const control_params_t *params)
+{
+    nvs_handle_t nvs;
+    climate_nvs_blob_t blob = { .version = CLIMATE_NVS_VERSION, .params = *params };
+
+    esp_err_t err = nvs_open(CLIMATE_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs, def->name, &blob, sizeof(blob));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+esp_err_t climate_control_init(const climate_loop_def_t *defs, size_t count)
+{
+    if (defs == NULL || count == 0 || count > CLIMATE_MAX_LOOPS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_lock != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int actuator = actuator_manager_find(defs[i].actuator, strlen(defs[i].actuator));
+        if (actuator < 0) {
+            ESP_LOGE(TAG, "Loop %s: unknown actuator %s", defs[i].name, defs[i].actuator);
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        control_params_t params;
+        load_params(&defs[i], &params);
+        s_loops[i].def = &defs[i];
+        s_loops[i].actuator = (uint8_t)actuator;
+        control_loop_init(&s_loops[i].loop, defs[i].action, &params);
+        ESP_LOGI(TAG, "Loop %s -> %s: %s, setpoint %.2f", defs[i].name, defs[i].actuator,
+                 mode_names[params.mode], params.setpoint);
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_count = count;
+    return ESP_OK;
+}
+
+void climate_control_feed(const telemetry_sample_t *sample)
+{
+    command_batch_t batch = { .count = 0 };
+
+    if (s_lock == NULL) {
+        return;
+    }
+
+    uint32_t states = actuator_manager_get_states();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (size_t i = 0; i < s_count; i++) {
+        climate_loop_t *c = &s_loops[i];
+        if (c->loop.params.mode == CONTROL_MODE_OFF) {
+            continue;
+        }
+
+        // Pick up manual commands or failed switches before deciding
+        bool actual = (states >> c->actuator) & 1u;
+        control_loop_sync(&c->loop, actual, sample->timestamp_ms);
+
+        float value = c->def->variable == CLIMATE_HUMIDITY ? sample->humidity : sample->temperature;
+        bool want = control_loop_update(&c->loop, value, sample->timestamp_ms);
+        if (want != actual) {
+            batch.cmds[batch.count].device = c->actuator;
+            batch.cmds[batch.count].action = want ? RELAY_CMD_ON : RELAY_CMD_OFF;
+            batch.count++;
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    if (batch.count > 0) {
+        esp_err_t err = actuator_manager_submit(&batch);
+        if (err != ESP_OK) {
+            // The next sample sees the unchanged relay and decides again
+            ESP_LOGW(TAG, "Failed to switch actuators: %s", esp_err_to_name(err));
+        }
+    }
+}
+
+static esp_err_t parse_mode(const json_tok_t *val, control_mode_t *mode)
+{
+    for (size_t i = 0; i < sizeof(mode_names) / sizeof(mode_names[0]); i++) {
+        if (val->type == JSON_TOK_STRING && json_tok_equals(val, mode_names[i])) {
+            *mode = (control_mode_t)i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t parse_number(const json_tok_t *val, double min, double max, double *out)
+{
+    if (json_tok_to_double(val, out) != ESP_OK || !isfinite(*out) || *out < min || *out > max) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_seconds(const json_tok_t *val, uint32_t *ms)
+{
+    double seconds;
+    esp_err_t err = parse_number(val, 0.0, 86400.0, &seconds);
+    if (err == ESP_OK) {
+        *ms = (uint32_t)(seconds * 1000.0);
+    }
+    return err;
+}
+
+/* Applies one member onto params; unknown members are ignored */
+static esp_err_t apply_member(const json_tok_t *key, const json_tok_t *val,
+                              climate_variable_t variable, control_params_t *params)
+{
+    double num;
+    esp_err_t err = ESP_OK;
+
+    if (json_tok_equals(key, "mode")) {
+        err = parse_mode(val, &params->mode);
+    } else if (json_tok_equals(key, "setpoint")) {
+        if (variable == CLIMATE_HUMIDITY) {
+            err = parse_number(val, 0.0, 100.0, &num);
+        } else {
+            err = parse_number(val, -40.0, 125.0, &num);
+        }
+        params->setpoint = (float)num;
+    } else if (json_tok_equals(key, "hysteresis")) {
+        err = parse_number(val, 0.0, 50.0, &num);
+        params->hysteresis = (float)num;
+    } else if (json_tok_equals(key, "kp")) {
+        err = parse_number(val, 0.0, 1000.0, &num);
+        params->kp = (float)num;
+    } else if (json_tok_equals(key, "ki")) {
+        err = parse_number(val, 0.0, 1000.0, &num);
+        params->ki = (float)num;
+    } else if (json_tok_equals(key, "kd")) {
+        err = parse_number(val, 0.0, 1000.0, &num);
+        params->kd = (float)num;
+    } else if (json_tok_equals(key, "window_s")) {
+        err = parse_seconds(val, &params->window_ms);
+    } else if (json_tok_equals(key, "min_on_s")) {
+        err = parse_seconds(val, &params->min_on_ms);
+    } else if (json_tok_equals(key, "min_off_s")) {
+        err = parse_seconds(val, &params->min_off_ms);
+    }
+    return err;
+}
+
+esp_err_t climate_control_configure(const char *payload, size_t len)
+{
+    json_scan_t scan;
+    json_tok_t key, val;
+    climate_loop_t *target = NULL;
+    esp_err_t err;
+
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // First pass: find the loop, members may come in any order
+    err = json_scan_object(&scan, payload, len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    while ((err = json_scan_next_member(&scan, &key, &val)) == ESP_OK) {
+        if (!json_tok_equals(&key, "loop")) {
+            continue;
+        }
+        for (size_t i = 0; i < s_count && val.type == JSON_TOK_STRING; i++) {
+            if (json_tok_equals(&val, s_loops[i].def->name)) {
+                target = &s_loops[i];
+            }
+        }
+        if (target == NULL) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+    if (err != ESP_ERR_NOT_FOUND) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (target == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Second pass: apply onto a copy so a bad member changes nothing
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    control_params_t params = target->loop.params;
+    xSemaphoreGive(s_lock);
+
+    json_scan_object(&scan, payload, len);
+    while (json_scan_next_member(&scan, &key, &val) == ESP_OK) {
+        err = apply_member(&key, &val, target->def->variable, &params);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Loop %s: invalid %.*s", target->def->name, (int)key.len, key.ptr);
+            return err;
+        }
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    control_loop_set_params(&target->loop, &params);
+    xSemaphoreGive(s_lock);
+
+    err = store_params(target->def, &params);
+    if (err != ESP_OK) {
+        // Still applied; it just will not survive a reboot
+        ESP_LOGW(TAG, "Loop %s: failed to store parameters: %s", target->def->name, esp_err_to_name(err));
+    }
+    ESP_LOGI(TAG, "Loop %s: %s, setpoint %.2f", target->def->name, mode_names[params.mode], params.setpoint);
+    return ESP_OK;
+}
+
+esp_err_t climate_control_status_json(char *buf, size_t len, size_t *out_len)
+{
+    size_t pos = 0;
+    bool overflow = false;
+    int n;
+
+    if (buf == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    n = snprintf(buf, len, "{\"loops\":[");
+    if (n < 0 || (size_t)n >= len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    pos = (size_t)n;
+
+    if (s_lock != NULL) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+    }
+    for (size_t i = 0; i < s_count; i++) {
+        const climate_loop_t *c = &s_loops[i];
+        const control_params_t *p = &c->loop.params;
+        n = snprintf(buf + pos, len - pos,
+                     "%s{\"loop\":\"%s\",\"actuator\":\"%s\",\"mode\":\"%s\",\"setpoint\":%.2f,"
+                     "\"hysteresis\":%.2f,\"kp\":%g,\"ki\":%g,\"kd\":%g,\"window_s\":%lu,"
+                     "\"min_on_s\":%lu,\"min_off_s\":%lu,\"output\":\"%s\",\"duty\":%.2f}",
+                     i > 0 ? "," : "", c->def->name, c->def->actuator, mode_names[p->mode],
+                     p->setpoint, p->hysteresis, p->kp, p->ki, p->kd,
+                     (unsigned long)(p->window_ms / 1000), (unsigned long)(p->min_on_ms / 1000),
+                     (unsigned long)(p->min_off_ms / 1000), c->loop.output ? "on" : "off",
+                     p->mode == CONTROL_MODE_PID ? c->loop.duty : (c->loop.output ? 1.0f : 0.0f));
+        if (n < 0 || (size_t)n >= len - pos) {
+            overflow = true;
+            break;
+        }
+        pos += (size_t)n;
+    }
+    if (s_lock != NULL) {
+        xSemaphoreGive(s_lock);
+    }
+
+    if (overflow || len - pos < 3) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    buf[pos++] = ']';
+    buf[pos++] = '}';
+    buf[pos] = '\0';
+    *out_len = pos;
+    return ESP_OK;
+}
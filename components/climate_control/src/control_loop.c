@@ -0,0 +1,117 @@
+/**
+ * @file control_loop.c
+ * @brief Hysteresis and time-proportioned PID on/off control.
+ */
+
+#include "control_loop.h"
+#include <stddef.h>
+
+static void reset_pid(control_loop_t *loop)
+{
+    loop->integral = 0.0f;
+    loop->has_prev = false;
+    loop->duty = 0.0f;
+    loop->window_start_ms = 0;
+}
+
+void control_loop_init(control_loop_t *loop, control_action_t action, const control_params_t *params)
+{
+    loop->params = *params;
+    loop->action = action;
+    loop->output = false;
+    loop->last_switch_ms = 0;
+    reset_pid(loop);
+}
+
+void control_loop_set_params(control_loop_t *loop, const control_params_t *params)
+{
+    if (params->mode != loop->params.mode) {
+        reset_pid(loop);
+    }
+    loop->params = *params;
+}
+
+void control_loop_sync(control_loop_t *loop, bool output, uint64_t now_ms)
+{
+    if (output != loop->output) {
+        loop->output = output;
+        loop->last_switch_ms = now_ms;
+    }
+}
+
+static bool hysteresis_step(const control_loop_t *loop, float error)
+{
+    float half_band = loop->params.hysteresis * 0.5f;
+
+    if (!loop->output && error > half_band) {
+        return true;
+    }
+    if (loop->output && error < -half_band) {
+        return false;
+    }
+    return loop->output;
+}
+
+static bool pid_step(control_loop_t *loop, float measurement, float error, uint64_t now_ms)
+{
+    const control_params_t *p = &loop->params;
+    float dt = loop->has_prev ? (float)(now_ms - loop->prev_ms) / 1000.0f : 0.0f;
+    float derivative = 0.0f;
+
+    if (dt > 0.0f) {
+        // On the measurement, so a setpoint change causes no derivative kick
+        float slope = (measurement - loop->prev_measurement) / dt;
+        derivative = loop->action == CONTROL_ACTION_RAISE ? -slope : slope;
+    }
+
+    float proportional = p->kp * error;
+    float integral = loop->integral + error * dt;
+    float u = proportional + p->ki * integral + p->kd * derivative;
+
+    // Conditional integration: keep the old integral if it would push further into saturation
+    if (!((u > 1.0f && error > 0.0f) || (u < 0.0f && error < 0.0f))) {
+        loop->integral = integral;
+    }
+    u = proportional + p->ki * loop->integral + p->kd * derivative;
+    loop->duty = u < 0.0f ? 0.0f : (u > 1.0f ? 1.0f : u);
+
+    loop->prev_measurement = measurement;
+    loop->prev_ms = now_ms;
+    loop->has_prev = true;
+
+    if (p->window_ms == 0) {
+        return loop->duty >= 0.5f;
+    }
+    if (now_ms - loop->window_start_ms >= p->window_ms) {
+        loop->window_start_ms = now_ms;
+    }
+    return (float)(now_ms - loop->window_start_ms) < loop->duty * (float)p->window_ms;
+}
+
+bool control_loop_update(control_loop_t *loop, float measurement, uint64_t now_ms)
+{
+    const control_params_t *p = &loop->params;
+    if (p->mode == CONTROL_MODE_OFF) {
+        return loop->output;
+    }
+
+    // Positive error means the actuator should run
+    float error = loop->action == CONTROL_ACTION_RAISE ? p->setpoint - measurement
+                                                       : measurement - p->setpoint;
+    bool want = p->mode == CONTROL_MODE_PID ? pid_step(loop, measurement, error, now_ms)
+                                            : hysteresis_step(loop, error);
+
+    // Minimum on/off times override both modes
+    uint64_t elapsed = now_ms - loop->last_switch_ms;
+    if (want && !loop->output && elapsed < p->min_off_ms) {
+        want = false;
+    } else if (!want && loop->output && elapsed < p->min_on_ms) {
+        want = true;
+    }
+
+    if (want != loop->output) {
+        loop->output = want;
+        loop->last_switch_ms = now_ms;
+    }
+    return loop->output;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file command_parser.h
+ * @brief Allocation-free parser for device commands received over MQTT.
+ *
+ * Accepts a single command
+ *   {"type": "<device>", "state": "on"|"off"|"toggle"|1|0|true|false}
+ * or a batch applied together
+ *   {"commands": [{"type": ..., "state": ...}, ...]}
+ * and parses it straight from the received buffer into compact commands.
+ * Device names are resolved to indices by the caller's lookup function.
+ * Member names and string values match case-insensitively ("device" is
+ * accepted as an alias of "type"); unknown members are ignored.
+ *
+ * Either form may carry a correlation id and the sender's timestamp,
+ *   {"id": "c0ffee", "ts": 1712345678123, "type": ..., "state": ...}
+ * which the device echoes in its acknowledgement so the sender can match
+ * it and measure the round trip on its own clock.
+ */
+
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Largest number of commands in one batch */
+#define COMMAND_BATCH_MAX   16
+/* Longest correlation id, enough for a UUID in text form */
+#define COMMAND_ID_MAX_LEN  36
+
+/**
+ * Relay command types
+ */
+typedef enum {
+    RELAY_CMD_OFF = 0,
+    RELAY_CMD_ON = 1,
+    RELAY_CMD_TOGGLE = 2
+} relay_cmd_t;
+
+/**
+ * Application command structure
+ */
+typedef struct {
+    uint8_t device;     /* index returned by the device lookup */
+    uint8_t action;     /* relay_cmd_t */
+} app_cmd_t;
+
+/**
+ * Where a batch came from, echoed in its acknowledgement. Batches raised on
+ * the device (control loops, rules) leave it zeroed and are not acknowledged.
+ */
+typedef struct {
+    char id[COMMAND_ID_MAX_LEN + 1];    /* empty: no acknowledgement wanted */
+    uint64_t sent_ms;                   /* "ts" as sent, opaque to the device */
+    int64_t received_us;                /* set by the receiver, esp_timer clock */
+} command_ref_t;
+
+typedef struct {
+    uint8_t count;
+    app_cmd_t cmds[COMMAND_BATCH_MAX];
+    command_ref_t ref;
+} command_batch_t;
+
+/**
+ * Resolves a device name (not NUL-terminated) to its index, or returns -1.
+ */
+typedef int (*command_device_lookup_t)(const char *name, size_t len);
+
+/**
+ * @brief Parses a single command or a batch. A batch is accepted or rejected
+ *        as a whole. The top-level "id" and "ts" are read first, so
+ *        batch->ref identifies the command even when an error is returned
+ *        for its contents (count is then 0).
+ * @param [in] buf Payload, not necessarily NUL-terminated.
+ * @param [in] len Payload length.
+ * @param [in] lookup Maps device names to indices.
+ * @param [out] batch Receives the commands (count is 1 for a single command).
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for malformed JSON,
+ *         ESP_ERR_NOT_FOUND if "type" or "state" is missing,
+ *         ESP_ERR_NOT_SUPPORTED for an unknown device or state,
+ *         ESP_ERR_INVALID_SIZE for an empty batch, more than COMMAND_BATCH_MAX
+ *         commands or an id longer than COMMAND_ID_MAX_LEN.
+ */
+esp_err_t command_parse(const char *buf, size_t len, command_device_lookup_t lookup,
+                        command_batch_t *batch);
+
+#endif // COMMAND_PARSER_H
@@ -0,0 +1,83 @@
+/**
+ * @file json_scan.h
+ * @brief In-place JSON tokenizer.
+ *
+ * Walks the members of an object (or the elements of an array) directly in
+ * the input buffer. Tokens point into that buffer and nothing is copied or
+ * allocated, so the input needs no NUL terminator and must outlive the tokens.
+ * Nested objects and arrays are returned as one token spanning their
+ * brackets and can be scanned in turn.
+ */
+
+#ifndef JSON_SCAN_H
+#define JSON_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Nesting limit when skipping over nested values */
+#define JSON_SCAN_MAX_DEPTH     8
+
+typedef enum {
+    JSON_TOK_STRING,    /* ptr/len exclude the quotes, escapes are left as-is */
+    JSON_TOK_NUMBER,
+    JSON_TOK_TRUE,
+    JSON_TOK_FALSE,
+    JSON_TOK_NULL,
+    JSON_TOK_OBJECT,    /* ptr/len include the braces */
+    JSON_TOK_ARRAY,     /* ptr/len include the brackets */
+} json_tok_type_t;
+
+typedef struct {
+    json_tok_type_t type;
+    const char *ptr;
+    size_t len;
+    bool escaped;       /* string contains backslash escapes */
+} json_tok_t;
+
+typedef struct {
+    const char *p;
+    const char *end;
+    char close;         /* '}' or ']' */
+    bool first;
+} json_scan_t;
+
+/**
+ * @brief Starts scanning the object or array that begins (after optional
+ *        whitespace) at buf.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if the input does not start with
+ *         '{' (object) or '[' (array) as requested.
+ */
+esp_err_t json_scan_object(json_scan_t *s, const char *buf, size_t len);
+esp_err_t json_scan_array(json_scan_t *s, const char *buf, size_t len);
+
+/**
+ * @brief Returns the next object member.
+ * @param [out] key Member name (JSON_TOK_STRING).
+ * @param [out] val Member value.
+ * @return ESP_OK for a member, ESP_ERR_NOT_FOUND at the end of the object,
+ *         ESP_ERR_INVALID_ARG on malformed input.
+ */
+esp_err_t json_scan_next_member(json_scan_t *s, json_tok_t *key, json_tok_t *val);
+
+/**
+ * @brief Returns the next array element.
+ * @return ESP_OK for an element, ESP_ERR_NOT_FOUND at the end of the array,
+ *         ESP_ERR_INVALID_ARG on malformed input.
+ */
+esp_err_t json_scan_next_element(json_scan_t *s, json_tok_t *val);
+
+/**
+ * @brief Case-insensitive comparison of an unescaped string token with a literal.
+ */
+bool json_tok_equals(const json_tok_t *tok, const char *literal);
+
+/**
+ * @brief Parses a number token as a double.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if the token is not a number.
+ */
+esp_err_t json_tok_to_double(const json_tok_t *tok, double *out);
+
+#endif // JSON_SCAN_H
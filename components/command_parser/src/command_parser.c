@@ -0,0 +1,183 @@
+#include "command_parser.h"
+#include <math.h>
+#include <string.h>
+#include "json_scan.h"
+
+static esp_err_t parse_device(const json_tok_t *val, command_device_lookup_t lookup, uint8_t *out)
+{
+    if (val->type != JSON_TOK_STRING || val->escaped) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    int index = lookup(val->ptr, val->len);
+    if (index < 0 || index > UINT8_MAX) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    *out = (uint8_t)index;
+    return ESP_OK;
+}
+
+static esp_err_t parse_state(const json_tok_t *val, uint8_t *out)
+{
+    double num;
+
+    switch (val->type) {
+        case JSON_TOK_STRING:
+            if (json_tok_equals(val, "on")) {
+                *out = RELAY_CMD_ON;
+            } else if (json_tok_equals(val, "off")) {
+                *out = RELAY_CMD_OFF;
+            } else if (json_tok_equals(val, "toggle")) {
+                *out = RELAY_CMD_TOGGLE;
+            } else {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            return ESP_OK;
+        case JSON_TOK_TRUE:
+            *out = RELAY_CMD_ON;
+            return ESP_OK;
+        case JSON_TOK_FALSE:
+            *out = RELAY_CMD_OFF;
+            return ESP_OK;
+        case JSON_TOK_NUMBER:
+            if (json_tok_to_double(val, &num) != ESP_OK || (num != 0.0 && num != 1.0)) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            *out = (num != 0.0) ? RELAY_CMD_ON : RELAY_CMD_OFF;
+            return ESP_OK;
+        default:
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+/* Parses one {"type":..,"state":..} object */
+static esp_err_t parse_command(const char *buf, size_t len, command_device_lookup_t lookup,
+                               app_cmd_t *cmd)
+{
+    json_scan_t scan;
+    json_tok_t key, val;
+    bool have_type = false, have_state = false;
+
+    esp_err_t err = json_scan_object(&scan, buf, len);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Read every member so a malformed tail rejects the whole command
+    while ((err = json_scan_next_member(&scan, &key, &val)) == ESP_OK) {
+        esp_err_t field_err = ESP_OK;
+        if (json_tok_equals(&key, "type") || json_tok_equals(&key, "device")) {
+            field_err = parse_device(&val, lookup, &cmd->device);
+            have_type = true;
+        } else if (json_tok_equals(&key, "state")) {
+            field_err = parse_state(&val, &cmd->action);
+            have_state = true;
+        }
+        if (field_err != ESP_OK) {
+            return field_err;
+        }
+    }
+    if (err != ESP_ERR_NOT_FOUND) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return (have_type && have_state) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t parse_batch(const json_tok_t *list, command_device_lookup_t lookup,
+                             command_batch_t *batch)
+{
+    json_scan_t scan;
+    json_tok_t item;
+    esp_err_t err;
+
+    if (list->type != JSON_TOK_ARRAY) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    json_scan_array(&scan, list->ptr, list->len);
+
+    batch->count = 0;
+    while ((err = json_scan_next_element(&scan, &item)) == ESP_OK) {
+        if (batch->count == COMMAND_BATCH_MAX) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        err = parse_command(item.ptr, item.len, lookup, &batch->cmds[batch->count]);
+        if (err != ESP_OK) {
+            return err;
+        }
+        batch->count++;
+    }
+    if (err != ESP_ERR_NOT_FOUND) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return batch->count > 0 ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+/* Reads the correlation members; a bad id or ts rejects the command */
+static esp_err_t parse_ref(const json_tok_t *key, const json_tok_t *val, command_ref_t *ref)
+{
+    double num;
+
+    if (json_tok_equals(key, "id")) {
+        if (val->type != JSON_TOK_STRING || val->escaped) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (val->len > COMMAND_ID_MAX_LEN) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(ref->id, val->ptr, val->len);
+        ref->id[val->len] = '\0';
+    } else if (json_tok_equals(key, "ts")) {
+        // Epoch milliseconds stay exact in a double up to 2^53
+        if (json_tok_to_double(val, &num) != ESP_OK || !(num >= 0.0) || num > 9007199254740992.0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        ref->sent_ms = (uint64_t)floor(num);
+    }
+    return ESP_OK;
+}
+
+esp_err_t command_parse(const char *buf, size_t len, command_device_lookup_t lookup,
+                        command_batch_t *batch)
+{
+    json_scan_t scan;
+    json_tok_t key, val, list = { 0 };
+    esp_err_t err, ref_err = ESP_OK;
+    bool is_batch = false;
+
+    if (buf == NULL || lookup == NULL || batch == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch->count = 0;
+    memset(&batch->ref, 0, sizeof(batch->ref));
+
+    // A batch is recognised by its "commands" member, anything else is a single command
+    err = json_scan_object(&scan, buf, len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    while ((err = json_scan_next_member(&scan, &key, &val)) == ESP_OK) {
+        if (json_tok_equals(&key, "commands")) {
+            list = val;
+            is_batch = true;
+        } else {
+            esp_err_t member_err = parse_ref(&key, &val, &batch->ref);
+            ref_err = ref_err != ESP_OK ? ref_err : member_err;
+        }
+    }
+    if (err != ESP_ERR_NOT_FOUND) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ref_err != ESP_OK) {
+        return ref_err;
+    }
+
+    if (is_batch) {
+        err = parse_batch(&list, lookup, batch);
+    } else {
+        batch->count = 1;
+        err = parse_command(buf, len, lookup, &batch->cmds[0]);
+    }
+    if (err != ESP_OK) {
+        batch->count = 0;
+    }
+    return err;
+}
@@ -0,0 +1,248 @@
+/**
+ * @file json_scan.c
+ * @brief In-place JSON tokenizer. Validates structure only as far as needed
+ *        to find token boundaries; numbers are checked for their charset.
+ */
+
+#include "json_scan.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Longest number accepted by json_tok_to_double */
+#define JSON_NUMBER_MAX_LEN     32
+
+static void skip_ws(json_scan_t *s)
+{
+    while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\n' || *s->p == '\r')) {
+        s->p++;
+    }
+}
+
+static bool match_literal(json_scan_t *s, const char *lit)
+{
+    size_t n = strlen(lit);
+    if ((size_t)(s->end - s->p) < n || memcmp(s->p, lit, n) != 0) {
+        return false;
+    }
+    s->p += n;
+    return true;
+}
+
+static esp_err_t read_string(json_scan_t *s, json_tok_t *tok)
+{
+    // s->p is on the opening quote
+    const char *start = ++s->p;
+    tok->escaped = false;
+    while (s->p < s->end) {
+        char c = *s->p;
+        if (c == '"') {
+            tok->type = JSON_TOK_STRING;
+            tok->ptr = start;
+            tok->len = (size_t)(s->p - start);
+            s->p++;
+            return ESP_OK;
+        }
+        if (c == '\\') {
+            tok->escaped = true;
+            s->p++;
+        } else if ((unsigned char)c < 0x20) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        s->p++;
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+/* Skips a nested object/array, honouring strings so brackets inside them are ignored */
+static esp_err_t read_container(json_scan_t *s, json_tok_t *tok)
+{
+    char stack[JSON_SCAN_MAX_DEPTH];
+    int depth = 0;
+    const char *start = s->p;
+
+    while (s->p < s->end) {
+        char c = *s->p;
+        if (c == '"') {
+            json_tok_t ignored;
+            if (read_string(s, &ignored) != ESP_OK) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            if (depth == JSON_SCAN_MAX_DEPTH) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            stack[depth++] = (c == '{') ? '}' : ']';
+        } else if (c == '}' || c == ']') {
+            if (depth == 0 || stack[--depth] != c) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            if (depth == 0) {
+                s->p++;
+                tok->type = (*start == '{') ? JSON_TOK_OBJECT : JSON_TOK_ARRAY;
+                tok->ptr = start;
+                tok->len = (size_t)(s->p - start);
+                tok->escaped = false;
+                return ESP_OK;
+            }
+        }
+        s->p++;
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t read_value(json_scan_t *s, json_tok_t *tok)
+{
+    skip_ws(s);
+    if (s->p >= s->end) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const char *start = s->p;
+    tok->escaped = false;
+    switch (*s->p) {
+        case '"':
+            return read_string(s, tok);
+        case '{':
+        case '[':
+            return read_container(s, tok);
+        case 't':
+            tok->type = JSON_TOK_TRUE;
+            break;
+        case 'f':
+            tok->type = JSON_TOK_FALSE;
+            break;
+        case 'n':
+            tok->type = JSON_TOK_NULL;
+            break;
+        default:
+            if (*s->p != '-' && !isdigit((unsigned char)*s->p)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            while (s->p < s->end && (isdigit((unsigned char)*s->p) || *s->p == '-' || *s->p == '+' ||
+                                     *s->p == '.' || *s->p == 'e' || *s->p == 'E')) {
+                s->p++;
+            }
+            tok->type = JSON_TOK_NUMBER;
+            tok->ptr = start;
+            tok->len = (size_t)(s->p - start);
+            return ESP_OK;
+    }
+
+    static const char *const literals[] = {
+        [JSON_TOK_TRUE] = "true", [JSON_TOK_FALSE] = "false", [JSON_TOK_NULL] = "null",
+    };
+    if (!match_literal(s, literals[tok->type])) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    tok->ptr = start;
+    tok->len = (size_t)(s->p - start);
+    return ESP_OK;
+}
+
+static esp_err_t scan_begin(json_scan_t *s, const char *buf, size_t len, char open, char close)
+{
+    if (s == NULL || buf == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s->p = buf;
+    s->end = buf + len;
+    skip_ws(s);
+    if (s->p >= s->end || *s->p != open) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s->p++;
+    s->close = close;
+    s->first = true;
+    return ESP_OK;
+}
+
+esp_err_t json_scan_object(json_scan_t *s, const char *buf, size_t len)
+{
+    return scan_begin(s, buf, len, '{', '}');
+}
+
+esp_err_t json_scan_array(json_scan_t *s, const char *buf, size_t len)
+{
+    return scan_begin(s, buf, len, '[', ']');
+}
+
+/* Consumes the separator before the next entry; ESP_ERR_NOT_FOUND at the closing bracket */
+static esp_err_t next_entry(json_scan_t *s)
+{
+    skip_ws(s);
+    if (s->p >= s->end) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (*s->p == s->close) {
+        s->p++;
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!s->first) {
+        if (*s->p != ',') {
+            return ESP_ERR_INVALID_ARG;
+        }
+        s->p++;
+        skip_ws(s);
+    }
+    s->first = false;
+    return ESP_OK;
+}
+
+esp_err_t json_scan_next_member(json_scan_t *s, json_tok_t *key, json_tok_t *val)
+{
+    esp_err_t err = next_entry(s);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (s->p >= s->end || *s->p != '"' || read_string(s, key) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    skip_ws(s);
+    if (s->p >= s->end || *s->p != ':') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s->p++;
+    return read_value(s, val);
+}
+
+esp_err_t json_scan_next_element(json_scan_t *s, json_tok_t *val)
+{
+    esp_err_t err = next_entry(s);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return read_value(s, val);
+}
+
+bool json_tok_equals(const json_tok_t *tok, const char *literal)
+{
+    size_t n = strlen(literal);
+    if (tok->type != JSON_TOK_STRING || tok->escaped || tok->len != n) {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (tolower((unsigned char)tok->ptr[i]) != tolower((unsigned char)literal[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t json_tok_to_double(const json_tok_t *tok, double *out)
+{
+    char tmp[JSON_NUMBER_MAX_LEN + 1];
+    char *endp = NULL;
+
+    if (tok->type != JSON_TOK_NUMBER || tok->len == 0 || tok->len > JSON_NUMBER_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // strtod needs a terminator; numbers are short, so copy to the stack
+    memcpy(tmp, tok->ptr, tok->len);
+    tmp[tok->len] = '\0';
+    *out = strtod(tmp, &endp);
+    return (endp == tmp + tok->len) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,204 @@
+/**
+ * @file deferred_log.h
+ * @brief Logging that records on the hot path and formats later.
+ *
+ * A log call stores a pointer to its static call site (format string and
+ * level) and its raw arguments in a lock-free ring, then returns; nothing
+ * is formatted on the calling task. A low-priority task drains the ring,
+ * formats each record and hands it to the normal ESP log output, so the
+ * printf stack and CPU time land there instead of on the MQTT or actuator
+ * task.
+ *
+ *     static deferred_log_module_t s_log = DEFERRED_LOG_MODULE_INIT("MQTT", DLOG_LEVEL_INFO);
+ *     DLOG_I(s_log, "Published %d bytes with msg_id=%d", len, msg_id);
+ *
+ * Arguments are captured by value when the call is made and formatted
+ * later, so the format string and every %s argument must outlive the call:
+ * string literals and static names only, never a received payload (log
+ * its length instead). Supported conversions are d i u x X o c with the
+ * hh h l ll z j t length modifiers, f F e E g G, s, p and %%, with flags,
+ * width and precision but no '*'. At most DEFERRED_LOG_MAX_ARGS arguments.
+ *
+ * Levels are per module and can be changed at runtime with
+ * deferred_log_set_level(); a call above its module's level costs a load
+ * and a compare. When the ring is full new records are dropped and counted.
+ */
+
+#ifndef DEFERRED_LOG_H
+#define DEFERRED_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#define DEFERRED_LOG_RECORDS        CONFIG_DEFERRED_LOG_RECORDS
+#define DEFERRED_LOG_MAX_ARGS       4
+/* Longest formatted message; longer ones are cut */
+#define DEFERRED_LOG_LINE_MAX       160
+
+_Static_assert((DEFERRED_LOG_RECORDS & (DEFERRED_LOG_RECORDS - 1)) == 0, "log ring size must be a power of two");
+
+/* Same values as esp_log_level_t */
+typedef enum {
+    DLOG_LEVEL_NONE,
+    DLOG_LEVEL_ERROR,
+    DLOG_LEVEL_WARN,
+    DLOG_LEVEL_INFO,
+    DLOG_LEVEL_DEBUG,
+    DLOG_LEVEL_VERBOSE,
+} dlog_level_t;
+
+typedef struct deferred_log_module {
+    const char *name;           /* printed as the log tag */
+    uint8_t level;              /* records above this level are skipped */
+    struct deferred_log_module *next;
+} deferred_log_module_t;
+
+#define DEFERRED_LOG_MODULE_INIT(module_name, default_level) \
+    { .name = (module_name), .level = (default_level) }
+
+/* One per log statement, in flash */
+typedef struct {
+    const char *fmt;
+    uint8_t level;
+    uint8_t arg_count;
+} dlog_site_t;
+
+typedef union {
+    int64_t i;                  /* every integer type, sign- or zero-extended */
+    double f;
+    const void *p;
+} dlog_arg_t;
+
+typedef struct {
+    uint32_t seq;               /* ring slot turn, see deferred_log.c */
+    uint32_t timestamp_ms;
+    const dlog_site_t *site;
+    const deferred_log_module_t *module;
+    dlog_arg_t args[DEFERRED_LOG_MAX_ARGS];     /* site->arg_count used */
+} dlog_record_t;
+
+/**
+ * Receives each drained record, formatted. Runs on the draining task.
+ */
+typedef void (*deferred_log_sink_t)(const deferred_log_module_t *module, dlog_level_t level,
+                                    uint32_t timestamp_ms, const char *message, void *ctx);
+
+/**
+ * @brief Adds a module to the registry so deferred_log_set_level() finds it.
+ *        Logging works without registering. Registering twice is a no-op.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a missing name.
+ */
+esp_err_t deferred_log_register(deferred_log_module_t *module);
+
+/**
+ * @brief Changes the level of a registered module at runtime.
+ * @param [in] name Module name, case-insensitive and not NUL-terminated;
+ *        "*" changes every registered module.
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if no module has that name.
+ */
+esp_err_t deferred_log_set_level(const char *name, size_t len, dlog_level_t level);
+
+/**
+ * @brief Stores one record; called by the DLOG_* macros. Never blocks.
+ * @return false if the ring was full and the record was dropped.
+ */
+bool deferred_log_write(const deferred_log_module_t *module, const dlog_site_t *site,
+                        const dlog_arg_t *args);
+
+/**
+ * @brief Formats up to max records, oldest first, and passes each to sink.
+ *        Only one task may drain.
+ * @return Number of records drained.
+ */
+size_t deferred_log_drain(deferred_log_sink_t sink, void *ctx, size_t max);
+
+/**
+ * @brief Formats a record's message the way printf would have.
+ * @return Length written, excluding the terminator (cut at len - 1).
+ */
+size_t deferred_log_format(const dlog_record_t *record, char *buf, size_t len);
+
+/**
+ * @brief Records dropped because the ring was full, since boot.
+ */
+uint32_t deferred_log_dropped(void);
+
+/**
+ * @brief Starts the low-priority task that drains the ring to the ESP log
+ *        output every few tens of milliseconds.
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if already running, ESP_ERR_NO_MEM.
+ */
+esp_err_t deferred_log_start(void);
+
+/* ---- argument capture ---------------------------------------------------- */
+
+static inline dlog_arg_t dlog_arg_int(long long value)
+{
+    dlog_arg_t arg = { .i = value };
+    return arg;
+}
+
+static inline dlog_arg_t dlog_arg_uint(unsigned long long value)
+{
+    dlog_arg_t arg = { .i = (int64_t)value };
+    return arg;
+}
+
+static inline dlog_arg_t dlog_arg_double(double value)
+{
+    dlog_arg_t arg = { .f = value };
+    return arg;
+}
+
+static inline dlog_arg_t dlog_arg_ptr(const void *value)
+{
+    dlog_arg_t arg = { .p = value };
+    return arg;
+}
+
+#define DLOG_ARG_(x) _Generic((x), \
+    float: dlog_arg_double, double: dlog_arg_double, long double: dlog_arg_double, \
+    char *: dlog_arg_ptr, const char *: dlog_arg_ptr, void *: dlog_arg_ptr, const void *: dlog_arg_ptr, \
+    unsigned int: dlog_arg_uint, unsigned long: dlog_arg_uint, unsigned long long: dlog_arg_uint, \
+    default: dlog_arg_int)(x)
+
+#define DLOG_NARGS_(...)    DLOG_NARGS_IMPL_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define DLOG_NARGS_IMPL_(_0, _1, _2, _3, _4, n, ...)    n
+#define DLOG_CAT_(a, b)     DLOG_CAT_IMPL_(a, b)
+#define DLOG_CAT_IMPL_(a, b) a##b
+#define DLOG_ARGS_0()
+#define DLOG_ARGS_1(a)          , DLOG_ARG_(a)
+#define DLOG_ARGS_2(a, ...)     , DLOG_ARG_(a) DLOG_ARGS_1(__VA_ARGS__)
+#define DLOG_ARGS_3(a, ...)     , DLOG_ARG_(a) DLOG_ARGS_2(__VA_ARGS__)
+#define DLOG_ARGS_4(a, ...)     , DLOG_ARG_(a) DLOG_ARGS_3(__VA_ARGS__)
+
+/* Never called; lets the compiler check arguments against the format */
+static inline __attribute__((format(printf, 1, 2))) void dlog_check_format_(const char *fmt, ...)
+{
+    (void)fmt;
+}
+
+/* Element 0 is a placeholder so the array is never empty */
+#define DLOG(module, lvl, fmt, ...) do { \
+        if (0) { \
+            dlog_check_format_(fmt, ##__VA_ARGS__); \
+        } \
+        if ((lvl) <= __atomic_load_n(&(module).level, __ATOMIC_RELAXED)) { \
+            static const dlog_site_t dlog_site_ = { (fmt), (lvl), DLOG_NARGS_(__VA_ARGS__) }; \
+            const dlog_arg_t dlog_args_[] = { { 0 } DLOG_CAT_(DLOG_ARGS_, DLOG_NARGS_(__VA_ARGS__))(__VA_ARGS__) }; \
+            deferred_log_write(&(module), &dlog_site_, dlog_args_ + 1); \
+        } \
+    } while (0)
+
+#define DLOG_E(module, fmt, ...)    DLOG(module, DLOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define DLOG_W(module, fmt, ...)    DLOG(module, DLOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define DLOG_I(module, fmt, ...)    DLOG(module, DLOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define DLOG_D(module, fmt, ...)    DLOG(module, DLOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define DLOG_V(module, fmt, ...)    DLOG(module, DLOG_LEVEL_VERBOSE, fmt, ##__VA_ARGS__)
+
+#endif // DEFERRED_LOG_H
@@ -0,0 +1,266 @@
+/**
+ * @file deferred_log.c
+ * @brief Lock-free record ring and the deferred printf formatter.
+ *
+ * The ring is a bounded multi-producer queue with one consumer. Each slot
+ * carries a turn number: a producer may fill the slot for position pos when
+ * its turn equals pos, and publishes it by setting pos + 1; the consumer
+ * takes it at turn pos + 1 and hands it back for the next lap at
+ * pos + DEFERRED_LOG_RECORDS. Turns are stored relative to the slot index,
+ * so a zeroed ring is a valid empty ring and logging works before any init.
+ */
+
+#include "deferred_log.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stddef.h>
+#include "esp_timer.h"
+
+#define RING_MASK   (DEFERRED_LOG_RECORDS - 1u)
+
+static dlog_record_t s_ring[DEFERRED_LOG_RECORDS];
+static uint32_t s_head = 0;     /* next position to claim */
+static uint32_t s_tail = 0;     /* next position to drain, consumer only */
+static uint32_t s_dropped = 0;
+static deferred_log_module_t *s_modules = NULL;
+
+static inline uint32_t slot_turn(const dlog_record_t *slot, uint32_t index)
+{
+    return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) + index;
+}
+
+static inline void slot_set_turn(dlog_record_t *slot, uint32_t index, uint32_t turn)
+{
+    __atomic_store_n(&slot->seq, turn - index, __ATOMIC_RELEASE);
+}
+
+esp_err_t deferred_log_register(deferred_log_module_t *module)
+{
+    if (module == NULL || module->name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (deferred_log_module_t *m = __atomic_load_n(&s_modules, __ATOMIC_ACQUIRE); m != NULL; m = m->next) {
+        if (m == module) {
+            return ESP_OK;
+        }
+    }
+    module->next = __atomic_load_n(&s_modules, __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&s_modules, &module->next, module, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+    }
+    return ESP_OK;
+}
+
+esp_err_t deferred_log_set_level(const char *name, size_t len, dlog_level_t level)
+{
+    bool all = len == 1 && name[0] == '*';
+    bool found = false;
+
+    for (deferred_log_module_t *m = __atomic_load_n(&s_modules, __ATOMIC_ACQUIRE); m != NULL; m = m->next) {
+        if (all || (strlen(m->name) == len && strncasecmp(m->name, name, len) == 0)) {
+            __atomic_store_n(&m->level, (uint8_t)level, __ATOMIC_RELAXED);
+            found = true;
+        }
+    }
+    return found ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+bool deferred_log_write(const deferred_log_module_t *module, const dlog_site_t *site,
+                        const dlog_arg_t *args)
+{
+    uint8_t arg_count = site->arg_count <= DEFERRED_LOG_MAX_ARGS ? site->arg_count : DEFERRED_LOG_MAX_ARGS;
+    uint32_t pos = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+    dlog_record_t *slot;
+
+    for (;;) {
+        slot = &s_ring[pos & RING_MASK];
+        int32_t lag = (int32_t)(slot_turn(slot, pos & RING_MASK) - pos);
+        if (lag == 0) {
+            if (__atomic_compare_exchange_n(&s_head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (lag < 0) {
+            // The consumer has not freed this slot yet: full
+            __atomic_fetch_add(&s_dropped, 1, __ATOMIC_RELAXED);
+            return false;
+        } else {
+            pos = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    slot->site = site;
+    slot->module = module;
+    memcpy(slot->args, args, arg_count * sizeof(dlog_arg_t));
+    slot_set_turn(slot, pos & RING_MASK, pos + 1);
+    return true;
+}
+
+size_t deferred_log_drain(deferred_log_sink_t sink, void *ctx, size_t max)
+{
+    char line[DEFERRED_LOG_LINE_MAX];
+    size_t drained = 0;
+
+    while (drained < max) {
+        uint32_t index = s_tail & RING_MASK;
+        dlog_record_t *slot = &s_ring[index];
+        if (slot_turn(slot, index) != s_tail + 1) {
+            break;
+        }
+
+        // Copy out and free the slot before the slow part
+        dlog_record_t record = *slot;
+        slot_set_turn(slot, index, s_tail + DEFERRED_LOG_RECORDS);
+        s_tail++;
+
+        deferred_log_format(&record, line, sizeof(line));
+        sink(record.module, (dlog_level_t)record.site->level, record.timestamp_ms, line, ctx);
+        drained++;
+    }
+    return drained;
+}
+
+uint32_t deferred_log_dropped(void)
+{
+    return __atomic_load_n(&s_dropped, __ATOMIC_RELAXED);
+}
+
+/* Integer length modifiers, collapsed to one letter */
+typedef enum { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_Z, LEN_J, LEN_T } length_t;
+
+static long long narrow_signed(int64_t value, length_t length)
+{
+    switch (length) {
+        case LEN_HH: return (signed char)value;
+        case LEN_H: return (short)value;
+        case LEN_NONE: return (int)value;
+        case LEN_L: return (long)value;
+        case LEN_T: return (ptrdiff_t)value;
+        case LEN_Z: return (long long)(ptrdiff_t)(size_t)value;
+        default: return (long long)value;
+    }
+}
+
+static unsigned long long narrow_unsigned(int64_t value, length_t length)
+{
+    switch (length) {
+        case LEN_HH: return (unsigned char)value;
+        case LEN_H: return (unsigned short)value;
+        case LEN_NONE: return (unsigned int)value;
+        case LEN_L: return (unsigned long)value;
+        case LEN_Z: return (size_t)value;
+        case LEN_T: return (unsigned long long)(ptrdiff_t)value;
+        default: return (unsigned long long)value;
+    }
+}
+
+/* Appends snprintf output, keeping pos at the cut when the buffer is full */
+#define APPEND(...) do { \
+        int n_ = snprintf(buf + pos, len - pos, __VA_ARGS__); \
+        if (n_ > 0) { \
+            pos += (size_t)n_ < len - pos ? (size_t)n_ : len - pos - 1; \
+        } \
+    } while (0)
+
+size_t deferred_log_format(const dlog_record_t *record, char *buf, size_t len)
+{
+    const char *fmt = record->site->fmt;
+    size_t pos = 0;
+    uint8_t next = 0;
+    uint8_t arg_count = record->site->arg_count;
+
+    if (len == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+
+    while (*fmt != '\0' && pos < len - 1) {
+        if (*fmt != '%') {
+            const char *lit = strchr(fmt, '%');
+            size_t n = lit != NULL ? (size_t)(lit - fmt) : strlen(fmt);
+            APPEND("%.*s", (int)n, fmt);
+            fmt += n;
+            continue;
+        }
+        if (fmt[1] == '%') {
+            APPEND("%%");
+            fmt += 2;
+            continue;
+        }
+
+        // Copy "%[flags][width][.precision]", then read the length and conversion
+        char spec[24];
+        size_t s = 0;
+        const char *start = fmt++;
+        spec[s++] = '%';
+        while (*fmt != '\0' && strchr("-+ #0123456789.", *fmt) != NULL && s < sizeof(spec) - 4) {
+            spec[s++] = *fmt++;
+        }
+        length_t length = LEN_NONE;
+        if (fmt[0] == 'h' && fmt[1] == 'h') {
+            length = LEN_HH;
+            fmt += 2;
+        } else if (fmt[0] == 'l' && fmt[1] == 'l') {
+            length = LEN_LL;
+            fmt += 2;
+        } else if (*fmt != '\0' && strchr("hlzjtL", *fmt) != NULL) {
+            length = *fmt == 'h' ? LEN_H : *fmt == 'l' ? LEN_L : *fmt == 'z' ? LEN_Z :
+                     *fmt == 'j' ? LEN_J : *fmt == 't' ? LEN_T : LEN_NONE;
+            fmt++;
+        }
+        char conv = *fmt;
+        if (conv == '\0' || strchr("diuxXocfFeEgGsp", conv) == NULL) {
+            // Not something we can format (e.g. a '*' width): print it as is
+            APPEND("%.*s", (int)(fmt - start), start);
+            continue;
+        }
+        fmt++;
+        if (next >= arg_count || next >= DEFERRED_LOG_MAX_ARGS) {
+            APPEND("<?>");
+            continue;
+        }
+        const dlog_arg_t *arg = &record->args[next++];
+
+        switch (conv) {
+            case 'd':
+            case 'i':
+                memcpy(&spec[s], "ll", 2);
+                spec[s + 2] = conv;
+                spec[s + 3] = '\0';
+                APPEND(spec, narrow_signed(arg->i, length));
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                memcpy(&spec[s], "ll", 2);
+                spec[s + 2] = conv;
+                spec[s + 3] = '\0';
+                APPEND(spec, narrow_unsigned(arg->i, length));
+                break;
+            case 'c':
+                spec[s] = conv;
+                spec[s + 1] = '\0';
+                APPEND(spec, (int)arg->i);
+                break;
+            case 's':
+                spec[s] = conv;
+                spec[s + 1] = '\0';
+                APPEND(spec, arg->p != NULL ? (const char *)arg->p : "(null)");
+                break;
+            case 'p':
+                spec[s] = conv;
+                spec[s + 1] = '\0';
+                APPEND(spec, arg->p);
+                break;
+            default:
+                spec[s] = conv;
+                spec[s + 1] = '\0';
+                APPEND(spec, arg->f);
+                break;
+        }
+    }
+    return pos;
+}
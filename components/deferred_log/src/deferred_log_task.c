@@ -0,0 +1,60 @@
+/**
+ * @file deferred_log_task.c
+ * @brief Low-priority task that formats deferred records into the ESP log.
+ */
+
+#include "deferred_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#define DEFERRED_LOG_TASK_STACK_SIZE    3072    /* the formatting stack the hot paths no longer need */
+#define DEFERRED_LOG_TASK_PRIORITY      1
+#define DEFERRED_LOG_PERIOD_MS          50
+/* Records per pass before yielding, so a burst does not hog the core */
+#define DEFERRED_LOG_BATCH              16
+
+static const char *TAG = "DLOG";
+static TaskHandle_t s_task = NULL;
+
+static void to_esp_log(const deferred_log_module_t *module, dlog_level_t level,
+                       uint32_t timestamp_ms, const char *message, void *ctx)
+{
+    static const char letters[] = "NEWIDV";
+
+    (void)ctx;
+    // Same line layout as ESP_LOGx, stamped with the time of the call, not of the output
+    esp_log_write((esp_log_level_t)level, module->name, "%c (%lu) %s: %s\n",
+                  letters[level <= DLOG_LEVEL_VERBOSE ? level : DLOG_LEVEL_VERBOSE],
+                  (unsigned long)timestamp_ms, module->name, message);
+}
+
+static void deferred_log_task(void *pvParameters)
+{
+    uint32_t reported_drops = 0;
+
+    while (1) {
+        while (deferred_log_drain(to_esp_log, NULL, DEFERRED_LOG_BATCH) == DEFERRED_LOG_BATCH) {
+            taskYIELD();
+        }
+
+        uint32_t drops = deferred_log_dropped();
+        if (drops != reported_drops) {
+            ESP_LOGW(TAG, "%lu log records dropped (ring full)", (unsigned long)(drops - reported_drops));
+            reported_drops = drops;
+        }
+        vTaskDelay(pdMS_TO_TICKS(DEFERRED_LOG_PERIOD_MS));
+    }
+}
+
+esp_err_t deferred_log_start(void)
+{
+    if (s_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xTaskCreate(deferred_log_task, "DLOG TASK", DEFERRED_LOG_TASK_STACK_SIZE, NULL,
+                    DEFERRED_LOG_TASK_PRIORITY, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
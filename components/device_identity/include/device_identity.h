@@ -0,0 +1,56 @@
+/**
+ * @file device_identity.h
+ * @brief Room and device name of this node, provisioned once in NVS.
+ *
+ * Every topic of the node starts with its prefix: "<room>", or
+ * "<room>/<device>" when a device name is provisioned (several nodes in one
+ * room). The names live in the "identity" NVS namespace, keys "room" and
+ * "device", so one firmware image serves the whole fleet; nodes without
+ * them use DEVICE_ROOM / DEVICE_NAME from menuconfig.
+ */
+
+#ifndef DEVICE_IDENTITY_H
+#define DEVICE_IDENTITY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define DEVICE_IDENTITY_NAME_MAX_LEN    31
+#define DEVICE_IDENTITY_PREFIX_MAX_LEN  (2 * DEVICE_IDENTITY_NAME_MAX_LEN + 1)
+
+typedef struct {
+    char room[DEVICE_IDENTITY_NAME_MAX_LEN + 1];
+    char device[DEVICE_IDENTITY_NAME_MAX_LEN + 1];     /* "" if not provisioned */
+    char prefix[DEVICE_IDENTITY_PREFIX_MAX_LEN + 1];
+} device_identity_t;
+
+/**
+ * @brief Reads the identity from NVS, falling back to the menuconfig
+ *        defaults for missing or invalid names. NVS must be initialized.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if the defaults are invalid too.
+ */
+esp_err_t device_identity_load(device_identity_t *identity);
+
+/**
+ * @brief Stores a new identity; it takes effect on the next boot.
+ * @param [in] device Device name, or "" for a single node per room.
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an invalid name, or an NVS error.
+ */
+esp_err_t device_identity_store(const char *room, const char *device);
+
+/**
+ * @brief Checks a room or device name: 1 to DEVICE_IDENTITY_NAME_MAX_LEN
+ *        characters out of [A-Za-z0-9_-], so it is a single topic level
+ *        without wildcards, and not "all", which addresses every node.
+ */
+bool device_identity_name_valid(const char *name);
+
+/**
+ * @brief Writes "<prefix>/<suffix>" into buf.
+ * @return ESP_OK, or ESP_ERR_INVALID_SIZE if buf is too small.
+ */
+esp_err_t device_identity_topic(const device_identity_t *identity, const char *suffix,
+                                char *buf, size_t len);
+
+#endif // DEVICE_IDENTITY_H
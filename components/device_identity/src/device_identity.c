@@ -0,0 +1,119 @@
+/**
+ * @file device_identity.c
+ * @brief Loads and stores the node identity in NVS.
+ */
+
+#include "device_identity.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+
+#define IDENTITY_NVS_NAMESPACE  "identity"
+
+static const char *TAG = "IDENTITY";
+
+bool device_identity_name_valid(const char *name)
+{
+    size_t len = strlen(name);
+
+    // "all" is the broadcast level
+    if (len == 0 || len > DEVICE_IDENTITY_NAME_MAX_LEN || strcmp(name, "all") == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = name[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+              c == '_' || c == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Reads key into buf if present and valid; leaves buf alone otherwise */
+static void load_name(nvs_handle_t nvs, const char *key, char *buf, size_t size)
+{
+    char name[DEVICE_IDENTITY_NAME_MAX_LEN + 1];
+    size_t len = sizeof(name);
+
+    esp_err_t err = nvs_get_str(nvs, key, name, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return;
+    }
+    if (err != ESP_OK || !device_identity_name_valid(name)) {
+        ESP_LOGW(TAG, "Ignoring invalid %s in NVS", key);
+        return;
+    }
+    snprintf(buf, size, "%s", name);
+}
+
+esp_err_t device_identity_load(device_identity_t *identity)
+{
+    nvs_handle_t nvs;
+
+    if (identity == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    snprintf(identity->room, sizeof(identity->room), "%s", CONFIG_DEVICE_ROOM);
+    snprintf(identity->device, sizeof(identity->device), "%s", CONFIG_DEVICE_NAME);
+    if (!device_identity_name_valid(identity->room) ||
+        (identity->device[0] != '\0' && !device_identity_name_valid(identity->device))) {
+        ESP_LOGE(TAG, "Invalid DEVICE_ROOM / DEVICE_NAME in menuconfig");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (nvs_open(IDENTITY_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        load_name(nvs, "room", identity->room, sizeof(identity->room));
+        load_name(nvs, "device", identity->device, sizeof(identity->device));
+        nvs_close(nvs);
+    } else {
+        ESP_LOGW(TAG, "Not provisioned, using the defaults");
+    }
+
+    if (identity->device[0] != '\0') {
+        snprintf(identity->prefix, sizeof(identity->prefix), "%s/%s", identity->room, identity->device);
+    } else {
+        snprintf(identity->prefix, sizeof(identity->prefix), "%s", identity->room);
+    }
+    ESP_LOGI(TAG, "Topic prefix: %s", identity->prefix);
+    return ESP_OK;
+}
+
+esp_err_t device_identity_store(const char *room, const char *device)
+{
+    nvs_handle_t nvs;
+
+    if (room == NULL || device == NULL || !device_identity_name_valid(room) ||
+        (device[0] != '\0' && !device_identity_name_valid(device))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = nvs_open(IDENTITY_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_str(nvs, "room", room);
+    if (err == ESP_OK) {
+        err = device[0] != '\0' ? nvs_set_str(nvs, "device", device) : nvs_erase_key(nvs, "device");
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+esp_err_t device_identity_topic(const device_identity_t *identity, const char *suffix,
+                                char *buf, size_t len)
+{
+    int n = snprintf(buf, len, "%s/%s", identity->prefix, suffix);
+    if (n < 0 || (size_t)n >= len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
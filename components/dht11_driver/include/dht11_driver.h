@@ -3,6 +3,10 @@
 
 #include <stdint.h>
 #include "esp_err.h"
+#include "dht_decoder.h"
+
+/* Shortest start signal: DHT11 needs >= 18 ms, DHT22 >= 1 ms */
+#define DHT_START_LOW_MS    20
 
 typedef struct
 {
@@ -13,17 +17,37 @@ typedef struct
 } dht11_data_t;
 
 /**
- * @brief Configures the specified GPIO pin as Input/Output Open-Drain and initializes the internal driver context.
- * @param [in] pin GPIO number to which the DHT11 data line is connected.
+ * @brief Configures the specified GPIO pin as Input/Output Open-Drain and sets up an
+ *        RMT receive channel on it to capture the sensor's pulse train.
+ * @param [in] pin GPIO number to which the DHT data line is connected.
+ * @param [in] type DHT_TYPE_DHT11 or DHT_TYPE_DHT22, selects the value format.
  * @return ESP_OK on success, or an error code on failure.
  */
-esp_err_t dht11_init(uint8_t pin);
+esp_err_t dht11_init(uint8_t pin, dht_type_t type);
+
+/**
+ * @brief Pulls the line low to begin the start signal and returns at once.
+ *        dht11_fetch() must follow after at least DHT_START_LOW_MS.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE before dht11_init().
+ */
+esp_err_t dht11_start(void);
 
 /**
- * @brief Executes the 1-Wire protocol (Start signal -> Response -> Data transmission) using precise microsecond delays to read 40 bits of data.
+ * @brief Ends the start signal begun by dht11_start(), lets the RMT
+ *        peripheral record the response and decodes it (about 5 ms).
+ * @param [out] data Receives temperature, humidity and timestamp.
+ * @return As dht11_read().
+ */
+esp_err_t dht11_fetch(dht11_data_t *data);
+
+/**
+ * @brief Sends the start signal (the task sleeps while the line is held low),
+ *        lets the RMT peripheral record the response and 40 data bits without
+ *        CPU involvement, then decodes the captured pulses.
  * @param [out] data Pointer to a dht11_data_t structure to store the read temperature, humidity, and timestamp.
- * @return ESP_OK on success, or an error code on failure.
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the sensor did not answer,
+ *         ESP_ERR_INVALID_CRC on a checksum mismatch, or an error code on failure.
  */
 esp_err_t dht11_read(dht11_data_t *data);
 
-#endif // DHT11_DRIVER_H
\ No newline at end of file
+#endif // DHT11_DRIVER_H
@@ -0,0 +1,56 @@
+/**
+ * @file dht_decoder.h
+ * @brief Hardware-independent decoding of the DHT11/DHT22 single-wire frame.
+ *
+ * The capture layer records the line as a list of level/duration pulses; this
+ * module turns them into the 5-byte frame and the frame into physical values.
+ * It has no driver dependencies and also builds on the host.
+ */
+
+#ifndef DHT_DECODER_H
+#define DHT_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define DHT_FRAME_BITS      40
+#define DHT_FRAME_LEN       5
+
+/* A "1" bit holds the line high for ~70 us, a "0" bit for ~26-28 us */
+#define DHT_BIT_THRESHOLD_US    48
+#define DHT_BIT_HIGH_MIN_US     10
+#define DHT_BIT_HIGH_MAX_US     100
+
+typedef enum {
+    DHT_TYPE_DHT11,
+    DHT_TYPE_DHT22,
+} dht_type_t;
+
+typedef struct {
+    uint16_t duration_us;
+    uint8_t level;
+} dht_pulse_t;
+
+/**
+ * @brief Extracts the 40 data bits from a captured pulse train. The bits are
+ *        the last 40 high pulses that are followed by a low pulse, so leading
+ *        pulses (start signal release, sensor response) are skipped.
+ * @param [in] pulses Captured pulses in line order.
+ * @param [in] count Number of pulses.
+ * @param [out] frame Receives the 5 frame bytes.
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if fewer than 40 bits were
+ *         captured, ESP_ERR_INVALID_RESPONSE for a bit pulse out of range,
+ *         ESP_ERR_INVALID_CRC if the checksum does not match.
+ */
+esp_err_t dht_decode_pulses(const dht_pulse_t *pulses, size_t count, uint8_t frame[DHT_FRAME_LEN]);
+
+/**
+ * @brief Converts a frame to temperature [C] and relative humidity [%],
+ *        using the DHT11 (integer + tenths) or DHT22 (0.1 unit, sign bit) format.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a NULL pointer.
+ */
+esp_err_t dht_frame_to_values(const uint8_t frame[DHT_FRAME_LEN], dht_type_t type,
+                              float *temperature, float *humidity);
+
+#endif // DHT_DECODER_H
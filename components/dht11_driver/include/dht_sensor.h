@@ -0,0 +1,41 @@
+/**
+ * @file dht_sensor.h
+ * @brief The DHT11/DHT22 behind the common sensor interface of sensor_hub.
+ *
+ * Start pulls the line low and returns; the hub fetches DHT_START_LOW_MS
+ * later, so the start signal overlaps with the other sensors instead of
+ * blocking the sampling task. The driver has one context, so there is at
+ * most one DHT per node.
+ */
+
+#ifndef DHT_SENSOR_H
+#define DHT_SENSOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "dht11_driver.h"
+#include "sensor_hub.h"
+
+/* Shortest interval between two measurements (datasheets) */
+#define DHT11_PERIOD_MS     1000
+#define DHT22_PERIOD_MS     2000
+
+typedef struct {
+    uint8_t pin;
+    dht_type_t type;
+    bool ready;                 /* dht11_init() succeeded */
+} dht_sensor_t;
+
+/**
+ * @brief Fills in a sensor_hub driver; the pin and RMT channel are set up
+ *        when the hub adds the sensor.
+ * @param [out] sensor Sensor state; must outlive the hub.
+ * @param [in] pin GPIO of the data line.
+ * @param [in] type DHT_TYPE_DHT11 or DHT_TYPE_DHT22.
+ * @param [out] driver Driver to pass to sensor_hub_add().
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG on a NULL pointer.
+ */
+esp_err_t dht_sensor_driver(dht_sensor_t *sensor, uint8_t pin, dht_type_t type, sensor_driver_t *driver);
+
+#endif // DHT_SENSOR_H
@@ -1,69 +1,93 @@
 #include "dht11_driver.h"
 #include "driver/gpio.h"
+#include "driver/rmt_rx.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
 #include "esp_timer.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include <string.h>
-#include <rom/ets_sys.h>
 
-#define CHECK_TIMEOUT(action, msg, ...) \
-    if ((action) != ESP_OK) { \
-        ESP_LOGE(TAG, "TIMEOUT: " msg, ##__VA_ARGS__); \
-        return ESP_ERR_TIMEOUT; \
-    }
+#define DHT_RMT_RESOLUTION_HZ   1000000     /* 1 tick = 1 us */
+#define DHT_RMT_SYMBOLS         64          /* ~43 needed: response + 40 bits + trailer */
+#define DHT_FRAME_TIMEOUT_MS    20          /* a full frame takes ~5 ms */
+/* Shorter pulses are glitches; a longer steady level ends the frame */
+#define DHT_GLITCH_NS           2000
+#define DHT_IDLE_NS             200000
 
 static const char *TAG = "DHT11_DRIVER";
 
 typedef struct {
     uint8_t pin;
+    dht_type_t type;
     bool initialized;
+    rmt_channel_handle_t rx_chan;
+    QueueHandle_t rx_done;
     dht11_data_t last_read;
 } dht11_context_t;
 
 static dht11_context_t dht11_ctx = {0};
+static rmt_symbol_word_t rx_symbols[DHT_RMT_SYMBOLS];
+static dht_pulse_t pulses[DHT_RMT_SYMBOLS * 2];
+
+static bool IRAM_ATTR dht11_rx_done_cb(rmt_channel_handle_t channel,
+                                       const rmt_rx_done_event_data_t *edata, void *user_ctx)
+{
+    BaseType_t woken = pdFALSE;
+    xQueueSendFromISR((QueueHandle_t)user_ctx, edata, &woken);
+    return woken == pdTRUE;
+}
 
-static esp_err_t dht11_wait_for_level(int target_level, uint32_t timeout_us)
+/* Flattens RMT symbols (two level/duration halves each) into a pulse list */
+static size_t dht11_symbols_to_pulses(const rmt_symbol_word_t *symbols, size_t num_symbols)
 {
-    int64_t start_time = esp_timer_get_time();
-    while ((esp_timer_get_time() - start_time) < timeout_us) {
-        if (gpio_get_level(dht11_ctx.pin) == target_level) {
-            return ESP_OK;
+    size_t n = 0;
+    for (size_t i = 0; i < num_symbols; i++) {
+        if (symbols[i].duration0 == 0) {
+            break;
         }
+        pulses[n++] = (dht_pulse_t){ .duration_us = symbols[i].duration0, .level = symbols[i].level0 };
+        if (symbols[i].duration1 == 0) {
+            break;
+        }
+        pulses[n++] = (dht_pulse_t){ .duration_us = symbols[i].duration1, .level = symbols[i].level1 };
     }
-    return ESP_ERR_TIMEOUT;
+    return n;
 }
 
-static esp_err_t dht11_send_start_signal()
+esp_err_t dht11_init(uint8_t pin, dht_type_t type)
 {
-    // USE OPEN-DRAIN mode to allow pulling the line low
-    // Set pin to output
-    // gpio_set_direction(dht11_ctx.pin, GPIO_MODE_OUTPUT);
-    
-    // Pull the pin low for at least 18ms
-    gpio_set_level(dht11_ctx.pin, 0);
-    ets_delay_us(20000); // 20ms
-
-    // Pull the pin high for 20-40us
-    gpio_set_level(dht11_ctx.pin, 1);
-    ets_delay_us(30);
-
-    // Use OPEN-DRAIN mode, so we can release the line
-    // Set pin to input to read data
-    // gpio_set_direction(dht11_ctx.pin, GPIO_MODE_INPUT);
+    // Initialize the DHT sensor on the specified GPIO pin
+    dht11_ctx.pin = pin;
+    dht11_ctx.type = type;
 
-    return ESP_OK;
-}
+    rmt_rx_channel_config_t rx_cfg = {
+        .gpio_num = pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = DHT_RMT_RESOLUTION_HZ,
+        .mem_block_symbols = DHT_RMT_SYMBOLS,
+    };
+    esp_err_t err = rmt_new_rx_channel(&rx_cfg, &dht11_ctx.rx_chan);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create RMT channel on GPIO %d: %s", pin, esp_err_to_name(err));
+        return err;
+    }
 
-static bool dht11_validate_data(const uint8_t *data) {
-    uint8_t checksum = data[0] + data[1] + data[2] + data[3];
-    return (checksum == data[4]);
-}
+    dht11_ctx.rx_done = xQueueCreate(1, sizeof(rmt_rx_done_event_data_t));
+    if (dht11_ctx.rx_done == NULL) {
+        rmt_del_channel(dht11_ctx.rx_chan);
+        return ESP_ERR_NO_MEM;
+    }
 
-esp_err_t dht11_init(uint8_t pin)
-{
-    // Initialize the DHT11 sensor on the specified GPIO pin
-    dht11_ctx.pin = pin;
+    rmt_rx_event_callbacks_t cbs = {
+        .on_recv_done = dht11_rx_done_cb,
+    };
+    ESP_ERROR_CHECK(rmt_rx_register_event_callbacks(dht11_ctx.rx_chan, &cbs, dht11_ctx.rx_done));
+    ESP_ERROR_CHECK(rmt_enable(dht11_ctx.rx_chan));
 
+    // USE OPEN-DRAIN mode: we pull the line low for the start signal while
+    // the RMT input keeps listening on the same pin
     gpio_config_t io_conf = {
         .pin_bit_mask = (1ULL << pin),
         .mode = GPIO_MODE_INPUT_OUTPUT_OD,
@@ -72,18 +96,32 @@ esp_err_t dht11_init(uint8_t pin)
         .intr_type = GPIO_INTR_DISABLE,
     };
 
-    esp_err_t err = gpio_config(&io_conf);
+    err = gpio_config(&io_conf);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to configure GPIO %d: %s", pin, esp_err_to_name(err));
         return err;
     }
+    gpio_set_level(pin, 1);
 
     dht11_ctx.initialized = true;
-    ESP_LOGI(TAG, "DHT11 Sensor initialized on GPIO %d", pin);
+    ESP_LOGI(TAG, "%s Sensor initialized on GPIO %d (RMT capture)",
+             type == DHT_TYPE_DHT22 ? "DHT22" : "DHT11", pin);
     return ESP_OK;
 }
 
-esp_err_t dht11_read(dht11_data_t *data)
+esp_err_t dht11_start(void)
+{
+    if (!dht11_ctx.initialized) {
+        ESP_LOGE(TAG, "DHT11 sensor not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Start signal: hold the line low until dht11_fetch() releases it
+    gpio_set_level(dht11_ctx.pin, 0);
+    return ESP_OK;
+}
+
+esp_err_t dht11_fetch(dht11_data_t *data)
 {
     if (!dht11_ctx.initialized) {
         ESP_LOGE(TAG, "DHT11 sensor not initialized");
@@ -91,55 +129,65 @@ esp_err_t dht11_read(dht11_data_t *data)
     }
 
     if (data == NULL) {
+        gpio_set_level(dht11_ctx.pin, 1);
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Send start signal
-    dht11_send_start_signal();
-    
-    // Wait for sensor response
-    // 1. Wait for sensor response (DHT pull-down 0)
-    CHECK_TIMEOUT(dht11_wait_for_level(0, 1000), "Wait response LOW");
-    
-    // 2. Wait for sensor response (DHT pull-up 1 to prepare for data transmission)
-    CHECK_TIMEOUT(dht11_wait_for_level(1, 1000), "Wait response HIGH");
-    
-    // 3. Wait for sensor to pull low to start data transmission
-    CHECK_TIMEOUT(dht11_wait_for_level(0, 1000), "Wait data transmission START LOW");
-    
-    uint8_t data_buffer[5] = {0};
-
-    // Read 40 bits (5 bytes) of data
-    for (int i = 0; i < 40; i++) {
-        // Wait for bit start (high pulse to measure length)
-        CHECK_TIMEOUT(dht11_wait_for_level(1, 1000), "Bit %d start", i);
-
-        // Measure the length of the high pulse
-        int64_t start_time = esp_timer_get_time();
-
-        // Wait for bit end
-        CHECK_TIMEOUT(dht11_wait_for_level(0, 1000), "Bit %d end", i);
-
-        // Calculate pulse duration
-        int64_t pulse_duration = esp_timer_get_time() - start_time;
+    // Arm the capture, then release the line and let the sensor answer
+    rmt_receive_config_t rx_cfg = {
+        .signal_range_min_ns = DHT_GLITCH_NS,
+        .signal_range_max_ns = DHT_IDLE_NS,
+    };
+    xQueueReset(dht11_ctx.rx_done);
+    esp_err_t err = rmt_receive(dht11_ctx.rx_chan, rx_symbols, sizeof(rx_symbols), &rx_cfg);
+    gpio_set_level(dht11_ctx.pin, 1);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start capture: %s", esp_err_to_name(err));
+        return err;
+    }
 
-        // Determine if bit is 0 or 1
-        if (pulse_duration > 50) {
-            data_buffer[i / 8] |= (1 << (7 - (i % 8)));
+    rmt_rx_done_event_data_t rx_data;
+    if (xQueueReceive(dht11_ctx.rx_done, &rx_data, pdMS_TO_TICKS(DHT_FRAME_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGE(TAG, "TIMEOUT: no response from sensor");
+        // The capture is still armed; without a reset every later rmt_receive fails with INVALID_STATE
+        err = rmt_disable(dht11_ctx.rx_chan);
+        if (err == ESP_OK) {
+            err = rmt_enable(dht11_ctx.rx_chan);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to abort capture: %s", esp_err_to_name(err));
         }
+        return ESP_ERR_TIMEOUT;
     }
 
-    if (dht11_validate_data(data_buffer)) {
-        data->humidity = data_buffer[0] + data_buffer[1] * 0.1f;
-        data->temperature = data_buffer[2] + data_buffer[3] * 0.1f;
-        data->timestamp = (uint32_t)(esp_timer_get_time() / 1000);
-    } else {
-        return ESP_ERR_INVALID_CRC;
+    size_t n = dht11_symbols_to_pulses(rx_data.received_symbols, rx_data.num_symbols);
+    uint8_t frame[DHT_FRAME_LEN];
+    err = dht_decode_pulses(pulses, n, frame);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to decode %u pulses: %s", (unsigned)n, esp_err_to_name(err));
+        return err;
     }
 
+    dht_frame_to_values(frame, dht11_ctx.type, &data->temperature, &data->humidity);
+    data->timestamp = (uint32_t)(esp_timer_get_time() / 1000);
+
     // Update context
     memcpy(&dht11_ctx.last_read, data, sizeof(dht11_data_t));
     
     return ESP_OK;
 }
 
+esp_err_t dht11_read(dht11_data_t *data)
+{
+    if (data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = dht11_start();
+    if (err != ESP_OK) {
+        return err;
+    }
+    // The task sleeps instead of spinning while the line is held low
+    vTaskDelay(pdMS_TO_TICKS(DHT_START_LOW_MS));
+    return dht11_fetch(data);
+}
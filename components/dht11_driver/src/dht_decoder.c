@@ -0,0 +1,60 @@
+#include "dht_decoder.h"
+#include <string.h>
+
+esp_err_t dht_decode_pulses(const dht_pulse_t *pulses, size_t count, uint8_t frame[DHT_FRAME_LEN])
+{
+    if (pulses == NULL || frame == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Walk backwards: the data bits are the last complete high pulses
+    uint16_t highs[DHT_FRAME_BITS];
+    int found = 0;
+    for (size_t i = count; i-- > 1 && found < DHT_FRAME_BITS; ) {
+        if (pulses[i - 1].level == 1 && pulses[i].level == 0) {
+            highs[DHT_FRAME_BITS - 1 - found] = pulses[i - 1].duration_us;
+            found++;
+        }
+    }
+    if (found < DHT_FRAME_BITS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memset(frame, 0, DHT_FRAME_LEN);
+    for (int bit = 0; bit < DHT_FRAME_BITS; bit++) {
+        uint16_t d = highs[bit];
+        if (d < DHT_BIT_HIGH_MIN_US || d > DHT_BIT_HIGH_MAX_US) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (d > DHT_BIT_THRESHOLD_US) {
+            frame[bit / 8] |= (uint8_t)(1 << (7 - (bit % 8)));
+        }
+    }
+
+    uint8_t checksum = frame[0] + frame[1] + frame[2] + frame[3];
+    return checksum == frame[4] ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+esp_err_t dht_frame_to_values(const uint8_t frame[DHT_FRAME_LEN], dht_type_t type,
+                              float *temperature, float *humidity)
+{
+    if (frame == NULL || temperature == NULL || humidity == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (type == DHT_TYPE_DHT22) {
+        *humidity = (float)((frame[0] << 8) | frame[1]) * 0.1f;
+        *temperature = (float)(((frame[2] & 0x7F) << 8) | frame[3]) * 0.1f;
+        if (frame[2] & 0x80) {
+            *temperature = -*temperature;
+        }
+    } else {
+        // DHT11: integer part + tenths; newer parts flag negative values in bit 7 of the tenths
+        *humidity = frame[0] + frame[1] * 0.1f;
+        *temperature = frame[2] + (frame[3] & 0x7F) * 0.1f;
+        if (frame[3] & 0x80) {
+            *temperature = -*temperature;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,48 @@
+#include "dht_sensor.h"
+#include <stddef.h>
+
+static esp_err_t dht_sensor_init(void *ctx)
+{
+    dht_sensor_t *sensor = ctx;
+    // The RMT channel is set up once; a sensor that stops answering needs nothing more than the next start
+    if (!sensor->ready) {
+        sensor->ready = dht11_init(sensor->pin, sensor->type) == ESP_OK;
+    }
+    return sensor->ready ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t dht_sensor_start(void *ctx, uint32_t *ready_ms)
+{
+    *ready_ms = DHT_START_LOW_MS;
+    return dht11_start();
+}
+
+static esp_err_t dht_sensor_fetch(void *ctx, telemetry_sample_t *sample)
+{
+    dht11_data_t data;
+    esp_err_t err = dht11_fetch(&data);
+    if (err == ESP_OK) {
+        sample->temperature = data.temperature;
+        sample->humidity = data.humidity;
+    }
+    return err;
+}
+
+esp_err_t dht_sensor_driver(dht_sensor_t *sensor, uint8_t pin, dht_type_t type, sensor_driver_t *driver)
+{
+    if (sensor == NULL || driver == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *sensor = (dht_sensor_t){ .pin = pin, .type = type };
+    *driver = (sensor_driver_t){
+        .name = type == DHT_TYPE_DHT22 ? "dht22" : "dht11",
+        .caps = SENSOR_CAP_TEMPERATURE | SENSOR_CAP_HUMIDITY,
+        .period_ms = type == DHT_TYPE_DHT22 ? DHT22_PERIOD_MS : DHT11_PERIOD_MS,
+        .init = dht_sensor_init,
+        .start = dht_sensor_start,
+        .fetch = dht_sensor_fetch,
+        .ctx = sensor,
+    };
+    return ESP_OK;
+}
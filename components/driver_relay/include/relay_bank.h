@@ -0,0 +1,73 @@
+/**
+ * @file relay_bank.h
+ * @brief A set of relay channels switched together in one output update.
+ *
+ * The bank keeps a shadow of the logical channel states (bit i = channel i
+ * on) and hands the backend a complete frame of physical levels, with
+ * active-low channels already inverted. The backend turns that frame into a
+ * single hardware operation: one GPIO output register write or one latched
+ * 74HC595 frame, so every channel in a batch changes at the same instant.
+ *
+ * Reads come from the shadow and never touch the pins. The bank is not
+ * thread-safe; it is meant to be owned by a single task.
+ */
+
+#ifndef RELAY_BANK_H
+#define RELAY_BANK_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define RELAY_BANK_MAX_CHANNELS     32
+
+typedef struct {
+    /* Drives all channels to levels (bit i = physical level of channel i) at once */
+    esp_err_t (*write)(void *ctx, uint32_t levels);
+    /* Optional: enables the outputs once the first frame has been written */
+    esp_err_t (*enable)(void *ctx);
+    void *ctx;
+} relay_bank_backend_t;
+
+typedef struct {
+    relay_bank_backend_t backend;
+    uint32_t channel_mask;      /* one bit per channel */
+    uint32_t active_low;        /* bit i set: channel i is on when its output is low */
+    uint32_t state;             /* shadow of the logical states last written */
+} relay_bank_t;
+
+/**
+ * @brief Initializes the bank, writes an all-off frame and enables the outputs.
+ * @param [out] bank Bank to initialize.
+ * @param [in] backend Output backend, copied into the bank.
+ * @param [in] channel_count Number of channels, 1..RELAY_BANK_MAX_CHANNELS.
+ * @param [in] active_low_mask Bit i set if channel i is active-low.
+ * @return ESP_OK on success, or the backend error.
+ */
+esp_err_t relay_bank_init(relay_bank_t *bank, const relay_bank_backend_t *backend,
+                          uint8_t channel_count, uint32_t active_low_mask);
+
+/**
+ * @brief Sets the channels in mask to the matching bits of states in one
+ *        backend write. Nothing is written if no channel changes.
+ * @return ESP_OK on success (the shadow is updated), or the backend error
+ *         (the shadow is left unchanged).
+ */
+esp_err_t relay_bank_apply(relay_bank_t *bank, uint32_t mask, uint32_t states);
+
+/**
+ * @brief Logical channel states from the shadow, bit i = channel i on.
+ */
+static inline uint32_t relay_bank_get_states(const relay_bank_t *bank)
+{
+    return bank->state;
+}
+
+/**
+ * @brief Physical output levels corresponding to a set of logical states.
+ */
+static inline uint32_t relay_bank_levels(const relay_bank_t *bank, uint32_t states)
+{
+    return (states ^ bank->active_low) & bank->channel_mask;
+}
+
+#endif // RELAY_BANK_H
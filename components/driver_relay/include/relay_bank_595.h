@@ -0,0 +1,43 @@
+/**
+ * @file relay_bank_595.h
+ * @brief Relay bank backend for daisy-chained 74HC595 shift registers.
+ *
+ * A frame is clocked into the shift stage and then latched, so all outputs
+ * change together on the latch edge regardless of how long shifting took.
+ * Channel i is output Qi of the chain (Q0 of the first register is channel 0).
+ */
+
+#ifndef RELAY_BANK_595_H
+#define RELAY_BANK_595_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "relay_bank.h"
+
+#define RELAY_BANK_595_NO_OE    (-1)
+
+typedef struct {
+    uint8_t data_pin;       /* SER */
+    uint8_t clock_pin;      /* SRCLK */
+    uint8_t latch_pin;      /* RCLK */
+    int8_t oe_pin;          /* /OE, or RELAY_BANK_595_NO_OE if tied low */
+    uint8_t chips;          /* registers in the chain, 1..4 */
+} relay_bank_595_config_t;
+
+typedef struct {
+    relay_bank_595_config_t cfg;
+    uint8_t bits;
+} relay_bank_595_t;
+
+/**
+ * @brief Configures the control pins (outputs disabled through /OE if wired)
+ *        and fills in a backend for relay_bank_init().
+ * @param [out] sr Backend state; must outlive the bank.
+ * @param [in] config Pin assignment and chain length.
+ * @param [out] backend Backend to pass to relay_bank_init().
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t relay_bank_595_init(relay_bank_595_t *sr, const relay_bank_595_config_t *config,
+                              relay_bank_backend_t *backend);
+
+#endif // RELAY_BANK_595_H
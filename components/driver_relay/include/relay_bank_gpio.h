@@ -0,0 +1,41 @@
+/**
+ * @file relay_bank_gpio.h
+ * @brief Relay bank backend driving one GPIO per channel through the GPIO
+ *        output set/clear registers.
+ *
+ * All pins must live in the same 32-pin output register (GPIO 0-31, or
+ * GPIO 32 and up on targets that have them) so a frame is applied with the
+ * set and clear registers of that one bank: channels switching off change
+ * in one store, channels switching on in the next, with interrupts masked
+ * in between.
+ */
+
+#ifndef RELAY_BANK_GPIO_H
+#define RELAY_BANK_GPIO_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "relay_bank.h"
+
+typedef struct {
+    uint32_t pin_bits[RELAY_BANK_MAX_CHANNELS];  /* register bit of each channel */
+    uint32_t pin_mask;                           /* all register bits of the bank */
+    uint8_t count;
+    uint8_t high_bank;                           /* pins are GPIO 32 and up */
+} relay_bank_gpio_t;
+
+/**
+ * @brief Validates the pins and fills in a backend for relay_bank_init().
+ *        The pins are switched to outputs by the backend's enable hook,
+ *        after the bank has written its first frame.
+ * @param [out] gpio Backend state; must outlive the bank.
+ * @param [in] pins GPIO number of each channel, in channel order.
+ * @param [in] count Number of channels.
+ * @param [out] backend Backend to pass to relay_bank_init().
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an invalid pin or pins
+ *         spread over two output registers.
+ */
+esp_err_t relay_bank_gpio_init(relay_bank_gpio_t *gpio, const uint8_t *pins, uint8_t count,
+                               relay_bank_backend_t *backend);
+
+#endif // RELAY_BANK_GPIO_H
@@ -59,24 +59,17 @@ esp_err_t relay_init(relay_config_t *config)
 esp_err_t relay_set_level(relay_config_t *config, uint32_t level) {
     if (config == NULL) return ESP_ERR_INVALID_ARG;
     
-    ESP_LOGI(TAG, "[relay_set_level] Setting GPIO %d (Type: %s) to level: %lu", 
-             config->gpio_pin,
-             config->type == RELAY_ACTIVE_HIGH ? "Active-High" : "Active-Low",
-             level);
-    
     // Xử lý Active High/Low
     uint32_t physical_level = level;
     if (config->type == RELAY_ACTIVE_LOW) {
         physical_level = !level;
     }
 
-    ESP_LOGI(TAG, "[relay_set_level] Physical level to set: %lu", physical_level);
+    // Debug level is compiled out at the default maximum log level
+    ESP_LOGD(TAG, "GPIO %d: level %lu (physical %lu)", config->gpio_pin, level, physical_level);
     
     esp_err_t ret = gpio_set_level(config->gpio_pin, physical_level);
-    
-    if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "[relay_set_level] GPIO set successful");
-    } else {
+    if (ret != ESP_OK) {
         ESP_LOGE(TAG, "[relay_set_level] GPIO set failed: %s", esp_err_to_name(ret));
     }
     
@@ -117,13 +110,8 @@ esp_err_t relay_get_state(relay_config_t *config, relay_state_t *state)
         return ESP_ERR_INVALID_ARG;
     }
 
-    ESP_LOGI(TAG, "[relay_get_state] Reading GPIO %d (Type: %s)", 
-             config->gpio_pin,
-             config->type == RELAY_ACTIVE_HIGH ? "Active-High" : "Active-Low");
-
     // Read GPIO level
     int level = gpio_get_level(config->gpio_pin);
-    ESP_LOGI(TAG, "[relay_get_state] GPIO level: %d", level);
     
     // Interpret level based on relay type
     if (config->type == RELAY_ACTIVE_HIGH) {
@@ -131,8 +119,8 @@ esp_err_t relay_get_state(relay_config_t *config, relay_state_t *state)
     } else { // RELAY_ACTIVE_LOW
         *state = (level == 0) ? RELAY_STATE_ON : RELAY_STATE_OFF;
     }
-    
-    ESP_LOGI(TAG, "[relay_get_state] Relay state: %s", 
+
+    ESP_LOGD(TAG, "GPIO %d: level %d, relay %s", config->gpio_pin, level,
              *state == RELAY_STATE_ON ? "ON" : "OFF");
     
     return ESP_OK;
@@ -0,0 +1,59 @@
+/**
+ * @file relay_bank.c
+ * @brief Hardware-independent part of the relay bank: shadow state and
+ *        polarity. Builds unchanged on the host against a mock backend.
+ */
+
+#include "relay_bank.h"
+#include <stddef.h>
+
+/* Per-write tracing costs more than the write itself, so it is opt-in at build time */
+#if defined(CONFIG_RELAY_BANK_TRACE) && CONFIG_RELAY_BANK_TRACE
+#include "esp_log.h"
+static const char *TAG = "RELAY_BANK";
+#define BANK_TRACE(...)     ESP_LOGI(TAG, __VA_ARGS__)
+#else
+#define BANK_TRACE(...)     do { } while (0)
+#endif
+
+esp_err_t relay_bank_init(relay_bank_t *bank, const relay_bank_backend_t *backend,
+                          uint8_t channel_count, uint32_t active_low_mask)
+{
+    if (bank == NULL || backend == NULL || backend->write == NULL ||
+        channel_count == 0 || channel_count > RELAY_BANK_MAX_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bank->backend = *backend;
+    bank->channel_mask = channel_count == 32 ? UINT32_MAX : (1u << channel_count) - 1;
+    bank->active_low = active_low_mask & bank->channel_mask;
+    bank->state = 0;
+
+    // All off before the outputs are enabled, so active-low relays do not click on at boot
+    esp_err_t ret = bank->backend.write(bank->backend.ctx, relay_bank_levels(bank, 0));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (bank->backend.enable != NULL) {
+        ret = bank->backend.enable(bank->backend.ctx);
+    }
+    return ret;
+}
+
+esp_err_t relay_bank_apply(relay_bank_t *bank, uint32_t mask, uint32_t states)
+{
+    mask &= bank->channel_mask;
+    uint32_t target = (bank->state & ~mask) | (states & mask);
+    if (target == bank->state) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = bank->backend.write(bank->backend.ctx, relay_bank_levels(bank, target));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    BANK_TRACE("states 0x%08lx -> 0x%08lx", (unsigned long)bank->state, (unsigned long)target);
+    bank->state = target;
+    return ESP_OK;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file relay_bank_595.c
+ * @brief 74HC595 backend of the relay bank.
+ */
+
+#include "relay_bank_595.h"
+#include <stddef.h>
+#include "driver/gpio.h"
+
+static esp_err_t sr_bank_write(void *ctx, uint32_t levels)
+{
+    relay_bank_595_t *sr = ctx;
+
+    // The last bit shifted in ends up in Q0 of the first register
+    for (int bit = sr->bits - 1; bit >= 0; bit--) {
+        gpio_set_level(sr->cfg.data_pin, (levels >> bit) & 1);
+        gpio_set_level(sr->cfg.clock_pin, 1);
+        gpio_set_level(sr->cfg.clock_pin, 0);
+    }
+
+    // All outputs take the new frame on this edge
+    gpio_set_level(sr->cfg.latch_pin, 1);
+    gpio_set_level(sr->cfg.latch_pin, 0);
+    return ESP_OK;
+}
+
+static esp_err_t sr_bank_enable(void *ctx)
+{
+    relay_bank_595_t *sr = ctx;
+
+    if (sr->cfg.oe_pin != RELAY_BANK_595_NO_OE) {
+        return gpio_set_level(sr->cfg.oe_pin, 0);
+    }
+    return ESP_OK;
+}
+
+esp_err_t relay_bank_595_init(relay_bank_595_t *sr, const relay_bank_595_config_t *config,
+                              relay_bank_backend_t *backend)
+{
+    if (sr == NULL || config == NULL || backend == NULL ||
+        config->chips == 0 || config->chips * 8 > RELAY_BANK_MAX_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint64_t pin_mask = (1ULL << config->data_pin) | (1ULL << config->clock_pin) |
+                        (1ULL << config->latch_pin);
+    if (config->oe_pin != RELAY_BANK_595_NO_OE) {
+        pin_mask |= 1ULL << config->oe_pin;
+    }
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = pin_mask,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE
+    };
+
+    // Keep the outputs off until the bank has shifted in its first frame
+    if (config->oe_pin != RELAY_BANK_595_NO_OE) {
+        gpio_set_level(config->oe_pin, 1);
+    }
+    esp_err_t ret = gpio_config(&io_conf);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    gpio_set_level(config->clock_pin, 0);
+    gpio_set_level(config->latch_pin, 0);
+
+    sr->cfg = *config;
+    sr->bits = config->chips * 8;
+
+    backend->write = sr_bank_write;
+    backend->enable = sr_bank_enable;
+    backend->ctx = sr;
+    return ESP_OK;
+}
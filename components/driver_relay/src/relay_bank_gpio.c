@@ -0,0 +1,83 @@
+/**
+ * @file relay_bank_gpio.c
+ * @brief GPIO register backend of the relay bank.
+ */
+
+#include "relay_bank_gpio.h"
+#include <stddef.h>
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
+#include "soc/soc_caps.h"
+
+static portMUX_TYPE s_gpio_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_err_t gpio_bank_write(void *ctx, uint32_t levels)
+{
+    relay_bank_gpio_t *gpio = ctx;
+    uint32_t set = 0;
+
+    for (uint8_t i = 0; i < gpio->count; i++) {
+        if (levels & (1u << i)) {
+            set |= gpio->pin_bits[i];
+        }
+    }
+    uint32_t clear = gpio->pin_mask & ~set;
+
+    // Clear before set: loads switching off never overlap loads switching on
+    portENTER_CRITICAL(&s_gpio_lock);
+#if SOC_GPIO_PIN_COUNT > 32
+    if (gpio->high_bank) {
+        REG_WRITE(GPIO_OUT1_W1TC_REG, clear);
+        REG_WRITE(GPIO_OUT1_W1TS_REG, set);
+    } else
+#endif
+    {
+        REG_WRITE(GPIO_OUT_W1TC_REG, clear);
+        REG_WRITE(GPIO_OUT_W1TS_REG, set);
+    }
+    portEXIT_CRITICAL(&s_gpio_lock);
+    return ESP_OK;
+}
+
+static esp_err_t gpio_bank_enable(void *ctx)
+{
+    relay_bank_gpio_t *gpio = ctx;
+
+    // INPUT_OUTPUT keeps the pad readable for debugging; the bank never reads it
+    gpio_config_t io_conf = {
+        .pin_bit_mask = gpio->high_bank ? ((uint64_t)gpio->pin_mask << 32) : gpio->pin_mask,
+        .mode = GPIO_MODE_INPUT_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE
+    };
+    return gpio_config(&io_conf);
+}
+
+esp_err_t relay_bank_gpio_init(relay_bank_gpio_t *gpio, const uint8_t *pins, uint8_t count,
+                               relay_bank_backend_t *backend)
+{
+    if (gpio == NULL || pins == NULL || backend == NULL ||
+        count == 0 || count > RELAY_BANK_MAX_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    gpio->count = count;
+    gpio->pin_mask = 0;
+    gpio->high_bank = pins[0] >= 32;
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (!GPIO_IS_VALID_OUTPUT_GPIO(pins[i]) || (pins[i] >= 32) != gpio->high_bank) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        gpio->pin_bits[i] = 1u << (pins[i] & 31);
+        gpio->pin_mask |= gpio->pin_bits[i];
+    }
+
+    backend->write = gpio_bank_write;
+    backend->enable = gpio_bank_enable;
+    backend->ctx = gpio;
+    return ESP_OK;
+}
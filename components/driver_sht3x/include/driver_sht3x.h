@@ -1,34 +1,99 @@
 #ifndef SHT3X_H
 #define SHT3X_H
 
+#include <stdint.h>
 #include "esp_err.h"
-#include "driver/i2c.h"
+#include "service_i2c_bus.h"
 
-#define I2C_MASTER_NUM          I2C_NUM_0
-#define SHT3X_ADDR              0x44
-#define SHT3X_CMD_MEASURE_HIGH  0x2C06
+#define SHT3X_ADDR              0x44    /* ADDR pin low */
+#define SHT3X_ADDR_ALT          0x45    /* ADDR pin high */
+#define SHT3X_CMD_FETCH_DATA    0xE000
+#define SHT3X_CMD_BREAK         0x3093
+
+/* Standard/fast mode limits supported by the sensor */
+#define SHT3X_I2C_CLOCK_DEFAULT 100000
+#define SHT3X_I2C_CLOCK_MAX     1000000
 
 typedef struct {
     float temperature;
     float humidity;
 } sht3x_data_t;
 
+typedef enum {
+    SHT3X_REPEATABILITY_HIGH,
+    SHT3X_REPEATABILITY_MEDIUM,
+    SHT3X_REPEATABILITY_LOW,
+} sht3x_repeatability_t;
+
+/* Periodic acquisition rates in measurements per second */
+typedef enum {
+    SHT3X_RATE_0_5_MPS,
+    SHT3X_RATE_1_MPS,
+    SHT3X_RATE_2_MPS,
+    SHT3X_RATE_4_MPS,
+    SHT3X_RATE_10_MPS,
+} sht3x_rate_t;
+
+typedef struct {
+    uint8_t address;                        /* SHT3X_ADDR or SHT3X_ADDR_ALT */
+    int8_t mux_channel;                     /* TCA9548A channel, or I2C_BUS_NO_MUX */
+    uint32_t clk_speed_hz;                  /* I2C clock, up to SHT3X_I2C_CLOCK_MAX */
+    sht3x_repeatability_t repeatability;
+    sht3x_rate_t rate;
+} sht3x_config_t;
+
+/* One sensor on the shared bus; storage is owned by the caller */
+typedef struct {
+    i2c_bus_device_t *dev;
+    uint16_t periodic_cmd;                  /* resent by sht3x_restart() */
+} sht3x_t;
+
+/**
+ * @brief Picks the slowest periodic rate that still produces at least two
+ *        measurements per read interval, so every read finds fresh data even
+ *        with clock drift between the sensor and the ESP32.
+ * @param [in] read_period_ms Interval at which sht3x_read_data() is called.
+ * @return The matching rate, or SHT3X_RATE_10_MPS for intervals below 200 ms.
+ */
+sht3x_rate_t sht3x_rate_for_period(uint32_t read_period_ms);
+
 /**
- * @brief Initializes the ESP32 I2C master driver with 100kHz clock speed and internal pull-ups enabled.
- * @param [in] sda_pin GPIO number for SDA line.
- * @param [in] scl_pin GPIO number for SCL line.
+ * @brief Interval between two measurements at a periodic rate.
+ */
+uint32_t sht3x_rate_period_ms(sht3x_rate_t rate);
+
+/**
+ * @brief Registers the sensor on the shared I2C bus (i2c_bus_init() must have
+ *        run) and starts periodic acquisition. The sensor then measures on its
+ *        own; this waits once for the first measurement to complete.
+ * @param [out] sensor Sensor instance to initialize.
+ * @param [in] config Address, mux channel, bus clock, repeatability and measurement rate.
  * @return ESP_OK on success, or an error code on failure.
  */
-esp_err_t sht3x_init_i2c(uint8_t sda_pin, uint8_t scl_pin);
+esp_err_t sht3x_init(sht3x_t *sensor, const sht3x_config_t *config);
 
 /**
- * @brief Sends measurement command (High Repeatability), 
- *        waits 20ms for conversion, reads 6 bytes, 
- *        verifies CRC-8, and calculates physical values.
+ * @brief Fetches the latest periodic measurement (6 bytes), verifies CRC-8
+ *        and calculates physical values. Does not wait for a conversion.
  * @param [out] temp Pointer to store the measured temperature in Celsius.
  * @param [out] hum Pointer to store the measured relative humidity in percentage.
+ * @return ESP_OK on success, ESP_ERR_INVALID_CRC on a corrupted frame,
+ *         or the I2C error (the sensor NACKs when no new measurement is ready).
+ */
+esp_err_t sht3x_read_data(sht3x_t *sensor, float *temp, float *hum);
+
+/**
+ * @brief Stops and restarts periodic acquisition with the settings of
+ *        sht3x_init(), e.g. after the sensor lost them in a brown-out. Waits
+ *        once for the first measurement to complete.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t sht3x_restart(sht3x_t *sensor);
+
+/**
+ * @brief Stops periodic acquisition; the sensor returns to idle.
  * @return ESP_OK on success, or an error code on failure.
  */
-esp_err_t sht3x_read_data(float *temp, float *hum);
+esp_err_t sht3x_stop(sht3x_t *sensor);
 
-#endif /* SHT3X_H */
\ No newline at end of file
+#endif /* SHT3X_H */
@@ -0,0 +1,33 @@
+/**
+ * @file sht3x_decoder.h
+ * @brief Hardware-independent checking and conversion of SHT3x measurements.
+ *
+ * A measurement arrives as 6 bytes: temperature MSB, LSB, CRC, humidity MSB,
+ * LSB, CRC. This module checks both CRCs and converts the raw words to
+ * physical values (datasheet section 4.13). It has no driver dependencies
+ * and also builds on the host.
+ */
+
+#ifndef SHT3X_DECODER_H
+#define SHT3X_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define SHT3X_MEASUREMENT_LEN   6
+
+/**
+ * @brief CRC-8 of the sensor words: polynomial 0x31, initial value 0xFF.
+ */
+uint8_t sht3x_crc8(const uint8_t *data, size_t len);
+
+/**
+ * @brief Checks a measurement and converts it to temperature [C] and
+ *        relative humidity [%].
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a NULL pointer,
+ *         ESP_ERR_INVALID_CRC if either word fails its CRC.
+ */
+esp_err_t sht3x_decode(const uint8_t data[SHT3X_MEASUREMENT_LEN], float *temperature, float *humidity);
+
+#endif // SHT3X_DECODER_H
@@ -0,0 +1,33 @@
+/**
+ * @file sht3x_sensor.h
+ * @brief The SHT3x behind the common sensor interface of sensor_hub.
+ *
+ * The sensor runs in periodic mode and measures on its own, so there is no
+ * start step: a fetch returns the latest measurement. The init hook runs
+ * sht3x_init() the first time and sht3x_restart() after that, which brings
+ * back a sensor that reset on a brown-out.
+ */
+
+#ifndef SHT3X_SENSOR_H
+#define SHT3X_SENSOR_H
+
+#include "esp_err.h"
+#include "driver_sht3x.h"
+#include "sensor_hub.h"
+
+typedef struct {
+    sht3x_t sht3x;
+    sht3x_config_t config;
+} sht3x_sensor_t;
+
+/**
+ * @brief Fills in a sensor_hub driver; the sensor is set up when the hub
+ *        adds it (i2c_bus_init() must have run by then).
+ * @param [out] sensor Sensor state; must outlive the hub.
+ * @param [in] config Copied into sensor.
+ * @param [out] driver Driver to pass to sensor_hub_add().
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG on a NULL pointer.
+ */
+esp_err_t sht3x_sensor_driver(sht3x_sensor_t *sensor, const sht3x_config_t *config, sensor_driver_t *driver);
+
+#endif // SHT3X_SENSOR_H
@@ -1,96 +1,142 @@
 #include "driver_sht3x.h"
+#include "sht3x_decoder.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "event_trace.h"
+
+#define SHT3X_XFER_TIMEOUT_MS   100
+/* Longest conversion (high repeatability), datasheet table 4 */
+#define SHT3X_MEASURE_MAX_MS    16
+/* Idle time after a break command before the next command */
+#define SHT3X_BREAK_MS          1
 
 static const char *TAG = "SHT3X";
 
-// Hàm tính CRC-8 (Polynomial: 0x31, Init: 0xFF)
-static uint8_t sht3x_calc_crc(uint8_t *data, size_t len) {
-    uint8_t crc = 0xFF;
-    for (size_t i = 0; i < len; i++) {
-        crc ^= data[i];
-        for (uint8_t bit = 0; bit < 8; bit++) {
-            if (crc & 0x80) {
-                crc = (crc << 1) ^ 0x31;
-            } else {
-                crc = crc << 1;
-            }
+/* Periodic acquisition commands [rate][repeatability], datasheet table 10 */
+static const uint16_t periodic_cmds[][3] = {
+    [SHT3X_RATE_0_5_MPS] = { 0x2032, 0x2024, 0x202F },
+    [SHT3X_RATE_1_MPS]   = { 0x2130, 0x2126, 0x212D },
+    [SHT3X_RATE_2_MPS]   = { 0x2236, 0x2220, 0x222B },
+    [SHT3X_RATE_4_MPS]   = { 0x2334, 0x2322, 0x2329 },
+    [SHT3X_RATE_10_MPS]  = { 0x2737, 0x2721, 0x272A },
+};
+
+static const uint32_t rate_period_ms[] = {
+    [SHT3X_RATE_0_5_MPS] = 2000,
+    [SHT3X_RATE_1_MPS]   = 1000,
+    [SHT3X_RATE_2_MPS]   = 500,
+    [SHT3X_RATE_4_MPS]   = 250,
+    [SHT3X_RATE_10_MPS]  = 100,
+};
+
+/* Sent on every read, so keep it in flash instead of building it per call */
+static const uint8_t fetch_cmd[2] = { SHT3X_CMD_FETCH_DATA >> 8, SHT3X_CMD_FETCH_DATA & 0xFF };
+
+static esp_err_t sht3x_send_cmd(sht3x_t *sensor, uint16_t cmd)
+{
+    uint8_t buf[2] = { (cmd >> 8) & 0xFF, cmd & 0xFF };
+    return i2c_bus_transfer(sensor->dev, buf, sizeof(buf), NULL, 0);
+}
+
+sht3x_rate_t sht3x_rate_for_period(uint32_t read_period_ms)
+{
+    for (int rate = SHT3X_RATE_0_5_MPS; rate <= SHT3X_RATE_10_MPS; rate++) {
+        if (rate_period_ms[rate] * 2 <= read_period_ms) {
+            return (sht3x_rate_t)rate;
         }
     }
-    return crc;
+    return SHT3X_RATE_10_MPS;
+}
+
+uint32_t sht3x_rate_period_ms(sht3x_rate_t rate)
+{
+    return rate <= SHT3X_RATE_10_MPS ? rate_period_ms[rate] : 0;
 }
 
-esp_err_t sht3x_init_i2c(uint8_t sda_pin, uint8_t scl_pin)
+esp_err_t sht3x_init(sht3x_t *sensor, const sht3x_config_t *config)
 {
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = sda_pin,
-        .scl_io_num = scl_pin,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = 100000,
+    if (sensor == NULL || config == NULL || config->clk_speed_hz == 0 ||
+        config->clk_speed_hz > SHT3X_I2C_CLOCK_MAX || config->rate > SHT3X_RATE_10_MPS ||
+        config->repeatability > SHT3X_REPEATABILITY_LOW) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_bus_device_config_t dev_cfg = {
+        .address = config->address,
+        .clk_speed_hz = config->clk_speed_hz,
+        .mux_channel = config->mux_channel,
+        .timeout_ms = SHT3X_XFER_TIMEOUT_MS,
     };
+    esp_err_t err = i2c_bus_add_device(&dev_cfg, &sensor->dev);
+    if (err != ESP_OK) {
+        return err;
+    }
 
-    esp_err_t err = i2c_param_config(I2C_MASTER_NUM, &conf);
+    sensor->periodic_cmd = periodic_cmds[config->rate][config->repeatability];
+    err = sht3x_send_cmd(sensor, sensor->periodic_cmd);
     if (err != ESP_OK) {
+        ESP_LOGE(TAG, "0x%02x: failed to start periodic mode", config->address);
         return err;
     }
 
-    return i2c_driver_install(I2C_MASTER_NUM, conf.mode, 0, 0, 0);
+    // Let the first measurement finish so the first fetch has data
+    vTaskDelay(pdMS_TO_TICKS(SHT3X_MEASURE_MAX_MS));
+
+    ESP_LOGI(TAG, "0x%02x (mux %d): periodic mode, %lu ms period, %lu Hz clock",
+             config->address, config->mux_channel,
+             (unsigned long)rate_period_ms[config->rate], (unsigned long)config->clk_speed_hz);
+    return ESP_OK;
 }
 
-esp_err_t sht3x_read_data(float *temp, float *hum)
+esp_err_t sht3x_read_data(sht3x_t *sensor, float *temp, float *hum)
 {
-    uint8_t cmd[2] = {
-        (SHT3X_CMD_MEASURE_HIGH >> 8) & 0xFF,
-        SHT3X_CMD_MEASURE_HIGH & 0xFF
-    };
-    uint8_t data[6];
+    uint8_t data[SHT3X_MEASUREMENT_LEN];
 
-    // 1. Send Write command
-    i2c_cmd_handle_t link = i2c_cmd_link_create();
-    i2c_master_start(link);
-    i2c_master_write_byte(link, (SHT3X_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write(link, cmd, 2, true);
-    i2c_master_stop(link);
-    esp_err_t err = i2c_master_cmd_begin(I2C_MASTER_NUM, link, pdMS_TO_TICKS(100));
-    i2c_cmd_link_delete(link);
+    if (sensor == NULL || sensor->dev == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
+    // Fetch Data command, then read the result as a separate transfer.
+    // The sensor NACKs the read header until a new measurement is available.
+    uint32_t t0 = event_trace_begin();
+    esp_err_t err = i2c_bus_transfer(sensor->dev, fetch_cmd, sizeof(fetch_cmd), data, sizeof(data));
+    event_trace_end(TRACE_SENSOR_READ, t0, (uint32_t)err);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "I2C Write Failed");
+        ESP_LOGE(TAG, "0x%02x: I2C transfer failed", i2c_bus_device_address(sensor->dev));
         return err;
     }
 
-    // Wait for measurement
-    vTaskDelay(pdMS_TO_TICKS(20));
+    err = sht3x_decode(data, temp, hum);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "CRC Check Failed");
+    }
+    return err;
+}
 
-    // Read data
-    link = i2c_cmd_link_create();
-    i2c_master_start(link);
-    i2c_master_write_byte(link, (SHT3X_ADDR << 1) | I2C_MASTER_READ, true);
-    i2c_master_read(link, data, 6, I2C_MASTER_LAST_NACK);
-    i2c_master_stop(link);
-    err = i2c_master_cmd_begin(I2C_MASTER_NUM, link, pdMS_TO_TICKS(100));
-    i2c_cmd_link_delete(link);
+esp_err_t sht3x_restart(sht3x_t *sensor)
+{
+    if (sensor == NULL || sensor->dev == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
+    // A sensor that already restarted NACKs the break; the periodic command is what matters
+    sht3x_send_cmd(sensor, SHT3X_CMD_BREAK);
+    vTaskDelay(pdMS_TO_TICKS(SHT3X_BREAK_MS));
+    esp_err_t err = sht3x_send_cmd(sensor, sensor->periodic_cmd);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "I2C Read Failed");
+        ESP_LOGE(TAG, "0x%02x: failed to restart periodic mode", i2c_bus_device_address(sensor->dev));
         return err;
     }
+    vTaskDelay(pdMS_TO_TICKS(SHT3X_MEASURE_MAX_MS));
+    ESP_LOGW(TAG, "0x%02x: periodic mode restarted", i2c_bus_device_address(sensor->dev));
+    return ESP_OK;
+}
 
-    // Check CRC
-    if (data[2] != sht3x_calc_crc(data, 2) || data[5] != sht3x_calc_crc(&data[3], 2)) {
-        ESP_LOGE(TAG, "CRC Check Failed");
-        return ESP_ERR_INVALID_CRC;
+esp_err_t sht3x_stop(sht3x_t *sensor)
+{
+    if (sensor == NULL || sensor->dev == NULL) {
+        return ESP_ERR_INVALID_STATE;
     }
-
-    // Change raw data to temperature and humidity
-    uint16_t raw_temp = (data[0] << 8) | data[1];
-    uint16_t raw_hum = (data[3] << 8) | data[4];
-
-    *temp = -45.0f + (175.0f * (float)raw_temp / 65535.0f);
-    *hum = 100.0f * ((float)raw_hum / 65535.0f);
-
-    return ESP_OK;
-}
\ No newline at end of file
+    return sht3x_send_cmd(sensor, SHT3X_CMD_BREAK);
+}
@@ -0,0 +1,38 @@
+#include "sht3x_decoder.h"
+
+// Hàm tính CRC-8 (Polynomial: 0x31, Init: 0xFF)
+uint8_t sht3x_crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (crc & 0x80) {
+                crc = (crc << 1) ^ 0x31;
+            } else {
+                crc = crc << 1;
+            }
+        }
+    }
+    return crc;
+}
+
+esp_err_t sht3x_decode(const uint8_t data[SHT3X_MEASUREMENT_LEN], float *temperature, float *humidity)
+{
+    if (data == NULL || temperature == NULL || humidity == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Check CRC
+    if (data[2] != sht3x_crc8(data, 2) || data[5] != sht3x_crc8(&data[3], 2)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    // Change raw data to temperature and humidity
+    uint16_t raw_temp = (data[0] << 8) | data[1];
+    uint16_t raw_hum = (data[3] << 8) | data[4];
+
+    *temperature = -45.0f + (175.0f * (float)raw_temp / 65535.0f);
+    *humidity = 100.0f * ((float)raw_hum / 65535.0f);
+    return ESP_OK;
+}
@@ -0,0 +1,37 @@
+#include "sht3x_sensor.h"
+#include <stddef.h>
+
+static esp_err_t sht3x_sensor_init(void *ctx)
+{
+    sht3x_sensor_t *sensor = ctx;
+    // Registered on the bus once; later runs only restart the acquisition
+    if (sensor->sht3x.dev == NULL) {
+        return sht3x_init(&sensor->sht3x, &sensor->config);
+    }
+    return sht3x_restart(&sensor->sht3x);
+}
+
+static esp_err_t sht3x_sensor_fetch(void *ctx, telemetry_sample_t *sample)
+{
+    sht3x_sensor_t *sensor = ctx;
+    return sht3x_read_data(&sensor->sht3x, &sample->temperature, &sample->humidity);
+}
+
+esp_err_t sht3x_sensor_driver(sht3x_sensor_t *sensor, const sht3x_config_t *config, sensor_driver_t *driver)
+{
+    if (sensor == NULL || config == NULL || driver == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sensor->sht3x.dev = NULL;
+    sensor->config = *config;
+    *driver = (sensor_driver_t){
+        .name = "sht3x",
+        .caps = SENSOR_CAP_TEMPERATURE | SENSOR_CAP_HUMIDITY,
+        .period_ms = sht3x_rate_period_ms(config->rate),
+        .init = sht3x_sensor_init,
+        .fetch = sht3x_sensor_fetch,
+        .ctx = sensor,
+    };
+    return ESP_OK;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file event_trace.h
+ * @brief Fixed-size binary trace ring for the firmware hot paths.
+ *
+ * Recording claims a slot with one atomic increment and fills in a 16-byte
+ * record; there is no lock, no allocation and no formatting, so it can stay
+ * enabled in production and be called from any task or ISR. The ring keeps
+ * the last CONFIG_EVENT_TRACE_RECORDS records. A dump pauses recording and
+ * hands the ring to a sink in self-describing chunks; host/tools/
+ * trace_to_perfetto.py turns them into a Chrome trace / Perfetto file.
+ *
+ * Spans are timed by the caller:
+ *     uint32_t t0 = event_trace_begin();
+ *     ...
+ *     event_trace_end(TRACE_SENSOR_READ, t0, err);
+ *
+ * Records are timestamped with the CPU cycle counter, which takes a single
+ * register read; esp_timer_get_time() would cost more than the rest of the
+ * record. The counter is per core and wraps every 2^32 cycles (about 18 s at
+ * 240 MHz), so the dump carries its frequency and the host tool unwraps it
+ * per core. Stretches without any record on a core longer than half a wrap
+ * are not detected.
+ *
+ * With CONFIG_EVENT_TRACE off every call compiles to nothing.
+ */
+
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_cpu.h"
+#include "trace_events.h"
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#if defined(CONFIG_EVENT_TRACE) && CONFIG_EVENT_TRACE
+#define EVENT_TRACE_ENABLED     1
+#define EVENT_TRACE_RECORDS     CONFIG_EVENT_TRACE_RECORDS
+#else
+#define EVENT_TRACE_ENABLED     0
+#define EVENT_TRACE_RECORDS     1
+#endif
+
+/*
+ * Dump chunk (little-endian): uint8 'T', uint8 'R', uint8 version,
+ * uint8 record size, uint16 chunk index, uint16 chunk count,
+ * uint32 records ever recorded (so the reader can tell how many were
+ * overwritten), uint32 clock frequency [Hz], then the records of the
+ * chunk, oldest first.
+ */
+#define EVENT_TRACE_VERSION         2
+#define EVENT_TRACE_CHUNK_HDR_LEN   16
+#define EVENT_TRACE_CHUNK_RECORDS   48
+#define EVENT_TRACE_CHUNK_LEN       (EVENT_TRACE_CHUNK_HDR_LEN + EVENT_TRACE_CHUNK_RECORDS * sizeof(trace_record_t))
+
+typedef struct {
+    uint32_t timestamp;         /* cycle counter at the start of a span */
+    uint32_t duration;          /* cycles, 0 for instant events */
+    uint32_t arg;
+    uint16_t event;             /* trace_event_t */
+    uint8_t core;
+    uint8_t reserved;
+} trace_record_t;
+
+_Static_assert(sizeof(trace_record_t) == 16, "trace record layout is part of the dump format");
+_Static_assert((EVENT_TRACE_RECORDS & (EVENT_TRACE_RECORDS - 1)) == 0, "trace ring size must be a power of two");
+
+typedef struct {
+    uint32_t head;              /* records ever claimed; the next slot is head % size */
+    bool paused;
+    trace_record_t records[EVENT_TRACE_RECORDS];
+} trace_ring_t;
+
+extern trace_ring_t g_event_trace;
+
+#define EVENT_TRACE_CORE()  ((uint8_t)esp_cpu_get_core_id())
+
+static inline uint32_t event_trace_begin(void)
+{
+#if EVENT_TRACE_ENABLED
+    return esp_cpu_get_cycle_count();
+#else
+    return 0;
+#endif
+}
+
+static inline void event_trace_record(uint16_t event, uint32_t start, uint32_t duration, uint32_t arg)
+{
+#if EVENT_TRACE_ENABLED
+    if (__atomic_load_n(&g_event_trace.paused, __ATOMIC_RELAXED)) {
+        return;
+    }
+    uint32_t slot = __atomic_fetch_add(&g_event_trace.head, 1, __ATOMIC_RELAXED) & (EVENT_TRACE_RECORDS - 1);
+    trace_record_t *r = &g_event_trace.records[slot];
+    r->timestamp = start;
+    r->duration = duration;
+    r->arg = arg;
+    r->event = event;
+    r->core = EVENT_TRACE_CORE();
+#else
+    (void)event;
+    (void)start;
+    (void)duration;
+    (void)arg;
+#endif
+}
+
+/**
+ * @brief Records a span that started at start (from event_trace_begin()).
+ */
+static inline void event_trace_end(trace_event_t event, uint32_t start, uint32_t arg)
+{
+#if EVENT_TRACE_ENABLED
+    event_trace_record((uint16_t)event, start, esp_cpu_get_cycle_count() - start, arg);
+#else
+    (void)event;
+    (void)start;
+    (void)arg;
+#endif
+}
+
+/**
+ * @brief Records an event without duration.
+ */
+static inline void event_trace_instant(trace_event_t event, uint32_t arg)
+{
+#if EVENT_TRACE_ENABLED
+    event_trace_record((uint16_t)event, esp_cpu_get_cycle_count(), 0, arg);
+#else
+    (void)event;
+    (void)arg;
+#endif
+}
+
+/**
+ * Receives one dump chunk of at most EVENT_TRACE_CHUNK_LEN bytes.
+ * @return ESP_OK to continue, anything else aborts the dump.
+ */
+typedef esp_err_t (*event_trace_sink_t)(const uint8_t *chunk, size_t len, void *ctx);
+
+/**
+ * @brief Writes the ring to a sink, oldest record first. Recording is paused
+ *        for the duration of the dump and resumes afterwards; a record that
+ *        was being written at the instant of the pause may come out torn.
+ *        Only one dump may run at a time.
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED with CONFIG_EVENT_TRACE off, or the
+ *         sink's error.
+ */
+esp_err_t event_trace_dump(event_trace_sink_t sink, void *ctx);
+
+#endif // EVENT_TRACE_H
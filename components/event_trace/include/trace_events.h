@@ -0,0 +1,31 @@
+/**
+ * @file trace_events.h
+ * @brief Event ids of the trace ring.
+ *
+ * One line per event: X(id, kind, label). SPAN events are recorded once,
+ * at the end, with their start time and duration; INSTANT events have no
+ * duration. host/tools/trace_to_perfetto.py reads this list to name the
+ * events, so ids are positional: append new events, never reorder.
+ */
+
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+#define TRACE_EVENT_LIST(X)                                                         \
+    X(TRACE_MQTT_RX,          INSTANT, "mqtt rx")          /* arg: payload length */    \
+    X(TRACE_MQTT_DISPATCH,    SPAN,    "mqtt dispatch")    /* arg: payload length */    \
+    X(TRACE_CMD_SUBMIT,       INSTANT, "command submit")   /* arg: commands, or error */ \
+    X(TRACE_ACTUATOR_BATCH,   SPAN,    "actuator batch")   /* arg: relay states after */ \
+    X(TRACE_RELAY_WRITE,      SPAN,    "relay write")      /* arg: esp_err_t */          \
+    X(TRACE_SENSOR_READ,      SPAN,    "sht3x read")       /* arg: esp_err_t */          \
+    X(TRACE_SENSOR_PUBLISH,   SPAN,    "sensor publish")   /* arg: samples */            \
+    X(TRACE_MQTT_PUBLISH,     SPAN,    "mqtt publish")     /* arg: payload length */
+
+#define TRACE_EVENT_ENUM(id, kind, label) id,
+typedef enum {
+    TRACE_EVENT_LIST(TRACE_EVENT_ENUM)
+    TRACE_EVENT_COUNT,
+} trace_event_t;
+#undef TRACE_EVENT_ENUM
+
+#endif // TRACE_EVENTS_H
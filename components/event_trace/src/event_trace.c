@@ -0,0 +1,80 @@
+/**
+ * @file event_trace.c
+ * @brief Trace ring storage and chunked dump.
+ */
+
+#include "event_trace.h"
+#include <string.h>
+#include "esp_rom_sys.h"
+
+trace_ring_t g_event_trace;
+
+static void put_u16_le(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32_le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+esp_err_t event_trace_dump(event_trace_sink_t sink, void *ctx)
+{
+#if EVENT_TRACE_ENABLED
+    static uint8_t chunk[EVENT_TRACE_CHUNK_LEN];
+    esp_err_t err = ESP_OK;
+
+    if (sink == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    __atomic_store_n(&g_event_trace.paused, true, __ATOMIC_SEQ_CST);
+    uint32_t head = __atomic_load_n(&g_event_trace.head, __ATOMIC_SEQ_CST);
+    // The CPU clock the cycle counter runs at; frequency scaling would skew the trace
+    uint32_t clock_hz = esp_rom_get_cpu_ticks_per_us() * 1000000u;
+    uint32_t count = head < EVENT_TRACE_RECORDS ? head : EVENT_TRACE_RECORDS;
+    uint32_t chunks = (count + EVENT_TRACE_CHUNK_RECORDS - 1) / EVENT_TRACE_CHUNK_RECORDS;
+    if (chunks == 0) {
+        chunks = 1;     // an empty ring still produces a header, so the reader sees the totals
+    }
+
+    for (uint32_t c = 0; c < chunks && err == ESP_OK; c++) {
+        uint32_t first = c * EVENT_TRACE_CHUNK_RECORDS;
+        uint32_t n = count - first < EVENT_TRACE_CHUNK_RECORDS ? count - first : EVENT_TRACE_CHUNK_RECORDS;
+
+        chunk[0] = 'T';
+        chunk[1] = 'R';
+        chunk[2] = EVENT_TRACE_VERSION;
+        chunk[3] = sizeof(trace_record_t);
+        put_u16_le(&chunk[4], (uint16_t)c);
+        put_u16_le(&chunk[6], (uint16_t)chunks);
+        put_u32_le(&chunk[8], head);
+        put_u32_le(&chunk[12], clock_hz);
+
+        uint8_t *p = &chunk[EVENT_TRACE_CHUNK_HDR_LEN];
+        for (uint32_t i = 0; i < n; i++) {
+            const trace_record_t *r = &g_event_trace.records[(head - count + first + i) & (EVENT_TRACE_RECORDS - 1)];
+            put_u32_le(&p[0], r->timestamp);
+            put_u32_le(&p[4], r->duration);
+            put_u32_le(&p[8], r->arg);
+            put_u16_le(&p[12], r->event);
+            p[14] = r->core;
+            p[15] = 0;
+            p += sizeof(trace_record_t);
+        }
+        err = sink(chunk, EVENT_TRACE_CHUNK_HDR_LEN + n * sizeof(trace_record_t), ctx);
+    }
+
+    __atomic_store_n(&g_event_trace.paused, false, __ATOMIC_SEQ_CST);
+    return err;
+#else
+    (void)sink;
+    (void)ctx;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
@@ -0,0 +1,95 @@
+/**
+ * @file metrics.h
+ * @brief Counters, gauges and fixed-bucket histograms for runtime diagnostics.
+ *
+ * Metrics are static objects owned by the module that updates them and
+ * registered once at init. Updates are single atomic operations, so they are
+ * cheap enough for hot paths and safe from any task. A snapshot walks the
+ * registry and writes every metric as JSON members; histograms are reset by
+ * the snapshot, so each one covers the interval since the previous snapshot,
+ * while counters keep counting since boot.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry_codec.h"
+
+/* Buckets per histogram, including the overflow bucket */
+#define METRICS_HIST_MAX_BUCKETS    8
+
+typedef struct metrics_counter {
+    const char *name;
+    uint32_t value;
+    struct metrics_counter *next;
+} metrics_counter_t;
+
+typedef struct metrics_gauge {
+    const char *name;
+    int32_t value;
+    struct metrics_gauge *next;
+} metrics_gauge_t;
+
+typedef struct metrics_histogram {
+    const char *name;
+    const uint32_t *bounds;     /* ascending upper bounds; bucket i counts values <= bounds[i] */
+    uint8_t bound_count;        /* at most METRICS_HIST_MAX_BUCKETS - 1 */
+    uint32_t counts[METRICS_HIST_MAX_BUCKETS];
+    uint32_t sum;
+    uint32_t max;
+    struct metrics_histogram *next;
+} metrics_histogram_t;
+
+#define METRICS_COUNTER_INIT(metric_name)   { .name = (metric_name) }
+#define METRICS_GAUGE_INIT(metric_name)     { .name = (metric_name) }
+/* bounds must be a static array, not a pointer */
+#define METRICS_HISTOGRAM_INIT(metric_name, bounds_array) \
+    { .name = (metric_name), .bounds = (bounds_array), \
+      .bound_count = (uint8_t)(sizeof(bounds_array) / sizeof((bounds_array)[0])) }
+
+/**
+ * @brief Adds a metric to the registry. Registering the same object twice
+ *        is a no-op.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a missing name or too many
+ *         histogram bounds.
+ */
+esp_err_t metrics_register_counter(metrics_counter_t *counter);
+esp_err_t metrics_register_gauge(metrics_gauge_t *gauge);
+esp_err_t metrics_register_histogram(metrics_histogram_t *hist);
+
+static inline void metrics_counter_add(metrics_counter_t *counter, uint32_t n)
+{
+    __atomic_fetch_add(&counter->value, n, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_counter_inc(metrics_counter_t *counter)
+{
+    metrics_counter_add(counter, 1);
+}
+
+static inline void metrics_gauge_set(metrics_gauge_t *gauge, int32_t value)
+{
+    __atomic_store_n(&gauge->value, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Raises the gauge to value if it is larger (high-water mark).
+ */
+void metrics_gauge_max(metrics_gauge_t *gauge, int32_t value);
+
+/**
+ * @brief Records one observation, e.g. a latency in microseconds.
+ */
+void metrics_histogram_observe(metrics_histogram_t *hist, uint32_t value);
+
+/**
+ * @brief Writes every registered metric as members of the currently open
+ *        object: "counters":{name:value,...}, "gauges":{...} and
+ *        "histograms":{name:{"le":[bounds],"n":[counts],"sum":..,"max":..}}.
+ *        The last count of "n" is the overflow bucket. Histograms are reset.
+ */
+void metrics_write_json(telemetry_json_writer_t *w);
+
+#endif // METRICS_H
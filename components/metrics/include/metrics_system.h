@@ -0,0 +1,31 @@
+/**
+ * @file metrics_system.h
+ * @brief Heap and per-task figures collected from ESP-IDF and FreeRTOS.
+ *
+ * These are sampled when a snapshot is written rather than updated
+ * continuously, so collecting them costs nothing between snapshots.
+ */
+
+#ifndef METRICS_SYSTEM_H
+#define METRICS_SYSTEM_H
+
+#include "telemetry_codec.h"
+
+/* Tasks a snapshot can hold; with more running, FreeRTOS reports none */
+#define METRICS_MAX_TASKS   32
+
+/**
+ * @brief Writes heap and task members into the currently open object:
+ *        "heap":{"free":..,"min_free":..,"largest":..,"frag":..} and
+ *        "tasks":[{"name":..,"cpu":..,"stack":..},...].
+ *        frag is 100 - largest block * 100 / free 8-bit heap. cpu is the
+ *        task's share of all cores in percent since the previous call, and
+ *        is left out without CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS. stack
+ *        is the lowest free stack ever seen, in bytes, and is left out
+ *        for a task reported without a stack base. The task list needs
+ *        CONFIG_FREERTOS_USE_TRACE_FACILITY.
+ *        Call from one task only (the health check task).
+ */
+void metrics_system_write_json(telemetry_json_writer_t *w);
+
+#endif // METRICS_SYSTEM_H
@@ -0,0 +1,141 @@
+/**
+ * @file metrics.c
+ * @brief Lock-free metric registry and JSON snapshot.
+ */
+
+#include "metrics.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+static metrics_counter_t *s_counters = NULL;
+static metrics_gauge_t *s_gauges = NULL;
+static metrics_histogram_t *s_histograms = NULL;
+
+/*
+ * The registries are singly linked lists that only ever grow at the head,
+ * so a snapshot running concurrently sees either the old or the new head.
+ */
+esp_err_t metrics_register_counter(metrics_counter_t *counter)
+{
+    if (counter == NULL || counter->name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (metrics_counter_t *m = __atomic_load_n(&s_counters, __ATOMIC_ACQUIRE); m != NULL; m = m->next) {
+        if (m == counter) {
+            return ESP_OK;
+        }
+    }
+    counter->next = __atomic_load_n(&s_counters, __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&s_counters, &counter->next, counter, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+    }
+    return ESP_OK;
+}
+
+esp_err_t metrics_register_gauge(metrics_gauge_t *gauge)
+{
+    if (gauge == NULL || gauge->name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (metrics_gauge_t *m = __atomic_load_n(&s_gauges, __ATOMIC_ACQUIRE); m != NULL; m = m->next) {
+        if (m == gauge) {
+            return ESP_OK;
+        }
+    }
+    gauge->next = __atomic_load_n(&s_gauges, __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&s_gauges, &gauge->next, gauge, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+    }
+    return ESP_OK;
+}
+
+esp_err_t metrics_register_histogram(metrics_histogram_t *hist)
+{
+    if (hist == NULL || hist->name == NULL || (hist->bounds == NULL && hist->bound_count > 0) ||
+        hist->bound_count >= METRICS_HIST_MAX_BUCKETS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (metrics_histogram_t *m = __atomic_load_n(&s_histograms, __ATOMIC_ACQUIRE); m != NULL; m = m->next) {
+        if (m == hist) {
+            return ESP_OK;
+        }
+    }
+    hist->next = __atomic_load_n(&s_histograms, __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&s_histograms, &hist->next, hist, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+    }
+    return ESP_OK;
+}
+
+static void atomic_max(uint32_t *target, uint32_t value)
+{
+    uint32_t cur = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while (value > cur &&
+           !__atomic_compare_exchange_n(target, &cur, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void metrics_gauge_max(metrics_gauge_t *gauge, int32_t value)
+{
+    int32_t cur = __atomic_load_n(&gauge->value, __ATOMIC_RELAXED);
+    while (value > cur &&
+           !__atomic_compare_exchange_n(&gauge->value, &cur, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void metrics_histogram_observe(metrics_histogram_t *hist, uint32_t value)
+{
+    uint8_t bucket = 0;
+    while (bucket < hist->bound_count && value > hist->bounds[bucket]) {
+        bucket++;
+    }
+    __atomic_fetch_add(&hist->counts[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+    atomic_max(&hist->max, value);
+}
+
+void metrics_write_json(telemetry_json_writer_t *w)
+{
+    telemetry_json_key(w, "counters");
+    telemetry_json_object_begin(w);
+    for (metrics_counter_t *c = __atomic_load_n(&s_counters, __ATOMIC_ACQUIRE); c != NULL; c = c->next) {
+        telemetry_json_key(w, c->name);
+        telemetry_json_number(w, (double)__atomic_load_n(&c->value, __ATOMIC_RELAXED));
+    }
+    telemetry_json_object_end(w);
+
+    telemetry_json_key(w, "gauges");
+    telemetry_json_object_begin(w);
+    for (metrics_gauge_t *g = __atomic_load_n(&s_gauges, __ATOMIC_ACQUIRE); g != NULL; g = g->next) {
+        telemetry_json_key(w, g->name);
+        telemetry_json_number(w, (double)__atomic_load_n(&g->value, __ATOMIC_RELAXED));
+    }
+    telemetry_json_object_end(w);
+
+    // Fields are swapped out one by one; an observation racing the snapshot
+    // may land half in this interval and half in the next
+    telemetry_json_key(w, "histograms");
+    telemetry_json_object_begin(w);
+    for (metrics_histogram_t *h = __atomic_load_n(&s_histograms, __ATOMIC_ACQUIRE); h != NULL; h = h->next) {
+        telemetry_json_key(w, h->name);
+        telemetry_json_object_begin(w);
+        telemetry_json_key(w, "le");
+        telemetry_json_array_begin(w);
+        for (uint8_t i = 0; i < h->bound_count; i++) {
+            telemetry_json_number(w, (double)h->bounds[i]);
+        }
+        telemetry_json_array_end(w);
+        telemetry_json_key(w, "n");
+        telemetry_json_array_begin(w);
+        for (uint8_t i = 0; i <= h->bound_count; i++) {
+            telemetry_json_number(w, (double)__atomic_exchange_n(&h->counts[i], 0, __ATOMIC_RELAXED));
+        }
+        telemetry_json_array_end(w);
+        telemetry_json_key(w, "sum");
+        telemetry_json_number(w, (double)__atomic_exchange_n(&h->sum, 0, __ATOMIC_RELAXED));
+        telemetry_json_key(w, "max");
+        telemetry_json_number(w, (double)__atomic_exchange_n(&h->max, 0, __ATOMIC_RELAXED));
+        telemetry_json_object_end(w);
+    }
+    telemetry_json_object_end(w);
+}
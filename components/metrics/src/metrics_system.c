@@ -0,0 +1,104 @@
+/**
+ * @file metrics_system.c
+ * @brief Heap and FreeRTOS task statistics for the metrics snapshot.
+ */
+
+#include "metrics_system.h"
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+static TaskStatus_t s_tasks[METRICS_MAX_TASKS];
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+/* Run time of each task at the previous snapshot, by task number */
+static struct {
+    UBaseType_t number;
+    uint32_t runtime;
+} s_prev[METRICS_MAX_TASKS];
+static UBaseType_t s_prev_count = 0;
+static uint32_t s_prev_total = 0;
+
+static bool prev_runtime(UBaseType_t number, uint32_t *runtime)
+{
+    for (UBaseType_t i = 0; i < s_prev_count; i++) {
+        if (s_prev[i].number == number) {
+            *runtime = s_prev[i].runtime;
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+#endif
+
+static void write_heap(telemetry_json_writer_t *w)
+{
+    size_t free_8bit = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+    telemetry_json_key(w, "heap");
+    telemetry_json_object_begin(w);
+    telemetry_json_key(w, "free");
+    telemetry_json_number(w, (double)esp_get_free_heap_size());
+    telemetry_json_key(w, "min_free");
+    telemetry_json_number(w, (double)esp_get_minimum_free_heap_size());
+    telemetry_json_key(w, "largest");
+    telemetry_json_number(w, (double)largest);
+    telemetry_json_key(w, "frag");
+    telemetry_json_number(w, free_8bit > 0 ? (double)(100 - (uint32_t)(largest * 100 / free_8bit)) : 0.0);
+    telemetry_json_object_end(w);
+}
+
+void metrics_system_write_json(telemetry_json_writer_t *w)
+{
+    write_heap(w);
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    uint32_t total = 0;
+    UBaseType_t count = uxTaskGetSystemState(s_tasks, METRICS_MAX_TASKS, &total);
+
+    telemetry_json_key(w, "tasks");
+    telemetry_json_array_begin(w);
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    // The run time counter covers one core; idle tasks included, the shares
+    // of all tasks add up to 100 across portNUM_PROCESSORS cores
+    uint32_t elapsed = (total - s_prev_total) * portNUM_PROCESSORS;
+    bool have_prev = s_prev_count > 0;
+#endif
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *t = &s_tasks[i];
+        telemetry_json_object_begin(w);
+        telemetry_json_key(w, "name");
+        telemetry_json_string(w, t->pcTaskName);
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        uint32_t before;
+        if (have_prev && elapsed > 0 && prev_runtime(t->xTaskNumber, &before)) {
+            // Rounded to 0.1 %; wrapping counters still subtract correctly
+            uint32_t permille = (uint32_t)((uint64_t)(t->ulRunTimeCounter - before) * 1000 / elapsed);
+            telemetry_json_key(w, "cpu");
+            telemetry_json_number(w, permille / 10.0);
+        }
+#endif
+        // A port that cannot measure a task's stack reports no stack base; leave the figure out
+        if (t->pxStackBase != NULL) {
+            telemetry_json_key(w, "stack");
+            telemetry_json_number(w, (double)t->usStackHighWaterMark);
+        }
+        telemetry_json_object_end(w);
+    }
+    telemetry_json_array_end(w);
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    for (UBaseType_t i = 0; i < count; i++) {
+        s_prev[i].number = s_tasks[i].xTaskNumber;
+        s_prev[i].runtime = s_tasks[i].ulRunTimeCounter;
+    }
+    s_prev_count = count;
+    s_prev_total = total;
+#endif
+#endif
+}
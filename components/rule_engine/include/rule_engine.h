@@ -0,0 +1,63 @@
+/**
+ * @file rule_engine.h
+ * @brief Evaluates user-defined rules (see rule_program.h) on every sample.
+ *
+ * A rules document received over MQTT is compiled once, swapped in as a
+ * whole and stored in NVS in compiled form, so it is active again right
+ * after a reboot. Evaluation runs inside the sensor task and sends its
+ * commands through the actuator manager, like commands from the cloud.
+ * The time spent per sample is measured and reported.
+ */
+
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry_codec.h"
+
+/* Worst-case rule_engine_status_json() output */
+#define RULE_ENGINE_STATUS_JSON_MAX_LEN     128
+
+typedef struct {
+    uint32_t rules;             /* rules in the active program */
+    uint32_t evaluations;       /* samples evaluated since boot */
+    uint32_t last_us;           /* cost of the last evaluation */
+    uint32_t max_us;
+    uint64_t total_us;
+} rule_engine_stats_t;
+
+/**
+ * @brief Loads the stored program, if any. The actuator manager must be
+ *        initialized first.
+ * @return ESP_OK (also when nothing is stored), or an error code on failure.
+ */
+esp_err_t rule_engine_init(void);
+
+/**
+ * @brief Evaluates the active rules on a valid sample and submits the
+ *        resulting commands as one actuator batch.
+ */
+void rule_engine_feed(const telemetry_sample_t *sample);
+
+/**
+ * @brief Compiles a rules document and, if it compiles, replaces the active
+ *        program and stores it. {"rules": []} removes all rules.
+ * @return ESP_OK, or the rule_compile() error (the active program is kept).
+ */
+esp_err_t rule_engine_configure(const char *payload, size_t len);
+
+/**
+ * @brief Evaluation counters since boot.
+ */
+void rule_engine_get_stats(rule_engine_stats_t *stats);
+
+/**
+ * @brief Writes the counters as JSON:
+ *        {"rules": 2, "evaluations": 1800, "last_us": 4, "max_us": 11, "avg_us": 4.20}
+ * @return ESP_OK, or ESP_ERR_INVALID_SIZE if buf is too small.
+ */
+esp_err_t rule_engine_status_json(char *buf, size_t len, size_t *out_len);
+
+#endif // RULE_ENGINE_H
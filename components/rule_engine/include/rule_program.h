@@ -0,0 +1,103 @@
+/**
+ * @file rule_program.h
+ * @brief Compiler and evaluator for user-defined actuator rules.
+ *
+ * Rules arrive as JSON:
+ *   {"rules": [{"if": "humidity < 40 and temperature > 26",
+ *               "then": {"device": "humidifier", "state": "on"},
+ *               "for_s": 600}, ...]}
+ *
+ * Conditions compare humidity/hum or temperature/temp against numbers with
+ * < <= > >=, combined with and/or/not (&&, ||, !) and parentheses. They are
+ * compiled once, on arrival, into fixed-size postfix code, so evaluating a
+ * sample is a short loop over at most RULE_MAX_RULES * RULE_MAX_CODE
+ * instructions with no parsing, allocation or recursion.
+ *
+ * Without for_s a rule fires once each time its condition becomes true.
+ * With for_s it applies its action while the condition holds and reverts
+ * it (on <-> off) once the condition has been false at the end of a hold.
+ */
+
+#ifndef RULE_PROGRAM_H
+#define RULE_PROGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "command_parser.h"
+
+#define RULE_MAX_RULES      16
+#define RULE_MAX_CODE       16      /* instructions per condition */
+
+typedef enum {
+    RULE_VAR_TEMPERATURE,
+    RULE_VAR_HUMIDITY,
+    RULE_VAR_COUNT,
+} rule_var_t;
+
+typedef enum {
+    RULE_OP_LT,         /* push var < value */
+    RULE_OP_LE,
+    RULE_OP_GT,
+    RULE_OP_GE,
+    RULE_OP_AND,        /* pop two, push both */
+    RULE_OP_OR,
+    RULE_OP_NOT,        /* pop one, push its negation */
+} rule_op_t;
+
+typedef struct {
+    uint8_t op;
+    uint8_t var;
+    float value;
+} rule_insn_t;
+
+typedef struct {
+    uint8_t device;         /* actuator index */
+    uint8_t action;         /* RELAY_CMD_ON or RELAY_CMD_OFF */
+    uint8_t code_len;
+    uint32_t hold_ms;       /* 0: fire on the rising edge only */
+    rule_insn_t code[RULE_MAX_CODE];
+} rule_t;
+
+typedef struct {
+    uint8_t count;
+    rule_t rules[RULE_MAX_RULES];
+} rule_program_t;
+
+/* Runtime state, reset whenever a new program is loaded */
+typedef struct {
+    uint32_t last_true;     /* bit i: rule i held at the previous sample */
+    uint32_t active;        /* bit i: hold of rule i is running */
+    uint64_t expires_ms[RULE_MAX_RULES];
+} rule_state_t;
+
+/**
+ * @brief Compiles a rules document.
+ * @param [in] buf JSON text, not necessarily NUL-terminated.
+ * @param [in] lookup Resolves device names to actuator indices.
+ * @param [out] program Compiled program; only valid if ESP_OK is returned.
+ * @param [out] bad_rule Index of the offending rule on error (may be NULL).
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a syntax error, ESP_ERR_NOT_FOUND
+ *         for an unknown device or variable, ESP_ERR_INVALID_SIZE for too
+ *         many rules or too long a condition.
+ */
+esp_err_t rule_compile(const char *buf, size_t len, command_device_lookup_t lookup,
+                       rule_program_t *program, size_t *bad_rule);
+
+/**
+ * @brief Checks a program loaded from storage before it is evaluated:
+ *        bounds, opcodes, device indices and the stack effect of each
+ *        condition.
+ * @return ESP_OK if the program is safe to evaluate.
+ */
+esp_err_t rule_program_validate(const rule_program_t *program, size_t device_count);
+
+/**
+ * @brief Evaluates every rule on one sample and appends the resulting
+ *        commands to batch (at most one per rule).
+ * @param [in] vars Current value of each rule_var_t.
+ */
+void rule_eval(const rule_program_t *program, rule_state_t *state,
+               const float vars[RULE_VAR_COUNT], uint64_t now_ms, command_batch_t *batch);
+
+#endif // RULE_PROGRAM_H
@@ -0,0 +1,198 @@
+/**
+ * @file rule_engine.c
+ * @brief Holds the active rule program, evaluates it per sample and keeps
+ *        it in NVS.
+ */
+
+#include "rule_engine.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "actuator_manager.h"
+#include "rule_program.h"
+
+#define RULE_NVS_NAMESPACE      "rules"
+#define RULE_NVS_KEY            "program"
+/* Bump when rule_program_t changes layout; older programs are then dropped */
+#define RULE_NVS_VERSION        1
+
+typedef struct {
+    uint8_t version;
+    rule_program_t program;
+} rule_nvs_blob_t;
+
+static const char *TAG = "RULES";
+
+static rule_program_t s_program;
+static rule_state_t s_state;
+static rule_engine_stats_t s_stats;
+static SemaphoreHandle_t s_lock = NULL;
+/* Compiler output and NVS image, too big for the MQTT task stack. Only used
+ * by init and configure, which both run before or on the MQTT task. */
+static rule_nvs_blob_t s_scratch;
+
+static esp_err_t store_program(const rule_program_t *program)
+{
+    nvs_handle_t nvs;
+
+    s_scratch.version = RULE_NVS_VERSION;
+    if (program != &s_scratch.program) {
+        s_scratch.program = *program;
+    }
+
+    esp_err_t err = nvs_open(RULE_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    // Only the rules in use are written
+    size_t size = offsetof(rule_nvs_blob_t, program.rules) + program->count * sizeof(rule_t);
+    err = nvs_set_blob(nvs, RULE_NVS_KEY, &s_scratch, size);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+esp_err_t rule_engine_init(void)
+{
+    nvs_handle_t nvs;
+    size_t size = sizeof(s_scratch);
+
+    if (s_lock != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(&s_program, 0, sizeof(s_program));
+    if (nvs_open(RULE_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return ESP_OK;
+    }
+    memset(&s_scratch, 0, sizeof(s_scratch));
+    esp_err_t err = nvs_get_blob(nvs, RULE_NVS_KEY, &s_scratch, &size);
+    nvs_close(nvs);
+
+    if (err == ESP_OK && s_scratch.version == RULE_NVS_VERSION &&
+        size == offsetof(rule_nvs_blob_t, program.rules) + s_scratch.program.count * sizeof(rule_t) &&
+        rule_program_validate(&s_scratch.program, actuator_manager_count()) == ESP_OK) {
+        s_program = s_scratch.program;
+    } else if (err == ESP_OK) {
+        ESP_LOGW(TAG, "Stored rules are invalid for this firmware, ignoring them");
+    }
+
+    s_stats.rules = s_program.count;
+    ESP_LOGI(TAG, "%u rules loaded", s_program.count);
+    return ESP_OK;
+}
+
+void rule_engine_feed(const telemetry_sample_t *sample)
+{
+    command_batch_t batch = { .count = 0 };
+    const float vars[RULE_VAR_COUNT] = {
+        [RULE_VAR_TEMPERATURE] = sample->temperature,
+        [RULE_VAR_HUMIDITY] = sample->humidity,
+    };
+
+    if (s_lock == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_program.count == 0) {
+        xSemaphoreGive(s_lock);
+        return;
+    }
+    int64_t start = esp_timer_get_time();
+    rule_eval(&s_program, &s_state, vars, sample->timestamp_ms, &batch);
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    s_stats.evaluations++;
+    s_stats.last_us = elapsed;
+    s_stats.total_us += elapsed;
+    if (elapsed > s_stats.max_us) {
+        s_stats.max_us = elapsed;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (batch.count > 0) {
+        esp_err_t err = actuator_manager_submit(&batch);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to queue %u rule commands: %s", batch.count, esp_err_to_name(err));
+        }
+    }
+}
+
+esp_err_t rule_engine_configure(const char *payload, size_t len)
+{
+    size_t bad_rule = 0;
+
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Compile outside the lock; the sensor task keeps evaluating the old program meanwhile
+    esp_err_t err = rule_compile(payload, len, actuator_manager_find, &s_scratch.program, &bad_rule);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Rule %u rejected: %s", (unsigned)bad_rule, esp_err_to_name(err));
+        return err;
+    }
+    // Same checks as a program loaded from NVS, so nothing is installed or
+    // stored that the next boot would refuse
+    err = rule_program_validate(&s_scratch.program, actuator_manager_count());
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Compiled rules failed validation: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_program = s_scratch.program;
+    memset(&s_state, 0, sizeof(s_state));
+    s_stats = (rule_engine_stats_t){ .rules = s_program.count };
+    xSemaphoreGive(s_lock);
+
+    err = store_program(&s_scratch.program);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to store rules: %s", esp_err_to_name(err));
+    }
+    ESP_LOGI(TAG, "%u rules active", s_program.count);
+    return ESP_OK;
+}
+
+void rule_engine_get_stats(rule_engine_stats_t *stats)
+{
+    if (s_lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t rule_engine_status_json(char *buf, size_t len, size_t *out_len)
+{
+    rule_engine_stats_t stats;
+
+    if (buf == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    rule_engine_get_stats(&stats);
+
+    double avg = stats.evaluations ? (double)stats.total_us / stats.evaluations : 0.0;
+    int n = snprintf(buf, len, "{\"rules\":%lu,\"evaluations\":%lu,\"last_us\":%lu,\"max_us\":%lu,\"avg_us\":%.2f}",
+                     (unsigned long)stats.rules, (unsigned long)stats.evaluations,
+                     (unsigned long)stats.last_us, (unsigned long)stats.max_us, avg);
+    if (n < 0 || (size_t)n >= len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_len = (size_t)n;
+    return ESP_OK;
+}
@@ -0,0 +1,461 @@
+/**
+ * @file rule_program.c
+ * @brief Rule compiler (recursive descent to postfix code) and evaluator.
+ */
+
+#include "rule_program.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "json_scan.h"
+
+/* Parenthesis nesting accepted by the compiler, bounds its recursion */
+#define RULE_MAX_NESTING    6
+
+typedef struct {
+    const char *p;
+    const char *end;
+    rule_t *rule;
+    int depth;          /* current evaluation stack depth of the emitted code */
+    int nesting;
+} compiler_t;
+
+static const struct {
+    const char *name;
+    rule_var_t var;
+} var_names[] = {
+    { "temperature", RULE_VAR_TEMPERATURE },
+    { "temp", RULE_VAR_TEMPERATURE },
+    { "humidity", RULE_VAR_HUMIDITY },
+    { "hum", RULE_VAR_HUMIDITY },
+};
+
+static esp_err_t parse_or(compiler_t *c);
+
+static void skip_ws(compiler_t *c)
+{
+    while (c->p < c->end && isspace((unsigned char)*c->p)) {
+        c->p++;
+    }
+}
+
+static size_t word_len(const compiler_t *c)
+{
+    const char *q = c->p;
+    while (q < c->end && (isalnum((unsigned char)*q) || *q == '_')) {
+        q++;
+    }
+    return (size_t)(q - c->p);
+}
+
+static bool match_word(compiler_t *c, const char *word)
+{
+    skip_ws(c);
+    size_t len = word_len(c);
+    if (len == strlen(word) && strncasecmp(c->p, word, len) == 0) {
+        c->p += len;
+        return true;
+    }
+    return false;
+}
+
+static bool match_sym(compiler_t *c, const char *sym)
+{
+    size_t len = strlen(sym);
+    skip_ws(c);
+    if ((size_t)(c->end - c->p) >= len && memcmp(c->p, sym, len) == 0) {
+        c->p += len;
+        return true;
+    }
+    return false;
+}
+
+static esp_err_t emit(compiler_t *c, rule_op_t op, uint8_t var, float value)
+{
+    if (c->rule->code_len >= RULE_MAX_CODE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    c->rule->code[c->rule->code_len++] = (rule_insn_t){ .op = op, .var = var, .value = value };
+    // Comparisons push, binary operators pop two and push one, not keeps the depth
+    c->depth += (op <= RULE_OP_GE) ? 1 : (op == RULE_OP_NOT ? 0 : -1);
+    return ESP_OK;
+}
+
+/* Operand of a comparison: a variable name (returns 1) or a number (returns 0) */
+static esp_err_t parse_operand(compiler_t *c, int *is_var, uint8_t *var, float *value)
+{
+    skip_ws(c);
+    size_t len = word_len(c);
+
+    if (len > 0 && isalpha((unsigned char)*c->p)) {
+        for (size_t i = 0; i < sizeof(var_names) / sizeof(var_names[0]); i++) {
+            if (len == strlen(var_names[i].name) && strncasecmp(c->p, var_names[i].name, len) == 0) {
+                c->p += len;
+                *is_var = 1;
+                *var = (uint8_t)var_names[i].var;
+                return ESP_OK;
+            }
+        }
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Copy the number out: the input is not NUL-terminated
+    char num[24];
+    size_t n = 0;
+    while (c->p + n < c->end && n < sizeof(num) - 1 &&
+           (isdigit((unsigned char)c->p[n]) || c->p[n] == '.' || c->p[n] == '-' || c->p[n] == '+')) {
+        num[n] = c->p[n];
+        n++;
+    }
+    num[n] = '\0';
+
+    char *num_end;
+    double d = strtod(num, &num_end);
+    if (n == 0 || num_end != num + n || !isfinite(d)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    c->p += n;
+    *is_var = 0;
+    *value = (float)d;
+    return ESP_OK;
+}
+
+static esp_err_t parse_comparison(compiler_t *c)
+{
+    static const struct {
+        const char *sym;
+        rule_op_t op;
+        rule_op_t flipped;      /* same test with the operands swapped */
+    } ops[] = {
+        { "<=", RULE_OP_LE, RULE_OP_GE },
+        { ">=", RULE_OP_GE, RULE_OP_LE },
+        { "<", RULE_OP_LT, RULE_OP_GT },
+        { ">", RULE_OP_GT, RULE_OP_LT },
+    };
+    int lhs_var, rhs_var;
+    uint8_t var_l = 0, var_r = 0;
+    float val_l = 0.0f, val_r = 0.0f;
+
+    esp_err_t err = parse_operand(c, &lhs_var, &var_l, &val_l);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    size_t i;
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (match_sym(c, ops[i].sym)) {
+            break;
+        }
+    }
+    if (i == sizeof(ops) / sizeof(ops[0])) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    err = parse_operand(c, &rhs_var, &var_r, &val_r);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Exactly one side must be a variable; "40 > humidity" becomes "humidity < 40"
+    if (lhs_var && !rhs_var) {
+        return emit(c, ops[i].op, var_l, val_r);
+    }
+    if (!lhs_var && rhs_var) {
+        return emit(c, ops[i].flipped, var_r, val_l);
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t parse_unary(compiler_t *c)
+{
+    esp_err_t err;
+
+    if (match_word(c, "not") || match_sym(c, "!")) {
+        err = parse_unary(c);
+        return err == ESP_OK ? emit(c, RULE_OP_NOT, 0, 0.0f) : err;
+    }
+    if (match_sym(c, "(")) {
+        if (++c->nesting > RULE_MAX_NESTING) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        err = parse_or(c);
+        c->nesting--;
+        if (err != ESP_OK) {
+            return err;
+        }
+        return match_sym(c, ")") ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+    return parse_comparison(c);
+}
+
+static esp_err_t parse_and(compiler_t *c)
+{
+    esp_err_t err = parse_unary(c);
+    while (err == ESP_OK && (match_word(c, "and") || match_sym(c, "&&"))) {
+        err = parse_unary(c);
+        if (err == ESP_OK) {
+            err = emit(c, RULE_OP_AND, 0, 0.0f);
+        }
+    }
+    return err;
+}
+
+static esp_err_t parse_or(compiler_t *c)
+{
+    esp_err_t err = parse_and(c);
+    while (err == ESP_OK && (match_word(c, "or") || match_sym(c, "||"))) {
+        err = parse_and(c);
+        if (err == ESP_OK) {
+            err = emit(c, RULE_OP_OR, 0, 0.0f);
+        }
+    }
+    return err;
+}
+
+static esp_err_t compile_condition(const json_tok_t *tok, rule_t *rule)
+{
+    if (tok->type != JSON_TOK_STRING || tok->escaped) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    compiler_t c = { .p = tok->ptr, .end = tok->ptr + tok->len, .rule = rule };
+    esp_err_t err = parse_or(&c);
+    if (err != ESP_OK) {
+        return err;
+    }
+    skip_ws(&c);
+    return (c.p == c.end && c.depth == 1) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t parse_action(const json_tok_t *tok, command_device_lookup_t lookup, rule_t *rule)
+{
+    json_scan_t scan;
+    json_tok_t key, val;
+    bool have_device = false, have_state = false;
+
+    esp_err_t err = json_scan_object(&scan, tok->ptr, tok->len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    while ((err = json_scan_next_member(&scan, &key, &val)) == ESP_OK) {
+        if (json_tok_equals(&key, "device") || json_tok_equals(&key, "type")) {
+            if (val.type != JSON_TOK_STRING || val.escaped) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            int index = lookup(val.ptr, val.len);
+            if (index < 0 || index > UINT8_MAX) {
+                return ESP_ERR_NOT_FOUND;
+            }
+            rule->device = (uint8_t)index;
+            have_device = true;
+        } else if (json_tok_equals(&key, "state")) {
+            if (val.type == JSON_TOK_TRUE || json_tok_equals(&val, "on")) {
+                rule->action = RELAY_CMD_ON;
+            } else if (val.type == JSON_TOK_FALSE || json_tok_equals(&val, "off")) {
+                rule->action = RELAY_CMD_OFF;
+            } else {
+                return ESP_ERR_INVALID_ARG;
+            }
+            have_state = true;
+        }
+    }
+    if (err != ESP_ERR_NOT_FOUND) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return (have_device && have_state) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t compile_rule(const json_tok_t *tok, command_device_lookup_t lookup, rule_t *rule)
+{
+    json_scan_t scan;
+    json_tok_t key, val;
+    bool have_if = false, have_then = false;
+
+    memset(rule, 0, sizeof(*rule));
+    esp_err_t err = json_scan_object(&scan, tok->ptr, tok->len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    while ((err = json_scan_next_member(&scan, &key, &val)) == ESP_OK) {
+        esp_err_t field_err = ESP_OK;
+        if (json_tok_equals(&key, "if")) {
+            // A second condition would be appended to the first one's code
+            if (have_if) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            field_err = compile_condition(&val, rule);
+            have_if = true;
+        } else if (json_tok_equals(&key, "then")) {
+            if (have_then) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            field_err = parse_action(&val, lookup, rule);
+            have_then = true;
+        } else if (json_tok_equals(&key, "for_s")) {
+            double seconds;
+            if (json_tok_to_double(&val, &seconds) != ESP_OK || !(seconds >= 0.0 && seconds <= 86400.0)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            rule->hold_ms = (uint32_t)(seconds * 1000.0);
+        }
+        if (field_err != ESP_OK) {
+            return field_err;
+        }
+    }
+    if (err != ESP_ERR_NOT_FOUND) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return (have_if && have_then) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rule_compile(const char *buf, size_t len, command_device_lookup_t lookup,
+                       rule_program_t *program, size_t *bad_rule)
+{
+    json_scan_t scan, rules;
+    json_tok_t key, val, item;
+    bool have_rules = false;
+    esp_err_t err;
+
+    if (buf == NULL || lookup == NULL || program == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    program->count = 0;
+
+    err = json_scan_object(&scan, buf, len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    while ((err = json_scan_next_member(&scan, &key, &val)) == ESP_OK) {
+        if (!json_tok_equals(&key, "rules")) {
+            continue;
+        }
+        if (json_scan_array(&rules, val.ptr, val.len) != ESP_OK) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        have_rules = true;
+
+        while ((err = json_scan_next_element(&rules, &item)) == ESP_OK) {
+            if (program->count >= RULE_MAX_RULES) {
+                err = ESP_ERR_INVALID_SIZE;
+            } else {
+                err = compile_rule(&item, lookup, &program->rules[program->count]);
+            }
+            if (err != ESP_OK) {
+                if (bad_rule != NULL) {
+                    *bad_rule = program->count;
+                }
+                return err;
+            }
+            program->count++;
+        }
+        if (err != ESP_ERR_NOT_FOUND) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    if (err != ESP_ERR_NOT_FOUND) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return have_rules ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rule_program_validate(const rule_program_t *program, size_t device_count)
+{
+    if (program->count > RULE_MAX_RULES) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for (size_t i = 0; i < program->count; i++) {
+        const rule_t *rule = &program->rules[i];
+        int depth = 0;
+
+        if (rule->device >= device_count || rule->code_len == 0 || rule->code_len > RULE_MAX_CODE ||
+            (rule->action != RELAY_CMD_ON && rule->action != RELAY_CMD_OFF)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        // Replay the stack effect so evaluation can never under- or overflow
+        for (size_t j = 0; j < rule->code_len; j++) {
+            const rule_insn_t *insn = &rule->code[j];
+            if (insn->op <= RULE_OP_GE) {
+                if (insn->var >= RULE_VAR_COUNT) {
+                    return ESP_ERR_INVALID_ARG;
+                }
+                depth++;
+            } else if (insn->op == RULE_OP_AND || insn->op == RULE_OP_OR) {
+                if (depth < 2) {
+                    return ESP_ERR_INVALID_ARG;
+                }
+                depth--;
+            } else if (insn->op != RULE_OP_NOT || depth < 1) {
+                return ESP_ERR_INVALID_ARG;
+            }
+        }
+        if (depth != 1) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    return ESP_OK;
+}
+
+static bool run_condition(const rule_t *rule, const float vars[RULE_VAR_COUNT])
+{
+    bool stack[RULE_MAX_CODE];
+    int sp = 0;
+
+    for (uint8_t i = 0; i < rule->code_len; i++) {
+        const rule_insn_t *insn = &rule->code[i];
+        switch (insn->op) {
+            case RULE_OP_LT: stack[sp++] = vars[insn->var] < insn->value; break;
+            case RULE_OP_LE: stack[sp++] = vars[insn->var] <= insn->value; break;
+            case RULE_OP_GT: stack[sp++] = vars[insn->var] > insn->value; break;
+            case RULE_OP_GE: stack[sp++] = vars[insn->var] >= insn->value; break;
+            case RULE_OP_AND: sp--; stack[sp - 1] = stack[sp - 1] && stack[sp]; break;
+            case RULE_OP_OR: sp--; stack[sp - 1] = stack[sp - 1] || stack[sp]; break;
+            case RULE_OP_NOT: stack[sp - 1] = !stack[sp - 1]; break;
+            default: return false;
+        }
+    }
+    return sp == 1 && stack[0];
+}
+
+static void push_command(command_batch_t *batch, uint8_t device, uint8_t action)
+{
+    if (batch->count < COMMAND_BATCH_MAX) {
+        batch->cmds[batch->count].device = device;
+        batch->cmds[batch->count].action = action;
+        batch->count++;
+    }
+}
+
+void rule_eval(const rule_program_t *program, rule_state_t *state,
+               const float vars[RULE_VAR_COUNT], uint64_t now_ms, command_batch_t *batch)
+{
+    for (uint8_t i = 0; i < program->count; i++) {
+        const rule_t *rule = &program->rules[i];
+        uint32_t bit = 1u << i;
+        bool holds = run_condition(rule, vars);
+
+        if (rule->hold_ms == 0) {
+            if (holds && !(state->last_true & bit)) {
+                push_command(batch, rule->device, rule->action);
+            }
+        } else if (state->active & bit) {
+            if (now_ms >= state->expires_ms[i]) {
+                if (holds) {
+                    state->expires_ms[i] = now_ms + rule->hold_ms;
+                } else {
+                    state->active &= ~bit;
+                    push_command(batch, rule->device,
+                                 rule->action == RELAY_CMD_ON ? RELAY_CMD_OFF : RELAY_CMD_ON);
+                }
+            }
+        } else if (holds) {
+            state->active |= bit;
+            state->expires_ms[i] = now_ms + rule->hold_ms;
+            push_command(batch, rule->device, rule->action);
+        }
+
+        state->last_true = holds ? (state->last_true | bit) : (state->last_true & ~bit);
+    }
+}
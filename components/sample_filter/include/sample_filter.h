@@ -0,0 +1,63 @@
+/**
+ * @file sample_filter.h
+ * @brief Smoothing and deadband gating of sensor samples before publishing.
+ *
+ * Each channel goes through a short median (drops single-sample spikes),
+ * then an exponential moving average (smooths sensor noise). A filtered
+ * sample is only passed on for publishing when a channel moved by more than
+ * its deadband since the last published sample, or when nothing was
+ * published for heartbeat_ms, so a steady room produces a trickle of
+ * heartbeats instead of a sample every period.
+ */
+
+#ifndef SAMPLE_FILTER_H
+#define SAMPLE_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry_codec.h"
+
+#define SAMPLE_FILTER_MEDIAN_MAX    5
+
+typedef struct {
+    uint8_t median_len;         /* 1 (off), 3 or 5 */
+    float ema_alpha;            /* weight of the new sample, 1.0 = no smoothing */
+    float temp_deadband;        /* degrees C */
+    float hum_deadband;         /* %RH */
+    uint32_t heartbeat_ms;      /* longest silence, 0 = no heartbeat */
+} sample_filter_config_t;
+
+typedef struct {
+    sample_filter_config_t cfg;
+    float temp_window[SAMPLE_FILTER_MEDIAN_MAX];
+    float hum_window[SAMPLE_FILTER_MEDIAN_MAX];
+    uint8_t filled;
+    uint8_t next;
+    bool smoothed_valid;
+    float temp_smoothed;
+    float hum_smoothed;
+    bool published_valid;
+    float temp_published;
+    float hum_published;
+    uint64_t published_ms;
+    uint32_t passed;            /* samples passed on for publishing */
+    uint32_t suppressed;        /* samples held back by the deadband */
+} sample_filter_t;
+
+/**
+ * @brief Initializes a filter.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for an unsupported median length
+ *         or an alpha outside (0, 1].
+ */
+esp_err_t sample_filter_init(sample_filter_t *filter, const sample_filter_config_t *config);
+
+/**
+ * @brief Filters one valid raw sample. Failed reads must not be fed in.
+ * @param [in] raw Raw sample.
+ * @param [out] out Filtered sample, always written (also used for local control).
+ * @return true if out should be published.
+ */
+bool sample_filter_update(sample_filter_t *filter, const telemetry_sample_t *raw, telemetry_sample_t *out);
+
+#endif // SAMPLE_FILTER_H
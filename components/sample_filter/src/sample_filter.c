@@ -0,0 +1,88 @@
+/**
+ * @file sample_filter.c
+ * @brief Median + EMA smoothing with deadband/heartbeat publishing.
+ */
+
+#include "sample_filter.h"
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Median of the first n values; n <= SAMPLE_FILTER_MEDIAN_MAX, so insertion sort on a copy */
+static float median(const float *values, uint8_t n)
+{
+    float sorted[SAMPLE_FILTER_MEDIAN_MAX];
+
+    // Copy first, then sort in place: every slot is written before it is read
+    memcpy(sorted, values, n * sizeof(sorted[0]));
+    for (uint8_t i = 1; i < n; i++) {
+        float v = sorted[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    // Even counts only occur while the window fills; take the lower middle
+    return sorted[(n - 1) / 2];
+}
+
+esp_err_t sample_filter_init(sample_filter_t *filter, const sample_filter_config_t *config)
+{
+    if (filter == NULL || config == NULL ||
+        (config->median_len != 1 && config->median_len != 3 && config->median_len != 5) ||
+        !(config->ema_alpha > 0.0f && config->ema_alpha <= 1.0f) ||
+        config->temp_deadband < 0.0f || config->hum_deadband < 0.0f) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(filter, 0, sizeof(*filter));
+    filter->cfg = *config;
+    return ESP_OK;
+}
+
+bool sample_filter_update(sample_filter_t *filter, const telemetry_sample_t *raw, telemetry_sample_t *out)
+{
+    const sample_filter_config_t *cfg = &filter->cfg;
+
+    filter->temp_window[filter->next] = raw->temperature;
+    filter->hum_window[filter->next] = raw->humidity;
+    filter->next = (uint8_t)((filter->next + 1) % cfg->median_len);
+    if (filter->filled < cfg->median_len) {
+        filter->filled++;
+    }
+
+    float temp = median(filter->temp_window, filter->filled);
+    float hum = median(filter->hum_window, filter->filled);
+
+    if (!filter->smoothed_valid) {
+        filter->temp_smoothed = temp;
+        filter->hum_smoothed = hum;
+        filter->smoothed_valid = true;
+    } else {
+        filter->temp_smoothed += cfg->ema_alpha * (temp - filter->temp_smoothed);
+        filter->hum_smoothed += cfg->ema_alpha * (hum - filter->hum_smoothed);
+    }
+
+    out->timestamp_ms = raw->timestamp_ms;
+    out->temperature = filter->temp_smoothed;
+    out->humidity = filter->hum_smoothed;
+
+    bool publish = !filter->published_valid ||
+                   fabsf(out->temperature - filter->temp_published) > cfg->temp_deadband ||
+                   fabsf(out->humidity - filter->hum_published) > cfg->hum_deadband ||
+                   (cfg->heartbeat_ms > 0 && raw->timestamp_ms - filter->published_ms >= cfg->heartbeat_ms);
+
+    if (!publish) {
+        filter->suppressed++;
+        return false;
+    }
+
+    filter->published_valid = true;
+    filter->temp_published = out->temperature;
+    filter->hum_published = out->humidity;
+    filter->published_ms = raw->timestamp_ms;
+    filter->passed++;
+    return true;
+}
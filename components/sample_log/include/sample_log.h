@@ -0,0 +1,94 @@
+/**
+ * @file sample_log.h
+ * @brief Store-and-forward log of sensor samples and rollups on a dedicated
+ *        flash partition.
+ *
+ * The partition is used as an append-only ring of 4 KB sectors. Sectors are
+ * filled in order and erased only when the ring wraps, so erases are spread
+ * evenly over the whole partition. Samples are stored as small delta-encoded
+ * records; each sector starts from a full keyframe so it decodes on its own.
+ *
+ * Rollups are stored whole, in the same ring between the samples.
+ *
+ * Records are read back in the order they were written. Reading is two-phase:
+ * sample_log_peek() returns the oldest pending samples (or
+ * sample_log_peek_rollup() the oldest rollup) and sample_log_consume() marks
+ * them as sent once the caller has handed them off, so nothing is lost if the
+ * device resets in between.
+ */
+
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry_codec.h"
+
+/* Largest number of samples returned by one peek */
+#define SAMPLE_LOG_PEEK_MAX     32
+
+/**
+ * @brief Mounts the log partition and rebuilds the read/write position from flash.
+ * @param [in] partition_label Label of the data partition used for the log.
+ * @param [in] boot_id Identifier of the current boot, stored with every sector.
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the partition does not exist,
+ *         or an error code on failure.
+ */
+esp_err_t sample_log_init(const char *partition_label, uint32_t boot_id);
+
+/**
+ * @brief Appends a sample. When the partition is full the oldest sector is
+ *        erased and its unsent samples are dropped.
+ * @param [in] sample Sample to store.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t sample_log_append(const telemetry_sample_t *sample);
+
+/**
+ * @brief Appends a rollup, like sample_log_append().
+ * @param [in] rollup Rollup to store.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t sample_log_append_rollup(const telemetry_rollup_t *rollup);
+
+/**
+ * @brief Reads the oldest unsent samples without removing them. All returned
+ *        samples come from the same boot. Stops at the first unsent rollup,
+ *        so count is 0 while one is next in line.
+ * @param [out] out Destination array.
+ * @param [in] max_count Capacity of out, at most SAMPLE_LOG_PEEK_MAX.
+ * @param [out] count Number of samples returned.
+ * @param [out] boot_id Boot the samples were recorded in.
+ * @return ESP_OK on success (count may be 0), or an error code on failure.
+ */
+esp_err_t sample_log_peek(telemetry_sample_t *out, uint32_t max_count, uint32_t *count,
+                          uint32_t *boot_id);
+
+/**
+ * @brief Reads the oldest unsent record if it is a rollup, without removing
+ *        it; sample_log_consume() confirms it like a peek of samples.
+ * @param [out] out Receives the rollup.
+ * @param [out] count 1 if a rollup was returned, 0 if samples come first or nothing is pending.
+ * @param [out] boot_id Boot the rollup was recorded in.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t sample_log_peek_rollup(telemetry_rollup_t *out, uint32_t *count, uint32_t *boot_id);
+
+/**
+ * @brief Marks the records returned by the last peek as sent.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if there is no peek to
+ *         confirm or the peeked samples were overwritten meanwhile.
+ */
+esp_err_t sample_log_consume(void);
+
+/**
+ * @brief Number of records (samples and rollups) stored but not yet sent (backlog depth).
+ */
+uint32_t sample_log_pending(void);
+
+/**
+ * @brief Number of unsent records lost because the log wrapped.
+ */
+uint32_t sample_log_dropped(void);
+
+#endif // SAMPLE_LOG_H
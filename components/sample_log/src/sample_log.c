@@ -0,0 +1,643 @@
+/**
+ * @file sample_log.c
+ * @brief Flash ring log for samples taken while offline.
+ *
+ * Sector layout:
+ *   header  : magic u32, seq u32, boot_id u32, reserved u32
+ *   records : len u8, state u8, payload[len]   (len == 0xFF marks erased space)
+ *
+ * The first sample record of a sector is a keyframe (absolute values), the
+ * others hold zigzag varint deltas to the previous sample record. Rollup
+ * records set REC_LEN_ROLLUP in the length byte and hold a telemetry_rollup_t
+ * as is; they sit between the samples without breaking the delta chain. A
+ * record is consumed by programming its state byte from 0xFF to 0x00, which
+ * needs no erase.
+ */
+
+#include "sample_log.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+
+#define SECTOR_SIZE         4096
+#define SECTOR_MAGIC        0x31474C53u     /* "SLG1" */
+#define SECTOR_HDR_LEN      16
+#define REC_HDR_LEN         2
+#define REC_MAX_PAYLOAD     24
+#define REC_LEN_ROLLUP      0x80            /* flag in the length byte */
+#define REC_ROLLUP_PAYLOAD  sizeof(telemetry_rollup_t)
+#define REC_LEN_ERASED      0xFF
+#define REC_STATE_PENDING   0xFF
+#define REC_STATE_CONSUMED  0x00
+
+static const char *TAG = "SAMPLE_LOG";
+
+_Static_assert(REC_ROLLUP_PAYLOAD < (REC_LEN_ERASED & ~REC_LEN_ROLLUP), "rollup record length must fit the length byte");
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t boot_id;
+    uint32_t reserved;
+} sector_hdr_t;
+
+/* Integer form of a sample, as stored (0.01 C / 0.01 %RH / ms) */
+typedef struct {
+    int32_t temp;
+    int32_t hum;
+    uint64_t ts_ms;
+} log_point_t;
+
+/* Position of a record plus the delta state needed to decode it */
+typedef struct {
+    uint32_t sector;
+    uint32_t seq;
+    uint32_t boot_id;
+    uint32_t off;
+    log_point_t prev;
+} log_cursor_t;
+
+static struct {
+    const esp_partition_t *part;
+    SemaphoreHandle_t lock;
+    uint32_t sector_count;
+    uint32_t boot_id;
+    uint32_t next_seq;
+    uint32_t next_sector;       /* sector opened by the next append when none is open */
+    uint32_t generation;        /* bumped on every erase, invalidates outstanding peeks */
+
+    bool w_open;
+    log_cursor_t w;             /* append position */
+
+    log_cursor_t r;             /* oldest pending record, valid while pending > 0 */
+    uint32_t pending;
+    uint32_t dropped;
+
+    bool peek_valid;
+    uint32_t peek_generation;
+    uint32_t peek_count;
+    log_cursor_t peek_end;
+    uint32_t peek_sector[SAMPLE_LOG_PEEK_MAX];
+    uint16_t peek_off[SAMPLE_LOG_PEEK_MAX];
+} s_log;
+
+/* ----- varint helpers ----- */
+
+static size_t put_uvarint(uint8_t *p, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static size_t put_svarint(uint8_t *p, int64_t v)
+{
+    return put_uvarint(p, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static bool get_uvarint(const uint8_t *p, size_t len, size_t *pos, uint64_t *v)
+{
+    uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64 && *pos < len; shift += 7) {
+        uint8_t b = p[(*pos)++];
+        result |= (uint64_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool get_svarint(const uint8_t *p, size_t len, size_t *pos, int64_t *v)
+{
+    uint64_t u;
+    if (!get_uvarint(p, len, pos, &u)) {
+        return false;
+    }
+    *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+    return true;
+}
+
+/* ----- record encoding ----- */
+
+static log_point_t to_point(const telemetry_sample_t *s)
+{
+    log_point_t p = {
+        .temp = isnan(s->temperature) ? 0 : (int32_t)lroundf(s->temperature * 100.0f),
+        .hum = isnan(s->humidity) ? 0 : (int32_t)lroundf(s->humidity * 100.0f),
+        .ts_ms = s->timestamp_ms,
+    };
+    return p;
+}
+
+static size_t encode_record(uint8_t *payload, const log_point_t *pt, const log_point_t *prev,
+                            bool keyframe)
+{
+    size_t n = 0;
+    if (keyframe) {
+        n += put_svarint(&payload[n], pt->temp);
+        n += put_svarint(&payload[n], pt->hum);
+        n += put_uvarint(&payload[n], pt->ts_ms);
+    } else {
+        n += put_svarint(&payload[n], (int64_t)pt->temp - prev->temp);
+        n += put_svarint(&payload[n], (int64_t)pt->hum - prev->hum);
+        n += put_uvarint(&payload[n], pt->ts_ms - prev->ts_ms);
+    }
+    return n;
+}
+
+static bool decode_record(const uint8_t *payload, size_t len, log_point_t *pt, bool keyframe)
+{
+    size_t pos = 0;
+    int64_t t, h;
+    uint64_t ts;
+    if (!get_svarint(payload, len, &pos, &t) || !get_svarint(payload, len, &pos, &h) ||
+        !get_uvarint(payload, len, &pos, &ts) || pos != len) {
+        return false;
+    }
+    if (keyframe) {
+        pt->temp = (int32_t)t;
+        pt->hum = (int32_t)h;
+        pt->ts_ms = ts;
+    } else {
+        pt->temp += (int32_t)t;
+        pt->hum += (int32_t)h;
+        pt->ts_ms += ts;
+    }
+    return true;
+}
+
+/* ----- flash access ----- */
+
+static uint32_t sector_addr(uint32_t sector)
+{
+    return sector * SECTOR_SIZE;
+}
+
+static bool read_header(uint32_t sector, sector_hdr_t *hdr)
+{
+    if (esp_partition_read(s_log.part, sector_addr(sector), hdr, sizeof(*hdr)) != ESP_OK) {
+        return false;
+    }
+    return hdr->magic == SECTOR_MAGIC;
+}
+
+typedef enum {
+    STEP_RECORD,        /* a sample record was decoded, cursor moved past it */
+    STEP_ROLLUP,        /* a rollup record was read, cursor moved past it */
+    STEP_END,           /* no more records in this sector */
+} step_result_t;
+
+/**
+ * Decodes the record at the cursor and advances it within the sector.
+ * @param [out] rollup Receives a rollup record; may be NULL.
+ */
+static step_result_t cursor_step(log_cursor_t *c, log_point_t *pt, telemetry_rollup_t *rollup,
+                                 uint8_t *state)
+{
+    uint8_t hdr[REC_HDR_LEN];
+    uint8_t payload[REC_ROLLUP_PAYLOAD > REC_MAX_PAYLOAD ? REC_ROLLUP_PAYLOAD : REC_MAX_PAYLOAD];
+
+    if (c->off + REC_HDR_LEN > SECTOR_SIZE ||
+        esp_partition_read(s_log.part, sector_addr(c->sector) + c->off, hdr, sizeof(hdr)) != ESP_OK ||
+        hdr[0] == REC_LEN_ERASED) {
+        return STEP_END;
+    }
+    bool is_rollup = (hdr[0] & REC_LEN_ROLLUP) != 0;
+    size_t len = hdr[0] & ~REC_LEN_ROLLUP;
+    if (is_rollup ? len != REC_ROLLUP_PAYLOAD : (len == 0 || len > REC_MAX_PAYLOAD)) {
+        return STEP_END;
+    }
+    if (c->off + REC_HDR_LEN + len > SECTOR_SIZE ||
+        esp_partition_read(s_log.part, sector_addr(c->sector) + c->off + REC_HDR_LEN,
+                           payload, len) != ESP_OK) {
+        return STEP_END;
+    }
+
+    if (is_rollup) {
+        if (rollup != NULL) {
+            memcpy(rollup, payload, sizeof(*rollup));
+        }
+        c->off += REC_HDR_LEN + len;
+        *state = hdr[1];
+        return STEP_ROLLUP;
+    }
+
+    log_point_t next = c->prev;
+    if (!decode_record(payload, len, &next, c->off == SECTOR_HDR_LEN)) {
+        /* Torn write: treat the rest of the sector as empty */
+        ESP_LOGW(TAG, "Corrupt record in sector %lu at %lu", (unsigned long)c->sector,
+                 (unsigned long)c->off);
+        return STEP_END;
+    }
+
+    c->prev = next;
+    c->off += REC_HDR_LEN + len;
+    *pt = next;
+    *state = hdr[1];
+    return STEP_RECORD;
+}
+
+/**
+ * Moves the cursor to the start of the sector written after it.
+ * @return false if there is no such sector.
+ */
+static bool cursor_next_sector(log_cursor_t *c)
+{
+    if (s_log.w_open && c->sector == s_log.w.sector) {
+        return false;
+    }
+
+    uint32_t next = (c->sector + 1) % s_log.sector_count;
+    sector_hdr_t hdr;
+    if (!read_header(next, &hdr) || hdr.seq != c->seq + 1) {
+        return false;
+    }
+
+    c->sector = next;
+    c->seq = hdr.seq;
+    c->boot_id = hdr.boot_id;
+    c->off = SECTOR_HDR_LEN;
+    memset(&c->prev, 0, sizeof(c->prev));
+    return true;
+}
+
+static bool cursor_at_writer(const log_cursor_t *c)
+{
+    return s_log.w_open && c->sector == s_log.w.sector && c->off >= s_log.w.off;
+}
+
+/**
+ * Counts the records from the cursor to the end of its sector.
+ */
+static uint32_t count_records_to_end(log_cursor_t c)
+{
+    uint32_t n = 0;
+    log_point_t pt;
+    uint8_t state;
+    while (cursor_step(&c, &pt, NULL, &state) != STEP_END) {
+        if (state == REC_STATE_PENDING) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static esp_err_t open_sector(uint32_t sector)
+{
+    sector_hdr_t old;
+    if (read_header(sector, &old) && s_log.pending > 0 && s_log.r.sector == sector) {
+        /* Log is full: the oldest unsent samples make room for new ones */
+        uint32_t lost = count_records_to_end(s_log.r);
+        s_log.dropped += lost;
+        s_log.pending -= lost;
+        ESP_LOGW(TAG, "Log full, dropped %lu unsent records", (unsigned long)lost);
+        if (s_log.pending > 0 && !cursor_next_sector(&s_log.r)) {
+            s_log.pending = 0;
+        }
+    }
+
+    esp_err_t err = esp_partition_erase_range(s_log.part, sector_addr(sector), SECTOR_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Erase of sector %lu failed: %s", (unsigned long)sector, esp_err_to_name(err));
+        return err;
+    }
+    s_log.generation++;
+
+    sector_hdr_t hdr = {
+        .magic = SECTOR_MAGIC,
+        .seq = s_log.next_seq,
+        .boot_id = s_log.boot_id,
+        .reserved = 0xFFFFFFFFu,
+    };
+    err = esp_partition_write(s_log.part, sector_addr(sector), &hdr, sizeof(hdr));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Header write to sector %lu failed: %s", (unsigned long)sector, esp_err_to_name(err));
+        return err;
+    }
+
+    s_log.next_seq++;
+    s_log.next_sector = (sector + 1) % s_log.sector_count;
+    s_log.w_open = true;
+    s_log.w.sector = sector;
+    s_log.w.seq = hdr.seq;
+    s_log.w.boot_id = hdr.boot_id;
+    s_log.w.off = SECTOR_HDR_LEN;
+    memset(&s_log.w.prev, 0, sizeof(s_log.w.prev));
+    return ESP_OK;
+}
+
+/**
+ * Writes a record (length byte already set) at the append position of the
+ * open sector and counts it as pending. Called with the lock held.
+ */
+static esp_err_t write_record(uint8_t *rec, size_t payload_len)
+{
+    rec[1] = REC_STATE_PENDING;
+    esp_err_t err = esp_partition_write(s_log.part, sector_addr(s_log.w.sector) + s_log.w.off,
+                                        rec, REC_HDR_LEN + payload_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Record write failed: %s", esp_err_to_name(err));
+        /* The sector tail may be half written; continue in a fresh sector */
+        s_log.w_open = false;
+        s_log.next_sector = (s_log.w.sector + 1) % s_log.sector_count;
+        return err;
+    }
+    if (s_log.pending == 0) {
+        s_log.r = s_log.w;
+    }
+    s_log.pending++;
+    s_log.w.off += REC_HDR_LEN + payload_len;
+    return ESP_OK;
+}
+
+/* ----- public API ----- */
+
+esp_err_t sample_log_init(const char *partition_label, uint32_t boot_id)
+{
+    memset(&s_log, 0, sizeof(s_log));
+
+    s_log.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                          partition_label);
+    if (s_log.part == NULL) {
+        ESP_LOGE(TAG, "Partition '%s' not found", partition_label);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    s_log.sector_count = s_log.part->size / SECTOR_SIZE;
+    if (s_log.sector_count < 2) {
+        ESP_LOGE(TAG, "Partition '%s' too small", partition_label);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    s_log.lock = xSemaphoreCreateMutex();
+    if (s_log.lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_log.boot_id = boot_id;
+
+    /* Find the oldest and newest sector by sequence number */
+    bool found = false;
+    uint32_t oldest = 0, newest = 0, oldest_seq = 0, newest_seq = 0;
+    for (uint32_t i = 0; i < s_log.sector_count; i++) {
+        sector_hdr_t hdr;
+        if (!read_header(i, &hdr)) {
+            continue;
+        }
+        if (!found || hdr.seq < oldest_seq) {
+            oldest = i;
+            oldest_seq = hdr.seq;
+        }
+        if (!found || hdr.seq > newest_seq) {
+            newest = i;
+            newest_seq = hdr.seq;
+        }
+        found = true;
+    }
+
+    if (!found) {
+        s_log.next_seq = 1;
+        s_log.next_sector = 0;
+        ESP_LOGI(TAG, "Empty log, %lu sectors", (unsigned long)s_log.sector_count);
+        return ESP_OK;
+    }
+
+    s_log.next_seq = newest_seq + 1;
+    /* Every boot starts a fresh sector so a sector never mixes boots */
+    s_log.next_sector = (newest + 1) % s_log.sector_count;
+
+    /* Walk all records oldest first; the first pending one becomes the read cursor */
+    sector_hdr_t hdr;
+    read_header(oldest, &hdr);
+    log_cursor_t c = {
+        .sector = oldest,
+        .seq = hdr.seq,
+        .boot_id = hdr.boot_id,
+        .off = SECTOR_HDR_LEN,
+    };
+    do {
+        while (true) {
+            log_cursor_t before = c;
+            log_point_t pt;
+            uint8_t state;
+            if (cursor_step(&c, &pt, NULL, &state) == STEP_END) {
+                break;
+            }
+            if (state == REC_STATE_PENDING) {
+                if (s_log.pending == 0) {
+                    s_log.r = before;
+                }
+                s_log.pending++;
+            }
+        }
+    } while (cursor_next_sector(&c));
+
+    ESP_LOGI(TAG, "Log mounted: %lu sectors, %lu records pending",
+             (unsigned long)s_log.sector_count, (unsigned long)s_log.pending);
+    return ESP_OK;
+}
+
+esp_err_t sample_log_append(const telemetry_sample_t *sample)
+{
+    if (s_log.part == NULL || sample == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_log.lock, portMAX_DELAY);
+
+    esp_err_t err = ESP_OK;
+    log_point_t pt = to_point(sample);
+    uint8_t rec[REC_HDR_LEN + REC_MAX_PAYLOAD];
+
+    /* Deltas assume time moves forward; start a new keyframe otherwise */
+    bool fits = false;
+    size_t len = 0;
+    if (s_log.w_open && s_log.w.off > SECTOR_HDR_LEN && pt.ts_ms >= s_log.w.prev.ts_ms) {
+        len = encode_record(&rec[REC_HDR_LEN], &pt, &s_log.w.prev, false);
+        fits = s_log.w.off + REC_HDR_LEN + len <= SECTOR_SIZE;
+    }
+    if (!fits) {
+        err = open_sector(s_log.w_open ? (s_log.w.sector + 1) % s_log.sector_count
+                                       : s_log.next_sector);
+        if (err != ESP_OK) {
+            s_log.w_open = false;
+            xSemaphoreGive(s_log.lock);
+            return err;
+        }
+        len = encode_record(&rec[REC_HDR_LEN], &pt, &s_log.w.prev, true);
+    }
+
+    rec[0] = (uint8_t)len;
+    err = write_record(rec, len);
+    if (err == ESP_OK) {
+        s_log.w.prev = pt;
+    }
+
+    xSemaphoreGive(s_log.lock);
+    return err;
+}
+
+esp_err_t sample_log_append_rollup(const telemetry_rollup_t *rollup)
+{
+    if (s_log.part == NULL || rollup == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_log.lock, portMAX_DELAY);
+
+    esp_err_t err = ESP_OK;
+    uint8_t rec[REC_HDR_LEN + REC_ROLLUP_PAYLOAD];
+
+    if (!s_log.w_open || s_log.w.off + sizeof(rec) > SECTOR_SIZE) {
+        err = open_sector(s_log.w_open ? (s_log.w.sector + 1) % s_log.sector_count
+                                       : s_log.next_sector);
+        if (err != ESP_OK) {
+            s_log.w_open = false;
+            xSemaphoreGive(s_log.lock);
+            return err;
+        }
+    }
+
+    rec[0] = (uint8_t)(REC_LEN_ROLLUP | REC_ROLLUP_PAYLOAD);
+    memcpy(&rec[REC_HDR_LEN], rollup, REC_ROLLUP_PAYLOAD);
+    err = write_record(rec, REC_ROLLUP_PAYLOAD);
+
+    xSemaphoreGive(s_log.lock);
+    return err;
+}
+
+/**
+ * Collects the oldest pending records of one kind and one boot for a later
+ * consume: up to max_count samples into out, or a single rollup if rollup is
+ * not NULL. Stops at the first pending record of the other kind.
+ */
+static uint32_t peek_records(telemetry_sample_t *out, uint32_t max_count, telemetry_rollup_t *rollup,
+                             uint32_t *boot_id)
+{
+    xSemaphoreTake(s_log.lock, portMAX_DELAY);
+
+    uint32_t n = 0;
+    log_cursor_t c = s_log.r;
+    uint32_t boot = c.boot_id;
+
+    if (s_log.pending > 0) {
+        while (n < max_count && !cursor_at_writer(&c)) {
+            log_cursor_t before = c;
+            log_point_t pt = { 0 };
+            uint8_t state;
+            step_result_t step = cursor_step(&c, &pt, rollup, &state);
+            if (step == STEP_END) {
+                log_cursor_t probe = c;
+                if (!cursor_next_sector(&probe) || (n > 0 && probe.boot_id != boot)) {
+                    break;
+                }
+                c = probe;
+                boot = c.boot_id;
+                continue;
+            }
+            if (state != REC_STATE_PENDING) {
+                continue;
+            }
+            if ((step == STEP_ROLLUP) != (rollup != NULL)) {
+                c = before;
+                break;
+            }
+            s_log.peek_sector[n] = before.sector;
+            s_log.peek_off[n] = (uint16_t)before.off;
+            if (step == STEP_RECORD) {
+                out[n].temperature = (float)pt.temp / 100.0f;
+                out[n].humidity = (float)pt.hum / 100.0f;
+                out[n].timestamp_ms = pt.ts_ms;
+            }
+            n++;
+        }
+    }
+
+    s_log.peek_valid = n > 0;
+    s_log.peek_count = n;
+    s_log.peek_end = c;
+    s_log.peek_generation = s_log.generation;
+
+    xSemaphoreGive(s_log.lock);
+
+    if (boot_id != NULL) {
+        *boot_id = boot;
+    }
+    return n;
+}
+
+esp_err_t sample_log_peek(telemetry_sample_t *out, uint32_t max_count, uint32_t *count,
+                          uint32_t *boot_id)
+{
+    if (s_log.part == NULL || out == NULL || count == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (max_count > SAMPLE_LOG_PEEK_MAX) {
+        max_count = SAMPLE_LOG_PEEK_MAX;
+    }
+
+    *count = peek_records(out, max_count, NULL, boot_id);
+    return ESP_OK;
+}
+
+esp_err_t sample_log_peek_rollup(telemetry_rollup_t *out, uint32_t *count, uint32_t *boot_id)
+{
+    if (s_log.part == NULL || out == NULL || count == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    *count = peek_records(NULL, 1, out, boot_id);
+    return ESP_OK;
+}
+
+esp_err_t sample_log_consume(void)
+{
+    if (s_log.part == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_log.lock, portMAX_DELAY);
+
+    if (!s_log.peek_valid || s_log.peek_generation != s_log.generation) {
+        s_log.peek_valid = false;
+        xSemaphoreGive(s_log.lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const uint8_t consumed = REC_STATE_CONSUMED;
+    for (uint32_t i = 0; i < s_log.peek_count; i++) {
+        esp_err_t err = esp_partition_write(s_log.part,
+                                            sector_addr(s_log.peek_sector[i]) + s_log.peek_off[i] + 1,
+                                            &consumed, 1);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to mark record consumed: %s", esp_err_to_name(err));
+        }
+    }
+
+    s_log.pending -= s_log.peek_count;
+    s_log.r = s_log.peek_end;
+    s_log.peek_valid = false;
+
+    xSemaphoreGive(s_log.lock);
+    return ESP_OK;
+}
+
+uint32_t sample_log_pending(void)
+{
+    return s_log.pending;
+}
+
+uint32_t sample_log_dropped(void)
+{
+    return s_log.dropped;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file sample_ring.h
+ * @brief Lock-free single-producer/single-consumer ring of sensor samples.
+ *
+ * Exactly one task may push and exactly one task may pop. No locks are taken,
+ * so the producer never blocks on the consumer (and vice versa).
+ */
+
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry_codec.h"
+
+typedef struct {
+    telemetry_sample_t *slots;
+    uint32_t mask;
+    _Atomic uint32_t head;      /* next slot to write, owned by the producer */
+    _Atomic uint32_t tail;      /* next slot to read, owned by the consumer */
+    _Atomic uint32_t dropped;   /* samples rejected because the ring was full */
+} sample_ring_t;
+
+/**
+ * @brief Initializes a ring over caller-provided storage.
+ * @param [out] ring Ring to initialize.
+ * @param [in] storage Backing array of samples.
+ * @param [in] capacity Number of slots, must be a power of two.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if capacity is not a power of two.
+ */
+esp_err_t sample_ring_init(sample_ring_t *ring, telemetry_sample_t *storage, uint32_t capacity);
+
+/**
+ * @brief Appends a sample. Producer side only.
+ * @return true if stored, false if the ring was full (the sample is counted as dropped).
+ */
+bool sample_ring_push(sample_ring_t *ring, const telemetry_sample_t *sample);
+
+/**
+ * @brief Removes up to max_count of the oldest samples. Consumer side only.
+ * @param [out] out Destination array.
+ * @param [in] max_count Capacity of out.
+ * @return Number of samples copied to out.
+ */
+uint32_t sample_ring_pop(sample_ring_t *ring, telemetry_sample_t *out, uint32_t max_count);
+
+/**
+ * @brief Number of samples currently queued. Safe to call from either side.
+ */
+uint32_t sample_ring_count(sample_ring_t *ring);
+
+/**
+ * @brief Number of samples dropped because the ring was full.
+ */
+uint32_t sample_ring_dropped(sample_ring_t *ring);
+
+#endif // SAMPLE_RING_H
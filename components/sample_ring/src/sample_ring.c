@@ -0,0 +1,67 @@
+/**
+ * @file sample_ring.c
+ * @brief SPSC sample ring. Head and tail are free-running counters; the slot
+ *        index is counter & mask, so a full ring is head - tail == capacity.
+ */
+
+#include "sample_ring.h"
+#include <stddef.h>
+
+esp_err_t sample_ring_init(sample_ring_t *ring, telemetry_sample_t *storage, uint32_t capacity)
+{
+    if (ring == NULL || storage == NULL || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ring->slots = storage;
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    return ESP_OK;
+}
+
+bool sample_ring_push(sample_ring_t *ring, const telemetry_sample_t *sample)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail > ring->mask) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    ring->slots[head & ring->mask] = *sample;
+    /* Publish the slot contents before the new head becomes visible */
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+uint32_t sample_ring_pop(sample_ring_t *ring, telemetry_sample_t *out, uint32_t max_count)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t n = head - tail;
+
+    if (n > max_count) {
+        n = max_count;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = ring->slots[(tail + i) & ring->mask];
+    }
+    /* Hand the slots back to the producer only after they have been copied */
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+    return n;
+}
+
+uint32_t sample_ring_count(sample_ring_t *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
+
+uint32_t sample_ring_dropped(sample_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
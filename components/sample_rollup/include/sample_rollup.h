@@ -0,0 +1,53 @@
+/**
+ * @file sample_rollup.h
+ * @brief Per-window statistics of the sensor channels.
+ *
+ * Every valid sample updates count, min, max, mean and variance of each
+ * channel in place (Welford's method), so a window costs the same few floats
+ * whether it holds 6 or 3600 samples. Windows are aligned to multiples of
+ * the window length on the device clock; the first sample past the end of a
+ * window closes it and starts the next one. Windows without samples produce
+ * no rollup.
+ */
+
+#ifndef SAMPLE_ROLLUP_H
+#define SAMPLE_ROLLUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry_codec.h"
+
+typedef struct {
+    uint32_t count;
+    float min;
+    float max;
+    float mean;
+    float m2;                   /* sum of squared deviations from the mean */
+} sample_rollup_channel_t;
+
+typedef struct {
+    uint32_t window_ms;
+    uint64_t start_ms;          /* start of the open window */
+    sample_rollup_channel_t temperature;
+    sample_rollup_channel_t humidity;
+    uint32_t emitted;           /* windows closed so far */
+} sample_rollup_t;
+
+/**
+ * @brief Initializes an aggregator.
+ * @param [in] window_ms Window length, at least one second.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG.
+ */
+esp_err_t sample_rollup_init(sample_rollup_t *rollup, uint32_t window_ms);
+
+/**
+ * @brief Adds one valid sample. Failed reads must not be fed in.
+ * @param [in] sample Sample, timestamps must not go backwards.
+ * @param [out] done Receives the closed window when this sample starts a new one.
+ * @return true if done was written.
+ */
+bool sample_rollup_add(sample_rollup_t *rollup, const telemetry_sample_t *sample,
+                       telemetry_rollup_t *done);
+
+#endif // SAMPLE_ROLLUP_H
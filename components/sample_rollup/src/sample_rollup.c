@@ -0,0 +1,71 @@
+/**
+ * @file sample_rollup.c
+ * @brief Constant-memory window statistics with Welford updates.
+ */
+
+#include "sample_rollup.h"
+#include <stddef.h>
+#include <string.h>
+
+esp_err_t sample_rollup_init(sample_rollup_t *rollup, uint32_t window_ms)
+{
+    if (rollup == NULL || window_ms < 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(rollup, 0, sizeof(*rollup));
+    rollup->window_ms = window_ms;
+    return ESP_OK;
+}
+
+static void channel_add(sample_rollup_channel_t *ch, float value)
+{
+    if (ch->count == 0) {
+        ch->min = value;
+        ch->max = value;
+    } else if (value < ch->min) {
+        ch->min = value;
+    } else if (value > ch->max) {
+        ch->max = value;
+    }
+
+    ch->count++;
+    float delta = value - ch->mean;
+    ch->mean += delta / (float)ch->count;
+    ch->m2 += delta * (value - ch->mean);
+}
+
+static void channel_close(const sample_rollup_channel_t *ch, telemetry_stats_t *out)
+{
+    out->min = ch->min;
+    out->max = ch->max;
+    out->mean = ch->mean;
+    // Population variance of the window; rounding can leave m2 just below zero
+    out->variance = ch->count > 0 && ch->m2 > 0.0f ? ch->m2 / (float)ch->count : 0.0f;
+}
+
+bool sample_rollup_add(sample_rollup_t *rollup, const telemetry_sample_t *sample,
+                       telemetry_rollup_t *done)
+{
+    uint64_t start = sample->timestamp_ms - sample->timestamp_ms % rollup->window_ms;
+    bool closed = false;
+
+    if (start != rollup->start_ms) {
+        if (rollup->temperature.count > 0) {
+            done->start_ms = rollup->start_ms;
+            done->window_ms = rollup->window_ms;
+            done->count = rollup->temperature.count;
+            channel_close(&rollup->temperature, &done->temperature);
+            channel_close(&rollup->humidity, &done->humidity);
+            rollup->emitted++;
+            closed = true;
+        }
+        memset(&rollup->temperature, 0, sizeof(rollup->temperature));
+        memset(&rollup->humidity, 0, sizeof(rollup->humidity));
+        rollup->start_ms = start;
+    }
+
+    channel_add(&rollup->temperature, sample->temperature);
+    channel_add(&rollup->humidity, sample->humidity);
+    return closed;
+}
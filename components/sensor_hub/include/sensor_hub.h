@@ -0,0 +1,150 @@
+/**
+ * @file sensor_hub.h
+ * @brief Common sensor interface and a sampling scheduler that overlaps
+ *        conversions across sensors.
+ *
+ * Each driver fills in a sensor_driver_t: start kicks off a conversion and
+ * says how long it takes, fetch collects the result. A cycle starts every
+ * sensor that is due first and only then collects them in order of
+ * readiness, so a DHT start pulse and an I2C conversion run at the same time
+ * instead of one after the other.
+ *
+ * The hub also keeps health counters per sensor. After
+ * SENSOR_HUB_REINIT_AFTER failures in a row the driver's init hook runs
+ * again and the sensor is polled less often (up to SENSOR_HUB_BACKOFF_MAX
+ * periods apart) until it answers.
+ *
+ * The schedule runs on the time passed in, so the hub has no RTOS
+ * dependency and also builds on the host. The hub is not thread-safe; it is meant to be owned
+ * by a single task, other tasks may only read the health counters.
+ */
+
+#ifndef SENSOR_HUB_H
+#define SENSOR_HUB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry_codec.h"
+
+#define SENSOR_HUB_MAX_SENSORS      4
+#define SENSOR_HUB_REINIT_AFTER     3
+/* Longest backoff of a failing sensor, in periods */
+#define SENSOR_HUB_BACKOFF_MAX      8
+
+/* What a sensor measures; the fields of telemetry_sample_t it fills in */
+#define SENSOR_CAP_TEMPERATURE      (1u << 0)
+#define SENSOR_CAP_HUMIDITY         (1u << 1)
+
+typedef struct {
+    const char *name;           /* short, used in logs and the health report */
+    uint32_t caps;              /* SENSOR_CAP_* */
+    uint32_t period_ms;         /* native period: shortest interval between measurements */
+    /* Optional: brings the sensor into a measurable state; run when added and after repeated failures */
+    esp_err_t (*init)(void *ctx);
+    /* Optional: starts a conversion; *ready_ms is how long until fetch has a result */
+    esp_err_t (*start)(void *ctx, uint32_t *ready_ms);
+    /* Collects the result; fills the fields named by caps */
+    esp_err_t (*fetch)(void *ctx, telemetry_sample_t *sample);
+    void *ctx;
+} sensor_driver_t;
+
+typedef enum {
+    SENSOR_STATE_OK,
+    SENSOR_STATE_DEGRADED,      /* the last read failed */
+    SENSOR_STATE_FAILED,        /* SENSOR_HUB_REINIT_AFTER or more reads in a row failed */
+} sensor_state_t;
+
+typedef struct {
+    uint32_t reads;             /* successful reads */
+    uint32_t failures;          /* failed starts and fetches */
+    uint32_t consecutive;       /* failures since the last successful read */
+    uint32_t reinits;           /* init hook runs after repeated failures */
+    esp_err_t last_error;
+    uint64_t last_ok_ms;        /* 0 until the first successful read */
+    uint32_t fetch_max_us;      /* slowest fetch call */
+} sensor_health_t;
+
+typedef struct {
+    sensor_driver_t driver;
+    sensor_health_t health;
+    uint32_t period_ms;         /* hub period, or the native period if longer */
+    uint64_t due_ms;            /* next scheduled start */
+    uint64_t ready_ms;          /* result of the pending conversion is available */
+    esp_err_t start_err;        /* reported by the collect that follows */
+    bool pending;
+} sensor_slot_t;
+
+typedef struct {
+    sensor_slot_t slots[SENSOR_HUB_MAX_SENSORS];
+    uint8_t count;
+    uint32_t period_ms;
+} sensor_hub_t;
+
+/**
+ * @brief Called for every collected sensor, successful or not.
+ * @param [in] index Sensor index in the order of sensor_hub_add().
+ * @param [in] err ESP_OK, or the start/fetch error (sample is then not valid).
+ */
+typedef void (*sensor_hub_reading_cb_t)(uint8_t index, const sensor_driver_t *driver, esp_err_t err,
+                                        const telemetry_sample_t *sample, void *ctx);
+
+/**
+ * @brief Initializes an empty hub.
+ * @param [in] period_ms Sampling period; sensors with a longer native period use theirs.
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a zero period.
+ */
+esp_err_t sensor_hub_init(sensor_hub_t *hub, uint32_t period_ms);
+
+/**
+ * @brief Adds a sensor (the driver is copied) and runs its init hook. A
+ *        sensor whose init fails is still added; its first failed read then
+ *        already runs init again.
+ * @param [in] now_ms Current time; the sensor is due immediately.
+ * @param [out] index Optional: index of the new sensor.
+ * @return The init hook's result, ESP_ERR_INVALID_ARG for a driver without
+ *         fetch or caps, ESP_ERR_NO_MEM if the hub is full.
+ */
+esp_err_t sensor_hub_add(sensor_hub_t *hub, const sensor_driver_t *driver, uint64_t now_ms, uint8_t *index);
+
+/**
+ * @brief Starts a conversion on every sensor that is due. A failed start is
+ *        reported by the next sensor_hub_collect().
+ * @return Number of sensors started.
+ */
+uint32_t sensor_hub_start(sensor_hub_t *hub, uint64_t now_ms);
+
+/**
+ * @brief Earliest time a started conversion is ready.
+ * @return false if nothing is pending.
+ */
+bool sensor_hub_next_ready(const sensor_hub_t *hub, uint64_t *ready_ms);
+
+/**
+ * @brief Fetches every pending sensor whose conversion is ready, in order
+ *        of readiness, updates its health and calls cb.
+ * @param [in] now_ms Current time.
+ * @return Number of sensors collected.
+ */
+uint32_t sensor_hub_collect(sensor_hub_t *hub, uint64_t now_ms, sensor_hub_reading_cb_t cb, void *ctx);
+
+/**
+ * @brief Earliest scheduled start over all sensors, UINT64_MAX without sensors.
+ */
+uint64_t sensor_hub_next_due(const sensor_hub_t *hub);
+
+sensor_state_t sensor_hub_state(const sensor_hub_t *hub, uint8_t index);
+
+/**
+ * @brief "ok", "degraded" or "failed".
+ */
+const char *sensor_state_name(sensor_state_t state);
+
+/**
+ * @brief Writes "sensors":[{"name", "state", "reads", "failures",
+ *        "consecutive", "reinits", "last_error", "last_ok_ms",
+ *        "fetch_max_us"}, ...] as a member of the currently open object.
+ */
+void sensor_hub_write_json(const sensor_hub_t *hub, telemetry_json_writer_t *w);
+
+#endif // SENSOR_HUB_H
@@ -0,0 +1,222 @@
+/**
+ * @file sensor_hub.c
+ * @brief Start-all-then-collect sampling with per-sensor health and backoff.
+ */
+
+#include "sensor_hub.h"
+#include <stddef.h>
+#include <string.h>
+#include "esp_timer.h"
+
+static const char *const state_names[] = {
+    [SENSOR_STATE_OK] = "ok",
+    [SENSOR_STATE_DEGRADED] = "degraded",
+    [SENSOR_STATE_FAILED] = "failed",
+};
+
+/* Periods until the next start: 1 while healthy, doubling per reinit round up to SENSOR_HUB_BACKOFF_MAX */
+static uint32_t backoff_periods(const sensor_slot_t *slot)
+{
+    uint32_t periods = 1;
+    for (uint32_t rounds = slot->health.consecutive / SENSOR_HUB_REINIT_AFTER;
+         rounds > 0 && periods < SENSOR_HUB_BACKOFF_MAX; rounds--) {
+        periods *= 2;
+    }
+    return periods < SENSOR_HUB_BACKOFF_MAX ? periods : SENSOR_HUB_BACKOFF_MAX;
+}
+
+static void schedule_next(sensor_slot_t *slot, uint64_t now_ms)
+{
+    slot->due_ms += slot->period_ms;
+    // After an overrun, skip the missed starts instead of bunching them up
+    if (slot->due_ms <= now_ms) {
+        slot->due_ms = now_ms + slot->period_ms;
+    }
+}
+
+static void record_failure(sensor_slot_t *slot, esp_err_t err)
+{
+    slot->health.failures++;
+    slot->health.consecutive++;
+    slot->health.last_error = err;
+    if (slot->health.consecutive % SENSOR_HUB_REINIT_AFTER == 0 && slot->driver.init != NULL) {
+        slot->health.reinits++;
+        slot->driver.init(slot->driver.ctx);
+    }
+    // The next start is already one period out; a successful read ends the backoff right away
+    slot->due_ms += (uint64_t)slot->period_ms * (backoff_periods(slot) - 1);
+}
+
+esp_err_t sensor_hub_init(sensor_hub_t *hub, uint32_t period_ms)
+{
+    if (hub == NULL || period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(hub, 0, sizeof(*hub));
+    hub->period_ms = period_ms;
+    return ESP_OK;
+}
+
+esp_err_t sensor_hub_add(sensor_hub_t *hub, const sensor_driver_t *driver, uint64_t now_ms, uint8_t *index)
+{
+    if (hub == NULL || driver == NULL || driver->fetch == NULL || driver->caps == 0 || driver->name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (hub->count >= SENSOR_HUB_MAX_SENSORS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    sensor_slot_t *slot = &hub->slots[hub->count];
+    memset(slot, 0, sizeof(*slot));
+    slot->driver = *driver;
+    slot->period_ms = driver->period_ms > hub->period_ms ? driver->period_ms : hub->period_ms;
+    slot->due_ms = now_ms;
+    if (index != NULL) {
+        *index = hub->count;
+    }
+    hub->count++;
+
+    esp_err_t err = driver->init != NULL ? driver->init(driver->ctx) : ESP_OK;
+    if (err != ESP_OK) {
+        // One failed read away from the next reinit
+        slot->health.failures++;
+        slot->health.consecutive = SENSOR_HUB_REINIT_AFTER - 1;
+        slot->health.last_error = err;
+    }
+    return err;
+}
+
+uint32_t sensor_hub_start(sensor_hub_t *hub, uint64_t now_ms)
+{
+    uint32_t started = 0;
+
+    for (uint8_t i = 0; i < hub->count; i++) {
+        sensor_slot_t *slot = &hub->slots[i];
+        if (slot->pending || slot->due_ms > now_ms) {
+            continue;
+        }
+        uint32_t conversion_ms = 0;
+        slot->start_err = slot->driver.start != NULL ? slot->driver.start(slot->driver.ctx, &conversion_ms) : ESP_OK;
+        slot->ready_ms = now_ms + (slot->start_err == ESP_OK ? conversion_ms : 0);
+        slot->pending = true;
+        schedule_next(slot, now_ms);
+        started++;
+    }
+    return started;
+}
+
+bool sensor_hub_next_ready(const sensor_hub_t *hub, uint64_t *ready_ms)
+{
+    bool found = false;
+
+    for (uint8_t i = 0; i < hub->count; i++) {
+        const sensor_slot_t *slot = &hub->slots[i];
+        if (slot->pending && (!found || slot->ready_ms < *ready_ms)) {
+            *ready_ms = slot->ready_ms;
+            found = true;
+        }
+    }
+    return found;
+}
+
+uint32_t sensor_hub_collect(sensor_hub_t *hub, uint64_t now_ms, sensor_hub_reading_cb_t cb, void *ctx)
+{
+    uint32_t collected = 0;
+
+    while (true) {
+        // Earliest ready conversion first; a handful of sensors, so a scan beats sorting
+        sensor_slot_t *slot = NULL;
+        uint8_t index = 0;
+        for (uint8_t i = 0; i < hub->count; i++) {
+            sensor_slot_t *s = &hub->slots[i];
+            if (s->pending && s->ready_ms <= now_ms && (slot == NULL || s->ready_ms < slot->ready_ms)) {
+                slot = s;
+                index = i;
+            }
+        }
+        if (slot == NULL) {
+            return collected;
+        }
+
+        telemetry_sample_t sample = { .timestamp_ms = now_ms };
+        esp_err_t err = slot->start_err;
+        if (err == ESP_OK) {
+            int64_t t0 = esp_timer_get_time();
+            err = slot->driver.fetch(slot->driver.ctx, &sample);
+            uint32_t fetch_us = (uint32_t)(esp_timer_get_time() - t0);
+            if (fetch_us > slot->health.fetch_max_us) {
+                slot->health.fetch_max_us = fetch_us;
+            }
+        }
+        slot->pending = false;
+
+        if (err == ESP_OK) {
+            slot->health.reads++;
+            slot->health.consecutive = 0;
+            slot->health.last_ok_ms = now_ms;
+        } else {
+            record_failure(slot, err);
+        }
+        if (cb != NULL) {
+            cb(index, &slot->driver, err, &sample, ctx);
+        }
+        collected++;
+    }
+}
+
+uint64_t sensor_hub_next_due(const sensor_hub_t *hub)
+{
+    uint64_t due = UINT64_MAX;
+
+    for (uint8_t i = 0; i < hub->count; i++) {
+        if (hub->slots[i].due_ms < due) {
+            due = hub->slots[i].due_ms;
+        }
+    }
+    return due;
+}
+
+sensor_state_t sensor_hub_state(const sensor_hub_t *hub, uint8_t index)
+{
+    uint32_t consecutive = hub->slots[index].health.consecutive;
+    if (consecutive >= SENSOR_HUB_REINIT_AFTER) {
+        return SENSOR_STATE_FAILED;
+    }
+    return consecutive > 0 ? SENSOR_STATE_DEGRADED : SENSOR_STATE_OK;
+}
+
+const char *sensor_state_name(sensor_state_t state)
+{
+    return state <= SENSOR_STATE_FAILED ? state_names[state] : "unknown";
+}
+
+void sensor_hub_write_json(const sensor_hub_t *hub, telemetry_json_writer_t *w)
+{
+    telemetry_json_key(w, "sensors");
+    telemetry_json_array_begin(w);
+    for (uint8_t i = 0; i < hub->count; i++) {
+        const sensor_slot_t *slot = &hub->slots[i];
+        const sensor_health_t *h = &slot->health;
+        telemetry_json_object_begin(w);
+        telemetry_json_key(w, "name");
+        telemetry_json_string(w, slot->driver.name);
+        telemetry_json_key(w, "state");
+        telemetry_json_string(w, sensor_state_name(sensor_hub_state(hub, i)));
+        telemetry_json_key(w, "reads");
+        telemetry_json_number(w, (double)h->reads);
+        telemetry_json_key(w, "failures");
+        telemetry_json_number(w, (double)h->failures);
+        telemetry_json_key(w, "consecutive");
+        telemetry_json_number(w, (double)h->consecutive);
+        telemetry_json_key(w, "reinits");
+        telemetry_json_number(w, (double)h->reinits);
+        telemetry_json_key(w, "last_error");
+        telemetry_json_string(w, esp_err_to_name(h->last_error));
+        telemetry_json_key(w, "last_ok_ms");
+        telemetry_json_number(w, (double)h->last_ok_ms);
+        telemetry_json_key(w, "fetch_max_us");
+        telemetry_json_number(w, (double)h->fetch_max_us);
+        telemetry_json_object_end(w);
+    }
+    telemetry_json_array_end(w);
+}
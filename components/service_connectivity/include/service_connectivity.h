@@ -0,0 +1,46 @@
+/**
+ * @file service_connectivity.h
+ * @brief Event-driven connection manager for Wi-Fi and MQTT.
+ *
+ * Brings the network up in the background and never blocks the caller, so
+ * sensing and actuation can start right at boot. Wi-Fi events from the
+ * default event loop and MQTT connect/disconnect events drive a small state
+ * machine:
+ *
+ *   OFFLINE --got IP--> WIFI_UP --MQTT connected--> ONLINE
+ *      ^                   |  ^                        |
+ *      +---Wi-Fi lost------+  +----MQTT disconnected---+
+ *
+ * The MQTT client is started on the first IP acquisition and asked to
+ * reconnect on every later one. Subscriptions registered through
+ * mqtt_service_subscribe() are re-issued by the MQTT service on each connect.
+ */
+
+#ifndef SERVICE_CONNECTIVITY_H
+#define SERVICE_CONNECTIVITY_H
+
+#include "service_mqtt.h"
+
+typedef enum {
+    CONNECTIVITY_OFFLINE,   /* no IP address */
+    CONNECTIVITY_WIFI_UP,   /* IP address, broker not reachable yet */
+    CONNECTIVITY_ONLINE,    /* connected to the broker */
+} connectivity_state_t;
+
+/**
+ * @brief Starts Wi-Fi and arms the state machine. Returns immediately.
+ * @param callback Function called for every incoming MQTT message.
+ */
+void connectivity_start(mqtt_data_callback_t callback);
+
+/**
+ * @brief Returns the current connection state.
+ */
+connectivity_state_t connectivity_get_state(void);
+
+/**
+ * @brief Returns a printable name for a connection state.
+ */
+const char *connectivity_state_name(connectivity_state_t state);
+
+#endif // SERVICE_CONNECTIVITY_H
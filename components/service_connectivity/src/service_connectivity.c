@@ -0,0 +1,78 @@
+#include <stdbool.h>
+#include "service_connectivity.h"
+#include "service_wifi.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_log.h"
+
+static const char *TAG = "CONNECTIVITY";
+static volatile connectivity_state_t state = CONNECTIVITY_OFFLINE;
+static mqtt_data_callback_t data_callback = NULL;
+static bool mqtt_started = false;
+
+static void set_state(connectivity_state_t next)
+{
+    if (state != next) {
+        ESP_LOGI(TAG, "%s -> %s", connectivity_state_name(state), connectivity_state_name(next));
+        state = next;
+    }
+}
+
+/* Runs on the default event loop task */
+static void network_event_handler(void* arg, esp_event_base_t event_base,
+                                  int32_t event_id, void* event_data)
+{
+    if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        set_state(CONNECTIVITY_WIFI_UP);
+        if (!mqtt_started) {
+            mqtt_service_start(data_callback);
+            mqtt_started = true;
+        } else {
+            // Don't wait for the client's own reconnect timer once the network is back
+            mqtt_service_reconnect();
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        set_state(CONNECTIVITY_OFFLINE);
+    }
+}
+
+/* Runs on the MQTT client task */
+static void mqtt_connection_handler(bool connected)
+{
+    if (connected) {
+        set_state(CONNECTIVITY_ONLINE);
+    } else {
+        set_state(wifi_service_is_connected() ? CONNECTIVITY_WIFI_UP : CONNECTIVITY_OFFLINE);
+    }
+}
+
+void connectivity_start(mqtt_data_callback_t callback)
+{
+    data_callback = callback;
+    mqtt_service_set_connection_callback(mqtt_connection_handler);
+
+    // Creates the default event loop, so register our handlers afterwards
+    wifi_service_start();
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                        &network_event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED,
+                                        &network_event_handler, NULL, NULL));
+
+    ESP_LOGI(TAG, "Connectivity manager started.");
+}
+
+connectivity_state_t connectivity_get_state(void)
+{
+    return state;
+}
+
+const char *connectivity_state_name(connectivity_state_t s)
+{
+    switch (s) {
+        case CONNECTIVITY_OFFLINE:  return "OFFLINE";
+        case CONNECTIVITY_WIFI_UP:  return "WIFI_UP";
+        case CONNECTIVITY_ONLINE:   return "ONLINE";
+        default:                    return "UNKNOWN";
+    }
+}
@@ -0,0 +1,119 @@
+/**
+ * @file service_i2c_bus.h
+ * @brief Shared I2C bus manager.
+ *
+ * One task owns the I2C master bus and executes transactions posted by any
+ * number of device drivers through a queue, so drivers running in different
+ * tasks never interleave on the wire. Transactions can be synchronous
+ * (i2c_bus_transfer) or queued with a completion callback (i2c_bus_submit),
+ * which lets a driver pipeline several transfers without waiting for each.
+ *
+ * Devices may sit behind a TCA9548A multiplexer. The manager remembers the
+ * selected mux channel and only rewrites the mux control register when a
+ * transaction targets a different channel.
+ */
+
+#ifndef SERVICE_I2C_BUS_H
+#define SERVICE_I2C_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "driver/i2c_master.h"
+
+#define I2C_BUS_MAX_DEVICES     8
+#define I2C_BUS_NO_MUX          (-1)    /* device is wired to the bus directly */
+#define I2C_BUS_MUX_CHANNELS    8
+
+typedef struct {
+    i2c_port_num_t port;
+    gpio_num_t sda_pin;
+    gpio_num_t scl_pin;
+    uint8_t mux_address;        /* TCA9548A address (0x70-0x77), 0 if there is no mux */
+    uint32_t queue_len;         /* pending transactions, shared by all devices */
+} i2c_bus_config_t;
+
+typedef struct {
+    uint8_t address;            /* 7-bit address */
+    uint32_t clk_speed_hz;
+    int8_t mux_channel;         /* 0-7, or I2C_BUS_NO_MUX */
+    uint32_t timeout_ms;        /* per I2C transfer */
+    bool write_read_restart;    /* write+read with a repeated start instead of two transfers */
+} i2c_bus_device_config_t;
+
+/* Per-device counters. Latency is measured from enqueue to completion. */
+typedef struct {
+    uint32_t transactions;
+    uint32_t errors;
+    esp_err_t last_error;
+    uint64_t latency_total_us;
+    uint32_t latency_max_us;
+} i2c_bus_device_stats_t;
+
+typedef struct {
+    uint32_t mux_switches;      /* mux control register writes */
+    uint32_t mux_switches_skipped;
+    uint32_t queue_full;        /* submissions rejected because the queue was full */
+} i2c_bus_stats_t;
+
+typedef struct i2c_bus_device i2c_bus_device_t;
+
+/* Called on the bus task when a queued transaction finishes; keep it short */
+typedef void (*i2c_bus_done_cb_t)(esp_err_t result, void *ctx);
+
+/**
+ * @brief Creates the I2C master bus (internal pull-ups enabled), the
+ *        transaction queue and the bus task.
+ * @param [in] config Bus pins, port, optional mux address and queue length.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if already initialized,
+ *         or an error code on failure.
+ */
+esp_err_t i2c_bus_init(const i2c_bus_config_t *config);
+
+/**
+ * @brief Registers a device on the bus.
+ * @param [in] config Address, clock, mux channel and transfer timeout.
+ * @param [out] out_dev Receives the device handle.
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if I2C_BUS_MAX_DEVICES are
+ *         registered, ESP_ERR_INVALID_ARG for a mux channel without a mux.
+ */
+esp_err_t i2c_bus_add_device(const i2c_bus_device_config_t *config, i2c_bus_device_t **out_dev);
+
+/**
+ * @brief Writes tx (if tx_len > 0) and then reads rx (if rx_len > 0), and
+ *        waits for the result. A device must not have more than one
+ *        synchronous transfer in flight, i.e. use it from one task at a time.
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the queue stayed full, or
+ *         the I2C error of the transfer.
+ */
+esp_err_t i2c_bus_transfer(i2c_bus_device_t *dev, const uint8_t *tx, size_t tx_len,
+                           uint8_t *rx, size_t rx_len);
+
+/**
+ * @brief Queues a transfer and returns immediately. The buffers must stay
+ *        valid until done_cb runs.
+ * @param [in] done_cb Completion callback, may be NULL.
+ * @return ESP_OK if queued, ESP_ERR_NO_MEM if the queue is full.
+ */
+esp_err_t i2c_bus_submit(i2c_bus_device_t *dev, const uint8_t *tx, size_t tx_len,
+                         uint8_t *rx, size_t rx_len, i2c_bus_done_cb_t done_cb, void *ctx);
+
+/**
+ * @brief Copies the counters of one device.
+ */
+esp_err_t i2c_bus_get_device_stats(const i2c_bus_device_t *dev, i2c_bus_device_stats_t *out);
+
+/**
+ * @brief Copies the bus-wide counters.
+ */
+esp_err_t i2c_bus_get_stats(i2c_bus_stats_t *out);
+
+/**
+ * @brief Address and mux channel of a device, for logging.
+ */
+uint8_t i2c_bus_device_address(const i2c_bus_device_t *dev);
+int8_t i2c_bus_device_mux_channel(const i2c_bus_device_t *dev);
+
+#endif // SERVICE_I2C_BUS_H
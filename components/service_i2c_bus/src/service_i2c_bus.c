@@ -0,0 +1,341 @@
+/**
+ * @file service_i2c_bus.c
+ * @brief I2C bus manager: a single task drains the transaction queue and
+ *        talks to the i2c_master driver, switching the mux when needed.
+ */
+
+#include "service_i2c_bus.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#define I2C_BUS_TASK_STACK_SIZE     3072
+#define I2C_BUS_TASK_PRIORITY       6
+#define I2C_BUS_MUX_CLOCK_HZ        100000
+#define I2C_BUS_MUX_TIMEOUT_MS      50
+#define MUX_STATE_UNKNOWN           (-1)
+
+struct i2c_bus_device {
+    i2c_master_dev_handle_t handle;
+    i2c_bus_device_config_t cfg;
+    bool isolate;                   /* a muxed device shares this direct device's address */
+    SemaphoreHandle_t done;         /* signals synchronous transfers */
+    esp_err_t result;
+    i2c_bus_device_stats_t stats;
+};
+
+typedef struct {
+    i2c_bus_device_t *dev;
+    const uint8_t *tx;
+    size_t tx_len;
+    uint8_t *rx;
+    size_t rx_len;
+    i2c_bus_done_cb_t done_cb;      /* NULL for synchronous transfers */
+    void *ctx;
+    int64_t enqueued_us;
+} i2c_bus_request_t;
+
+static const char *TAG = "I2C_BUS";
+
+static i2c_master_bus_handle_t bus_handle = NULL;
+static i2c_master_dev_handle_t mux_handle = NULL;
+static QueueHandle_t request_queue = NULL;
+static i2c_bus_device_t devices[I2C_BUS_MAX_DEVICES];
+static int device_count = 0;
+static int16_t mux_state = MUX_STATE_UNKNOWN;    /* channel mask last written to the mux */
+static i2c_bus_stats_t bus_stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Brings the mux into the state the device needs; a no-op when it is already there */
+static esp_err_t select_channel(const i2c_bus_device_t *dev)
+{
+    int16_t wanted;
+
+    if (mux_handle == NULL) {
+        return ESP_OK;
+    }
+    if (dev->cfg.mux_channel != I2C_BUS_NO_MUX) {
+        wanted = (int16_t)(1u << dev->cfg.mux_channel);
+    } else if (dev->isolate) {
+        wanted = 0;
+    } else {
+        return ESP_OK;
+    }
+
+    if (wanted == mux_state) {
+        taskENTER_CRITICAL(&stats_lock);
+        bus_stats.mux_switches_skipped++;
+        taskEXIT_CRITICAL(&stats_lock);
+        return ESP_OK;
+    }
+
+    uint8_t ctrl = (uint8_t)wanted;
+    esp_err_t err = i2c_master_transmit(mux_handle, &ctrl, 1, I2C_BUS_MUX_TIMEOUT_MS);
+    // On failure the mux state is unknown, so the next transaction rewrites it
+    mux_state = (err == ESP_OK) ? wanted : MUX_STATE_UNKNOWN;
+    taskENTER_CRITICAL(&stats_lock);
+    bus_stats.mux_switches++;
+    taskEXIT_CRITICAL(&stats_lock);
+    return err;
+}
+
+static esp_err_t execute(const i2c_bus_request_t *req)
+{
+    i2c_bus_device_t *dev = req->dev;
+    int timeout = (int)dev->cfg.timeout_ms;
+
+    esp_err_t err = select_channel(dev);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Mux channel %d select failed: %s", dev->cfg.mux_channel, esp_err_to_name(err));
+        return err;
+    }
+
+    if (req->tx_len > 0 && req->rx_len > 0 && dev->cfg.write_read_restart) {
+        return i2c_master_transmit_receive(dev->handle, req->tx, req->tx_len, req->rx, req->rx_len, timeout);
+    }
+    if (req->tx_len > 0) {
+        err = i2c_master_transmit(dev->handle, req->tx, req->tx_len, timeout);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    if (req->rx_len > 0) {
+        err = i2c_master_receive(dev->handle, req->rx, req->rx_len, timeout);
+    }
+    return err;
+}
+
+static void i2c_bus_task(void *pvParameters)
+{
+    i2c_bus_request_t req;
+
+    while (1) {
+        if (xQueueReceive(request_queue, &req, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        esp_err_t err = execute(&req);
+        uint32_t latency_us = (uint32_t)(esp_timer_get_time() - req.enqueued_us);
+
+        i2c_bus_device_stats_t *st = &req.dev->stats;
+        taskENTER_CRITICAL(&stats_lock);
+        st->transactions++;
+        st->latency_total_us += latency_us;
+        if (latency_us > st->latency_max_us) {
+            st->latency_max_us = latency_us;
+        }
+        if (err != ESP_OK) {
+            st->errors++;
+            st->last_error = err;
+        }
+        taskEXIT_CRITICAL(&stats_lock);
+
+        if (req.done_cb != NULL) {
+            req.done_cb(err, req.ctx);
+        } else {
+            req.dev->result = err;
+            xSemaphoreGive(req.dev->done);
+        }
+    }
+}
+
+esp_err_t i2c_bus_init(const i2c_bus_config_t *config)
+{
+    if (config == NULL || config->queue_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (bus_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    i2c_master_bus_config_t bus_cfg = {
+        .i2c_port = config->port,
+        .sda_io_num = config->sda_pin,
+        .scl_io_num = config->scl_pin,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t err = i2c_new_master_bus(&bus_cfg, &bus_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (config->mux_address != 0) {
+        i2c_device_config_t mux_cfg = {
+            .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+            .device_address = config->mux_address,
+            .scl_speed_hz = I2C_BUS_MUX_CLOCK_HZ,
+        };
+        err = i2c_master_bus_add_device(bus_handle, &mux_cfg, &mux_handle);
+        if (err != ESP_OK) {
+            goto fail;
+        }
+    }
+
+    request_queue = xQueueCreate(config->queue_len, sizeof(i2c_bus_request_t));
+    if (request_queue == NULL) {
+        err = ESP_ERR_NO_MEM;
+        goto fail;
+    }
+
+    if (xTaskCreate(i2c_bus_task, "I2C BUS TASK", I2C_BUS_TASK_STACK_SIZE, NULL,
+                    I2C_BUS_TASK_PRIORITY, NULL) != pdPASS) {
+        err = ESP_ERR_NO_MEM;
+        goto fail;
+    }
+
+    ESP_LOGI(TAG, "I2C bus started (mux %s)", mux_handle != NULL ? "present" : "none");
+    return ESP_OK;
+
+fail:
+    if (request_queue != NULL) {
+        vQueueDelete(request_queue);
+        request_queue = NULL;
+    }
+    if (mux_handle != NULL) {
+        i2c_master_bus_rm_device(mux_handle);
+        mux_handle = NULL;
+    }
+    i2c_del_master_bus(bus_handle);
+    bus_handle = NULL;
+    return err;
+}
+
+esp_err_t i2c_bus_add_device(const i2c_bus_device_config_t *config, i2c_bus_device_t **out_dev)
+{
+    if (config == NULL || out_dev == NULL ||
+        config->mux_channel < I2C_BUS_NO_MUX || config->mux_channel >= I2C_BUS_MUX_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (bus_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config->mux_channel != I2C_BUS_NO_MUX && mux_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (device_count >= I2C_BUS_MAX_DEVICES) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    i2c_bus_device_t *dev = &devices[device_count];
+    memset(dev, 0, sizeof(*dev));
+    dev->cfg = *config;
+
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = config->address,
+        .scl_speed_hz = config->clk_speed_hz,
+    };
+    esp_err_t err = i2c_master_bus_add_device(bus_handle, &dev_cfg, &dev->handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    dev->done = xSemaphoreCreateBinary();
+    if (dev->done == NULL) {
+        i2c_master_bus_rm_device(dev->handle);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // A direct device answering on the same address as a muxed one must be
+    // accessed with all mux channels closed, or both would respond
+    for (int i = 0; i < device_count; i++) {
+        i2c_bus_device_t *other = &devices[i];
+        if (other->cfg.address != config->address) {
+            continue;
+        }
+        if (config->mux_channel == I2C_BUS_NO_MUX && other->cfg.mux_channel != I2C_BUS_NO_MUX) {
+            dev->isolate = true;
+        } else if (config->mux_channel != I2C_BUS_NO_MUX && other->cfg.mux_channel == I2C_BUS_NO_MUX) {
+            other->isolate = true;
+        }
+    }
+
+    device_count++;
+    *out_dev = dev;
+    return ESP_OK;
+}
+
+static esp_err_t enqueue(i2c_bus_device_t *dev, const uint8_t *tx, size_t tx_len, uint8_t *rx,
+                         size_t rx_len, i2c_bus_done_cb_t done_cb, void *ctx, TickType_t wait)
+{
+    i2c_bus_request_t req = {
+        .dev = dev,
+        .tx = tx,
+        .tx_len = tx_len,
+        .rx = rx,
+        .rx_len = rx_len,
+        .done_cb = done_cb,
+        .ctx = ctx,
+        .enqueued_us = esp_timer_get_time(),
+    };
+
+    if (xQueueSend(request_queue, &req, wait) != pdTRUE) {
+        taskENTER_CRITICAL(&stats_lock);
+        bus_stats.queue_full++;
+        taskEXIT_CRITICAL(&stats_lock);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_transfer(i2c_bus_device_t *dev, const uint8_t *tx, size_t tx_len,
+                           uint8_t *rx, size_t rx_len)
+{
+    if (dev == NULL || (tx_len > 0 && tx == NULL) || (rx_len > 0 && rx == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (enqueue(dev, tx, tx_len, rx, rx_len, NULL, NULL, pdMS_TO_TICKS(dev->cfg.timeout_ms)) != ESP_OK) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreTake(dev->done, portMAX_DELAY);
+    return dev->result;
+}
+
+esp_err_t i2c_bus_submit(i2c_bus_device_t *dev, const uint8_t *tx, size_t tx_len,
+                         uint8_t *rx, size_t rx_len, i2c_bus_done_cb_t done_cb, void *ctx)
+{
+    if (dev == NULL || (tx_len > 0 && tx == NULL) || (rx_len > 0 && rx == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return enqueue(dev, tx, tx_len, rx, rx_len, done_cb, ctx, 0) == ESP_OK ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_bus_get_device_stats(const i2c_bus_device_t *dev, i2c_bus_device_stats_t *out)
+{
+    if (dev == NULL || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&stats_lock);
+    *out = dev->stats;
+    taskEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_get_stats(i2c_bus_stats_t *out)
+{
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&stats_lock);
+    *out = bus_stats;
+    taskEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+uint8_t i2c_bus_device_address(const i2c_bus_device_t *dev)
+{
+    return dev->cfg.address;
+}
+
+int8_t i2c_bus_device_mux_channel(const i2c_bus_device_t *dev)
+{
+    return dev->cfg.mux_channel;
+}
@@ -1,34 +1,91 @@
 #ifndef SERVICE_MQTT_H
 #define SERVICE_MQTT_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
 typedef void (*mqtt_data_callback_t)(const char* topic, int topic_len, const char* data, int data_len);
+typedef void (*mqtt_connection_callback_t)(bool connected);
 
 /**
  * @brief Initializes the MQTT client with URI, Port (8883), and TLS credentials. 
  *        Registers a global event handler and starts the MQTT client task.
- * @param callback Function pointer for handling incoming MQTT messages.
+ * @param callback Function pointer for handling incoming MQTT messages. It is called
+ *        once per complete message (fragments are joined first); data is not
+ *        NUL-terminated and only valid during the call.
  * @return None
  */
 void mqtt_service_start(mqtt_data_callback_t callback);
 
+typedef enum {
+    MQTT_PRIORITY_HIGH,     /* command acks and device states */
+    MQTT_PRIORITY_MID,      /* health, status and diagnostics */
+    MQTT_PRIORITY_LOW,      /* telemetry */
+    MQTT_PRIORITY_COUNT,
+} mqtt_priority_t;
+
+/* The payload is a full snapshot: a newer one for the same topic replaces it while queued */
+#define MQTT_PUBLISH_LATEST     (1u << 0)
+
 /**
- * @brief Publishes a message to a specific topic. 
- *        Checks if the client is initialized before calling
- *        the underlying ESP-MQTT publish function.
+ * @brief Queues a copy of a message for the publisher task and returns
+ *        without touching the network. Higher priorities reach the client's
+ *        outbox first.
+ *
+ *        Each priority may fill only its share of CONFIG_MQTT_OUTBOX_BUDGET
+ *        (queue plus outbox): all of it for HIGH, 3/4 for MID, 1/2 for LOW,
+ *        so telemetry backs off first on a slow link. A MQTT_PUBLISH_LATEST
+ *        message is never refused for budget: it replaces a queued one for
+ *        the same topic, or waits as the only one for its topic.
  * @param topic The MQTT topic to publish to.
- * @param payload The message payload to publish.
+ * @param data The message payload; copied, so it can be reused on return.
+ * @param len Payload length in bytes.
  * @param qos The Quality of Service level for the message.
- * @return None
+ * @param priority Priority class of the message.
+ * @param flags 0 or MQTT_PUBLISH_LATEST.
+ * @return ESP_OK if queued (or merged), ESP_ERR_NO_MEM if dropped because the
+ *         priority is over budget or the static message pool has no room, ESP_ERR_INVALID_STATE
+ *         before mqtt_service_start(), ESP_ERR_INVALID_ARG.
  */
-void mqtt_service_publish(const char* topic, const char* payload, int qos);
+esp_err_t mqtt_service_enqueue(const char* topic, const void* data, int len, int qos,
+                               mqtt_priority_t priority, uint32_t flags);
 
 /**
- * @brief Subscribes the client to a specific topic to receive incoming
- *        messages. Status is logged upon successful subscription.
+ * @brief Reports whether the client currently has a session with the broker.
+ * @return true between MQTT_EVENT_CONNECTED and MQTT_EVENT_DISCONNECTED.
+ */
+bool mqtt_service_is_connected(void);
+
+/**
+ * @brief Registers a subscription. It is issued right away if the client is
+ *        connected and re-issued on every MQTT_EVENT_CONNECTED, so it can be
+ *        called before the network is up and survives reconnects.
  * 
  * @param topic The MQTT topic to subscribe to.
  * @param qos The Quality of Service level for the subscription.
  */
 void mqtt_service_subscribe(const char* topic, int qos);
 
+/**
+ * @brief Sets the retained connection status topic: the broker publishes
+ *        "offline" there as last will, the client "online" on every connect.
+ *        Must be called before mqtt_service_start(); without it there is no
+ *        last will.
+ * @param topic The MQTT topic, copied.
+ */
+void mqtt_service_set_status_topic(const char* topic);
+
+/**
+ * @brief Sets a callback invoked from the MQTT task on every connect and disconnect.
+ * @param callback Function receiving true on MQTT_EVENT_CONNECTED, false on MQTT_EVENT_DISCONNECTED.
+ */
+void mqtt_service_set_connection_callback(mqtt_connection_callback_t callback);
+
+/**
+ * @brief Asks a started but disconnected client to reconnect now instead of
+ *        waiting for its reconnect timer (e.g. right after Wi-Fi got an IP).
+ */
+void mqtt_service_reconnect(void);
+
 #endif // SERVICE_MQTT_H
\ No newline at end of file
@@ -1,20 +1,150 @@
+#include <stdio.h>
+#include <string.h>
 #include "service_mqtt.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "mqtt_client.h"
 #include "esp_log.h"
 #include "esp_crt_bundle.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "event_trace.h"
+#include "deferred_log.h"
+
+#define MQTT_SERVICE_MAX_SUBSCRIPTIONS  12
+#define MQTT_SERVICE_TOPIC_MAX_LEN      96
+#define MQTT_REASSEMBLY_BUFFER_SIZE     CONFIG_MQTT_REASSEMBLY_BUFFER_SIZE
+
+/*
+ * Publish pipeline: producers queue copies per priority and return; the
+ * publisher task hands them to the client's outbox, highest priority
+ * first, while the outbox holds less than the window. Unacknowledged QoS 1
+ * messages stay in the outbox, so on a slow link the window fills and the
+ * ordering happens here instead of in the outbox's FIFO.
+ */
+#define MQTT_OUTBOX_BUDGET              CONFIG_MQTT_OUTBOX_BUDGET
+#define MQTT_OUTBOX_WINDOW              (MQTT_OUTBOX_BUDGET / 4)
+#define MQTT_PUBLISH_TASK_STACK_SIZE    3072
+#define MQTT_PUBLISH_TASK_PRIORITY      5
+/* QoS 0 messages leave the outbox without an event, so look again after this long */
+#define MQTT_PUBLISH_POLL_MS            100
+/* At most one drop warning this often; the counters have every drop */
+#define MQTT_DROP_WARN_INTERVAL_US      (60LL * 1000 * 1000)
+
+/*
+ * Queued messages live in a static pool of fixed slots, each message in a
+ * contiguous run of them. Beside the budget it holds a quarter more for
+ * headers, topics and rounding, and room for the snapshots that may wait
+ * past the budget. A message that finds no free run is refused like one
+ * over budget.
+ */
+#define MQTT_POOL_SLOT_SIZE             64
+#define MQTT_POOL_LATEST_RESERVE        4096
+#define MQTT_POOL_SLOTS                 ((MQTT_OUTBOX_BUDGET + MQTT_OUTBOX_BUDGET / 4 + \
+                                          MQTT_POOL_LATEST_RESERVE) / MQTT_POOL_SLOT_SIZE)
+
+typedef struct {
+    char topic[MQTT_SERVICE_TOPIC_MAX_LEN];
+    int qos;
+} mqtt_subscription_t;
 
 static const char *TAG = "MQTT_SERVICE";
+/* Per-message logs; formatted later by the log task, not on the MQTT task */
+static deferred_log_module_t s_log = DEFERRED_LOG_MODULE_INIT("MQTT_SERVICE", DLOG_LEVEL_INFO);
 static esp_mqtt_client_handle_t client = NULL;
 static mqtt_data_callback_t data_callback = NULL;
+static mqtt_connection_callback_t connection_callback = NULL;
+static volatile bool connected = false;
+
+typedef struct mqtt_message {
+    struct mqtt_message *next;
+    int64_t queued_us;
+    const char *topic;          /* stored after the payload */
+    int len;
+    uint16_t slots;             /* pool slots taken, header included */
+    uint8_t qos;
+    uint8_t flags;
+    uint8_t data[];
+} mqtt_message_t;
+
+typedef union {
+    mqtt_message_t align;
+    uint8_t bytes[MQTT_POOL_SLOT_SIZE];
+} mqtt_pool_slot_t;
+
+typedef struct {
+    mqtt_message_t *head;
+    mqtt_message_t *tail;
+} mqtt_message_queue_t;
+
+static mqtt_message_queue_t pipeline[MQTT_PRIORITY_COUNT];
+static SemaphoreHandle_t pipeline_lock = NULL;
+static TaskHandle_t publisher_task = NULL;
+static uint32_t pipeline_bytes = 0;     /* queued here, under pipeline_lock */
+static uint32_t outbox_bytes = 0;       /* last outbox size seen by the publisher */
+static int64_t drop_warned_us = -MQTT_DROP_WARN_INTERVAL_US;   /* under pipeline_lock, as is the count */
+static uint32_t drops_unwarned = 0;
+static mqtt_pool_slot_t pool[MQTT_POOL_SLOTS];
+static uint32_t pool_used[(MQTT_POOL_SLOTS + 31) / 32];    /* one bit per slot, under pipeline_lock */
+
+/* Share of MQTT_OUTBOX_BUDGET each class may fill, queue and outbox together */
+static const uint32_t priority_budget[MQTT_PRIORITY_COUNT] = {
+    [MQTT_PRIORITY_HIGH] = MQTT_OUTBOX_BUDGET,
+    [MQTT_PRIORITY_MID] = MQTT_OUTBOX_BUDGET / 4 * 3,
+    [MQTT_PRIORITY_LOW] = MQTT_OUTBOX_BUDGET / 2,
+};
+
+/* Time the publisher spends in esp_mqtt_client_enqueue, which can wait for the client's lock */
+static const uint32_t publish_bounds_us[] = { 1000, 5000, 20000, 100000, 500000, 2000000 };
+static metrics_histogram_t publish_latency = METRICS_HISTOGRAM_INIT("mqtt_publish_us", publish_bounds_us);
+/* Time from mqtt_service_enqueue() to the outbox, per priority */
+static const uint32_t wait_bounds_us[] = { 1000, 10000, 100000, 1000000, 5000000, 30000000 };
+static metrics_histogram_t wait_latency[MQTT_PRIORITY_COUNT] = {
+    [MQTT_PRIORITY_HIGH] = METRICS_HISTOGRAM_INIT("mqtt_wait_high_us", wait_bounds_us),
+    [MQTT_PRIORITY_MID] = METRICS_HISTOGRAM_INIT("mqtt_wait_mid_us", wait_bounds_us),
+    [MQTT_PRIORITY_LOW] = METRICS_HISTOGRAM_INIT("mqtt_wait_low_us", wait_bounds_us),
+};
+static metrics_counter_t dropped[MQTT_PRIORITY_COUNT] = {
+    [MQTT_PRIORITY_HIGH] = METRICS_COUNTER_INIT("mqtt_dropped_high"),
+    [MQTT_PRIORITY_MID] = METRICS_COUNTER_INIT("mqtt_dropped_mid"),
+    [MQTT_PRIORITY_LOW] = METRICS_COUNTER_INIT("mqtt_dropped_low"),
+};
+static metrics_counter_t coalesced = METRICS_COUNTER_INIT("mqtt_coalesced");
+static metrics_gauge_t backlog_peak = METRICS_GAUGE_INIT("mqtt_backlog_peak");
+static metrics_counter_t published = METRICS_COUNTER_INIT("mqtt_published");
+static metrics_counter_t publish_failed = METRICS_COUNTER_INIT("mqtt_publish_failed");
+static metrics_counter_t disconnects = METRICS_COUNTER_INIT("mqtt_disconnects");
+
+/* Subscriptions are (re)issued on every MQTT_EVENT_CONNECTED */
+static mqtt_subscription_t subscriptions[MQTT_SERVICE_MAX_SUBSCRIPTIONS];
+static int subscription_count = 0;
+
+/*
+ * Fragmented messages are joined here. Chunks of one message arrive back to
+ * back on the MQTT task, so one buffer is enough; only the first chunk
+ * carries the topic.
+ */
+static struct {
+    char topic[MQTT_SERVICE_TOPIC_MAX_LEN];
+    int topic_len;
+    char data[MQTT_REASSEMBLY_BUFFER_SIZE];
+    int total_len;
+    int received;
+    bool active;
+    bool discard;
+} reassembly;
 
-const esp_mqtt_client_config_t mqtt_cfg = {
+static char status_topic[MQTT_SERVICE_TOPIC_MAX_LEN];
+
+static esp_mqtt_client_config_t mqtt_cfg = {
     .broker.address.uri = CONFIG_MQTT_BROKER_URI,
     .broker.verification.crt_bundle_attach = esp_crt_bundle_attach,
     .credentials.username = CONFIG_MQTT_USERNAME,
     .credentials.authentication.password = CONFIG_MQTT_PASSWORD,
     .session.keepalive = 15,
     .session.last_will = {
-        .topic = CONFIG_MQTT_LWT_TOPIC,
+        .topic = status_topic,      /* set by mqtt_service_set_status_topic() */
         .msg = "offline",
         .msg_len = 7,
         .qos = 1,
@@ -22,18 +152,89 @@ const esp_mqtt_client_config_t mqtt_cfg = {
     }
 };
 
+static void subscribe_all(void)
+{
+    for (int i = 0; i < subscription_count; i++) {
+        int msg_id = esp_mqtt_client_subscribe(client, subscriptions[i].topic, subscriptions[i].qos);
+        ESP_LOGI(TAG, "Subscribed to topic %s with msg_id=%d", subscriptions[i].topic, msg_id);
+    }
+}
+
+/* Passes complete messages through untouched and joins fragmented ones */
+static void handle_data(esp_mqtt_event_handle_t event)
+{
+    if (data_callback == NULL) {
+        return;
+    }
+
+    // Common case: the whole message is in this event, use the client's buffer directly
+    if (event->current_data_offset == 0 && event->data_len == event->total_data_len) {
+        reassembly.active = false;
+        data_callback(event->topic, event->topic_len, event->data, event->data_len);
+        return;
+    }
+
+    if (event->current_data_offset == 0) {
+        reassembly.active = true;
+        reassembly.total_len = event->total_data_len;
+        reassembly.received = 0;
+        reassembly.discard = event->total_data_len > (int)sizeof(reassembly.data) ||
+                             event->topic_len >= (int)sizeof(reassembly.topic);
+        if (reassembly.discard) {
+            ESP_LOGW(TAG, "Dropping %d byte message on %.*s (reassembly buffer %d bytes)",
+                     event->total_data_len, event->topic_len, event->topic, (int)sizeof(reassembly.data));
+        } else {
+            memcpy(reassembly.topic, event->topic, event->topic_len);
+            reassembly.topic_len = event->topic_len;
+        }
+    } else if (!reassembly.active || event->current_data_offset != reassembly.received) {
+        ESP_LOGW(TAG, "Unexpected fragment at offset %d, dropped", event->current_data_offset);
+        reassembly.active = false;
+        return;
+    }
+
+    if (event->current_data_offset + event->data_len > reassembly.total_len) {
+        ESP_LOGW(TAG, "Fragment overruns message length, dropped");
+        reassembly.active = false;
+        return;
+    }
+    if (!reassembly.discard) {
+        memcpy(&reassembly.data[event->current_data_offset], event->data, event->data_len);
+    }
+    reassembly.received += event->data_len;
+
+    if (reassembly.received >= reassembly.total_len) {
+        reassembly.active = false;
+        if (!reassembly.discard) {
+            data_callback(reassembly.topic, reassembly.topic_len, reassembly.data, reassembly.total_len);
+        }
+    }
+}
+
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, 
     int32_t event_id, void *event_data)
 {
     esp_mqtt_event_handle_t event = event_data;
-    int msg_id;
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
-            esp_mqtt_client_publish(client, CONFIG_MQTT_LWT_TOPIC, "online", 0, 1, 1);
+            connected = true;
+            if (status_topic[0] != '\0') {
+                esp_mqtt_client_publish(client, status_topic, "online", 0, 1, 1);
+            }
+            subscribe_all();
+            if (connection_callback) {
+                connection_callback(true);
+            }
+            xTaskNotifyGive(publisher_task);
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+            connected = false;
+            metrics_counter_inc(&disconnects);
+            if (connection_callback) {
+                connection_callback(false);
+            }
             break;
         case MQTT_EVENT_SUBSCRIBED:
             ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
@@ -42,14 +243,25 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
             ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
             break;
         case MQTT_EVENT_PUBLISHED:
-            ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            DLOG_D(s_log, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            // Acknowledged messages leave the outbox: room for the next ones
+            xTaskNotifyGive(publisher_task);
+            break;
+        case MQTT_EVENT_DELETED:
+            DLOG_W(s_log, "Outbox message %d expired unacknowledged", event->msg_id);
+            xTaskNotifyGive(publisher_task);
             break;
         case MQTT_EVENT_DATA:
-            ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-            ESP_LOGI(TAG, "TOPIC=%.*s", event->topic_len, event->topic);
-            ESP_LOGI(TAG, "DATA=%.*s", event->data_len, event->data);
-            if (data_callback) {
-                data_callback(event->topic, event->topic_len, event->data, event->data_len);
+            DLOG_I(s_log, "MQTT_EVENT_DATA, %d of %d bytes at offset %d", event->data_len,
+                   event->total_data_len, event->current_data_offset);
+            // The content lives in the client's buffer, so it can only be logged in place;
+            // compiled out unless the maximum log level includes debug
+            ESP_LOGD(TAG, "TOPIC=%.*s DATA=%.*s", event->topic_len, event->topic, event->data_len, event->data);
+            event_trace_instant(TRACE_MQTT_RX, (uint32_t)event->data_len);
+            {
+                uint32_t t0 = event_trace_begin();
+                handle_data(event);
+                event_trace_end(TRACE_MQTT_DISPATCH, t0, (uint32_t)event->total_data_len);
             }
             break;
         case MQTT_EVENT_ERROR:
@@ -61,10 +273,125 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
     }
 }
 
+/* First fit; call with pipeline_lock held. NULL if no run of free slots is long enough. */
+static mqtt_message_t *pool_alloc(size_t size)
+{
+    uint32_t need = (uint32_t)((size + MQTT_POOL_SLOT_SIZE - 1) / MQTT_POOL_SLOT_SIZE);
+    uint32_t run = 0;
+
+    for (uint32_t i = 0; i < MQTT_POOL_SLOTS; i++) {
+        if (pool_used[i / 32] & (1u << (i % 32))) {
+            run = 0;
+            continue;
+        }
+        if (++run == need) {
+            uint32_t first = i + 1 - need;
+            for (uint32_t k = first; k <= i; k++) {
+                pool_used[k / 32] |= 1u << (k % 32);
+            }
+            mqtt_message_t *msg = &pool[first].align;
+            msg->slots = (uint16_t)need;
+            return msg;
+        }
+    }
+    return NULL;
+}
+
+/* Call with pipeline_lock held */
+static void pool_free(mqtt_message_t *msg)
+{
+    uint32_t first = (uint32_t)((mqtt_pool_slot_t *)msg - pool);
+    for (uint32_t k = first; k < first + msg->slots; k++) {
+        pool_used[k / 32] &= ~(1u << (k % 32));
+    }
+}
+
+/* Takes the oldest message of the highest priority if the outbox window has room */
+static mqtt_message_t *pipeline_pop(uint32_t outbox)
+{
+    mqtt_message_t *msg = NULL;
+
+    xSemaphoreTake(pipeline_lock, portMAX_DELAY);
+    for (int p = 0; p < MQTT_PRIORITY_COUNT; p++) {
+        mqtt_message_queue_t *q = &pipeline[p];
+        if (q->head == NULL) {
+            continue;
+        }
+        // An oversized message still goes, alone, once the outbox is empty
+        if (outbox == 0 || outbox + (uint32_t)q->head->len <= MQTT_OUTBOX_WINDOW) {
+            msg = q->head;
+            q->head = msg->next;
+            if (q->head == NULL) {
+                q->tail = NULL;
+            }
+            pipeline_bytes -= (uint32_t)msg->len;
+        }
+        break;
+    }
+    xSemaphoreGive(pipeline_lock);
+    return msg;
+}
+
+static void publisher(void *pvParameters)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MQTT_PUBLISH_POLL_MS));
+
+        // While disconnected everything waits here, where it can still be coalesced
+        while (connected) {
+            int size = esp_mqtt_client_get_outbox_size(client);
+            uint32_t outbox = size > 0 ? (uint32_t)size : 0;
+            __atomic_store_n(&outbox_bytes, outbox, __ATOMIC_RELAXED);
+
+            mqtt_message_t *msg = pipeline_pop(outbox);
+            if (msg == NULL) {
+                break;
+            }
+
+            int priority = msg->flags >> 4;
+            int64_t start = esp_timer_get_time();
+            int msg_id = esp_mqtt_client_enqueue(client, msg->topic, (const char *)msg->data, msg->len,
+                                                 msg->qos, 0, true);
+            int64_t end = esp_timer_get_time();
+            metrics_histogram_observe(&publish_latency, (uint32_t)(end - start));
+            metrics_histogram_observe(&wait_latency[priority], (uint32_t)(start - msg->queued_us));
+            event_trace_end(TRACE_MQTT_PUBLISH, (uint32_t)start, (uint32_t)msg->len);
+            metrics_counter_inc(msg_id >= 0 ? &published : &publish_failed);
+            DLOG_I(s_log, "Published %d bytes with msg_id=%d", msg->len, msg_id);
+            xSemaphoreTake(pipeline_lock, portMAX_DELAY);
+            pool_free(msg);
+            xSemaphoreGive(pipeline_lock);
+        }
+    }
+}
+
 void mqtt_service_start(mqtt_data_callback_t callback)
 {
     data_callback = callback;
 
+    metrics_register_histogram(&publish_latency);
+    for (int p = 0; p < MQTT_PRIORITY_COUNT; p++) {
+        metrics_register_histogram(&wait_latency[p]);
+        metrics_register_counter(&dropped[p]);
+    }
+    metrics_register_counter(&coalesced);
+    metrics_register_gauge(&backlog_peak);
+    metrics_register_counter(&published);
+    metrics_register_counter(&publish_failed);
+    metrics_register_counter(&disconnects);
+    deferred_log_register(&s_log);
+
+    pipeline_lock = xSemaphoreCreateMutex();
+    if (pipeline_lock == NULL ||
+        xTaskCreate(publisher, "MQTT PUB TASK", MQTT_PUBLISH_TASK_STACK_SIZE, NULL,
+                    MQTT_PUBLISH_TASK_PRIORITY, &publisher_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the publisher");
+        return;
+    }
+
+    if (status_topic[0] == '\0') {
+        mqtt_cfg.session.last_will.topic = NULL;
+    }
     client = esp_mqtt_client_init(&mqtt_cfg);
 
     esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID,
@@ -72,22 +399,147 @@ void mqtt_service_start(mqtt_data_callback_t callback)
     esp_mqtt_client_start(client);
 }
 
-void mqtt_service_publish(const char* topic, const char* payload, int qos)
+esp_err_t mqtt_service_enqueue(const char *topic, const void *data, int len, int qos,
+                               mqtt_priority_t priority, uint32_t flags)
 {
-    if (client != NULL) {
-        int msg_id = esp_mqtt_client_publish(client, topic, payload, 0, qos, 0);
-        ESP_LOGI(TAG, "Published message with msg_id=%d", msg_id);
+    if (topic == NULL || (data == NULL && len > 0) || len < 0 || qos < 0 || qos > 2 ||
+        priority < 0 || priority >= MQTT_PRIORITY_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pipeline_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    size_t topic_size = strlen(topic) + 1;
+    mqtt_message_queue_t *q = &pipeline[priority];
+    mqtt_message_t *msg = NULL, *stale = NULL, *prev = NULL, *next = NULL;
+    esp_err_t err = ESP_OK;
+    uint32_t warn_drops = 0;
+
+    xSemaphoreTake(pipeline_lock, portMAX_DELAY);
+    if (flags & MQTT_PUBLISH_LATEST) {
+        // A snapshot still waiting for the same topic is outdated now: the new one takes its place
+        for (stale = q->head; stale != NULL; prev = stale, stale = stale->next) {
+            if ((stale->flags & MQTT_PUBLISH_LATEST) && strcmp(stale->topic, topic) == 0) {
+                // Read before its slots are handed out again
+                next = stale->next;
+                pipeline_bytes -= (uint32_t)stale->len;
+                pool_free(stale);
+                break;
+            }
+        }
+    }
+    uint32_t backlog = __atomic_load_n(&outbox_bytes, __ATOMIC_RELAXED) + pipeline_bytes + (uint32_t)len;
+    // One snapshot per topic may wait past the budget, so the newest state always gets out
+    if (backlog > priority_budget[priority] && !(flags & MQTT_PUBLISH_LATEST)) {
+        err = ESP_ERR_NO_MEM;
+    } else if ((msg = pool_alloc(sizeof(*msg) + (size_t)len + topic_size)) == NULL) {
+        err = ESP_ERR_NO_MEM;
     } else {
-        ESP_LOGW(TAG, "MQTT client not initialized");
+        // Copied under the lock, the publisher frees slots under it too
+        memcpy(msg->data, data, (size_t)len);
+        memcpy(&msg->data[len], topic, topic_size);
+        msg->queued_us = esp_timer_get_time();
+        msg->topic = (const char *)&msg->data[len];
+        msg->len = len;
+        msg->qos = (uint8_t)qos;
+        msg->flags = (uint8_t)((priority << 4) | (flags & 0x0f));
+        pipeline_bytes += (uint32_t)len;
+    }
+    if (stale != NULL) {
+        // Without room for the new snapshot the old one is gone too
+        mqtt_message_t *replacement = msg != NULL ? msg : next;
+        if (msg != NULL) {
+            msg->next = next;
+        }
+        if (prev != NULL) {
+            prev->next = replacement;
+        } else {
+            q->head = replacement;
+        }
+        if (q->tail == stale) {
+            q->tail = msg != NULL ? msg : prev;
+        }
+    } else if (msg != NULL) {
+        msg->next = NULL;
+        if (q->tail != NULL) {
+            q->tail->next = msg;
+        } else {
+            q->head = msg;
+        }
+        q->tail = msg;
+        metrics_gauge_max(&backlog_peak, (int32_t)backlog);
+    }
+    if (err != ESP_OK) {
+        int64_t now = esp_timer_get_time();
+        drops_unwarned++;
+        if (now - drop_warned_us >= MQTT_DROP_WARN_INTERVAL_US) {
+            warn_drops = drops_unwarned;
+            drops_unwarned = 0;
+            drop_warned_us = now;
+        }
+    }
+    xSemaphoreGive(pipeline_lock);
+
+    if (stale != NULL) {
+        metrics_counter_inc(&coalesced);
+    }
+    if (err != ESP_OK) {
+        metrics_counter_inc(&dropped[priority]);
+        if (warn_drops > 0) {
+            DLOG_W(s_log, "Dropped %d bytes at priority %d, outbox over budget (%lu drops since the last warning)",
+                   len, (int)priority, (unsigned long)warn_drops);
+        }
+        return err;
     }
+    xTaskNotifyGive(publisher_task);
+    return ESP_OK;
+}
+
+bool mqtt_service_is_connected(void)
+{
+    return connected;
 }
 
 void mqtt_service_subscribe(const char* topic, int qos)
 {
-    if (client != NULL) {
+    if (subscription_count >= MQTT_SERVICE_MAX_SUBSCRIPTIONS ||
+        strlen(topic) >= MQTT_SERVICE_TOPIC_MAX_LEN) {
+        ESP_LOGE(TAG, "Cannot register subscription to %s", topic);
+        return;
+    }
+
+    mqtt_subscription_t *sub = &subscriptions[subscription_count];
+    strncpy(sub->topic, topic, sizeof(sub->topic) - 1);
+    sub->topic[sizeof(sub->topic) - 1] = '\0';
+    sub->qos = qos;
+    subscription_count++;
+
+    if (client != NULL && connected) {
         int msg_id = esp_mqtt_client_subscribe(client, topic, qos);
         ESP_LOGI(TAG, "Subscribed to topic %s with msg_id=%d", topic, msg_id);
     } else {
-        ESP_LOGW(TAG, "MQTT client not initialized");
+        ESP_LOGI(TAG, "Subscription to %s deferred until connected", topic);
+    }
+}
+
+void mqtt_service_set_status_topic(const char* topic)
+{
+    if (client != NULL || strlen(topic) >= sizeof(status_topic)) {
+        ESP_LOGE(TAG, "Cannot set status topic %s", topic);
+        return;
+    }
+    snprintf(status_topic, sizeof(status_topic), "%s", topic);
+}
+
+void mqtt_service_set_connection_callback(mqtt_connection_callback_t callback)
+{
+    connection_callback = callback;
+}
+
+void mqtt_service_reconnect(void)
+{
+    if (client != NULL && !connected) {
+        esp_mqtt_client_reconnect(client);
     }
 }
\ No newline at end of file
@@ -3,30 +3,31 @@
  * @brief Header file for WiFi service component.
  * 
  * This module responsible for handle WiFi connectivity.
- * Auto reconnect when disconnected.
+ * Auto reconnect when disconnected, with an increasing delay between attempts.
+ * Nothing in this module blocks; connection changes are reported through the
+ * default event loop (WIFI_EVENT / IP_EVENT).
  */
 
 #ifndef SERVICE_WIFI_H
 #define SERVICE_WIFI_H
 
+#include <stdbool.h>
 #include "esp_err.h"
 
 /**
  * @brief Initializes TCP/IP stack, creates default event loop, 
  *        and configures WiFi in Station mode using credentials from Kconfig.
  *        Registers event handlers for connection and IP acquisition.
+ *        Returns immediately; the connection is established in the background.
  * @param None
  * @return None
  */
 void wifi_service_start(void);
 
 /**
- * @brief Blocks the calling task (typically Main Task) 
- *        using FreeRTOS Event Groups until the WiFi connection 
- *        is successfully established and an IP address is obtained.
- * @param None
- * @return None
+ * @brief Reports whether the station currently holds an IP address.
+ * @return true if connected to the AP with an IP address, false otherwise.
  */
-void wifi_service_wait_for_connect(void);
+bool wifi_service_is_connected(void);
 
-#endif // SERVICE_WIFI_H
\ No newline at end of file
+#endif // SERVICE_WIFI_H
@@ -2,12 +2,12 @@
 #include "service_wifi.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 
-#define MAX_RETRY      10
-
-#define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
+/* Reconnect delay doubles after every failed attempt, up to the maximum */
+#define RETRY_DELAY_MIN_MS      500
+#define RETRY_DELAY_MAX_MS      30000
 
 wifi_config_t wifi_cfg = {
     .sta = {
@@ -18,9 +18,15 @@ wifi_config_t wifi_cfg = {
 };
 
 static const char *TAG = "WIFI_SERVICE";
-static int retry_num = 0;
-static bool ever_connected = false;  // Track if WiFi has ever connected successfully
-static EventGroupHandle_t s_wifi_event_group;
+static uint32_t retry_num = 0;
+static uint32_t retry_delay_ms = RETRY_DELAY_MIN_MS;
+static volatile bool connected = false;
+static esp_timer_handle_t s_retry_timer;
+
+static void retry_timer_cb(void *arg)
+{
+    esp_wifi_connect();
+}
 
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                int32_t event_id, void* event_data)
@@ -29,51 +35,39 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
     }
-    // Retry connecting to AP
+    // Retry connecting to AP, never give up; the rest of the system keeps running offline
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        // If we've connected before, retry indefinitely (for reconnection after WiFi loss)
-        if (ever_connected) {
-            esp_wifi_connect();
-            ESP_LOGI(TAG, "WiFi disconnected, retrying to reconnect...");
-        }
-        // If never connected, use limited retries (for initial connection)
-        else if (retry_num < MAX_RETRY) {
-            esp_wifi_connect();
-            retry_num++;
-            ESP_LOGI(TAG, "Retrying to connect to the AP (attempt %d/%d)", retry_num, MAX_RETRY);
-        } else {
-            ESP_LOGI(TAG, "Failed to connect to the AP after %d attempts", MAX_RETRY);
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-        }
+        connected = false;
+        retry_num++;
+        ESP_LOGI(TAG, "WiFi disconnected, retrying in %lu ms (attempt %lu)",
+                 (unsigned long)retry_delay_ms, (unsigned long)retry_num);
+        // Schedule the reconnect instead of delaying here: this runs on the event loop task
+        esp_timer_stop(s_retry_timer);
+        esp_timer_start_once(s_retry_timer, (uint64_t)retry_delay_ms * 1000);
+        retry_delay_ms = retry_delay_ms * 2 > RETRY_DELAY_MAX_MS ? RETRY_DELAY_MAX_MS : retry_delay_ms * 2;
     }
     // Successfully got IP
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
         retry_num = 0;
-        ever_connected = true;  // Mark that we've successfully connected
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        retry_delay_ms = RETRY_DELAY_MIN_MS;
+        connected = true;
     }
 }
 
-void wifi_service_wait_for_connect(void)
+bool wifi_service_is_connected(void)
 {
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-            WIFI_CONNECTED_BIT,
-            pdFALSE,
-            pdTRUE,
-            portMAX_DELAY);
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "Connected to AP");
-    } else {
-        ESP_LOGE(TAG, "UNEXPECTED EVENT");
-    }
+    return connected;
 }
 
 void wifi_service_start(void)
 {
-    // Initialize the Event Group
-    s_wifi_event_group = xEventGroupCreate();
+    const esp_timer_create_args_t retry_timer_args = {
+        .callback = retry_timer_cb,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_timer_args, &s_retry_timer));
 
     // 1. Wi-Fi/LwIP Init Phase
     // Initialize TCP/IP network interface
@@ -106,4 +100,4 @@ void wifi_service_start(void)
     esp_wifi_start();
 
     ESP_LOGI(TAG, "WiFi Service Started.");
-}
\ No newline at end of file
+}
@@ -0,0 +1,328 @@
+/**
+ * @file telemetry_codec.h
+ * @brief Heap-free encoders for the MQTT telemetry payloads.
+ *
+ * Payloads are written straight into a caller-provided buffer. The JSON
+ * output is byte-for-byte identical to what cJSON_PrintUnformatted produced
+ * for the same values, so the backend contract does not change.
+ */
+
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Large enough for every fixed-shape payload built by this module */
+#define TELEMETRY_JSON_MAX_LEN      160
+
+/*
+ * Compact binary payloads (little-endian, fixed schema). Byte 0 is a marker
+ * carrying the schema version; it can never start a JSON text, which lets a
+ * consumer tell both formats apart on the same topic. Byte 1 is the message type.
+ *
+ *   sensor:        marker, type, int16 temp [0.01 C], uint16 hum [0.01 %RH], uint32 timestamp [s]
+ *   device status: marker, type, uint32 timestamp [s], uint8 state, uint8 name_len, name[name_len]
+ *   health:        marker, type, uint32 uptime_ms, uint32 free_heap, int8 wifi_rssi, uint32 backlog,
+ *                  uint32 first_sample_ms, uint32 first_publish_ms
+ *   sensor batch:  marker, type, uint32 now [s], uint8 count,
+ *                  count x (int16 temp, uint16 hum, int32 sample time relative to now [ms]),
+ *                  then uint32 boot id unless it is unknown
+ *   sensor backlog: same layout as a batch, but "now" is only the time base of the
+ *                  offsets: the samples come from an earlier boot and cannot be
+ *                  placed on the current device clock. The boot id tells the
+ *                  consumer which boot's clock they are on.
+ *   device states: marker, type, uint32 timestamp [s], uint8 count,
+ *                  count x (uint8 state, uint8 name_len, name[name_len])
+ *   rollup:        marker, type, uint32 now [s], int32 window start relative to now [ms],
+ *                  uint32 window [ms], uint16 count,
+ *                  temp: int16 min, int16 max, int16 mean [0.01 C], uint32 variance [1e-4 C^2],
+ *                  hum: uint16 min, uint16 max, uint16 mean [0.01 %RH], uint32 variance [1e-4 %RH^2],
+ *                  then uint32 boot id unless it is unknown
+ *   rollup backlog: same layout as a rollup, but "now" is only the time base of the
+ *                  window start, which is on the clock of an earlier boot (see
+ *                  sensor backlog)
+ */
+#define TELEMETRY_BIN_VERSION       1
+#define TELEMETRY_BIN_MARKER        (0xA0 | TELEMETRY_BIN_VERSION)
+#define TELEMETRY_BIN_MAX_LEN       48
+#define TELEMETRY_BIN_SENSOR_LEN    10
+#define TELEMETRY_BIN_HEALTH_LEN    23
+#define TELEMETRY_BIN_NAME_MAX      32
+#define TELEMETRY_BIN_BATCH_HDR_LEN 7
+#define TELEMETRY_BIN_BATCH_ITEM_LEN 8
+#define TELEMETRY_BIN_BATCH_MAX     255
+#define TELEMETRY_BIN_ROLLUP_LEN    36
+
+/* Upper bound of one sample object inside a JSON batch, used to size buffers */
+#define TELEMETRY_JSON_SAMPLE_MAX_LEN   96
+/* Upper bound of a JSON rollup */
+#define TELEMETRY_JSON_ROLLUP_MAX_LEN   320
+
+typedef enum {
+    TELEMETRY_BIN_SENSOR = 1,
+    TELEMETRY_BIN_DEVICE_STATUS = 2,
+    TELEMETRY_BIN_HEALTH = 3,
+    TELEMETRY_BIN_SENSOR_BATCH = 4,
+    TELEMETRY_BIN_SENSOR_BACKLOG = 5,
+    TELEMETRY_BIN_DEVICE_STATES = 6,
+    TELEMETRY_BIN_ROLLUP = 7,
+    TELEMETRY_BIN_ROLLUP_BACKLOG = 8,
+} telemetry_bin_type_t;
+
+/* Upper bound of one entry in a JSON device-state report with a plain ASCII name */
+#define TELEMETRY_JSON_DEVICE_ITEM_MAX_LEN  (TELEMETRY_BIN_NAME_MAX + 32)
+
+/**
+ * Health check report. The boot milestones are milliseconds since boot and
+ * stay 0 until reached.
+ */
+typedef struct {
+    uint32_t uptime_ms;
+    size_t free_heap;
+    int8_t wifi_rssi;
+    uint32_t backlog;           /* samples stored offline and not yet sent */
+    uint32_t first_sample_ms;   /* first successful sensor read */
+    uint32_t first_publish_ms;  /* first sensor payload handed to the broker */
+} telemetry_health_t;
+
+/**
+ * State of one actuator, for combined status reports.
+ */
+typedef struct {
+    const char *name;
+    bool on;
+} telemetry_device_state_t;
+
+/* Pass as now_ms when the samples do not belong to the current device clock */
+#define TELEMETRY_TIME_UNKNOWN      UINT64_MAX
+/* Pass as boot_id when the boot counter is not available */
+#define TELEMETRY_BOOT_UNKNOWN      0
+
+/**
+ * One sensor measurement, timestamped when it was taken.
+ */
+typedef struct {
+    uint64_t timestamp_ms;      /* milliseconds since boot */
+    float temperature;
+    float humidity;
+} telemetry_sample_t;
+
+/**
+ * Statistics of one channel over a window.
+ */
+typedef struct {
+    float min;
+    float max;
+    float mean;
+    float variance;             /* population variance */
+} telemetry_stats_t;
+
+/**
+ * Aggregate of the samples taken in one window.
+ */
+typedef struct {
+    uint64_t start_ms;          /* window start, milliseconds since boot */
+    uint32_t window_ms;
+    uint32_t count;             /* samples in the window */
+    telemetry_stats_t temperature;
+    telemetry_stats_t humidity;
+} telemetry_rollup_t;
+
+/* Maximum nesting depth supported by the streaming writer */
+#define TELEMETRY_JSON_MAX_DEPTH    8
+
+/**
+ * Streaming JSON writer state. Lives on the caller's stack, holds no heap.
+ */
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    uint8_t depth;
+    uint8_t need_comma;     /* bit n set: container at depth n already has a member */
+    bool overflow;
+} telemetry_json_writer_t;
+
+/**
+ * @brief Binds a writer to an output buffer. The buffer is kept NUL-terminated.
+ * @param [out] w Writer to initialize.
+ * @param [in] buf Output buffer.
+ * @param [in] cap Size of the output buffer in bytes (including the terminator).
+ */
+void telemetry_json_init(telemetry_json_writer_t *w, char *buf, size_t cap);
+
+void telemetry_json_object_begin(telemetry_json_writer_t *w);
+void telemetry_json_object_end(telemetry_json_writer_t *w);
+void telemetry_json_array_begin(telemetry_json_writer_t *w);
+void telemetry_json_array_end(telemetry_json_writer_t *w);
+
+/**
+ * @brief Writes an object key. Must be followed by exactly one value.
+ */
+void telemetry_json_key(telemetry_json_writer_t *w, const char *key);
+
+/**
+ * @brief Writes a number using the same formatting rules as cJSON
+ *        (integers as "%d", otherwise the shortest of "%1.15g"/"%1.17g"
+ *        that round-trips, NaN/Inf as null).
+ */
+void telemetry_json_number(telemetry_json_writer_t *w, double value);
+
+/**
+ * @brief Writes a string value, escaped the same way cJSON escapes it.
+ */
+void telemetry_json_string(telemetry_json_writer_t *w, const char *value);
+
+/**
+ * @brief Completes the payload.
+ * @param [in] w Writer.
+ * @param [out] out_len Optional, receives the payload length without the terminator.
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the buffer was too small
+ *         or ESP_ERR_INVALID_STATE if containers are left open.
+ */
+esp_err_t telemetry_json_finish(telemetry_json_writer_t *w, size_t *out_len);
+
+/**
+ * @brief Encodes {"temperature":..,"humidity":..,"timestamp":..}.
+ * @param [out] buf Output buffer.
+ * @param [in] buf_len Size of the output buffer.
+ * @param [in] temperature Temperature in Celsius.
+ * @param [in] humidity Relative humidity in percent.
+ * @param [in] timestamp Seconds since boot.
+ * @param [out] out_len Optional, receives the payload length.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t telemetry_encode_sensor_json(char *buf, size_t buf_len, float temperature,
+                                       float humidity, uint32_t timestamp, size_t *out_len);
+
+/**
+ * @brief Encodes {"device":..,"state":..,"timestamp":..}.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t telemetry_encode_device_status_json(char *buf, size_t buf_len, const char *device,
+                                              const char *state, uint32_t timestamp,
+                                              size_t *out_len);
+
+/**
+ * @brief Encodes the state of several actuators as one report:
+ *        {"timestamp":..,"devices":[{"device":..,"state":"on"|"off"},...]}
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t telemetry_encode_device_states_json(char *buf, size_t buf_len,
+                                              const telemetry_device_state_t *devices, size_t count,
+                                              uint32_t timestamp, size_t *out_len);
+
+/**
+ * @brief Encodes {"uptime_ms":..,"free_heap":..,"wifi_rssi":..,"backlog":..,
+ *        "first_sample_ms":..,"first_publish_ms":..}.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t telemetry_encode_health_json(char *buf, size_t buf_len, const telemetry_health_t *health,
+                                       size_t *out_len);
+
+/**
+ * @brief Writes the members of the health payload into the currently open
+ *        object, so a larger report can extend it.
+ */
+void telemetry_json_health_members(telemetry_json_writer_t *w, const telemetry_health_t *health);
+
+/**
+ * @brief Encodes a sensor sample in the binary schema. Values outside the
+ *        fixed-point range are clamped.
+ * @param [out] buf Output buffer, at least TELEMETRY_BIN_SENSOR_LEN bytes.
+ * @param [in] buf_len Size of the output buffer.
+ * @param [in] temperature Temperature in Celsius.
+ * @param [in] humidity Relative humidity in percent.
+ * @param [in] timestamp Seconds since boot.
+ * @param [out] out_len Receives the payload length.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t telemetry_encode_sensor_bin(uint8_t *buf, size_t buf_len, float temperature,
+                                      float humidity, uint32_t timestamp, size_t *out_len);
+
+/**
+ * @brief Encodes a device status report in the binary schema.
+ *        The state must be "on" or "off".
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown state or a
+ *         device name longer than TELEMETRY_BIN_NAME_MAX.
+ */
+esp_err_t telemetry_encode_device_status_bin(uint8_t *buf, size_t buf_len, const char *device,
+                                             const char *state, uint32_t timestamp,
+                                             size_t *out_len);
+
+/**
+ * @brief Encodes a combined actuator report in the binary schema.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for more than 255 devices or a
+ *         name longer than TELEMETRY_BIN_NAME_MAX, ESP_ERR_INVALID_SIZE if buf is too small.
+ */
+esp_err_t telemetry_encode_device_states_bin(uint8_t *buf, size_t buf_len,
+                                             const telemetry_device_state_t *devices, size_t count,
+                                             uint32_t timestamp, size_t *out_len);
+
+/**
+ * @brief Encodes the health check parameters in the binary schema.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t telemetry_encode_health_bin(uint8_t *buf, size_t buf_len, const telemetry_health_t *health,
+                                      size_t *out_len);
+
+/**
+ * @brief Encodes several samples as one message:
+ *        {"timestamp":now,"samples":[{"temperature":..,"humidity":..,"timestamp":..},...]}
+ *        Each element has the same shape as a single sensor payload; the outer
+ *        timestamp is the device time at publish, so the consumer can map
+ *        per-sample timestamps onto its own clock. Timestamps are seconds since
+ *        boot with millisecond resolution. With now_ms == TELEMETRY_TIME_UNKNOWN
+ *        the outer timestamp is left out. "boot" follows "timestamp" and
+ *        names the boot the samples were taken in, so a consumer that saw
+ *        that boot's clock live can still place samples replayed after a
+ *        reboot.
+ * @param [out] buf Output buffer.
+ * @param [in] buf_len Size of the output buffer.
+ * @param [in] samples Samples in measurement order.
+ * @param [in] count Number of samples.
+ * @param [in] now_ms Milliseconds since boot at publish time.
+ * @param [in] boot_id Boot the samples come from; left out if TELEMETRY_BOOT_UNKNOWN.
+ * @param [out] out_len Optional, receives the payload length.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t telemetry_encode_sensor_batch_json(char *buf, size_t buf_len,
+                                             const telemetry_sample_t *samples, size_t count,
+                                             uint64_t now_ms, uint32_t boot_id, size_t *out_len);
+
+/**
+ * @brief Binary counterpart of telemetry_encode_sensor_batch_json.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if count exceeds TELEMETRY_BIN_BATCH_MAX.
+ */
+esp_err_t telemetry_encode_sensor_batch_bin(uint8_t *buf, size_t buf_len,
+                                            const telemetry_sample_t *samples, size_t count,
+                                            uint64_t now_ms, uint32_t boot_id, size_t *out_len);
+
+/**
+ * @brief Encodes one window of statistics:
+ *        {"timestamp":now,"start":..,"window_s":..,"count":..,
+ *         "temperature":{"min":..,"max":..,"mean":..,"var":..},"humidity":{...}}
+ *        Times are seconds since boot with millisecond resolution, like a
+ *        batch. min/max/mean are rounded to 0.01 and var to 0.0001, the
+ *        resolution of the binary schema. As in a batch, "timestamp" is left
+ *        out for a window from an earlier boot and "boot" names its boot.
+ * @param [in] now_ms Milliseconds since boot at publish time, or TELEMETRY_TIME_UNKNOWN.
+ * @param [in] boot_id Boot the window comes from; left out if TELEMETRY_BOOT_UNKNOWN.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t telemetry_encode_rollup_json(char *buf, size_t buf_len, const telemetry_rollup_t *rollup,
+                                       uint64_t now_ms, uint32_t boot_id, size_t *out_len);
+
+/**
+ * @brief Binary counterpart of telemetry_encode_rollup_json. Values outside
+ *        the fixed-point ranges are clamped.
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if buf is shorter than
+ *         TELEMETRY_BIN_ROLLUP_LEN (plus 4 with a boot id).
+ */
+esp_err_t telemetry_encode_rollup_bin(uint8_t *buf, size_t buf_len, const telemetry_rollup_t *rollup,
+                                      uint64_t now_ms, uint32_t boot_id, size_t *out_len);
+
+#endif // TELEMETRY_CODEC_H
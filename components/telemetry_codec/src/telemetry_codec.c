@@ -0,0 +1,632 @@
+/**
+ * @file telemetry_codec.c
+ * @brief Streaming JSON writer and payload encoders for telemetry topics.
+ */
+
+#include "telemetry_codec.h"
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void put_raw(telemetry_json_writer_t *w, const char *s, size_t n)
+{
+    if (w->overflow) {
+        return;
+    }
+    if (w->len + n >= w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(&w->buf[w->len], s, n);
+    w->len += n;
+    w->buf[w->len] = '\0';
+}
+
+static void put_char(telemetry_json_writer_t *w, char c)
+{
+    put_raw(w, &c, 1);
+}
+
+/* Emits the separator before a value or key inside the current container */
+static void begin_member(telemetry_json_writer_t *w)
+{
+    uint8_t bit = (uint8_t)(1u << w->depth);
+    if (w->need_comma & bit) {
+        put_char(w, ',');
+    }
+    w->need_comma |= bit;
+}
+
+void telemetry_json_init(telemetry_json_writer_t *w, char *buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->depth = 0;
+    w->need_comma = 0;
+    w->overflow = (buf == NULL || cap == 0);
+    if (!w->overflow) {
+        buf[0] = '\0';
+    }
+}
+
+static void container_begin(telemetry_json_writer_t *w, char open)
+{
+    begin_member(w);
+    if (w->depth + 1 >= TELEMETRY_JSON_MAX_DEPTH) {
+        w->overflow = true;
+        return;
+    }
+    put_char(w, open);
+    w->depth++;
+    w->need_comma &= (uint8_t)~(1u << w->depth);
+}
+
+static void container_end(telemetry_json_writer_t *w, char close)
+{
+    if (w->depth == 0) {
+        w->overflow = true;
+        return;
+    }
+    put_char(w, close);
+    w->depth--;
+}
+
+void telemetry_json_object_begin(telemetry_json_writer_t *w)
+{
+    container_begin(w, '{');
+}
+
+void telemetry_json_object_end(telemetry_json_writer_t *w)
+{
+    container_end(w, '}');
+}
+
+void telemetry_json_array_begin(telemetry_json_writer_t *w)
+{
+    container_begin(w, '[');
+}
+
+void telemetry_json_array_end(telemetry_json_writer_t *w)
+{
+    container_end(w, ']');
+}
+
+static void put_escaped(telemetry_json_writer_t *w, const char *s)
+{
+    put_char(w, '"');
+    for (const unsigned char *p = (const unsigned char *)s; *p != '\0'; p++) {
+        switch (*p) {
+            case '"':  put_raw(w, "\\\"", 2); break;
+            case '\\': put_raw(w, "\\\\", 2); break;
+            case '\b': put_raw(w, "\\b", 2); break;
+            case '\f': put_raw(w, "\\f", 2); break;
+            case '\n': put_raw(w, "\\n", 2); break;
+            case '\r': put_raw(w, "\\r", 2); break;
+            case '\t': put_raw(w, "\\t", 2); break;
+            default:
+                if (*p < 32) {
+                    char esc[7];
+                    snprintf(esc, sizeof(esc), "\\u%04x", *p);
+                    put_raw(w, esc, 6);
+                } else {
+                    put_char(w, (char)*p);
+                }
+                break;
+        }
+    }
+    put_char(w, '"');
+}
+
+void telemetry_json_key(telemetry_json_writer_t *w, const char *key)
+{
+    begin_member(w);
+    put_escaped(w, key);
+    put_char(w, ':');
+    /* The value that follows must not emit another separator */
+    w->need_comma &= (uint8_t)~(1u << w->depth);
+}
+
+void telemetry_json_string(telemetry_json_writer_t *w, const char *value)
+{
+    begin_member(w);
+    put_escaped(w, value != NULL ? value : "");
+}
+
+static size_t format_int(char *out, int v)
+{
+    char tmp[12];
+    size_t n = 0;
+    /* Work on the negative range so INT_MIN does not overflow */
+    int neg = v < 0;
+    int x = neg ? v : -v;
+    do {
+        tmp[n++] = (char)('0' - (x % 10));
+        x /= 10;
+    } while (x != 0);
+    size_t len = 0;
+    if (neg) {
+        out[len++] = '-';
+    }
+    while (n > 0) {
+        out[len++] = tmp[--n];
+    }
+    return len;
+}
+
+static bool doubles_equal(double a, double b)
+{
+    double max_val = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+    return fabs(a - b) <= max_val * DBL_EPSILON;
+}
+
+void telemetry_json_number(telemetry_json_writer_t *w, double value)
+{
+    char tmp[26];
+    size_t n;
+
+    begin_member(w);
+
+    if (isnan(value) || isinf(value)) {
+        put_raw(w, "null", 4);
+        return;
+    }
+
+    /* Same clamping cJSON applies when it fills in valueint */
+    int as_int;
+    if (value >= INT_MAX) {
+        as_int = INT_MAX;
+    } else if (value <= (double)INT_MIN) {
+        as_int = INT_MIN;
+    } else {
+        as_int = (int)value;
+    }
+
+    if (value == (double)as_int) {
+        n = format_int(tmp, as_int);
+    } else {
+        n = (size_t)snprintf(tmp, sizeof(tmp), "%1.15g", value);
+        if (!doubles_equal(strtod(tmp, NULL), value)) {
+            n = (size_t)snprintf(tmp, sizeof(tmp), "%1.17g", value);
+        }
+    }
+    put_raw(w, tmp, n);
+}
+
+esp_err_t telemetry_json_finish(telemetry_json_writer_t *w, size_t *out_len)
+{
+    if (w->overflow) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (w->depth != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (out_len != NULL) {
+        *out_len = w->len;
+    }
+    return ESP_OK;
+}
+
+esp_err_t telemetry_encode_sensor_json(char *buf, size_t buf_len, float temperature,
+                                       float humidity, uint32_t timestamp, size_t *out_len)
+{
+    telemetry_json_writer_t w;
+    telemetry_json_init(&w, buf, buf_len);
+    telemetry_json_object_begin(&w);
+    telemetry_json_key(&w, "temperature");
+    telemetry_json_number(&w, temperature);
+    telemetry_json_key(&w, "humidity");
+    telemetry_json_number(&w, humidity);
+    telemetry_json_key(&w, "timestamp");
+    telemetry_json_number(&w, (double)timestamp);
+    telemetry_json_object_end(&w);
+    return telemetry_json_finish(&w, out_len);
+}
+
+esp_err_t telemetry_encode_device_status_json(char *buf, size_t buf_len, const char *device,
+                                              const char *state, uint32_t timestamp,
+                                              size_t *out_len)
+{
+    telemetry_json_writer_t w;
+    telemetry_json_init(&w, buf, buf_len);
+    telemetry_json_object_begin(&w);
+    telemetry_json_key(&w, "device");
+    telemetry_json_string(&w, device);
+    telemetry_json_key(&w, "state");
+    telemetry_json_string(&w, state);
+    telemetry_json_key(&w, "timestamp");
+    telemetry_json_number(&w, (double)timestamp);
+    telemetry_json_object_end(&w);
+    return telemetry_json_finish(&w, out_len);
+}
+
+esp_err_t telemetry_encode_device_states_json(char *buf, size_t buf_len,
+                                              const telemetry_device_state_t *devices, size_t count,
+                                              uint32_t timestamp, size_t *out_len)
+{
+    if (devices == NULL && count != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    telemetry_json_writer_t w;
+    telemetry_json_init(&w, buf, buf_len);
+    telemetry_json_object_begin(&w);
+    telemetry_json_key(&w, "timestamp");
+    telemetry_json_number(&w, (double)timestamp);
+    telemetry_json_key(&w, "devices");
+    telemetry_json_array_begin(&w);
+    for (size_t i = 0; i < count; i++) {
+        telemetry_json_object_begin(&w);
+        telemetry_json_key(&w, "device");
+        telemetry_json_string(&w, devices[i].name);
+        telemetry_json_key(&w, "state");
+        telemetry_json_string(&w, devices[i].on ? "on" : "off");
+        telemetry_json_object_end(&w);
+    }
+    telemetry_json_array_end(&w);
+    telemetry_json_object_end(&w);
+    return telemetry_json_finish(&w, out_len);
+}
+
+void telemetry_json_health_members(telemetry_json_writer_t *w, const telemetry_health_t *health)
+{
+    telemetry_json_key(w, "uptime_ms");
+    telemetry_json_number(w, (double)health->uptime_ms);
+    telemetry_json_key(w, "free_heap");
+    telemetry_json_number(w, (double)health->free_heap);
+    telemetry_json_key(w, "wifi_rssi");
+    telemetry_json_number(w, (double)health->wifi_rssi);
+    telemetry_json_key(w, "backlog");
+    telemetry_json_number(w, (double)health->backlog);
+    telemetry_json_key(w, "first_sample_ms");
+    telemetry_json_number(w, (double)health->first_sample_ms);
+    telemetry_json_key(w, "first_publish_ms");
+    telemetry_json_number(w, (double)health->first_publish_ms);
+}
+
+esp_err_t telemetry_encode_health_json(char *buf, size_t buf_len, const telemetry_health_t *health,
+                                       size_t *out_len)
+{
+    if (health == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    telemetry_json_writer_t w;
+    telemetry_json_init(&w, buf, buf_len);
+    telemetry_json_object_begin(&w);
+    telemetry_json_health_members(&w, health);
+    telemetry_json_object_end(&w);
+    return telemetry_json_finish(&w, out_len);
+}
+
+esp_err_t telemetry_encode_sensor_batch_json(char *buf, size_t buf_len,
+                                             const telemetry_sample_t *samples, size_t count,
+                                             uint64_t now_ms, uint32_t boot_id, size_t *out_len)
+{
+    if (samples == NULL && count != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    telemetry_json_writer_t w;
+    telemetry_json_init(&w, buf, buf_len);
+    telemetry_json_object_begin(&w);
+    if (now_ms != TELEMETRY_TIME_UNKNOWN) {
+        telemetry_json_key(&w, "timestamp");
+        telemetry_json_number(&w, (double)now_ms / 1000.0);
+    }
+    if (boot_id != TELEMETRY_BOOT_UNKNOWN) {
+        telemetry_json_key(&w, "boot");
+        telemetry_json_number(&w, (double)boot_id);
+    }
+    telemetry_json_key(&w, "samples");
+    telemetry_json_array_begin(&w);
+    for (size_t i = 0; i < count && !w.overflow; i++) {
+        telemetry_json_object_begin(&w);
+        telemetry_json_key(&w, "temperature");
+        telemetry_json_number(&w, samples[i].temperature);
+        telemetry_json_key(&w, "humidity");
+        telemetry_json_number(&w, samples[i].humidity);
+        telemetry_json_key(&w, "timestamp");
+        telemetry_json_number(&w, (double)samples[i].timestamp_ms / 1000.0);
+        telemetry_json_object_end(&w);
+    }
+    telemetry_json_array_end(&w);
+    telemetry_json_object_end(&w);
+    return telemetry_json_finish(&w, out_len);
+}
+
+/* Rounds to 1/scale so float noise does not leak into the payload */
+static double rounded(float value, double scale)
+{
+    return round((double)value * scale) / scale;
+}
+
+static void put_stats(telemetry_json_writer_t *w, const char *key, const telemetry_stats_t *stats)
+{
+    telemetry_json_key(w, key);
+    telemetry_json_object_begin(w);
+    telemetry_json_key(w, "min");
+    telemetry_json_number(w, rounded(stats->min, 100.0));
+    telemetry_json_key(w, "max");
+    telemetry_json_number(w, rounded(stats->max, 100.0));
+    telemetry_json_key(w, "mean");
+    telemetry_json_number(w, rounded(stats->mean, 100.0));
+    telemetry_json_key(w, "var");
+    telemetry_json_number(w, rounded(stats->variance, 10000.0));
+    telemetry_json_object_end(w);
+}
+
+esp_err_t telemetry_encode_rollup_json(char *buf, size_t buf_len, const telemetry_rollup_t *rollup,
+                                       uint64_t now_ms, uint32_t boot_id, size_t *out_len)
+{
+    if (rollup == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    telemetry_json_writer_t w;
+    telemetry_json_init(&w, buf, buf_len);
+    telemetry_json_object_begin(&w);
+    if (now_ms != TELEMETRY_TIME_UNKNOWN) {
+        telemetry_json_key(&w, "timestamp");
+        telemetry_json_number(&w, (double)now_ms / 1000.0);
+    }
+    if (boot_id != TELEMETRY_BOOT_UNKNOWN) {
+        telemetry_json_key(&w, "boot");
+        telemetry_json_number(&w, (double)boot_id);
+    }
+    telemetry_json_key(&w, "start");
+    telemetry_json_number(&w, (double)rollup->start_ms / 1000.0);
+    telemetry_json_key(&w, "window_s");
+    telemetry_json_number(&w, (double)rollup->window_ms / 1000.0);
+    telemetry_json_key(&w, "count");
+    telemetry_json_number(&w, (double)rollup->count);
+    put_stats(&w, "temperature", &rollup->temperature);
+    put_stats(&w, "humidity", &rollup->humidity);
+    telemetry_json_object_end(&w);
+    return telemetry_json_finish(&w, out_len);
+}
+
+static void put_u16_le(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32_le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* Scales to hundredths and clamps into [lo, hi] */
+static int32_t to_centi(float value, int32_t lo, int32_t hi)
+{
+    if (isnan(value)) {
+        return 0;
+    }
+    float scaled = value * 100.0f;
+    if (scaled <= (float)lo) {
+        return lo;
+    }
+    if (scaled >= (float)hi) {
+        return hi;
+    }
+    return (int32_t)lroundf(scaled);
+}
+
+esp_err_t telemetry_encode_sensor_bin(uint8_t *buf, size_t buf_len, float temperature,
+                                      float humidity, uint32_t timestamp, size_t *out_len)
+{
+    if (buf == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (buf_len < TELEMETRY_BIN_SENSOR_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    buf[0] = TELEMETRY_BIN_MARKER;
+    buf[1] = TELEMETRY_BIN_SENSOR;
+    put_u16_le(&buf[2], (uint16_t)(int16_t)to_centi(temperature, INT16_MIN, INT16_MAX));
+    put_u16_le(&buf[4], (uint16_t)to_centi(humidity, 0, UINT16_MAX));
+    put_u32_le(&buf[6], timestamp);
+    *out_len = TELEMETRY_BIN_SENSOR_LEN;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_encode_device_status_bin(uint8_t *buf, size_t buf_len, const char *device,
+                                             const char *state, uint32_t timestamp,
+                                             size_t *out_len)
+{
+    if (buf == NULL || device == NULL || state == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t state_val;
+    if (strcmp(state, "on") == 0) {
+        state_val = 1;
+    } else if (strcmp(state, "off") == 0) {
+        state_val = 0;
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t name_len = strlen(device);
+    if (name_len > TELEMETRY_BIN_NAME_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (buf_len < 8 + name_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    buf[0] = TELEMETRY_BIN_MARKER;
+    buf[1] = TELEMETRY_BIN_DEVICE_STATUS;
+    put_u32_le(&buf[2], timestamp);
+    buf[6] = state_val;
+    buf[7] = (uint8_t)name_len;
+    memcpy(&buf[8], device, name_len);
+    *out_len = 8 + name_len;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_encode_device_states_bin(uint8_t *buf, size_t buf_len,
+                                             const telemetry_device_state_t *devices, size_t count,
+                                             uint32_t timestamp, size_t *out_len)
+{
+    if (buf == NULL || out_len == NULL || (devices == NULL && count != 0) || count > UINT8_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (buf_len < 7) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    buf[0] = TELEMETRY_BIN_MARKER;
+    buf[1] = TELEMETRY_BIN_DEVICE_STATES;
+    put_u32_le(&buf[2], timestamp);
+    buf[6] = (uint8_t)count;
+
+    size_t pos = 7;
+    for (size_t i = 0; i < count; i++) {
+        size_t name_len = strlen(devices[i].name);
+        if (name_len > TELEMETRY_BIN_NAME_MAX) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (buf_len - pos < 2 + name_len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        buf[pos] = devices[i].on ? 1 : 0;
+        buf[pos + 1] = (uint8_t)name_len;
+        memcpy(&buf[pos + 2], devices[i].name, name_len);
+        pos += 2 + name_len;
+    }
+    *out_len = pos;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_encode_health_bin(uint8_t *buf, size_t buf_len, const telemetry_health_t *health,
+                                      size_t *out_len)
+{
+    if (buf == NULL || health == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (buf_len < TELEMETRY_BIN_HEALTH_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    buf[0] = TELEMETRY_BIN_MARKER;
+    buf[1] = TELEMETRY_BIN_HEALTH;
+    put_u32_le(&buf[2], health->uptime_ms);
+    put_u32_le(&buf[6], health->free_heap > UINT32_MAX ? UINT32_MAX : (uint32_t)health->free_heap);
+    buf[10] = (uint8_t)health->wifi_rssi;
+    put_u32_le(&buf[11], health->backlog);
+    put_u32_le(&buf[15], health->first_sample_ms);
+    put_u32_le(&buf[19], health->first_publish_ms);
+    *out_len = TELEMETRY_BIN_HEALTH_LEN;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_encode_sensor_batch_bin(uint8_t *buf, size_t buf_len,
+                                            const telemetry_sample_t *samples, size_t count,
+                                            uint64_t now_ms, uint32_t boot_id, size_t *out_len)
+{
+    if (buf == NULL || out_len == NULL || (samples == NULL && count != 0) ||
+        count > TELEMETRY_BIN_BATCH_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t len = TELEMETRY_BIN_BATCH_HDR_LEN + count * TELEMETRY_BIN_BATCH_ITEM_LEN +
+                 (boot_id != TELEMETRY_BOOT_UNKNOWN ? 4 : 0);
+    if (buf_len < len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    /* Without a current clock, offsets are relative to the first sample */
+    bool backlog = (now_ms == TELEMETRY_TIME_UNKNOWN);
+    uint64_t now_s = (backlog ? (count > 0 ? samples[0].timestamp_ms : 0) : now_ms) / 1000;
+
+    buf[0] = TELEMETRY_BIN_MARKER;
+    buf[1] = backlog ? TELEMETRY_BIN_SENSOR_BACKLOG : TELEMETRY_BIN_SENSOR_BATCH;
+    put_u32_le(&buf[2], (uint32_t)now_s);
+    buf[6] = (uint8_t)count;
+
+    uint8_t *p = &buf[TELEMETRY_BIN_BATCH_HDR_LEN];
+    for (size_t i = 0; i < count; i++) {
+        put_u16_le(&p[0], (uint16_t)(int16_t)to_centi(samples[i].temperature, INT16_MIN, INT16_MAX));
+        put_u16_le(&p[2], (uint16_t)to_centi(samples[i].humidity, 0, UINT16_MAX));
+        int64_t offset_ms = (int64_t)samples[i].timestamp_ms - (int64_t)(now_s * 1000);
+        if (offset_ms < INT32_MIN) {
+            offset_ms = INT32_MIN;
+        } else if (offset_ms > INT32_MAX) {
+            offset_ms = INT32_MAX;
+        }
+        put_u32_le(&p[4], (uint32_t)(int32_t)offset_ms);
+        p += TELEMETRY_BIN_BATCH_ITEM_LEN;
+    }
+    if (boot_id != TELEMETRY_BOOT_UNKNOWN) {
+        put_u32_le(p, boot_id);
+    }
+
+    *out_len = len;
+    return ESP_OK;
+}
+
+/* Variance in 1e-4 units, clamped into uint32 */
+static uint32_t to_variance(float value)
+{
+    if (!(value > 0.0f)) {
+        return 0;
+    }
+    double scaled = (double)value * 10000.0;
+    return scaled >= (double)UINT32_MAX ? UINT32_MAX : (uint32_t)llround(scaled);
+}
+
+esp_err_t telemetry_encode_rollup_bin(uint8_t *buf, size_t buf_len, const telemetry_rollup_t *rollup,
+                                      uint64_t now_ms, uint32_t boot_id, size_t *out_len)
+{
+    if (buf == NULL || rollup == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t len = TELEMETRY_BIN_ROLLUP_LEN + (boot_id != TELEMETRY_BOOT_UNKNOWN ? 4 : 0);
+    if (buf_len < len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    /* Without a current clock, the start is relative to itself */
+    bool backlog = (now_ms == TELEMETRY_TIME_UNKNOWN);
+    uint64_t now_s = (backlog ? rollup->start_ms : now_ms) / 1000;
+    int64_t offset_ms = (int64_t)rollup->start_ms - (int64_t)(now_s * 1000);
+    if (offset_ms < INT32_MIN) {
+        offset_ms = INT32_MIN;
+    } else if (offset_ms > INT32_MAX) {
+        offset_ms = INT32_MAX;
+    }
+
+    buf[0] = TELEMETRY_BIN_MARKER;
+    buf[1] = backlog ? TELEMETRY_BIN_ROLLUP_BACKLOG : TELEMETRY_BIN_ROLLUP;
+    put_u32_le(&buf[2], (uint32_t)now_s);
+    put_u32_le(&buf[6], (uint32_t)(int32_t)offset_ms);
+    put_u32_le(&buf[10], rollup->window_ms);
+    put_u16_le(&buf[14], rollup->count > UINT16_MAX ? UINT16_MAX : (uint16_t)rollup->count);
+
+    const telemetry_stats_t *t = &rollup->temperature;
+    put_u16_le(&buf[16], (uint16_t)(int16_t)to_centi(t->min, INT16_MIN, INT16_MAX));
+    put_u16_le(&buf[18], (uint16_t)(int16_t)to_centi(t->max, INT16_MIN, INT16_MAX));
+    put_u16_le(&buf[20], (uint16_t)(int16_t)to_centi(t->mean, INT16_MIN, INT16_MAX));
+    put_u32_le(&buf[22], to_variance(t->variance));
+
+    const telemetry_stats_t *h = &rollup->humidity;
+    put_u16_le(&buf[26], (uint16_t)to_centi(h->min, 0, UINT16_MAX));
+    put_u16_le(&buf[28], (uint16_t)to_centi(h->max, 0, UINT16_MAX));
+    put_u16_le(&buf[30], (uint16_t)to_centi(h->mean, 0, UINT16_MAX));
+    put_u32_le(&buf[32], to_variance(h->variance));
+
+    if (boot_id != TELEMETRY_BOOT_UNKNOWN) {
+        put_u32_le(&buf[TELEMETRY_BIN_ROLLUP_LEN], boot_id);
+    }
+    *out_len = len;
+    return ESP_OK;
+}
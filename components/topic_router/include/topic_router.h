@@ -0,0 +1,101 @@
+/**
+ * @file topic_router.h
+ * @brief Dispatches inbound MQTT topics to handlers through tables built
+ *        once at boot.
+ *
+ * Filters use MQTT syntax: "room_01/commands", "all/commands",
+ * "room_01/+/set" or "room_01/trace/#". Filters without wildcards go into a
+ * small hash table keyed by topic length and last byte, so the common case
+ * costs one probe and one memcmp however many routes there are. Filters
+ * with wildcards go into a trie of topic levels, which is only walked when
+ * the table has no entry.
+ *
+ * When several filters match, the most specific wins: an exact filter
+ * first, then in the trie at every level an exact child before '+', and
+ * '+' before '#'.
+ *
+ * Routes are added before the first dispatch; the router is read-only
+ * afterwards, so dispatch needs no lock.
+ */
+
+#ifndef TOPIC_ROUTER_H
+#define TOPIC_ROUTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define TOPIC_ROUTER_MAX_ROUTES     16
+#define TOPIC_ROUTER_MAX_NODES      32      /* levels of the wildcard filters, shared prefixes count once */
+#define TOPIC_ROUTER_MAX_LEVELS     8
+
+/**
+ * @brief Called for a matching topic. topic and payload are not
+ *        NUL-terminated and only valid during the call.
+ */
+typedef void (*topic_handler_t)(const char *topic, size_t topic_len,
+                                const char *payload, size_t payload_len, void *ctx);
+
+/* Node links are indices into nodes[] and route is an index into routes[]
+ * plus one; 0 means none (the root is nobody's child). */
+typedef struct {
+    const char *level;      /* points into the filter string */
+    uint16_t len;
+    uint8_t first_child;    /* exact children, linked through next_sibling */
+    uint8_t next_sibling;
+    uint8_t plus_child;     /* '+' */
+    uint8_t hash_child;     /* '#' */
+    uint8_t route;
+} topic_router_node_t;
+
+typedef struct {
+    topic_handler_t handler;
+    void *ctx;
+    const char *filter;
+    uint16_t len;
+} topic_router_route_t;
+
+/* Open addressing, at most half full */
+#define TOPIC_ROUTER_TABLE_SIZE     (2 * TOPIC_ROUTER_MAX_ROUTES)
+
+typedef struct {
+    uint8_t node_count;
+    uint8_t route_count;
+    uint8_t exact[TOPIC_ROUTER_TABLE_SIZE];                 /* route index + 1, 0: empty */
+    topic_router_node_t nodes[TOPIC_ROUTER_MAX_NODES];      /* nodes[0] is the root */
+    topic_router_route_t routes[TOPIC_ROUTER_MAX_ROUTES];
+} topic_router_t;
+
+/**
+ * @brief Empties the router.
+ */
+void topic_router_init(topic_router_t *router);
+
+/**
+ * @brief Adds a route.
+ * @param [in] filter MQTT topic filter; not copied, must stay valid.
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a malformed filter (empty level
+ *         names are allowed, wildcards must fill a whole level and '#' must
+ *         be last), ESP_ERR_INVALID_STATE if the filter is already routed,
+ *         ESP_ERR_NO_MEM if the route or node table is full.
+ */
+esp_err_t topic_router_add(topic_router_t *router, const char *filter,
+                           topic_handler_t handler, void *ctx);
+
+/**
+ * @brief Calls the handler of the most specific filter matching topic.
+ * @return ESP_OK if a handler was called, ESP_ERR_NOT_FOUND if no filter
+ *         matches, ESP_ERR_INVALID_ARG for an empty topic.
+ */
+esp_err_t topic_router_dispatch(const topic_router_t *router, const char *topic, size_t topic_len,
+                                const char *payload, size_t payload_len);
+
+/**
+ * @brief Filter of route i (0 <= i < router->route_count), e.g. to subscribe to it.
+ */
+static inline const char *topic_router_filter(const topic_router_t *router, size_t i)
+{
+    return router->routes[i].filter;
+}
+
+#endif // TOPIC_ROUTER_H
@@ -0,0 +1,222 @@
+/**
+ * @file topic_router.c
+ * @brief Exact-topic table and wildcard trie; see topic_router.h.
+ */
+
+#include "topic_router.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define NONE    0
+
+static size_t level_end(const char *topic, size_t len, size_t pos)
+{
+    const char *slash = memchr(topic + pos, '/', len - pos);
+    return slash ? (size_t)(slash - topic) : len;
+}
+
+/*
+ * Returns the table slot holding topic, or the empty slot where it would
+ * go. Topics of one node differ in length or last byte more often than not,
+ * so the probe sequence is usually one slot long.
+ */
+static uint8_t *find_exact(const topic_router_t *router, const char *topic, size_t len)
+{
+    size_t i = (len * 31u + (uint8_t)topic[len - 1]) % TOPIC_ROUTER_TABLE_SIZE;
+
+    for (; router->exact[i] != NONE; i = (i + 1) % TOPIC_ROUTER_TABLE_SIZE) {
+        const topic_router_route_t *r = &router->routes[router->exact[i] - 1];
+        if (r->len == len && memcmp(r->filter, topic, len) == 0) {
+            break;
+        }
+    }
+    return (uint8_t *)&router->exact[i];
+}
+
+void topic_router_init(topic_router_t *router)
+{
+    memset(router, 0, sizeof(*router));
+    router->node_count = 1;
+}
+
+static uint8_t new_node(topic_router_t *router, const char *level, size_t len)
+{
+    if (router->node_count >= TOPIC_ROUTER_MAX_NODES) {
+        return NONE;
+    }
+    uint8_t i = router->node_count++;
+    router->nodes[i].level = level;
+    router->nodes[i].len = (uint16_t)len;
+    return i;
+}
+
+static uint8_t find_child(const topic_router_t *router, uint8_t parent, const char *level, size_t len)
+{
+    for (uint8_t c = router->nodes[parent].first_child; c != NONE; c = router->nodes[c].next_sibling) {
+        const topic_router_node_t *n = &router->nodes[c];
+        if (n->len == len && memcmp(n->level, level, len) == 0) {
+            return c;
+        }
+    }
+    return NONE;
+}
+
+/* Walks or extends the trie along the filter; returns the last node's route slot */
+static uint8_t *add_levels(topic_router_t *router, const char *filter, size_t len)
+{
+    uint8_t node = 0;
+    for (size_t pos = 0; pos <= len; ) {
+        size_t end = level_end(filter, len, pos);
+        const char *level = filter + pos;
+        size_t level_len = end - pos;
+        uint8_t *link = NULL;
+        uint8_t next;
+
+        if (level_len == 1 && level[0] == '+') {
+            link = &router->nodes[node].plus_child;
+        } else if (level_len == 1 && level[0] == '#') {
+            link = &router->nodes[node].hash_child;
+        }
+
+        if (link != NULL) {
+            next = *link;
+            if (next == NONE) {
+                next = new_node(router, level, level_len);
+                *link = next;
+            }
+        } else {
+            next = find_child(router, node, level, level_len);
+            if (next == NONE) {
+                next = new_node(router, level, level_len);
+                if (next != NONE) {
+                    // Newest first; sibling order does not affect which route wins
+                    router->nodes[next].next_sibling = router->nodes[node].first_child;
+                    router->nodes[node].first_child = next;
+                }
+            }
+        }
+        if (next == NONE) {
+            return NULL;
+        }
+        node = next;
+        pos = end + 1;
+    }
+    return &router->nodes[node].route;
+}
+
+esp_err_t topic_router_add(topic_router_t *router, const char *filter,
+                           topic_handler_t handler, void *ctx)
+{
+    if (router == NULL || filter == NULL || handler == NULL || filter[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Validate first so a bad filter leaves no nodes behind
+    size_t len = strlen(filter);
+    size_t levels = 0;
+    bool wildcards = false;
+    for (size_t pos = 0; pos <= len; levels++) {
+        size_t end = level_end(filter, len, pos);
+        for (size_t i = pos; i < end; i++) {
+            bool wildcard = filter[i] == '+' || filter[i] == '#';
+            if (wildcard && end - pos != 1) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            wildcards |= wildcard;
+        }
+        if (filter[pos] == '#' && end != len) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        pos = end + 1;
+    }
+    if (levels > TOPIC_ROUTER_MAX_LEVELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (router->route_count >= TOPIC_ROUTER_MAX_ROUTES) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The table never fills up: it has twice as many slots as routes
+    uint8_t *slot = wildcards ? add_levels(router, filter, len) : find_exact(router, filter, len);
+    if (slot == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (*slot != NONE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    router->routes[router->route_count] = (topic_router_route_t) {
+        .handler = handler,
+        .ctx = ctx,
+        .filter = filter,
+        .len = (uint16_t)len,
+    };
+    *slot = ++router->route_count;
+    return ESP_OK;
+}
+
+/*
+ * Returns the route matching the topic levels from pos on, below node.
+ * pos == len + 1 means every level has been consumed. Recursion follows the
+ * trie, so it is at most TOPIC_ROUTER_MAX_LEVELS deep.
+ */
+static uint8_t match(const topic_router_t *router, uint8_t node, const char *topic, size_t len, size_t pos)
+{
+    const topic_router_node_t *n = &router->nodes[node];
+
+    if (pos > len) {
+        if (n->route != NONE) {
+            return n->route;
+        }
+        // "a/#" also matches "a"
+        return n->hash_child != NONE ? router->nodes[n->hash_child].route : NONE;
+    }
+
+    size_t left = len - pos;
+    uint8_t route;
+
+    // A child matches if its bytes are next and end where the level ends,
+    // so the topic is compared in place without looking for the '/' first
+    for (uint8_t c = n->first_child; c != NONE; c = router->nodes[c].next_sibling) {
+        const topic_router_node_t *child = &router->nodes[c];
+        if (child->len <= left && (child->len == left || topic[pos + child->len] == '/') &&
+            memcmp(child->level, topic + pos, child->len) == 0) {
+            route = match(router, c, topic, len, pos + child->len + 1);
+            if (route != NONE) {
+                return route;
+            }
+            break;  // levels are unique among siblings
+        }
+    }
+
+    // Wildcards do not match topics starting with '$' at the first level
+    if (node == 0 && topic[0] == '$') {
+        return NONE;
+    }
+    if (n->plus_child != NONE) {
+        route = match(router, n->plus_child, topic, len, level_end(topic, len, pos) + 1);
+        if (route != NONE) {
+            return route;
+        }
+    }
+    return n->hash_child != NONE ? router->nodes[n->hash_child].route : NONE;
+}
+
+esp_err_t topic_router_dispatch(const topic_router_t *router, const char *topic, size_t topic_len,
+                                const char *payload, size_t payload_len)
+{
+    if (router == NULL || topic == NULL || topic_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t route = *find_exact(router, topic, topic_len);
+    if (route == NONE && router->node_count > 1) {
+        route = match(router, 0, topic, topic_len, 0);
+    }
+    if (route == NONE) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    const topic_router_route_t *r = &router->routes[route - 1];
+    r->handler(topic, topic_len, payload, payload_len, r->ctx);
+    return ESP_OK;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file bench_event_trace.c
+ * @brief Host benchmark: cost of recording trace events, and a sample dump.
+ *
+ * Measures an instant event and a span (two cycle counter reads) against
+ * the bare ring insert with a fixed timestamp, which is what the firmware
+ * pays on top of its clock. The host counter (TSC) is far slower to read
+ * than the chip's CCOUNT register, especially under virtualization. With an output path the ring is dumped as "TRACE <hex>"
+ * lines, the console format, for trying host/tools/trace_to_perfetto.py.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "event_trace.h"
+
+#define BENCH_ITERATIONS 2000000
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void report(const char *name, double elapsed_ns)
+{
+    printf("%-28s %10.1f ns/op %8.2f allocs/op\n", name, elapsed_ns / BENCH_ITERATIONS, 0.0);
+}
+
+static esp_err_t write_hex(const uint8_t *chunk, size_t len, void *ctx)
+{
+    FILE *out = ctx;
+    fputs("TRACE ", out);
+    for (size_t i = 0; i < len; i++) {
+        fprintf(out, "%02x", chunk[i]);
+    }
+    fputc('\n', out);
+    return ESP_OK;
+}
+
+int main(int argc, char **argv)
+{
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        event_trace_record(TRACE_MQTT_RX, 1000, 0, i);
+    }
+    report("ring insert", now_ns() - t0);
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        event_trace_instant(TRACE_MQTT_RX, i);
+    }
+    report("instant event", now_ns() - t0);
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        uint32_t start = event_trace_begin();
+        event_trace_end(TRACE_SENSOR_READ, start, i);
+    }
+    report("span (begin + end)", now_ns() - t0);
+
+    if (argc > 1) {
+        // A short command-to-relay sequence to look at in the trace viewer
+        for (uint32_t i = 0; i < 20; i++) {
+            uint32_t start = event_trace_begin();
+            event_trace_instant(TRACE_MQTT_RX, 40);
+            event_trace_instant(TRACE_CMD_SUBMIT, 1);
+            uint32_t write = event_trace_begin();
+            event_trace_end(TRACE_RELAY_WRITE, write, 0);
+            event_trace_end(TRACE_ACTUATOR_BATCH, start, i & 3);
+            event_trace_end(TRACE_MQTT_DISPATCH, start, 40);
+        }
+        FILE *out = fopen(argv[1], "w");
+        if (out == NULL || event_trace_dump(write_hex, out) != ESP_OK) {
+            fprintf(stderr, "failed to write %s\n", argv[1]);
+            return 1;
+        }
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,373 @@
+#include "bench_harness.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "json_scan.h"
+
+/* Timed runs per benchmark; the fastest one is reported */
+#define BENCH_RUNS                  25
+/* Extra measurements of a case that looks regressed, before it is flagged */
+#define BENCH_RECHECKS              3
+#define BENCH_DEFAULT_MIN_TIME_MS   250
+#define BENCH_DEFAULT_THRESHOLD_PCT 15.0
+/* Slack on allocs/op before an increase counts, for rounding in the baseline file */
+#define BENCH_ALLOC_SLACK           0.005
+#define BENCH_BASELINE_MAX          (64 * 1024)
+#define BENCH_MAX_CASES             64
+
+typedef struct {
+    const bench_case_t *c;
+    const char *name;
+    double ns_per_op;
+    double rel;                 /* ns_per_op in multiples of the calibration loop */
+    double allocs_per_op;
+    uint64_t iterations;
+    bool has_baseline;
+    double baseline_rel;
+    double baseline_allocs;
+    bool regressed;
+} bench_result_t;
+
+static volatile uint64_t sink;
+/* ns/op of the calibration loop in this process, for display; cases are compared by rel */
+static double calibration_ns;
+static bool counting;
+static uint64_t allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+    allocations += counting;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    allocations += counting;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocations += counting;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    __real_free(ptr);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static double timed_run(bench_fn_t fn, uint64_t iterations)
+{
+    counting = true;
+    double start = now_ns();
+    sink += fn(iterations);
+    double elapsed = now_ns() - start;
+    counting = false;
+    return elapsed;
+}
+
+/* Iterations for one timed run of about run_ns */
+static uint64_t run_length(bench_fn_t fn, double run_ns)
+{
+    uint64_t n = 1;
+    double elapsed;
+
+    // Grow the count until a run is long enough to scale from, then aim at run_ns
+    while ((elapsed = timed_run(fn, n)) < 1e6 && n < (UINT64_C(1) << 40)) {
+        n *= 10;
+    }
+    return (uint64_t)fmax(1.0, (double)n * run_ns / elapsed);
+}
+
+/*
+ * Fixed work in the style of the cases (a byte loop with data-dependent
+ * branches over a short text, no calls into libc), so that a faster or
+ * slower machine moves it and the cases alike.
+ */
+static uint64_t calibration_loop(uint64_t iterations)
+{
+    static const char text[] = "{\"id\":\"a1\",\"devices\":[{\"name\":\"fan\",\"state\":\"on\"}],\"t\":1234}";
+    uint64_t acc = 0;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint32_t h = (uint32_t)i;
+        for (const char *p = text; *p != '\0'; p++) {
+            if (*p >= '0' && *p <= '9') {
+                h = h * 10 + (uint32_t)(*p - '0');
+            } else if (*p == '"' || *p == ':') {
+                h ^= h >> 7;
+            } else {
+                h = (h ^ (uint8_t)*p) * 16777619u;
+            }
+        }
+        acc += h;
+    }
+    return acc;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * BENCH_RUNS runs of the case, each followed by a run of the calibration
+ * loop, so that both see the same load and clock speed. ns_per_op is the
+ * best run; rel is the median ratio of a run to its calibration run, and is
+ * what baselines compare, so a baseline carries over to a faster or slower
+ * machine.
+ */
+static void measure(const bench_case_t *c, double min_time_ns, bench_result_t *r)
+{
+    double run_ns = min_time_ns / BENCH_RUNS;
+    uint64_t n = run_length(c->fn, run_ns);
+    uint64_t cal_n = run_length(calibration_loop, run_ns / 2);
+
+    allocations = 0;
+    double best = INFINITY, cal_best = INFINITY, ratios[BENCH_RUNS];
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        double t = timed_run(c->fn, n);
+        uint64_t allocs = allocations;
+        double cal = timed_run(calibration_loop, cal_n);
+        allocations = allocs;
+        ratios[i] = (t / (double)n) / (cal / (double)cal_n);
+        best = fmin(best, t);
+        cal_best = fmin(cal_best, cal);
+    }
+    qsort(ratios, BENCH_RUNS, sizeof(ratios[0]), compare_doubles);
+    double cal_ns = cal_best / (double)cal_n;
+    r->c = c;
+    r->name = c->name;
+    r->iterations = n;
+    r->ns_per_op = best / (double)n;
+    r->rel = ratios[BENCH_RUNS / 2];
+    r->allocs_per_op = (double)allocations / ((double)n * BENCH_RUNS);
+    calibration_ns = fmin(calibration_ns, cal_ns);
+}
+
+static char *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    char *buf = malloc(BENCH_BASELINE_MAX);
+    *len = buf != NULL ? fread(buf, 1, BENCH_BASELINE_MAX, f) : 0;
+    fclose(f);
+    return buf;
+}
+
+/*
+ * Attaches the baseline figures to the matching results; non-zero if the
+ * file cannot be read. Cases without a "rel" figure (files from before the
+ * calibration) count as having no baseline.
+ */
+static int load_baseline(const char *path, bench_result_t *results, size_t count)
+{
+    size_t len;
+    char *buf = read_file(path, &len);
+    json_scan_t top, list, item;
+    json_tok_t key, val, entry;
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+
+    if (buf == NULL) {
+        fprintf(stderr, "cannot read baseline %s\n", path);
+        return 1;
+    }
+    if (json_scan_object(&top, buf, len) == ESP_OK) {
+        while (json_scan_next_member(&top, &key, &val) == ESP_OK) {
+            if (json_tok_equals(&key, "benchmarks") && val.type == JSON_TOK_ARRAY) {
+                err = json_scan_array(&list, val.ptr, val.len);
+                break;
+            }
+        }
+    }
+    while (err == ESP_OK && (err = json_scan_next_element(&list, &entry)) == ESP_OK) {
+        json_tok_t name = { 0 };
+        double r = NAN, allocs = 0.0;
+        if (entry.type != JSON_TOK_OBJECT || json_scan_object(&item, entry.ptr, entry.len) != ESP_OK) {
+            err = ESP_ERR_INVALID_ARG;
+            break;
+        }
+        while (json_scan_next_member(&item, &key, &val) == ESP_OK) {
+            if (json_tok_equals(&key, "name") && val.type == JSON_TOK_STRING) {
+                name = val;
+            } else if (json_tok_equals(&key, "rel")) {
+                json_tok_to_double(&val, &r);
+            } else if (json_tok_equals(&key, "allocs_per_op")) {
+                json_tok_to_double(&val, &allocs);
+            }
+        }
+        for (size_t i = 0; i < count && name.ptr != NULL && !isnan(r) && r > 0; i++) {
+            if (strlen(results[i].name) == name.len && memcmp(results[i].name, name.ptr, name.len) == 0) {
+                results[i].has_baseline = true;
+                results[i].baseline_rel = r;
+                results[i].baseline_allocs = allocs;
+            }
+        }
+    }
+    free(buf);
+    if (err != ESP_ERR_NOT_FOUND) {
+        fprintf(stderr, "%s is not a benchmark baseline\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+static bool is_regressed(const bench_result_t *r, double threshold_pct)
+{
+    return r->has_baseline && (r->rel > r->baseline_rel * (1.0 + threshold_pct / 100.0) ||
+                               r->allocs_per_op > r->baseline_allocs + BENCH_ALLOC_SLACK);
+}
+
+static double delta_pct(const bench_result_t *r)
+{
+    return (r->rel / r->baseline_rel - 1.0) * 100.0;
+}
+
+/* Names are plain ASCII identifiers, so they need no escaping */
+static void write_json(FILE *out, const bench_result_t *results, size_t count, bool with_baseline)
+{
+    fprintf(out, "{\n  \"calibration_ns_per_op\": %.2f,\n  \"benchmarks\": [\n", calibration_ns);
+    for (size_t i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %.2f, \"rel\": %.4f, \"allocs_per_op\": %.2f, "
+                "\"iterations\": %llu",
+                r->name, r->ns_per_op, r->rel, r->allocs_per_op, (unsigned long long)r->iterations);
+        if (with_baseline && r->has_baseline) {
+            fprintf(out, ", \"baseline_rel\": %.4f, \"baseline_allocs_per_op\": %.2f, "
+                    "\"delta_pct\": %.1f, \"regressed\": %s",
+                    r->baseline_rel, r->baseline_allocs, delta_pct(r), r->regressed ? "true" : "false");
+        }
+        fprintf(out, "}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static void write_table(const bench_result_t *results, size_t count, bool with_baseline)
+{
+    printf("%-32s %10.1f ns/op\n", "(calibration)", calibration_ns);
+    for (size_t i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        printf("%-32s %10.1f ns/op %9.3fx %8.2f allocs/op", r->name, r->ns_per_op, r->rel, r->allocs_per_op);
+        if (with_baseline) {
+            if (r->has_baseline) {
+                printf("   %+6.1f%% vs %.3fx calibration%s", delta_pct(r), r->baseline_rel,
+                       r->regressed ? "   REGRESSED" : "");
+            } else {
+                printf("   (no baseline)");
+            }
+        }
+        printf("\n");
+    }
+}
+
+static int usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [--json] [--filter TEXT] [--min-time MS] [--save FILE]\n"
+                    "          [--check FILE [--threshold PCT]]\n", prog);
+    return 2;
+}
+
+int bench_main(int argc, char **argv, const bench_case_t *cases, size_t count)
+{
+    static bench_result_t results[BENCH_MAX_CASES];
+    const char *filter = NULL, *save_path = NULL, *check_path = NULL;
+    double min_time_ms = BENCH_DEFAULT_MIN_TIME_MS, threshold = BENCH_DEFAULT_THRESHOLD_PCT;
+    bool json = false;
+    size_t ran = 0;
+    int regressions = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+            continue;
+        }
+        if (value == NULL) {
+            return usage(argv[0]);
+        }
+        i++;
+        if (strcmp(argv[i - 1], "--filter") == 0) {
+            filter = value;
+        } else if (strcmp(argv[i - 1], "--min-time") == 0) {
+            min_time_ms = atof(value);
+        } else if (strcmp(argv[i - 1], "--save") == 0) {
+            save_path = value;
+        } else if (strcmp(argv[i - 1], "--check") == 0) {
+            check_path = value;
+        } else if (strcmp(argv[i - 1], "--threshold") == 0) {
+            threshold = atof(value);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (min_time_ms <= 0 || threshold < 0 || count > BENCH_MAX_CASES) {
+        return usage(argv[0]);
+    }
+
+    calibration_ns = INFINITY;
+    for (size_t i = 0; i < count; i++) {
+        if (filter == NULL || strstr(cases[i].name, filter) != NULL) {
+            measure(&cases[i], min_time_ms * 1e6, &results[ran++]);
+        }
+    }
+
+    if (check_path != NULL) {
+        if (load_baseline(check_path, results, ran) != 0) {
+            return 2;
+        }
+        for (size_t i = 0; i < ran; i++) {
+            bench_result_t *r = &results[i];
+            // Interference only ever slows a run down, so keep the best of the rechecks
+            for (int k = 0; k < BENCH_RECHECKS && is_regressed(r, threshold); k++) {
+                bench_result_t again;
+                measure(r->c, min_time_ms * 1e6, &again);
+                r->ns_per_op = fmin(r->ns_per_op, again.ns_per_op);
+                r->rel = fmin(r->rel, again.rel);
+                r->allocs_per_op = again.allocs_per_op;
+            }
+            r->regressed = is_regressed(r, threshold);
+            regressions += r->regressed;
+        }
+    }
+
+    if (json) {
+        write_json(stdout, results, ran, check_path != NULL);
+    } else {
+        write_table(results, ran, check_path != NULL);
+    }
+    if (save_path != NULL) {
+        FILE *f = fopen(save_path, "w");
+        if (f == NULL) {
+            fprintf(stderr, "cannot write %s\n", save_path);
+            return 2;
+        }
+        write_json(f, results, ran, false);
+        fclose(f);
+    }
+    if (regressions > 0) {
+        fprintf(stderr, "%d benchmark(s) regressed by more than %.0f%% (or allocate more) against %s\n",
+                regressions, threshold, check_path);
+        return 1;
+    }
+    return 0;
+}
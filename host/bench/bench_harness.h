@@ -0,0 +1,40 @@
+/**
+ * @file bench_harness.h
+ * @brief Timing, allocation counting, machine-readable output and baseline
+ *        comparison for host benchmarks.
+ *
+ * A benchmark is a function that runs its operation a given number of times.
+ * The harness grows the count until a run takes long enough to time, keeps
+ * the best of several runs as ns/op and counts heap allocations made during
+ * the runs (the executable links with --wrap for malloc, calloc, realloc and
+ * free). Every run is paired with a run of a fixed calibration loop; the
+ * median ratio of the two ("rel") is what --check compares, so a baseline
+ * saved on one machine holds on another. Results print as a table, or as
+ * JSON with --json; the JSON is also the baseline format for --save and
+ * --check.
+ */
+
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Runs the operation iterations times; returns something derived from the results so the work is kept */
+typedef uint64_t (*bench_fn_t)(uint64_t iterations);
+
+typedef struct {
+    const char *name;           /* "group/case", unique; the key in baselines */
+    bench_fn_t fn;
+} bench_case_t;
+
+/**
+ * @brief Runs the benchmarks selected on the command line:
+ *        [--json] [--filter TEXT] [--min-time MS] [--save FILE]
+ *        [--check FILE [--threshold PCT]]
+ * @return Exit status: 0, 1 if --check found a regression, 2 on a usage or
+ *         file error.
+ */
+int bench_main(int argc, char **argv, const bench_case_t *cases, size_t count);
+
+#endif // BENCH_HARNESS_H
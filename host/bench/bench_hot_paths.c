@@ -0,0 +1,402 @@
+/**
+ * @file bench_hot_paths.c
+ * @brief Host benchmark suite: the pure-compute steps on the firmware's
+ *        per-sample and per-message paths.
+ *
+ * - SHT3x CRC and raw -> physical conversion (sht3x_decoder)
+ * - DHT11 pulse train -> frame -> values (dht_decoder)
+ * - command parsing, as app_controller_send_command does it (command_parser)
+ * - the JSON encoders behind the publish_* functions of main.c, and the
+ *   writer sequence of publish_command_ack (telemetry_codec)
+ * - topic dispatch of on_mqtt_data_received over the firmware's routes
+ *
+ * Inputs are checked once before timing; the run stops with exit status 3
+ * if any step gives a wrong answer. Results can be compared against
+ * host/bench/baselines/bench_hot_paths.json (see bench_harness.h).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "bench_harness.h"
+#include "command_parser.h"
+#include "dht_decoder.h"
+#include "sht3x_decoder.h"
+#include "telemetry_codec.h"
+#include "topic_router.h"
+
+/* ---- SHT3x ---- */
+
+#define SHT3X_INPUTS    64
+
+static uint8_t sht3x_inputs[SHT3X_INPUTS][SHT3X_MEASUREMENT_LEN];
+
+static void sht3x_setup(void)
+{
+    for (int i = 0; i < SHT3X_INPUTS; i++) {
+        uint16_t raw_temp = (uint16_t)(0x6000 + i * 37);
+        uint16_t raw_hum = (uint16_t)(0x8000 + i * 91);
+        uint8_t *m = sht3x_inputs[i];
+        m[0] = raw_temp >> 8;
+        m[1] = raw_temp & 0xFF;
+        m[2] = sht3x_crc8(m, 2);
+        m[3] = raw_hum >> 8;
+        m[4] = raw_hum & 0xFF;
+        m[5] = sht3x_crc8(&m[3], 2);
+    }
+}
+
+static uint64_t bench_sht3x_crc8(uint64_t n)
+{
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        acc += sht3x_crc8(sht3x_inputs[i % SHT3X_INPUTS], 2);
+    }
+    return acc;
+}
+
+static uint64_t bench_sht3x_decode(uint64_t n)
+{
+    uint64_t acc = 0;
+    float temp, hum;
+    for (uint64_t i = 0; i < n; i++) {
+        acc += sht3x_decode(sht3x_inputs[i % SHT3X_INPUTS], &temp, &hum) == ESP_OK;
+    }
+    return acc + (uint64_t)temp;
+}
+
+/* ---- DHT11 ---- */
+
+/* Start release, sensor response, 40 bits and the final low, as the RMT captures them */
+#define DHT_PULSES  (2 + DHT_FRAME_BITS * 2 + 1)
+
+static const uint8_t dht_frame[DHT_FRAME_LEN] = { 55, 0, 24, 3, 55 + 24 + 3 };
+static dht_pulse_t dht_pulses[DHT_PULSES];
+
+static void dht_setup(void)
+{
+    size_t n = 0;
+    dht_pulses[n++] = (dht_pulse_t) { .level = 0, .duration_us = 80 };
+    dht_pulses[n++] = (dht_pulse_t) { .level = 1, .duration_us = 80 };
+    for (int bit = 0; bit < DHT_FRAME_BITS; bit++) {
+        bool one = (dht_frame[bit / 8] >> (7 - bit % 8)) & 1;
+        dht_pulses[n++] = (dht_pulse_t) { .level = 0, .duration_us = 50 };
+        dht_pulses[n++] = (dht_pulse_t) { .level = 1, .duration_us = one ? 70 : 27 };
+    }
+    dht_pulses[n++] = (dht_pulse_t) { .level = 0, .duration_us = 50 };
+}
+
+static uint64_t bench_dht_decode_pulses(uint64_t n)
+{
+    uint64_t acc = 0;
+    uint8_t frame[DHT_FRAME_LEN];
+    for (uint64_t i = 0; i < n; i++) {
+        acc += dht_decode_pulses(dht_pulses, DHT_PULSES, frame) == ESP_OK;
+        acc += frame[2];
+    }
+    return acc;
+}
+
+static uint64_t bench_dht_frame_to_values(uint64_t n)
+{
+    uint64_t acc = 0;
+    float temp, hum;
+    for (uint64_t i = 0; i < n; i++) {
+        dht_frame_to_values(dht_frame, DHT_TYPE_DHT11, &temp, &hum);
+        acc += (uint64_t)hum;
+    }
+    return acc;
+}
+
+/* ---- command parsing ---- */
+
+/* Same matching as actuator_manager_find, over the default actuators */
+static int lookup(const char *name, size_t len)
+{
+    static const char *const devices[] = { "humidifier", "fan" };
+    for (int i = 0; i < 2; i++) {
+        if (strlen(devices[i]) == len && strncasecmp(devices[i], name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static const char command_single[] =
+    "{\"type\": \"fan\", \"state\": \"on\", \"id\": \"9d92598d9d5a\", \"ts\": 1712345678123}";
+static const char command_batch[] =
+    "{\"id\": \"c0ffee-0001\", \"ts\": 1712345678123, \"commands\": ["
+    "{\"device\": \"fan\", \"state\": \"on\"}, {\"device\": \"humidifier\", \"state\": \"off\"}, "
+    "{\"device\": \"fan\", \"state\": \"toggle\"}, {\"device\": \"humidifier\", \"state\": true}]}";
+
+static uint64_t bench_command(const char *payload, uint64_t n)
+{
+    uint64_t acc = 0;
+    size_t len = strlen(payload);
+    for (uint64_t i = 0; i < n; i++) {
+        command_batch_t batch;
+        acc += command_parse(payload, len, lookup, &batch) == ESP_OK ? batch.count : 0;
+    }
+    return acc;
+}
+
+static uint64_t bench_command_single(uint64_t n)
+{
+    return bench_command(command_single, n);
+}
+
+static uint64_t bench_command_batch(uint64_t n)
+{
+    return bench_command(command_batch, n);
+}
+
+/* ---- publish_* encoders ---- */
+
+#define BATCH_SAMPLES   10
+
+static telemetry_sample_t batch_samples[BATCH_SAMPLES];
+static const telemetry_rollup_t rollup = {
+    .start_ms = 120000, .window_ms = 60000, .count = 30,
+    .temperature = { .min = 23.46f, .max = 24.1f, .mean = 23.8f, .variance = 0.0123f },
+    .humidity = { .min = 55.2f, .max = 57.9f, .mean = 56.41f, .variance = 0.4821f },
+};
+static const telemetry_device_state_t device_states[] = { { "humidifier", false }, { "fan", true } };
+
+static void publish_setup(void)
+{
+    for (int i = 0; i < BATCH_SAMPLES; i++) {
+        batch_samples[i] = (telemetry_sample_t) {
+            .timestamp_ms = 100250 + (uint64_t)i * 2000,
+            .temperature = 23.5f + (float)i * 0.07f,
+            .humidity = 56.0f + (float)i * 0.13f,
+        };
+    }
+}
+
+static uint64_t bench_publish_sensor(uint64_t n)
+{
+    char buf[TELEMETRY_JSON_MAX_LEN];
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        size_t len = 0;
+        telemetry_encode_sensor_json(buf, sizeof(buf), 23.5f + (float)(i & 15) * 0.01f, 56.25f,
+                                     (uint32_t)i, &len);
+        acc += len;
+    }
+    return acc;
+}
+
+static uint64_t bench_publish_batch(uint64_t n)
+{
+    char buf[BATCH_SAMPLES * TELEMETRY_JSON_SAMPLE_MAX_LEN + 64];
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        size_t len = 0;
+        telemetry_encode_sensor_batch_json(buf, sizeof(buf), batch_samples, BATCH_SAMPLES, 120500 + i, 7, &len);
+        acc += len;
+    }
+    return acc;
+}
+
+static uint64_t bench_publish_rollup(uint64_t n)
+{
+    char buf[TELEMETRY_JSON_ROLLUP_MAX_LEN];
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        size_t len = 0;
+        telemetry_encode_rollup_json(buf, sizeof(buf), &rollup, 185500 + i, 7, &len);
+        acc += len;
+    }
+    return acc;
+}
+
+static uint64_t bench_publish_device_states(uint64_t n)
+{
+    char buf[2 * TELEMETRY_JSON_DEVICE_ITEM_MAX_LEN + 48];
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        size_t len = 0;
+        telemetry_encode_device_states_json(buf, sizeof(buf), device_states, 2, (uint32_t)i, &len);
+        acc += len;
+    }
+    return acc;
+}
+
+static uint64_t bench_publish_health(uint64_t n)
+{
+    char buf[TELEMETRY_JSON_MAX_LEN];
+    telemetry_health_t health = {
+        .free_heap = 181234, .wifi_rssi = -65, .backlog = 0, .first_sample_ms = 35, .first_publish_ms = 20410,
+    };
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        size_t len = 0;
+        health.uptime_ms = (uint32_t)(i * 60000);
+        telemetry_encode_health_json(buf, sizeof(buf), &health, &len);
+        acc += len;
+    }
+    return acc;
+}
+
+/* The writer calls publish_command_ack makes for a one-device ack */
+static uint64_t bench_publish_command_ack(uint64_t n)
+{
+    char buf[192];
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        telemetry_json_writer_t w;
+        size_t len = 0;
+        telemetry_json_init(&w, buf, sizeof(buf));
+        telemetry_json_object_begin(&w);
+        telemetry_json_key(&w, "id");
+        telemetry_json_string(&w, "9d92598d9d5a");
+        telemetry_json_key(&w, "ts");
+        telemetry_json_number(&w, 1712345678123.0);
+        telemetry_json_key(&w, "status");
+        telemetry_json_string(&w, "ok");
+        telemetry_json_key(&w, "device_us");
+        telemetry_json_number(&w, (double)(850 + (i & 63)));
+        telemetry_json_key(&w, "devices");
+        telemetry_json_array_begin(&w);
+        telemetry_json_object_begin(&w);
+        telemetry_json_key(&w, "device");
+        telemetry_json_string(&w, "fan");
+        telemetry_json_key(&w, "state");
+        telemetry_json_string(&w, "on");
+        telemetry_json_object_end(&w);
+        telemetry_json_array_end(&w);
+        telemetry_json_object_end(&w);
+        telemetry_json_finish(&w, &len);
+        acc += len;
+    }
+    return acc;
+}
+
+/* ---- topic dispatch ---- */
+
+static topic_router_t router;
+static size_t routed;
+
+static void handler(const char *topic, size_t topic_len, const char *payload, size_t payload_len, void *ctx)
+{
+    routed += (size_t)ctx;
+}
+
+/* The routes app_main registers, for a node provisioned as room_07/node_a */
+static const char *const routes[] = {
+    "room_07/node_a/commands",
+    "all/commands",
+    "room_07/node_a/control/set",
+    "room_07/node_a/rules/set",
+    "room_07/node_a/trace/dump",
+    "room_07/node_a/log/level",
+    "all/log/level",
+    "room_07/node_a/identity/set",
+};
+#define ROUTE_COUNT (sizeof(routes) / sizeof(routes[0]))
+
+/* What arrives: mostly commands, now and then something else */
+static const char *const inbound[] = {
+    "room_07/node_a/commands",
+    "room_07/node_a/commands",
+    "all/commands",
+    "room_07/node_a/control/set",
+    "room_07/node_a/log/level",
+    "room_07/node_a/identity/set",
+    "room_07/node_b/commands",
+    "room_07/node_a/commands",
+};
+#define INBOUND_COUNT (sizeof(inbound) / sizeof(inbound[0]))
+static size_t inbound_len[INBOUND_COUNT];
+
+static int dispatch_setup(void)
+{
+    topic_router_init(&router);
+    for (size_t i = 0; i < ROUTE_COUNT; i++) {
+        if (topic_router_add(&router, routes[i], handler, (void *)(i + 1)) != ESP_OK) {
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < INBOUND_COUNT; i++) {
+        inbound_len[i] = strlen(inbound[i]);
+    }
+    return 0;
+}
+
+static uint64_t bench_dispatch(uint64_t n)
+{
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        size_t k = i % INBOUND_COUNT;
+        acc += topic_router_dispatch(&router, inbound[k], inbound_len[k], "{}", 2) == ESP_OK;
+    }
+    return acc + routed;
+}
+
+static const bench_case_t cases[] = {
+    { "sht3x/crc8", bench_sht3x_crc8 },
+    { "sht3x/decode", bench_sht3x_decode },
+    { "dht11/decode_pulses", bench_dht_decode_pulses },
+    { "dht11/frame_to_values", bench_dht_frame_to_values },
+    { "command/parse_single", bench_command_single },
+    { "command/parse_batch4", bench_command_batch },
+    { "publish/sensor_json", bench_publish_sensor },
+    { "publish/sensor_batch10_json", bench_publish_batch },
+    { "publish/rollup_json", bench_publish_rollup },
+    { "publish/device_states_json", bench_publish_device_states },
+    { "publish/health_json", bench_publish_health },
+    { "publish/command_ack_json", bench_publish_command_ack },
+    { "dispatch/firmware_routes", bench_dispatch },
+};
+
+/* Every input gives the expected answer, so the timings are of working code */
+static int check(void)
+{
+    int failures = 0;
+    float temp, hum;
+    uint8_t frame[DHT_FRAME_LEN];
+    command_batch_t batch;
+    /* Datasheet example: 0xBEEF has CRC 0x92 */
+    static const uint8_t beef[SHT3X_MEASUREMENT_LEN] = { 0xBE, 0xEF, 0x92, 0xBE, 0xEF, 0x92 };
+    uint8_t corrupt[SHT3X_MEASUREMENT_LEN];
+
+    failures += sht3x_decode(beef, &temp, &hum) != ESP_OK;
+    memcpy(corrupt, beef, sizeof(corrupt));
+    corrupt[4] ^= 1;
+    failures += sht3x_decode(corrupt, &temp, &hum) != ESP_ERR_INVALID_CRC;
+    failures += sht3x_decode(sht3x_inputs[0], &temp, &hum) != ESP_OK || temp < 20.0f || temp > 22.0f;
+
+    failures += dht_decode_pulses(dht_pulses, DHT_PULSES, frame) != ESP_OK ||
+                memcmp(frame, dht_frame, DHT_FRAME_LEN) != 0;
+    failures += dht_frame_to_values(frame, DHT_TYPE_DHT11, &temp, &hum) != ESP_OK ||
+                hum != 55.0f || temp < 24.29f || temp > 24.31f;
+
+    failures += command_parse(command_single, strlen(command_single), lookup, &batch) != ESP_OK ||
+                batch.count != 1 || batch.cmds[0].device != 1 || strcmp(batch.ref.id, "9d92598d9d5a") != 0;
+    failures += command_parse(command_batch, strlen(command_batch), lookup, &batch) != ESP_OK ||
+                batch.count != 4 || batch.cmds[2].action != RELAY_CMD_TOGGLE;
+
+    routed = 0;
+    for (size_t i = 0; i < INBOUND_COUNT; i++) {
+        topic_router_dispatch(&router, inbound[i], inbound_len[i], "{}", 2);
+    }
+    /* Route numbers: commands (1) three times, all/commands, control/set, log/level, identity/set; node_b is not ours */
+    failures += routed != 3 * 1 + 2 + 3 + 6 + 8;
+    routed = 0;
+
+    if (failures != 0) {
+        fprintf(stderr, "%d check(s) failed, not benchmarking\n", failures);
+    }
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    sht3x_setup();
+    dht_setup();
+    publish_setup();
+    if (dispatch_setup() != 0 || check() != 0) {
+        return 3;
+    }
+    return bench_main(argc, argv, cases, sizeof(cases) / sizeof(cases[0]));
+}
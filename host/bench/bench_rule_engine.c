@@ -0,0 +1,98 @@
+/**
+ * @file bench_rule_engine.c
+ * @brief Host benchmark: rule compilation and per-sample evaluation cost.
+ *
+ * Evaluates a typical two-rule program and a worst-case program (every rule
+ * slot filled with a maximum-length condition), which bounds the time the
+ * sensor task can spend on rules per sample.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "rule_program.h"
+
+#define BENCH_ITERATIONS 200000
+
+static volatile size_t sink;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int lookup(const char *name, size_t len)
+{
+    static const char *const devices[] = { "humidifier", "fan" };
+    for (int i = 0; i < 2; i++) {
+        if (strlen(devices[i]) == len && strncasecmp(devices[i], name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void report(const char *name, double elapsed_ns)
+{
+    printf("%-28s %10.1f ns/op %8.2f allocs/op\n", name, elapsed_ns / BENCH_ITERATIONS, 0.0);
+}
+
+static void bench_eval(const char *name, const rule_program_t *program)
+{
+    rule_state_t state = {0};
+    double t0 = now_ns();
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        command_batch_t batch = { .count = 0 };
+        const float vars[RULE_VAR_COUNT] = {
+            [RULE_VAR_TEMPERATURE] = 20.0f + (float)(i % 150) * 0.1f,
+            [RULE_VAR_HUMIDITY] = 30.0f + (float)(i % 400) * 0.1f,
+        };
+        rule_eval(program, &state, vars, (uint64_t)i * 2000, &batch);
+        sink += batch.count;
+    }
+    report(name, now_ns() - t0);
+}
+
+int main(void)
+{
+    static const char typical[] =
+        "{\"rules\":["
+        "{\"if\":\"humidity < 40 and temperature > 26\",\"then\":{\"device\":\"humidifier\",\"state\":\"on\"},\"for_s\":600},"
+        "{\"if\":\"temp > 30\",\"then\":{\"device\":\"fan\",\"state\":\"on\"}}]}";
+    /* RULE_MAX_CODE instructions: 8 comparisons, 8 operators */
+    static const char worst_rule[] =
+        "{\"if\":\"(hum < 40 and temp > 26) or (hum > 70 and not temp < 18) or "
+        "(temp >= 31 and hum <= 35) or (hum > 90 and temp > 10)\","
+        "\"then\":{\"device\":\"fan\",\"state\":\"on\"},\"for_s\":60}";
+    char worst[RULE_MAX_RULES * sizeof(worst_rule) + 16];
+    static rule_program_t program;
+    size_t pos = 0;
+
+    pos += (size_t)snprintf(worst + pos, sizeof(worst) - pos, "{\"rules\":[");
+    for (int i = 0; i < RULE_MAX_RULES; i++) {
+        pos += (size_t)snprintf(worst + pos, sizeof(worst) - pos, "%s%s", i ? "," : "", worst_rule);
+    }
+    snprintf(worst + pos, sizeof(worst) - pos, "]}");
+
+    double t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        if (rule_compile(typical, sizeof(typical) - 1, lookup, &program, NULL) != ESP_OK) {
+            fprintf(stderr, "typical program does not compile\n");
+            return 1;
+        }
+    }
+    report("compile 2 rules", now_ns() - t0);
+    bench_eval("eval 2 rules", &program);
+
+    if (rule_compile(worst, strlen(worst), lookup, &program, NULL) != ESP_OK) {
+        fprintf(stderr, "worst-case program does not compile\n");
+        return 1;
+    }
+    printf("worst case: %u rules x %u instructions\n", program.count, program.rules[0].code_len);
+    bench_eval("eval worst case", &program);
+    return 0;
+}
@@ -0,0 +1,222 @@
+/**
+ * @file bench_telemetry_codec.c
+ * @brief Host benchmark: streaming telemetry encoder vs the cJSON tree path.
+ *
+ * When cJSON is available the benchmark also checks that both paths produce
+ * byte-identical payloads and exits non-zero if they do not.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "telemetry_codec.h"
+
+#ifdef BENCH_HAVE_CJSON
+#include "cJSON.h"
+#endif
+
+#define BENCH_ITERATIONS 200000
+
+static volatile size_t sink;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Deterministic spread of values similar to what the SHT3x reports */
+static float sample_temp(int i)
+{
+    return -45.0f + 175.0f * (float)(((unsigned)i * 7919u) % 65536u) / 65535.0f;
+}
+
+static float sample_hum(int i)
+{
+    return 100.0f * (float)(((unsigned)i * 104729u) % 65536u) / 65535.0f;
+}
+
+#ifdef BENCH_HAVE_CJSON
+static size_t cjson_allocs;
+
+static void *counting_malloc(size_t sz)
+{
+    cjson_allocs++;
+    return malloc(sz);
+}
+
+static char *cjson_sensor(float temp, float hum, uint32_t ts)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "temperature", temp);
+    cJSON_AddNumberToObject(root, "humidity", hum);
+    cJSON_AddNumberToObject(root, "timestamp", (double)ts);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static char *cjson_device(const char *device, const char *state, uint32_t ts)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "device", device);
+    cJSON_AddStringToObject(root, "state", state);
+    cJSON_AddNumberToObject(root, "timestamp", (double)ts);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static char *cjson_health(const telemetry_health_t *h)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "uptime_ms", h->uptime_ms);
+    cJSON_AddNumberToObject(root, "free_heap", h->free_heap);
+    cJSON_AddNumberToObject(root, "wifi_rssi", h->wifi_rssi);
+    cJSON_AddNumberToObject(root, "backlog", h->backlog);
+    cJSON_AddNumberToObject(root, "first_sample_ms", h->first_sample_ms);
+    cJSON_AddNumberToObject(root, "first_publish_ms", h->first_publish_ms);
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static int verify_identical(void)
+{
+    char buf[TELEMETRY_JSON_MAX_LEN];
+    int mismatches = 0;
+
+    for (int i = 0; i < 65536; i++) {
+        uint32_t ts = (uint32_t)i * 2654435761u;
+        char *ref = cjson_sensor(sample_temp(i), sample_hum(i), ts);
+        telemetry_encode_sensor_json(buf, sizeof(buf), sample_temp(i), sample_hum(i), ts, NULL);
+        if (strcmp(ref, buf) != 0 && mismatches++ < 5) {
+            fprintf(stderr, "sensor mismatch:\n  cjson: %s\n  codec: %s\n", ref, buf);
+        }
+        free(ref);
+
+        telemetry_health_t health = {
+            .uptime_ms = ts, .free_heap = (size_t)i * 13, .wifi_rssi = (int8_t)(i & 0xFF),
+            .backlog = (uint32_t)i, .first_sample_ms = ts >> 8, .first_publish_ms = ts >> 4,
+        };
+        ref = cjson_health(&health);
+        telemetry_encode_health_json(buf, sizeof(buf), &health, NULL);
+        if (strcmp(ref, buf) != 0 && mismatches++ < 5) {
+            fprintf(stderr, "health mismatch:\n  cjson: %s\n  codec: %s\n", ref, buf);
+        }
+        free(ref);
+    }
+
+    const char *odd = "a\"b\\c\n\x01\xc3\xa9";
+    char *ref = cjson_device(odd, "on", 42);
+    telemetry_encode_device_status_json(buf, sizeof(buf), odd, "on", 42, NULL);
+    if (strcmp(ref, buf) != 0 && mismatches++ < 5) {
+        fprintf(stderr, "device mismatch:\n  cjson: %s\n  codec: %s\n", ref, buf);
+    }
+    free(ref);
+
+    return mismatches;
+}
+#endif
+
+static void report(const char *name, double elapsed_ns, double allocs)
+{
+    printf("%-28s %10.1f ns/op %8.2f allocs/op\n", name,
+           elapsed_ns / BENCH_ITERATIONS, allocs / BENCH_ITERATIONS);
+}
+
+int main(void)
+{
+    char buf[TELEMETRY_JSON_MAX_LEN];
+    double t0;
+
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        size_t len = 0;
+        telemetry_encode_sensor_json(buf, sizeof(buf), sample_temp(i), sample_hum(i), (uint32_t)i, &len);
+        sink += len;
+    }
+    report("codec sensor", now_ns() - t0, 0);
+
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        size_t len = 0;
+        telemetry_encode_device_status_json(buf, sizeof(buf), "humidifier", (i & 1) ? "on" : "off",
+                                            (uint32_t)i, &len);
+        sink += len;
+    }
+    report("codec device_status", now_ns() - t0, 0);
+
+    telemetry_health_t health = {
+        .free_heap = 180000, .wifi_rssi = -60, .first_sample_ms = 2100, .first_publish_ms = 3400,
+    };
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        size_t len = 0;
+        health.uptime_ms = (uint32_t)i * 1000u;
+        telemetry_encode_health_json(buf, sizeof(buf), &health, &len);
+        sink += len;
+    }
+    report("codec health", now_ns() - t0, 0);
+
+    uint8_t bin[TELEMETRY_BIN_MAX_LEN];
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        size_t len = 0;
+        telemetry_encode_sensor_bin(bin, sizeof(bin), sample_temp(i), sample_hum(i), (uint32_t)i, &len);
+        sink += len;
+    }
+    report("codec sensor (binary)", now_ns() - t0, 0);
+
+    size_t json_len = 0, bin_len = 0;
+    telemetry_encode_sensor_json(buf, sizeof(buf), 25.3f, 61.27f, 86400, &json_len);
+    telemetry_encode_sensor_bin(bin, sizeof(bin), 25.3f, 61.27f, 86400, &bin_len);
+    printf("sensor payload size: json %zu bytes, binary %zu bytes (%.1fx)\n",
+           json_len, bin_len, (double)json_len / (double)bin_len);
+
+#ifdef BENCH_HAVE_CJSON
+    cJSON_Hooks hooks = { .malloc_fn = counting_malloc, .free_fn = free };
+    cJSON_InitHooks(&hooks);
+
+    cjson_allocs = 0;
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        char *out = cjson_sensor(sample_temp(i), sample_hum(i), (uint32_t)i);
+        sink += strlen(out);
+        free(out);
+    }
+    report("cjson sensor", now_ns() - t0, (double)cjson_allocs);
+
+    cjson_allocs = 0;
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        char *out = cjson_device("humidifier", (i & 1) ? "on" : "off", (uint32_t)i);
+        sink += strlen(out);
+        free(out);
+    }
+    report("cjson device_status", now_ns() - t0, (double)cjson_allocs);
+
+    cjson_allocs = 0;
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        health.uptime_ms = (uint32_t)i * 1000u;
+        char *out = cjson_health(&health);
+        sink += strlen(out);
+        free(out);
+    }
+    report("cjson health", now_ns() - t0, (double)cjson_allocs);
+
+    int mismatches = verify_identical();
+    if (mismatches != 0) {
+        fprintf(stderr, "%d payload mismatches between codec and cJSON\n", mismatches);
+        return 1;
+    }
+    printf("payloads byte-identical to cJSON\n");
+#else
+    printf("cJSON baseline skipped (set CJSON_DIR or IDF_PATH)\n");
+#endif
+
+    return 0;
+}
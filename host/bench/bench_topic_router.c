@@ -0,0 +1,191 @@
+/**
+ * @file bench_topic_router.c
+ * @brief Host benchmark: topic dispatch through the router vs the
+ *        strlen + strncmp chain it replaced.
+ *
+ * Routes the firmware's inbound topics under a two-level prefix and
+ * dispatches a mix of them, including broadcast and unrouted topics. Before
+ * timing, checks exact, '+' and '#' matching and their precedence, and exits
+ * non-zero if any topic reaches the wrong handler.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "topic_router.h"
+
+#define BENCH_ITERATIONS 1000000
+
+static volatile size_t sink;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void report(const char *name, double elapsed_ns, size_t ops)
+{
+    printf("%-28s %10.1f ns/op %8.2f allocs/op\n", name, elapsed_ns / (double)ops, 0.0);
+}
+
+static void handler(const char *topic, size_t topic_len, const char *payload, size_t payload_len, void *ctx)
+{
+    sink += (size_t)ctx;
+}
+
+static const char *const filter_names[] = {
+    "room_07/node_a/commands",
+    "all/commands",
+    "room_07/node_a/control/set",
+    "room_07/node_a/rules/set",
+    "room_07/node_a/trace/dump",
+    "room_07/node_a/log/level",
+    "all/log/level",
+    "room_07/node_a/identity/set",
+    /* room to grow: the firmware's routes fill the table up to here */
+    "room_07/node_a/ota/start",
+    "room_07/node_a/ota/abort",
+    "room_07/node_a/sensors/config",
+    "room_07/node_a/filter/set",
+    "room_07/node_a/rollup/set",
+    "room_07/node_a/relay/config",
+    "all/identity/query",
+    "all/time/sync",
+};
+#define FILTER_COUNT (sizeof(filter_names) / sizeof(filter_names[0]))
+/* Routes the firmware registers today */
+#define FIRMWARE_ROUTES 8
+
+/* Built at run time like the firmware's topics, so strlen() is not folded away */
+static char filters[FILTER_COUNT][64];
+static size_t filter_count;
+
+/* The dispatch it replaces: one strlen and strncmp per route, in order */
+static size_t dispatch_chain(const char *topic, size_t topic_len)
+{
+    for (size_t i = 0; i < filter_count; i++) {
+        if (topic_len == strlen(filters[i]) && strncmp(topic, filters[i], topic_len) == 0) {
+            handler(topic, topic_len, "", 0, (void *)(i + 1));
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static int check(const topic_router_t *router, const char *topic, size_t expected)
+{
+    size_t before = sink;
+    esp_err_t err = topic_router_dispatch(router, topic, strlen(topic), "", 0);
+    size_t got = err == ESP_OK ? sink - before : 0;
+
+    if (got != expected) {
+        fprintf(stderr, "%s: expected route %zu, got %zu\n", topic, expected, got);
+        return 1;
+    }
+    return 0;
+}
+
+static int check_matching(void)
+{
+    static topic_router_t router;
+    int failures = 0;
+
+    topic_router_init(&router);
+    topic_router_add(&router, "a/b/c", handler, (void *)1);
+    topic_router_add(&router, "a/+/c", handler, (void *)2);
+    topic_router_add(&router, "a/#", handler, (void *)3);
+    topic_router_add(&router, "+/x", handler, (void *)4);
+    topic_router_add(&router, "a/b/", handler, (void *)5);
+
+    failures += check(&router, "a/b/c", 1);
+    failures += check(&router, "a/z/c", 2);
+    failures += check(&router, "a/b/d", 3);
+    failures += check(&router, "a", 3);
+    failures += check(&router, "a/x", 3);       /* exact "a" is tried before "+", so "a/#" wins */
+    failures += check(&router, "q/x", 4);
+    failures += check(&router, "a/b/", 5);
+    failures += check(&router, "q/y", 0);
+    failures += check(&router, "$SYS/x", 0);
+    failures += check(&router, "a/b/c/d", 3);
+
+    failures += topic_router_add(&router, "a/b/c", handler, NULL) != ESP_ERR_INVALID_STATE;
+    failures += topic_router_add(&router, "a/#/c", handler, NULL) != ESP_ERR_INVALID_ARG;
+    failures += topic_router_add(&router, "a/b+", handler, NULL) != ESP_ERR_INVALID_ARG;
+    return failures;
+}
+
+static const char *const inbound[] = {
+    "room_07/node_a/commands",
+    "room_07/node_a/commands",
+    "all/commands",
+    "room_07/node_a/control/set",
+    "room_07/node_a/log/level",
+    "room_07/node_a/identity/set",
+    "room_07/node_b/commands",      /* not ours */
+};
+#define INBOUND_COUNT (sizeof(inbound) / sizeof(inbound[0]))
+static size_t inbound_len[INBOUND_COUNT];
+
+/* Routes the first count filters both ways and times the same inbound mix */
+static int bench_routes(size_t count)
+{
+    static topic_router_t router;
+    char name[48];
+    int failures = 0;
+
+    filter_count = count;
+    topic_router_init(&router);
+    for (size_t i = 0; i < count; i++) {
+        if (topic_router_add(&router, filters[i], handler, (void *)(i + 1)) != ESP_OK) {
+            fprintf(stderr, "failed to route %s\n", filters[i]);
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < INBOUND_COUNT; i++) {
+        size_t before = sink;
+        size_t expected = dispatch_chain(inbound[i], inbound_len[i]);
+        sink = before;
+        failures += check(&router, inbound[i], expected);
+    }
+    if (failures) {
+        return failures;
+    }
+
+    double t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        size_t k = (size_t)i % INBOUND_COUNT;
+        dispatch_chain(inbound[k], inbound_len[k]);
+    }
+    snprintf(name, sizeof(name), "strncmp chain, %zu routes", count);
+    report(name, now_ns() - t0, BENCH_ITERATIONS);
+
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        size_t k = (size_t)i % INBOUND_COUNT;
+        topic_router_dispatch(&router, inbound[k], inbound_len[k], "", 0);
+    }
+    snprintf(name, sizeof(name), "router, %zu routes", count);
+    report(name, now_ns() - t0, BENCH_ITERATIONS);
+    return 0;
+}
+
+int main(void)
+{
+    int failures = check_matching();
+
+    for (size_t i = 0; i < FILTER_COUNT; i++) {
+        snprintf(filters[i], sizeof(filters[i]), "%s", filter_names[i]);
+    }
+    for (size_t i = 0; i < INBOUND_COUNT; i++) {
+        inbound_len[i] = strlen(inbound[i]);
+    }
+    failures += bench_routes(FIRMWARE_ROUTES);
+    failures += bench_routes(FILTER_COUNT);
+    if (failures) {
+        fprintf(stderr, "%d routing checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
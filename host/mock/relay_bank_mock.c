@@ -0,0 +1,38 @@
+/**
+ * @file relay_bank_mock.c
+ * @brief Recording relay bank backend for host builds.
+ */
+
+#include "relay_bank_mock.h"
+#include <string.h>
+
+static esp_err_t mock_write(void *ctx, uint32_t levels)
+{
+    relay_bank_mock_t *mock = ctx;
+
+    if (mock->fail_with != ESP_OK) {
+        esp_err_t ret = mock->fail_with;
+        mock->fail_with = ESP_OK;
+        return ret;
+    }
+    mock->history[mock->writes % RELAY_BANK_MOCK_HISTORY] = levels;
+    mock->levels = levels;
+    mock->writes++;
+    return ESP_OK;
+}
+
+static esp_err_t mock_enable(void *ctx)
+{
+    relay_bank_mock_t *mock = ctx;
+    mock->enabled = true;
+    mock->writes_at_enable = mock->writes;
+    return ESP_OK;
+}
+
+void relay_bank_mock_init(relay_bank_mock_t *mock, relay_bank_backend_t *backend)
+{
+    memset(mock, 0, sizeof(*mock));
+    backend->write = mock_write;
+    backend->enable = mock_enable;
+    backend->ctx = mock;
+}
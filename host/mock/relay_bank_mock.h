@@ -0,0 +1,31 @@
+/**
+ * @file relay_bank_mock.h
+ * @brief Recording relay bank backend for host builds. Every frame the bank
+ *        writes is kept, so bank logic can be checked without hardware.
+ */
+
+#ifndef RELAY_BANK_MOCK_H
+#define RELAY_BANK_MOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "relay_bank.h"
+
+#define RELAY_BANK_MOCK_HISTORY     16
+
+typedef struct {
+    uint32_t writes;                            /* frames written so far */
+    uint32_t levels;                            /* last frame written */
+    uint32_t history[RELAY_BANK_MOCK_HISTORY];  /* frame n at history[n % HISTORY] */
+    bool enabled;                               /* enable hook has run */
+    uint32_t writes_at_enable;                  /* frames written when it ran */
+    esp_err_t fail_with;                        /* returned by the next write if not ESP_OK */
+} relay_bank_mock_t;
+
+/**
+ * @brief Resets the mock and fills in a backend that records into it.
+ */
+void relay_bank_mock_init(relay_bank_mock_t *mock, relay_bank_backend_t *backend);
+
+#endif // RELAY_BANK_MOCK_H
@@ -0,0 +1,28 @@
+/* Host stand-in for the ESP-IDF CPU helpers: the processor's free-running counter, core 0 */
+#ifndef HOST_SHIM_ESP_CPU_H
+#define HOST_SHIM_ESP_CPU_H
+
+#include <stdint.h>
+#include <time.h>
+
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return (uint32_t)ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+#endif
+}
+
+static inline int esp_cpu_get_core_id(void)
+{
+    return 0;
+}
+
+#endif // HOST_SHIM_ESP_CPU_H
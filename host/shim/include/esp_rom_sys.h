@@ -0,0 +1,34 @@
+/* Host stand-in for the ESP-IDF ROM helpers: rate of esp_cpu_get_cycle_count() in ticks per microsecond */
+#ifndef HOST_SHIM_ESP_ROM_SYS_H
+#define HOST_SHIM_ESP_ROM_SYS_H
+
+#include <stdint.h>
+#include <time.h>
+#include "esp_cpu.h"
+
+static inline uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    // The TSC rate is not exposed to user space; measure it against the monotonic clock once
+    static uint32_t ticks_per_us;
+    if (ticks_per_us == 0) {
+        struct timespec t0, t1, pause = { .tv_nsec = 20 * 1000 * 1000 };
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        uint32_t c0 = esp_cpu_get_cycle_count();
+        nanosleep(&pause, NULL);
+        uint32_t c1 = esp_cpu_get_cycle_count();
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double us = (double)(t1.tv_sec - t0.tv_sec) * 1e6 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e3;
+        ticks_per_us = (uint32_t)((double)(c1 - c0) / us + 0.5);
+    }
+    return ticks_per_us;
+#elif defined(__aarch64__)
+    uint64_t hz;
+    __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(hz));
+    return (uint32_t)(hz / 1000000u);
+#else
+    return 1000;
+#endif
+}
+
+#endif // HOST_SHIM_ESP_ROM_SYS_H
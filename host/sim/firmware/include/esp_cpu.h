@@ -0,0 +1,23 @@
+/**
+ * @file esp_cpu.h
+ * @brief The cycle counter runs on the virtual clock (src/sim_rtos.c), one
+ *        tick per microsecond, so traces line up with simulated time.
+ */
+
+#ifndef SIM_ESP_CPU_H
+#define SIM_ESP_CPU_H
+
+#include <stdint.h>
+#include "esp_timer.h"
+
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static inline int esp_cpu_get_core_id(void)
+{
+    return 0;
+}
+
+#endif // SIM_ESP_CPU_H
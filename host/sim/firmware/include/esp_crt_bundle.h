@@ -0,0 +1,13 @@
+/**
+ * @file esp_crt_bundle.h
+ * @brief The simulated MQTT transport is plain TCP; the bundle is not used.
+ */
+
+#ifndef SIM_ESP_CRT_BUNDLE_H
+#define SIM_ESP_CRT_BUNDLE_H
+
+#include "esp_err.h"
+
+esp_err_t esp_crt_bundle_attach(void *conf);
+
+#endif // SIM_ESP_CRT_BUNDLE_H
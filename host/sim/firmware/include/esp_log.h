@@ -0,0 +1,40 @@
+/**
+ * @file esp_log.h
+ * @brief ESP log API of the firmware simulation: lines go to stdout,
+ *        stamped with virtual milliseconds since boot. As on the device,
+ *        debug and verbose calls are compiled out.
+ */
+
+#ifndef SIM_ESP_LOG_H
+#define SIM_ESP_LOG_H
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+/* "*" sets every tag; a tag set later overrides it */
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+uint32_t esp_log_timestamp(void);
+
+#define SIM_LOG(level, letter, tag, format, ...) \
+    esp_log_write(level, tag, letter " (%lu) %s: " format "\n", (unsigned long)esp_log_timestamp(), tag, ##__VA_ARGS__)
+#define SIM_LOG_OFF(tag, format, ...) \
+    do { if (0) { SIM_LOG(ESP_LOG_NONE, "", tag, format, ##__VA_ARGS__); } } while (0)
+
+#define ESP_LOGE(tag, format, ...)  SIM_LOG(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)  SIM_LOG(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)  SIM_LOG(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)  SIM_LOG_OFF(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)  SIM_LOG_OFF(tag, format, ##__VA_ARGS__)
+
+#endif // SIM_ESP_LOG_H
@@ -0,0 +1,16 @@
+/**
+ * @file esp_rom_sys.h
+ * @brief Rate of the simulated cycle counter (see esp_cpu.h).
+ */
+
+#ifndef SIM_ESP_ROM_SYS_H
+#define SIM_ESP_ROM_SYS_H
+
+#include <stdint.h>
+
+static inline uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+    return 1;
+}
+
+#endif // SIM_ESP_ROM_SYS_H
@@ -0,0 +1,20 @@
+/**
+ * @file esp_system.h
+ * @brief Heap figures and restart of the firmware simulation.
+ */
+
+#ifndef SIM_ESP_SYSTEM_H
+#define SIM_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Simulated heap (src/sim_heap.c): firmware allocations, task stacks and
+ * queues are charged against SIM_HEAP_SIZE */
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+/* Keeps NVS and flash (with --state) and boots the firmware again */
+void esp_restart(void) __attribute__((noreturn));
+
+#endif // SIM_ESP_SYSTEM_H
@@ -0,0 +1,15 @@
+/**
+ * @file esp_timer.h
+ * @brief Virtual microseconds since boot (src/sim_rtos.c). While a task
+ *        runs the clock follows the host's real time; while every task is
+ *        blocked it jumps to the next wake-up.
+ */
+
+#ifndef SIM_ESP_TIMER_H
+#define SIM_ESP_TIMER_H
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
+
+#endif // SIM_ESP_TIMER_H
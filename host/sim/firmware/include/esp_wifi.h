@@ -0,0 +1,22 @@
+/**
+ * @file esp_wifi.h
+ * @brief The parts of the Wi-Fi API the firmware uses outside
+ *        service_wifi, which the simulation replaces (src/sim_wifi.c).
+ */
+
+#ifndef SIM_ESP_WIFI_H
+#define SIM_ESP_WIFI_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+typedef struct {
+    uint8_t ssid[33];
+    int8_t rssi;
+} wifi_ap_record_t;
+
+/* ESP_ERR_WIFI_NOT_CONNECT (as ESP_FAIL) while the simulated link is down */
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info);
+
+#endif // SIM_ESP_WIFI_H
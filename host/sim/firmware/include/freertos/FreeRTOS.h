@@ -0,0 +1,43 @@
+/**
+ * @file FreeRTOS.h
+ * @brief FreeRTOS API of the firmware simulation.
+ *
+ * Tasks are coroutines on one host thread, scheduled by priority on a
+ * virtual clock (src/sim_rtos.c): a task runs until it blocks, or until it
+ * wakes a task of higher priority, like on a single core. One tick is one
+ * millisecond. Nothing is ever interrupted, so critical sections are empty.
+ */
+
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdFAIL                  pdFALSE
+#define pdPASS                  pdTRUE
+
+#define configTICK_RATE_HZ      1000
+#define portTICK_PERIOD_MS      1
+#define portMAX_DELAY           ((TickType_t)0xffffffffu)
+#define portNUM_PROCESSORS      1
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+#define taskENTER_CRITICAL(mux)         ((void)(mux))
+#define taskEXIT_CRITICAL(mux)          ((void)(mux))
+
+#endif // SIM_FREERTOS_H
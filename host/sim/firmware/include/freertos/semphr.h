@@ -0,0 +1,22 @@
+/**
+ * @file semphr.h
+ * @brief Semaphores of the firmware simulation: queues of empty items, as
+ *        in FreeRTOS. Mutexes have no priority inheritance.
+ */
+
+#ifndef SIM_FREERTOS_SEMPHR_H
+#define SIM_FREERTOS_SEMPHR_H
+
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+QueueHandle_t sim_semaphore_create(UBaseType_t max_count, UBaseType_t initial_count);
+
+#define xSemaphoreCreateMutex()             sim_semaphore_create(1, 1)
+#define xSemaphoreCreateBinary()            sim_semaphore_create(1, 0)
+#define xSemaphoreTake(sem, ticks)          xQueueReceive((sem), NULL, (ticks))
+#define xSemaphoreGive(sem)                 xQueueSend((sem), NULL, 0)
+#define vSemaphoreDelete(sem)               vQueueDelete(sem)
+
+#endif // SIM_FREERTOS_SEMPHR_H
@@ -0,0 +1,14 @@
+/**
+ * @file nvs_flash.h
+ * @brief NVS partition setup of the firmware simulation.
+ */
+
+#ifndef SIM_NVS_FLASH_H
+#define SIM_NVS_FLASH_H
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif // SIM_NVS_FLASH_H
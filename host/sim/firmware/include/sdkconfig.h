@@ -0,0 +1,58 @@
+/**
+ * @file sdkconfig.h
+ * @brief Configuration of the firmware simulation: the defaults of
+ *        main/Kconfig.projbuild plus sdkconfig.defaults. Keep in step with
+ *        both; an option missing here fails the build.
+ */
+
+#ifndef SIM_SDKCONFIG_H
+#define SIM_SDKCONFIG_H
+
+/* WiFi / identity */
+#define CONFIG_WIFI_SSID                        "sim"
+#define CONFIG_WIFI_PASSWORD                    ""
+#define CONFIG_DEVICE_ROOM                      "room_01"
+#define CONFIG_DEVICE_NAME                      ""
+
+/* MQTT; the broker is overridden with --broker */
+#define CONFIG_MQTT_BROKER_URI                  "mqtt://127.0.0.1:1883"
+#define CONFIG_MQTT_BROKER_PORT                 1883
+#define CONFIG_MQTT_USERNAME                    ""
+#define CONFIG_MQTT_PASSWORD                    ""
+#define CONFIG_MQTT_REASSEMBLY_BUFFER_SIZE      1024
+#define CONFIG_MQTT_OUTBOX_BUDGET               16384
+
+/* Telemetry */
+#define CONFIG_TELEMETRY_FORMAT_JSON            1
+#define CONFIG_SHT3X_PERIOD_MS                  2000
+#define CONFIG_SENSOR_BATCH_SIZE                10
+#define CONFIG_SENSOR_BATCH_MAX_AGE_MS          20000
+#define CONFIG_SENSOR_MEDIAN_WINDOW_3           1
+#define CONFIG_SENSOR_MEDIAN_WINDOW             3
+#define CONFIG_SENSOR_EMA_ALPHA_PERCENT         30
+#define CONFIG_SENSOR_DEADBAND_TEMP_CENTI       10
+#define CONFIG_SENSOR_DEADBAND_HUM_CENTI        50
+#define CONFIG_SENSOR_HEARTBEAT_MS              300000
+#define CONFIG_SENSOR_ROLLUP_WINDOW_S           60
+#define CONFIG_SENSOR_PUBLISH_RAW               1
+
+/* Sensor and relays */
+#define CONFIG_SHT3X_REPEATABILITY_HIGH         1
+#define CONFIG_SHT3X_I2C_CLOCK_HZ               100000
+#define CONFIG_SHT3X_ADDRESS                    0x44
+#define CONFIG_I2C_MUX_ADDRESS                  0x0
+#define CONFIG_RELAY_BANK_GPIO                  1
+
+/* Offline log, health, diagnostics */
+#define CONFIG_SAMPLE_LOG_REPLAY_BATCH          16
+#define CONFIG_SAMPLE_LOG_REPLAY_INTERVAL_MS    1000
+#define CONFIG_HEALTH_CHECK_PERIOD_MS           60000
+#define CONFIG_EVENT_TRACE                      1
+#define CONFIG_EVENT_TRACE_RECORDS              512
+#define CONFIG_DEFERRED_LOG_RECORDS             64
+
+/* sdkconfig.defaults */
+#define CONFIG_FREERTOS_USE_TRACE_FACILITY      1
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS 1
+
+#endif // SIM_SDKCONFIG_H
@@ -0,0 +1,11 @@
+/* GPIO output set/clear registers of the simulated ESP32, decoded by REG_WRITE in soc/soc.h */
+#ifndef SIM_SOC_GPIO_REG_H
+#define SIM_SOC_GPIO_REG_H
+
+#define DR_REG_GPIO_BASE        0x3ff44000
+#define GPIO_OUT_W1TS_REG       (DR_REG_GPIO_BASE + 0x0008)
+#define GPIO_OUT_W1TC_REG       (DR_REG_GPIO_BASE + 0x000c)
+#define GPIO_OUT1_W1TS_REG      (DR_REG_GPIO_BASE + 0x0014)
+#define GPIO_OUT1_W1TC_REG      (DR_REG_GPIO_BASE + 0x0018)
+
+#endif // SIM_SOC_GPIO_REG_H
@@ -0,0 +1,11 @@
+/* Register access of the simulated ESP32: only the GPIO output registers exist */
+#ifndef SIM_SOC_SOC_H
+#define SIM_SOC_SOC_H
+
+#include <stdint.h>
+
+void sim_gpio_reg_write(uint32_t reg, uint32_t value);
+
+#define REG_WRITE(reg, value)   sim_gpio_reg_write((uint32_t)(reg), (uint32_t)(value))
+
+#endif // SIM_SOC_SOC_H
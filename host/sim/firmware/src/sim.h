@@ -0,0 +1,119 @@
+/**
+ * @file sim.h
+ * @brief Internals shared by the parts of the firmware simulation.
+ *
+ * The firmware sees only the ESP-IDF and FreeRTOS APIs in ../include; this
+ * is what the simulated hardware and the scheduler tell each other.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "telemetry_codec.h"
+
+#define SIM_MAX_OUTAGES     8
+
+typedef struct {
+    uint32_t at_s;                  /* virtual seconds since the first boot */
+    uint32_t for_s;
+} sim_outage_t;
+
+typedef struct {
+    const char *broker_uri;         /* NULL: no broker, MQTT never connects */
+    int64_t duration_us;            /* virtual time to run, over all boots */
+    const char *state_dir;          /* NULL: NVS and flash are not kept */
+    const char *report_path;        /* NULL: no JSON report */
+    uint32_t i2c_error_permille;    /* sensor reads NACKed on purpose */
+    uint32_t seed;
+    sim_outage_t outages[SIM_MAX_OUTAGES];
+    int outage_count;
+} sim_config_t;
+
+extern sim_config_t g_sim;
+
+/* Virtual time elapsed in earlier boots of this run (restarts via esp_restart()) */
+extern int64_t g_sim_boot_offset_us;
+extern uint32_t g_sim_boot_count;
+
+/* ---- scheduler (sim_rtos.c) ---- */
+
+/**
+ * @brief Runs the tasks until the virtual clock reaches end_us, then calls
+ *        sim_finish(). Never returns.
+ */
+void sim_rtos_run(int64_t end_us) __attribute__((noreturn));
+
+/**
+ * @brief Blocks the calling task for us of virtual time (bus transfers).
+ */
+void sim_sleep_us(int64_t us);
+
+/**
+ * @brief Blocks the calling task until fd is readable, the task is
+ *        notified (xTaskNotifyGive) or ticks pass. While every task waits,
+ *        the clock jumps ahead unless a reply is due: up to reply_due_real_us
+ *        (host monotonic time, 0 if nothing is due) the sockets are polled
+ *        in real time, so a local broker answers before virtual timeouts.
+ * @return true if fd is readable.
+ */
+bool sim_wait_fd(int fd, TickType_t ticks, int64_t reply_due_real_us);
+
+/* Host monotonic time in us */
+int64_t sim_real_us(void);
+
+/* Host CPU time used by the firmware tasks, and virtual time spent idle */
+void sim_rtos_cpu(uint64_t *busy_us, uint64_t *idle_us);
+
+/* ---- simulated heap (sim_heap.c) ---- */
+
+#define SIM_HEAP_SIZE   (256 * 1024)
+
+/* Charges kernel objects to the simulated heap; false if it is exhausted */
+bool sim_heap_charge(size_t size);
+void sim_heap_release(size_t size);
+void sim_heap_usage(size_t *used, size_t *peak);
+
+/* ---- peripherals ---- */
+
+/* Relay pins of main.c (CONFIG_HUMID_PIN, CONFIG_FAN_PIN) */
+#define SIM_HUMIDIFIER_PIN  16
+#define SIM_FAN_PIN         18
+
+int sim_gpio_level(int pin);
+uint32_t sim_gpio_toggles(int pin);
+
+/* Room the sensor sits in; the relays act on it (sim_room.c) */
+void sim_room_init(uint32_t seed);
+/* Integrates the room up to now_us under the current relay levels */
+void sim_room_advance(int64_t now_us);
+/* What the sensor measures now: the room plus noise and rare spikes */
+void sim_room_measure(int64_t now_us, float *temperature, float *humidity);
+void sim_room_write_json(telemetry_json_writer_t *w);
+
+/* Simulated Wi-Fi link (sim_wifi.c) */
+bool sim_wifi_link_up(void);
+
+/* Called by sim_wifi.c on every link change */
+void sim_mqtt_link_changed(void);
+void sim_mqtt_write_json(telemetry_json_writer_t *w);
+
+/* ---- persistence (sim_nvs.c, sim_flash.c) ---- */
+
+void sim_nvs_load(const char *dir);
+void sim_nvs_save(const char *dir);
+void sim_flash_load(const char *dir);
+void sim_flash_save(const char *dir);
+
+/* ---- run control (sim_main.c) ---- */
+
+/**
+ * @brief Ends the run: keeps the state, prints the summary, writes the report
+ *        and exits with status.
+ */
+void sim_finish(int status) __attribute__((noreturn));
+
+#endif // SIM_H
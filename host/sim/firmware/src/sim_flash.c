@@ -0,0 +1,110 @@
+/**
+ * @file sim_flash.c
+ * @brief The "samplelog" partition of partitions.csv as NOR flash in memory:
+ *        erasing sets 4 KB sectors to 0xFF and writing can only clear bits.
+ *        With --state the image is kept in <state>/samplelog.bin.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_partition.h"
+#include "sim.h"
+
+#define SAMPLELOG_SIZE      0x40000
+
+static const esp_partition_t s_samplelog = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = 0x40,
+    .address = 0x190000,
+    .size = SAMPLELOG_SIZE,
+    .erase_size = SPI_FLASH_SEC_SIZE,
+    .label = "samplelog",
+};
+
+static uint8_t s_image[SAMPLELOG_SIZE];
+static bool s_erased = false;
+
+static void erase_all_once(void)
+{
+    if (!s_erased) {
+        memset(s_image, 0xff, sizeof(s_image));
+        s_erased = true;
+    }
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    if (type != s_samplelog.type || (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != s_samplelog.subtype) ||
+        (label != NULL && strcmp(label, s_samplelog.label) != 0)) {
+        return NULL;
+    }
+    erase_all_once();
+    return &s_samplelog;
+}
+
+static bool in_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    return partition == &s_samplelog && offset <= SAMPLELOG_SIZE && size <= SAMPLELOG_SIZE - offset;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (!in_range(partition, src_offset, size) || dst == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(dst, &s_image[src_offset], size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    if (!in_range(partition, dst_offset, size) || src == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint8_t *bytes = src;
+    for (size_t i = 0; i < size; i++) {
+        s_image[dst_offset + i] &= bytes[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (!in_range(partition, offset, size) || offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(&s_image[offset], 0xff, size);
+    return ESP_OK;
+}
+
+void sim_flash_load(const char *dir)
+{
+    char path[512];
+
+    erase_all_once();
+    snprintf(path, sizeof(path), "%s/samplelog.bin", dir);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return;
+    }
+    if (fread(s_image, sizeof(s_image), 1, f) != 1) {
+        fprintf(stderr, "sim: %s is short, starting from erased flash\n", path);
+        memset(s_image, 0xff, sizeof(s_image));
+    }
+    fclose(f);
+}
+
+void sim_flash_save(const char *dir)
+{
+    char path[512];
+
+    snprintf(path, sizeof(path), "%s/samplelog.bin", dir);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL || fwrite(s_image, sizeof(s_image), 1, f) != 1) {
+        fprintf(stderr, "sim: cannot write %s\n", path);
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+}
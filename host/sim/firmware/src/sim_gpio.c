@@ -0,0 +1,82 @@
+/**
+ * @file sim_gpio.c
+ * @brief GPIO pins of the simulated ESP32. The relay pins drive the room
+ *        model, which is brought up to date before every change.
+ */
+
+#include "driver/gpio.h"
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
+#include "esp_timer.h"
+#include "sim.h"
+
+static uint64_t s_levels = 0;
+static uint32_t s_toggles[SOC_GPIO_PIN_COUNT];
+
+static void set_levels(uint64_t levels)
+{
+    uint64_t changed = levels ^ s_levels;
+
+    if (changed == 0) {
+        return;
+    }
+    sim_room_advance(esp_timer_get_time());
+    for (int pin = 0; pin < SOC_GPIO_PIN_COUNT; pin++) {
+        if (changed & (1ull << pin)) {
+            s_toggles[pin]++;
+        }
+    }
+    s_levels = levels;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    if (config == NULL || config->pin_bit_mask >> SOC_GPIO_PIN_COUNT != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!GPIO_IS_VALID_OUTPUT_GPIO(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    set_levels(level ? s_levels | (1ull << gpio_num) : s_levels & ~(1ull << gpio_num));
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return GPIO_IS_VALID_GPIO(gpio_num) ? (int)((s_levels >> gpio_num) & 1) : 0;
+}
+
+void sim_gpio_reg_write(uint32_t reg, uint32_t value)
+{
+    switch (reg) {
+        case GPIO_OUT_W1TS_REG:
+            set_levels(s_levels | value);
+            break;
+        case GPIO_OUT_W1TC_REG:
+            set_levels(s_levels & ~(uint64_t)value);
+            break;
+        case GPIO_OUT1_W1TS_REG:
+            set_levels(s_levels | ((uint64_t)value << 32));
+            break;
+        case GPIO_OUT1_W1TC_REG:
+            set_levels(s_levels & ~((uint64_t)value << 32));
+            break;
+        default:
+            break;
+    }
+}
+
+int sim_gpio_level(int pin)
+{
+    return gpio_get_level(pin);
+}
+
+uint32_t sim_gpio_toggles(int pin)
+{
+    return pin >= 0 && pin < SOC_GPIO_PIN_COUNT ? s_toggles[pin] : 0;
+}
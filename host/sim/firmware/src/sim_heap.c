@@ -0,0 +1,119 @@
+/**
+ * @file sim_heap.c
+ * @brief Simulated heap: the firmware's malloc/free (linked with
+ *        -Wl,--wrap) and task stacks are charged against SIM_HEAP_SIZE, so
+ *        free heap, its low-water mark and running out of memory behave as
+ *        on the device. The memory itself comes from the host allocator.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "sim.h"
+
+/* Keeps the size in front of each block; 16 bytes keeps malloc's alignment */
+typedef union {
+    size_t size;
+    max_align_t align;
+} block_header_t;
+
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+
+static size_t s_used = 0;
+static size_t s_peak = 0;
+
+bool sim_heap_charge(size_t size)
+{
+    if (size > SIM_HEAP_SIZE - s_used) {
+        return false;
+    }
+    s_used += size;
+    if (s_used > s_peak) {
+        s_peak = s_used;
+    }
+    return true;
+}
+
+void sim_heap_release(size_t size)
+{
+    s_used -= size;
+}
+
+void sim_heap_usage(size_t *used, size_t *peak)
+{
+    *used = s_used;
+    *peak = s_peak;
+}
+
+void *__wrap_malloc(size_t size)
+{
+    if (!sim_heap_charge(size)) {
+        return NULL;
+    }
+    block_header_t *block = __real_malloc(sizeof(*block) + size);
+    if (block == NULL) {
+        sim_heap_release(size);
+        return NULL;
+    }
+    block->size = size;
+    return block + 1;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    block_header_t *block = (block_header_t *)ptr - 1;
+    sim_heap_release(block->size);
+    __real_free(block);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ptr = __wrap_malloc(count * size);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    if (ptr == NULL) {
+        return __wrap_malloc(size);
+    }
+    size_t old = ((block_header_t *)ptr - 1)->size;
+    void *fresh = __wrap_malloc(size);
+    if (fresh != NULL) {
+        memcpy(fresh, ptr, old < size ? old : size);
+        __wrap_free(ptr);
+    }
+    return fresh;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return (uint32_t)(SIM_HEAP_SIZE - s_used);
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return (uint32_t)(SIM_HEAP_SIZE - s_peak);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return SIM_HEAP_SIZE - s_used;
+}
+
+/* No fragmentation model: the free heap is one block */
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return SIM_HEAP_SIZE - s_used;
+}
@@ -0,0 +1,245 @@
+/**
+ * @file sim_i2c.c
+ * @brief I2C master driver with an SHT3x and an optional TCA9548A on the bus.
+ *
+ * The SHT3x follows the datasheet's periodic mode: a periodic command
+ * starts measurements at its rate, Fetch Data (0xE000) followed by a read
+ * returns the latest one with CRCs, and the read is NACKed while no new
+ * measurement has completed. --i2c-errors NACKs that many reads per mille
+ * on top. Every transfer blocks the caller for 9 clocks per byte,
+ * address included.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "driver/i2c_master.h"
+#include "esp_timer.h"
+#include "sim.h"
+
+#define SIM_I2C_MAX_DEVICES     8
+/* Conversion time at high repeatability, datasheet table 4 */
+#define SHT3X_MEASURE_US        15500
+#define TCA9548A_ADDRESS_FIRST  0x70
+#define TCA9548A_ADDRESS_LAST   0x77
+
+#ifdef CONFIG_SHT3X_MUX_CHANNEL
+#define SIM_SHT3X_MUX_CHANNEL   CONFIG_SHT3X_MUX_CHANNEL
+#else
+#define SIM_SHT3X_MUX_CHANNEL   (-1)    /* main.c's default: straight on the bus */
+#endif
+
+struct sim_i2c_bus {
+    bool used;
+};
+
+struct sim_i2c_dev {
+    bool used;
+    uint16_t address;
+    uint32_t hz;
+};
+
+static struct sim_i2c_bus s_bus;
+static struct sim_i2c_dev s_devs[SIM_I2C_MAX_DEVICES];
+static uint8_t s_mux_channels = 0;
+
+static struct {
+    int64_t started_us;         /* periodic mode start, -1 when idle */
+    int64_t period_us;
+    int64_t fetched_index;      /* last measurement read out */
+    bool fetch_pending;
+} s_sht3x = { .started_us = -1 };
+
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xff;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void put_word(uint8_t *out, double raw)
+{
+    uint16_t word = (uint16_t)fmin(fmax(raw, 0.0), 65535.0);
+    out[0] = (uint8_t)(word >> 8);
+    out[1] = (uint8_t)word;
+    out[2] = crc8(out, 2);
+}
+
+static void wire_time(const struct sim_i2c_dev *dev, size_t bytes)
+{
+    sim_sleep_us((int64_t)(bytes + 1) * 9 * 1000000 / dev->hz);
+}
+
+static bool is_mux(const struct sim_i2c_dev *dev)
+{
+    return CONFIG_I2C_MUX_ADDRESS != 0 && dev->address == CONFIG_I2C_MUX_ADDRESS &&
+           dev->address >= TCA9548A_ADDRESS_FIRST && dev->address <= TCA9548A_ADDRESS_LAST;
+}
+
+static bool sht3x_reachable(const struct sim_i2c_dev *dev)
+{
+    if (dev->address != CONFIG_SHT3X_ADDRESS) {
+        return false;
+    }
+    if (CONFIG_I2C_MUX_ADDRESS == 0 || SIM_SHT3X_MUX_CHANNEL < 0) {
+        return true;
+    }
+    return (s_mux_channels >> (SIM_SHT3X_MUX_CHANNEL & 7)) & 1;
+}
+
+static int64_t sht3x_period_us(uint8_t rate_byte)
+{
+    switch (rate_byte) {
+        case 0x20: return 2000000;
+        case 0x21: return 1000000;
+        case 0x22: return 500000;
+        case 0x23: return 250000;
+        case 0x27: return 100000;
+        default:   return 0;
+    }
+}
+
+static esp_err_t sht3x_command(uint16_t cmd)
+{
+    int64_t period = sht3x_period_us(cmd >> 8);
+
+    if (period != 0) {
+        s_sht3x.started_us = esp_timer_get_time();
+        s_sht3x.period_us = period;
+        s_sht3x.fetched_index = -1;
+        s_sht3x.fetch_pending = false;
+    } else if (cmd == 0xE000) {
+        s_sht3x.fetch_pending = true;
+    } else if (cmd == 0x3093 || cmd == 0x30A2) {
+        // Break or soft reset: back to single shot mode
+        s_sht3x.started_us = -1;
+        s_sht3x.fetch_pending = false;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t sht3x_read(uint8_t *out, size_t len)
+{
+    bool fetch = s_sht3x.fetch_pending;
+    int64_t now = esp_timer_get_time();
+
+    s_sht3x.fetch_pending = false;
+    if (!fetch || s_sht3x.started_us < 0 || now < s_sht3x.started_us + SHT3X_MEASURE_US) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t index = (now - s_sht3x.started_us - SHT3X_MEASURE_US) / s_sht3x.period_us;
+    if (index == s_sht3x.fetched_index) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (g_sim.i2c_error_permille > 0 && (uint32_t)rand() % 1000 < g_sim.i2c_error_permille) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_sht3x.fetched_index = index;
+
+    float t, h;
+    uint8_t data[6];
+    sim_room_measure(now, &t, &h);
+    put_word(&data[0], ((double)t + 45.0) / 175.0 * 65535.0);
+    put_word(&data[3], (double)h / 100.0 * 65535.0);
+    memcpy(out, data, len < sizeof(data) ? len : sizeof(data));
+    return ESP_OK;
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config, i2c_master_bus_handle_t *ret_bus_handle)
+{
+    if (bus_config == NULL || ret_bus_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_bus.used) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_bus.used = true;
+    *ret_bus_handle = &s_bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t bus_handle)
+{
+    if (bus_handle != &s_bus) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_bus.used = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle, const i2c_device_config_t *dev_config,
+                                    i2c_master_dev_handle_t *ret_handle)
+{
+    if (bus_handle != &s_bus || dev_config == NULL || ret_handle == NULL || dev_config->scl_speed_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < SIM_I2C_MAX_DEVICES; i++) {
+        if (!s_devs[i].used) {
+            s_devs[i] = (struct sim_i2c_dev) {
+                .used = true,
+                .address = dev_config->device_address,
+                .hz = dev_config->scl_speed_hz,
+            };
+            *ret_handle = &s_devs[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t handle)
+{
+    if (handle == NULL || !handle->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handle->used = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size,
+                              int xfer_timeout_ms)
+{
+    if (i2c_dev == NULL || write_buffer == NULL || write_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (is_mux(i2c_dev)) {
+        wire_time(i2c_dev, write_size);
+        s_mux_channels = write_buffer[write_size - 1];
+        return ESP_OK;
+    }
+    if (!sht3x_reachable(i2c_dev)) {
+        wire_time(i2c_dev, 0);
+        return ESP_ERR_INVALID_STATE;
+    }
+    wire_time(i2c_dev, write_size);
+    return write_size == 2 ? sht3x_command((uint16_t)(write_buffer[0] << 8 | write_buffer[1])) : ESP_OK;
+}
+
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t i2c_dev, uint8_t *read_buffer, size_t read_size,
+                             int xfer_timeout_ms)
+{
+    if (i2c_dev == NULL || read_buffer == NULL || read_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (is_mux(i2c_dev)) {
+        wire_time(i2c_dev, read_size);
+        memset(read_buffer, s_mux_channels, read_size);
+        return ESP_OK;
+    }
+    esp_err_t err = sht3x_reachable(i2c_dev) ? sht3x_read(read_buffer, read_size) : ESP_ERR_INVALID_STATE;
+    wire_time(i2c_dev, err == ESP_OK ? read_size : 0);
+    return err;
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer,
+                                      size_t write_size, uint8_t *read_buffer, size_t read_size,
+                                      int xfer_timeout_ms)
+{
+    esp_err_t err = i2c_master_transmit(i2c_dev, write_buffer, write_size, xfer_timeout_ms);
+    return err == ESP_OK ? i2c_master_receive(i2c_dev, read_buffer, read_size, xfer_timeout_ms) : err;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file sim_log.c
+ * @brief esp_log on stdout, stamped with the virtual clock.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define SIM_LOG_MAX_TAGS    16
+
+static struct {
+    char tag[16];
+    esp_log_level_t level;
+} s_tags[SIM_LOG_MAX_TAGS];
+static int s_tag_count = 0;
+static esp_log_level_t s_default_level = ESP_LOG_INFO;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    if (strcmp(tag, "*") == 0) {
+        s_default_level = level;
+        s_tag_count = 0;
+        return;
+    }
+    for (int i = 0; i < s_tag_count; i++) {
+        if (strcmp(s_tags[i].tag, tag) == 0) {
+            s_tags[i].level = level;
+            return;
+        }
+    }
+    if (s_tag_count < SIM_LOG_MAX_TAGS) {
+        snprintf(s_tags[s_tag_count].tag, sizeof(s_tags[0].tag), "%s", tag);
+        s_tags[s_tag_count++].level = level;
+    }
+}
+
+static esp_log_level_t level_for(const char *tag)
+{
+    for (int i = 0; i < s_tag_count; i++) {
+        if (strcmp(s_tags[i].tag, tag) == 0) {
+            return s_tags[i].level;
+        }
+    }
+    return s_default_level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    va_list args;
+
+    if (level > level_for(tag)) {
+        return;
+    }
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
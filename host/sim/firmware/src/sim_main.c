@@ -0,0 +1,302 @@
+/**
+ * @file sim_main.c
+ * @brief Runs the unmodified firmware (main/main.c and its components) on
+ *        Linux against a virtual clock.
+ *
+ *   firmware_sim [--broker URI|none] [--days D | --duration S]
+ *                [--room NAME [--device NAME]] [--state DIR] [--report FILE]
+ *                [--outage AT:FOR]... [--i2c-errors PERMILLE] [--seed N]
+ *                [--log-level none|error|warn|info]
+ *
+ * --outage takes the Wi-Fi down AT seconds into the run for FOR seconds.
+ * --state keeps NVS and the sample log flash between runs and lets
+ * esp_restart() boot the firmware again (the process execs itself, the
+ * virtual clock carries on). At the end a summary goes to stderr and, with
+ * --report, a JSON report with the firmware's own metrics to FILE.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "device_identity.h"
+#include "metrics.h"
+#include "metrics_system.h"
+#include "sim.h"
+
+#define MAIN_TASK_STACK_SIZE    3584    /* CONFIG_ESP_MAIN_TASK_STACK_SIZE */
+#define MAIN_TASK_PRIORITY      1
+#define SIM_REPORT_SIZE         (16 * 1024)
+
+/* Carried across esp_restart() */
+#define ENV_BOOT_OFFSET     "SIM_BOOT_OFFSET_US"
+#define ENV_BOOT_COUNT      "SIM_BOOT_COUNT"
+#define ENV_WALL_START      "SIM_WALL_START_US"
+
+sim_config_t g_sim = {
+    .duration_us = 86400LL * 1000000,
+    .seed = 1,
+};
+int64_t g_sim_boot_offset_us = 0;
+uint32_t g_sim_boot_count = 0;
+
+static int64_t s_wall_start_us;
+static char **s_argv;
+
+void app_main(void);
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--broker URI|none] [--days D | --duration S]\n"
+            "          [--room NAME [--device NAME]] [--state DIR] [--report FILE]\n"
+            "          [--outage AT:FOR]... [--i2c-errors PERMILLE] [--seed N]\n"
+            "          [--log-level none|error|warn|info]\n", prog);
+    exit(2);
+}
+
+static int compare_outages(const void *a, const void *b)
+{
+    const sim_outage_t *x = a;
+    const sim_outage_t *y = b;
+    return (x->at_s > y->at_s) - (x->at_s < y->at_s);
+}
+
+static void write_report(const char *path, double virtual_s, double wall_s)
+{
+    static char buf[SIM_REPORT_SIZE];
+    telemetry_json_writer_t w;
+    size_t used, peak, len;
+
+    sim_heap_usage(&used, &peak);
+    telemetry_json_init(&w, buf, sizeof(buf));
+    telemetry_json_object_begin(&w);
+
+    telemetry_json_key(&w, "sim");
+    telemetry_json_object_begin(&w);
+    telemetry_json_key(&w, "virtual_s");
+    telemetry_json_number(&w, round(virtual_s));
+    telemetry_json_key(&w, "wall_s");
+    telemetry_json_number(&w, round(wall_s * 1000.0) / 1000.0);
+    telemetry_json_key(&w, "speedup");
+    telemetry_json_number(&w, wall_s > 0 ? round(virtual_s / wall_s) : 0);
+    telemetry_json_key(&w, "boots");
+    telemetry_json_number(&w, g_sim_boot_count + 1);
+    telemetry_json_key(&w, "seed");
+    telemetry_json_number(&w, g_sim.seed);
+    telemetry_json_object_end(&w);
+
+    telemetry_json_key(&w, "heap");
+    telemetry_json_object_begin(&w);
+    telemetry_json_key(&w, "size");
+    telemetry_json_number(&w, SIM_HEAP_SIZE);
+    telemetry_json_key(&w, "used");
+    telemetry_json_number(&w, (double)used);
+    telemetry_json_key(&w, "peak");
+    telemetry_json_number(&w, (double)peak);
+    telemetry_json_object_end(&w);
+
+    telemetry_json_key(&w, "mqtt");
+    telemetry_json_object_begin(&w);
+    sim_mqtt_write_json(&w);
+    telemetry_json_object_end(&w);
+
+    telemetry_json_key(&w, "room");
+    telemetry_json_object_begin(&w);
+    sim_room_write_json(&w);
+    telemetry_json_object_end(&w);
+
+    // What the health check would publish now
+    telemetry_json_key(&w, "firmware");
+    telemetry_json_object_begin(&w);
+    metrics_system_write_json(&w);
+    metrics_write_json(&w);
+    telemetry_json_object_end(&w);
+
+    telemetry_json_object_end(&w);
+    if (telemetry_json_finish(&w, &len) != ESP_OK) {
+        fprintf(stderr, "sim: report does not fit in %d bytes\n", SIM_REPORT_SIZE);
+        return;
+    }
+
+    FILE *f = fopen(path, "w");
+    if (f == NULL || fprintf(f, "%s\n", buf) < 0) {
+        fprintf(stderr, "sim: cannot write %s: %s\n", path, strerror(errno));
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+}
+
+static void save_state(void)
+{
+    if (g_sim.state_dir != NULL) {
+        sim_nvs_save(g_sim.state_dir);
+        sim_flash_save(g_sim.state_dir);
+    }
+}
+
+void sim_finish(int status)
+{
+    int64_t virtual_us = g_sim_boot_offset_us + esp_timer_get_time();
+    double wall_s = (double)(sim_real_us() - s_wall_start_us) / 1e6;
+    double virtual_s = (double)virtual_us / 1e6;
+    uint64_t busy_us, idle_us;
+    size_t used, peak;
+
+    save_state();
+    fflush(stdout);
+    sim_rtos_cpu(&busy_us, &idle_us);
+    sim_heap_usage(&used, &peak);
+    fprintf(stderr, "sim: %.0f s virtual in %.2f s wall (%.0fx), %" PRIu32 " boot(s), "
+            "tasks busy %.2f s, heap peak %zu of %d bytes\n",
+            virtual_s, wall_s, wall_s > 0 ? virtual_s / wall_s : 0.0, g_sim_boot_count + 1,
+            (double)busy_us / 1e6, peak, SIM_HEAP_SIZE);
+    if (g_sim.report_path != NULL) {
+        write_report(g_sim.report_path, virtual_s, wall_s);
+    }
+    exit(status);
+}
+
+void esp_restart(void)
+{
+    int64_t offset_us = g_sim_boot_offset_us + esp_timer_get_time();
+    char value[32];
+
+    if (g_sim.state_dir == NULL) {
+        fprintf(stderr, "sim: esp_restart() without --state ends the run\n");
+        sim_finish(0);
+    }
+    save_state();
+    fflush(stdout);
+    fflush(stderr);
+
+    snprintf(value, sizeof(value), "%" PRId64, offset_us);
+    setenv(ENV_BOOT_OFFSET, value, 1);
+    snprintf(value, sizeof(value), "%" PRIu32, g_sim_boot_count + 1);
+    setenv(ENV_BOOT_COUNT, value, 1);
+    snprintf(value, sizeof(value), "%" PRId64, s_wall_start_us);
+    setenv(ENV_WALL_START, value, 1);
+    execv("/proc/self/exe", s_argv);
+    fprintf(stderr, "sim: cannot restart: %s\n", strerror(errno));
+    exit(1);
+}
+
+static void main_task(void *arg)
+{
+    app_main();
+}
+
+static esp_log_level_t parse_level(const char *name)
+{
+    static const char *const names[] = { "none", "error", "warn", "info" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return (esp_log_level_t)i;
+        }
+    }
+    fprintf(stderr, "sim: unknown log level %s\n", name);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *room = NULL;
+    const char *device = "";
+    const char *env;
+
+    s_argv = argv;
+    g_sim.broker_uri = NULL;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            usage(argv[0]);
+        }
+        i++;
+        if (strcmp(arg, "--broker") == 0) {
+            g_sim.broker_uri = strcmp(value, "none") == 0 ? NULL : value;
+        } else if (strcmp(arg, "--days") == 0) {
+            g_sim.duration_us = (int64_t)(atof(value) * 86400.0 * 1e6);
+        } else if (strcmp(arg, "--duration") == 0) {
+            g_sim.duration_us = (int64_t)(atof(value) * 1e6);
+        } else if (strcmp(arg, "--room") == 0) {
+            room = value;
+        } else if (strcmp(arg, "--device") == 0) {
+            device = value;
+        } else if (strcmp(arg, "--state") == 0) {
+            g_sim.state_dir = value;
+        } else if (strcmp(arg, "--report") == 0) {
+            g_sim.report_path = value;
+        } else if (strcmp(arg, "--outage") == 0) {
+            unsigned at, duration;
+            if (g_sim.outage_count >= SIM_MAX_OUTAGES || sscanf(value, "%u:%u", &at, &duration) != 2) {
+                usage(argv[0]);
+            }
+            g_sim.outages[g_sim.outage_count++] = (sim_outage_t) { .at_s = at, .for_s = duration };
+        } else if (strcmp(arg, "--i2c-errors") == 0) {
+            g_sim.i2c_error_permille = (uint32_t)atoi(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            g_sim.seed = (uint32_t)strtoul(value, NULL, 0);
+        } else if (strcmp(arg, "--log-level") == 0) {
+            esp_log_level_set("*", parse_level(value));
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (g_sim.duration_us <= 0) {
+        usage(argv[0]);
+    }
+    qsort(g_sim.outages, (size_t)g_sim.outage_count, sizeof(g_sim.outages[0]), compare_outages);
+
+    s_wall_start_us = sim_real_us();
+    if ((env = getenv(ENV_BOOT_OFFSET)) != NULL) {
+        g_sim_boot_offset_us = strtoll(env, NULL, 10);
+    }
+    if ((env = getenv(ENV_BOOT_COUNT)) != NULL) {
+        g_sim_boot_count = (uint32_t)strtoul(env, NULL, 10);
+    }
+    if ((env = getenv(ENV_WALL_START)) != NULL) {
+        s_wall_start_us = strtoll(env, NULL, 10);
+    }
+    if (g_sim_boot_offset_us >= g_sim.duration_us) {
+        sim_finish(0);
+    }
+
+    srand(g_sim.seed + g_sim_boot_count);
+    sim_room_init(g_sim.seed);
+    if (g_sim.state_dir != NULL) {
+        if (mkdir(g_sim.state_dir, 0755) != 0 && errno != EEXIST) {
+            fprintf(stderr, "sim: cannot create %s: %s\n", g_sim.state_dir, strerror(errno));
+            return 1;
+        }
+        sim_nvs_load(g_sim.state_dir);
+        sim_flash_load(g_sim.state_dir);
+    }
+
+    // Provisioning happens before the first boot, as on the production line
+    if (room != NULL && g_sim_boot_count == 0) {
+        nvs_flash_init();
+        esp_err_t err = device_identity_store(room, device);
+        if (err != ESP_OK) {
+            fprintf(stderr, "sim: cannot provision %s/%s: %s\n", room, device, esp_err_to_name(err));
+            return 2;
+        }
+    }
+
+    if (xTaskCreate(main_task, "main", MAIN_TASK_STACK_SIZE, NULL, MAIN_TASK_PRIORITY, NULL) != pdPASS) {
+        fprintf(stderr, "sim: cannot create the main task\n");
+        return 1;
+    }
+    sim_rtos_run(g_sim.duration_us - g_sim_boot_offset_us);
+}
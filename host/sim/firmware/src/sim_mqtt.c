@@ -0,0 +1,831 @@
+/**
+ * @file sim_mqtt.c
+ * @brief esp-mqtt for the simulation: MQTT 3.1.1 over plain TCP.
+ *
+ * Behaves like esp-mqtt where the firmware can tell: a client task
+ * ("mqtt_task") owns the socket, publishes go through an outbox that keeps
+ * QoS 1 messages until PUBACK and resends them after a reconnect, messages
+ * unacknowledged for 30 s are deleted with MQTT_EVENT_DELETED, a failed
+ * connection is retried every 10 s, and inbound messages longer than the
+ * 1024-byte buffer arrive as several MQTT_EVENT_DATA with the topic on the
+ * first one only. TLS is not spoken; point --broker at a plain listener.
+ *
+ * Tasks only switch at blocking calls, and nothing here blocks while the
+ * client state is being changed, so the client needs no lock.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_crt_bundle.h"
+#include "mqtt_client.h"
+#include "sim.h"
+
+#define MQTT_BUFFER_SIZE            1024
+#define MQTT_TASK_PRIORITY          5
+#define MQTT_TASK_STACK_SIZE        6144
+#define MQTT_RECONNECT_US           (10 * 1000000LL)
+#define MQTT_OUTBOX_EXPIRE_US       (30 * 1000000LL)
+#define MQTT_POLL_MAX_MS            1000
+/* Real time a local broker gets to answer before the virtual clock moves on */
+#define MQTT_REPLY_WAIT_US          200000
+#define MQTT_RX_MAX                 (64 * 1024)
+
+#define PKT_CONNECT     0x10
+#define PKT_CONNACK     0x20
+#define PKT_PUBLISH     0x30
+#define PKT_PUBACK      0x40
+#define PKT_SUBSCRIBE   0x82
+#define PKT_SUBACK      0x90
+#define PKT_PINGREQ     0xc0
+#define PKT_PINGRESP    0xd0
+
+static const char *TAG = "mqtt_client";
+
+typedef struct outbox_item {
+    struct outbox_item *next;
+    int msg_id;
+    int qos;
+    bool subscribe;
+    bool sent;
+    bool resend;                /* sent on an earlier connection, goes again with DUP */
+    int64_t created_us;
+    size_t len;
+    uint8_t data[];
+} outbox_item_t;
+
+typedef enum {
+    STATE_STOPPED,
+    STATE_DISCONNECTED,
+    STATE_WAIT_CONNACK,
+    STATE_CONNECTED,
+} client_state_t;
+
+struct esp_mqtt_client {
+    char host[64];
+    char port[8];
+    char client_id[24];
+    const char *username;
+    const char *password;
+    const char *will_topic;
+    const char *will_msg;
+    int will_len;
+    int will_qos;
+    int will_retain;
+    int keepalive_s;
+
+    esp_event_handler_t handler;
+    void *handler_arg;
+    TaskHandle_t task;
+
+    client_state_t state;
+    int fd;
+    int64_t reconnect_at_us;
+    int64_t last_tx_us;
+    int64_t ping_sent_us;       /* 0: no ping outstanding */
+    int64_t reply_due_real_us;
+    bool failing;               /* the last attempt failed too, don't log again */
+    uint16_t last_msg_id;
+
+    outbox_item_t *outbox;
+    size_t outbox_bytes;
+};
+
+static struct {
+    uint32_t connects;
+    uint32_t connect_failures;
+    uint32_t disconnects;
+    uint32_t published;
+    uint32_t resent;
+    uint32_t acked;
+    uint32_t expired;
+    uint32_t received;
+    uint64_t bytes_tx;
+    uint64_t bytes_rx;
+    size_t outbox_peak;
+} s_stats;
+
+static esp_mqtt_client_handle_t s_client = NULL;
+static uint8_t s_rx[MQTT_RX_MAX];
+static size_t s_rx_len;
+
+static void post(esp_mqtt_client_handle_t c, esp_mqtt_event_t *event)
+{
+    event->client = c;
+    if (c->handler != NULL) {
+        c->handler(c->handler_arg, "MQTT_EVENTS", event->event_id, event);
+    }
+}
+
+static void post_simple(esp_mqtt_client_handle_t c, esp_mqtt_event_id_t id, int msg_id)
+{
+    esp_mqtt_event_t event = { .event_id = id, .msg_id = msg_id };
+    post(c, &event);
+}
+
+/* ---- encoding ---- */
+
+static size_t put_length(uint8_t *out, size_t len)
+{
+    size_t n = 0;
+    do {
+        uint8_t byte = len % 128;
+        len /= 128;
+        out[n++] = len > 0 ? (byte | 0x80) : byte;
+    } while (len > 0);
+    return n;
+}
+
+static size_t put_u16(uint8_t *out, uint16_t v)
+{
+    out[0] = (uint8_t)(v >> 8);
+    out[1] = (uint8_t)v;
+    return 2;
+}
+
+static size_t put_bytes(uint8_t *out, const void *data, size_t len)
+{
+    put_u16(out, (uint16_t)len);
+    memcpy(out + 2, data, len);
+    return 2 + len;
+}
+
+/* Allocates an outbox item for a packet with the given remaining length; body is written by the caller */
+static outbox_item_t *new_packet(uint8_t type, size_t remaining, uint8_t **body)
+{
+    uint8_t header[5];
+    size_t header_len = 1 + put_length(header + 1, remaining);
+    outbox_item_t *item = malloc(sizeof(*item) + header_len + remaining);
+
+    if (item == NULL) {
+        return NULL;
+    }
+    memset(item, 0, sizeof(*item));
+    header[0] = type;
+    memcpy(item->data, header, header_len);
+    item->len = header_len + remaining;
+    item->created_us = esp_timer_get_time();
+    *body = item->data + header_len;
+    return item;
+}
+
+static int next_msg_id(esp_mqtt_client_handle_t c)
+{
+    if (++c->last_msg_id == 0) {
+        c->last_msg_id = 1;
+    }
+    return c->last_msg_id;
+}
+
+static void outbox_add(esp_mqtt_client_handle_t c, outbox_item_t *item)
+{
+    outbox_item_t **tail = &c->outbox;
+    while (*tail != NULL) {
+        tail = &(*tail)->next;
+    }
+    *tail = item;
+    c->outbox_bytes += item->len;
+    if (c->outbox_bytes > s_stats.outbox_peak) {
+        s_stats.outbox_peak = c->outbox_bytes;
+    }
+}
+
+static void outbox_remove(esp_mqtt_client_handle_t c, outbox_item_t **link)
+{
+    outbox_item_t *item = *link;
+    *link = item->next;
+    c->outbox_bytes -= item->len;
+    free(item);
+}
+
+/* ---- connection ---- */
+
+static bool send_all(esp_mqtt_client_handle_t c, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(c->fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+        s_stats.bytes_tx += (uint64_t)n;
+    }
+    c->last_tx_us = esp_timer_get_time();
+    return true;
+}
+
+static void expect_reply(esp_mqtt_client_handle_t c)
+{
+    c->reply_due_real_us = sim_real_us() + MQTT_REPLY_WAIT_US;
+}
+
+static void drop_connection(esp_mqtt_client_handle_t c, const char *why)
+{
+    bool was_connected = c->state == STATE_CONNECTED;
+
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+    c->state = STATE_DISCONNECTED;
+    c->ping_sent_us = 0;
+    c->reply_due_real_us = 0;
+    c->reconnect_at_us = esp_timer_get_time() + MQTT_RECONNECT_US;
+    s_rx_len = 0;
+    // Subscriptions are issued again on the next MQTT_EVENT_CONNECTED
+    for (outbox_item_t **link = &c->outbox; *link != NULL; ) {
+        if ((*link)->subscribe || (*link)->qos == 0) {
+            outbox_remove(c, link);
+        } else {
+            if ((*link)->sent) {
+                (*link)->sent = false;
+                (*link)->resend = true;
+                (*link)->data[0] |= 0x08;
+            }
+            link = &(*link)->next;
+        }
+    }
+    if (was_connected) {
+        s_stats.disconnects++;
+        ESP_LOGW(TAG, "Connection lost: %s", why);
+    } else {
+        s_stats.connect_failures++;
+        if (!c->failing) {
+            ESP_LOGE(TAG, "Connect to %s:%s failed: %s", c->host, c->port, why);
+        }
+        c->failing = true;
+        post_simple(c, MQTT_EVENT_ERROR, 0);
+    }
+    post_simple(c, MQTT_EVENT_DISCONNECTED, 0);
+}
+
+static int open_socket(const char *host, const char *port)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    int fd = -1;
+
+    if (getaddrinfo(host, port, &hints, &res) != 0) {
+        return -1;
+    }
+    for (struct addrinfo *ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+static void start_connect(esp_mqtt_client_handle_t c)
+{
+    post_simple(c, MQTT_EVENT_BEFORE_CONNECT, 0);
+
+    if (!sim_wifi_link_up() || g_sim.broker_uri == NULL) {
+        drop_connection(c, sim_wifi_link_up() ? "no broker" : "network down");
+        return;
+    }
+    c->fd = open_socket(c->host, c->port);
+    if (c->fd < 0) {
+        drop_connection(c, strerror(errno));
+        return;
+    }
+
+    bool user = c->username != NULL && c->username[0] != '\0';
+    bool pass = c->password != NULL && c->password[0] != '\0';
+    bool will = c->will_topic != NULL && c->will_topic[0] != '\0';
+    size_t remaining = 10 + 2 + strlen(c->client_id);
+    if (will) {
+        remaining += 2 + strlen(c->will_topic) + 2 + (size_t)c->will_len;
+    }
+    if (user) {
+        remaining += 2 + strlen(c->username);
+    }
+    if (pass) {
+        remaining += 2 + strlen(c->password);
+    }
+
+    uint8_t *body;
+    outbox_item_t *packet = new_packet(PKT_CONNECT, remaining, &body);
+    if (packet == NULL) {
+        drop_connection(c, "out of memory");
+        return;
+    }
+    uint8_t flags = 0x02;   // clean session
+    if (will) {
+        flags |= 0x04 | (uint8_t)(c->will_qos << 3) | (c->will_retain ? 0x20 : 0);
+    }
+    flags |= (user ? 0x80 : 0) | (pass ? 0x40 : 0);
+
+    body += put_bytes(body, "MQTT", 4);
+    *body++ = 4;    // protocol level 3.1.1
+    *body++ = flags;
+    body += put_u16(body, (uint16_t)c->keepalive_s);
+    body += put_bytes(body, c->client_id, strlen(c->client_id));
+    if (will) {
+        body += put_bytes(body, c->will_topic, strlen(c->will_topic));
+        body += put_bytes(body, c->will_msg, (size_t)c->will_len);
+    }
+    if (user) {
+        body += put_bytes(body, c->username, strlen(c->username));
+    }
+    if (pass) {
+        body += put_bytes(body, c->password, strlen(c->password));
+    }
+
+    bool ok = send_all(c, packet->data, packet->len);
+    free(packet);
+    if (!ok) {
+        drop_connection(c, "send failed");
+        return;
+    }
+    c->state = STATE_WAIT_CONNACK;
+    expect_reply(c);
+}
+
+/* ---- inbound ---- */
+
+static void handle_publish(esp_mqtt_client_handle_t c, uint8_t flags, const uint8_t *p, size_t len)
+{
+    int qos = (flags >> 1) & 3;
+    if (len < 2) {
+        return;
+    }
+    size_t topic_len = (size_t)p[0] << 8 | p[1];
+    size_t pos = 2 + topic_len;
+    int msg_id = 0;
+    if (pos > len) {
+        return;
+    }
+    if (qos > 0) {
+        if (pos + 2 > len) {
+            return;
+        }
+        msg_id = p[pos] << 8 | p[pos + 1];
+        pos += 2;
+
+        uint8_t ack[4] = { PKT_PUBACK, 2 };
+        put_u16(ack + 2, (uint16_t)msg_id);
+        send_all(c, ack, sizeof(ack));
+    }
+    s_stats.received++;
+
+    // As esp-mqtt: the first chunk shares the buffer with the topic
+    const char *payload = (const char *)p + pos;
+    int total = (int)(len - pos);
+    int offset = 0;
+    do {
+        int room = offset == 0 ? MQTT_BUFFER_SIZE - (int)pos : MQTT_BUFFER_SIZE;
+        int chunk = total - offset < room ? total - offset : room;
+        esp_mqtt_event_t event = {
+            .event_id = MQTT_EVENT_DATA,
+            .data = (char *)payload + offset,
+            .data_len = chunk,
+            .total_data_len = total,
+            .current_data_offset = offset,
+            .topic = offset == 0 ? (char *)p + 2 : NULL,
+            .topic_len = offset == 0 ? (int)topic_len : 0,
+            .msg_id = msg_id,
+            .retain = flags & 1,
+            .qos = qos,
+            .dup = (flags >> 3) & 1,
+        };
+        post(c, &event);
+        offset += chunk;
+    } while (offset < total);
+}
+
+/* Removes the outbox entry acknowledged by a PUBACK or SUBACK */
+static bool acknowledge(esp_mqtt_client_handle_t c, int msg_id, bool subscribe)
+{
+    for (outbox_item_t **link = &c->outbox; *link != NULL; link = &(*link)->next) {
+        if ((*link)->msg_id == msg_id && (*link)->subscribe == subscribe && (*link)->sent) {
+            outbox_remove(c, link);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void handle_packet(esp_mqtt_client_handle_t c, uint8_t type, const uint8_t *p, size_t len)
+{
+    switch (type & 0xf0) {
+        case PKT_CONNACK:
+            if (c->state != STATE_WAIT_CONNACK || len < 2 || p[1] != 0) {
+                drop_connection(c, "connection refused");
+                return;
+            }
+            c->state = STATE_CONNECTED;
+            c->failing = false;
+            s_stats.connects++;
+            ESP_LOGI(TAG, "Connected to %s:%s as %s", c->host, c->port, c->client_id);
+            {
+                esp_mqtt_event_t event = { .event_id = MQTT_EVENT_CONNECTED, .session_present = p[0] & 1 };
+                post(c, &event);
+            }
+            break;
+        case PKT_PUBLISH:
+            handle_publish(c, type & 0x0f, p, len);
+            break;
+        case PKT_PUBACK:
+            if (len >= 2 && acknowledge(c, p[0] << 8 | p[1], false)) {
+                s_stats.acked++;
+                post_simple(c, MQTT_EVENT_PUBLISHED, p[0] << 8 | p[1]);
+            }
+            break;
+        case PKT_SUBACK:
+            if (len >= 2 && acknowledge(c, p[0] << 8 | p[1], true)) {
+                post_simple(c, MQTT_EVENT_SUBSCRIBED, p[0] << 8 | p[1]);
+            }
+            break;
+        case PKT_PINGRESP:
+            c->ping_sent_us = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+static void receive(esp_mqtt_client_handle_t c)
+{
+    ssize_t n = recv(c->fd, s_rx + s_rx_len, sizeof(s_rx) - s_rx_len, MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        drop_connection(c, n == 0 ? "closed by the broker" : strerror(errno));
+        return;
+    }
+    if (n < 0) {
+        return;
+    }
+    s_rx_len += (size_t)n;
+    s_stats.bytes_rx += (uint64_t)n;
+
+    for (;;) {
+        size_t remaining = 0;
+        size_t pos = 1;
+        int shift = 0;
+        bool complete = false;
+        while (pos < s_rx_len && pos < 5) {
+            remaining |= (size_t)(s_rx[pos] & 0x7f) << shift;
+            shift += 7;
+            if ((s_rx[pos++] & 0x80) == 0) {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete) {
+            break;
+        }
+        if (pos + remaining > sizeof(s_rx)) {
+            drop_connection(c, "packet too large");
+            return;
+        }
+        if (pos + remaining > s_rx_len) {
+            break;
+        }
+        handle_packet(c, s_rx[0], s_rx + pos, remaining);
+        if (c->fd < 0) {
+            return;     // the packet ended the connection
+        }
+        memmove(s_rx, s_rx + pos + remaining, s_rx_len - pos - remaining);
+        s_rx_len -= pos + remaining;
+    }
+}
+
+/* ---- client task ---- */
+
+static void flush_outbox(esp_mqtt_client_handle_t c)
+{
+    for (outbox_item_t **link = &c->outbox; *link != NULL && c->fd >= 0; ) {
+        outbox_item_t *item = *link;
+        if (item->sent) {
+            link = &item->next;
+            continue;
+        }
+        if (!send_all(c, item->data, item->len)) {
+            drop_connection(c, "send failed");
+            return;
+        }
+        if (item->resend) {
+            s_stats.resent++;
+        } else if (!item->subscribe) {
+            s_stats.published++;
+        }
+        if (item->qos == 0 && !item->subscribe) {
+            outbox_remove(c, link);
+            continue;
+        }
+        item->sent = true;
+        expect_reply(c);
+        link = &item->next;
+    }
+}
+
+static void expire_outbox(esp_mqtt_client_handle_t c, int64_t now)
+{
+    for (outbox_item_t **link = &c->outbox; *link != NULL; ) {
+        outbox_item_t *item = *link;
+        if (now - item->created_us < MQTT_OUTBOX_EXPIRE_US) {
+            link = &item->next;
+            continue;
+        }
+        int msg_id = item->msg_id;
+        bool subscribe = item->subscribe;
+        outbox_remove(c, link);
+        if (!subscribe) {
+            s_stats.expired++;
+            post_simple(c, MQTT_EVENT_DELETED, msg_id);
+        }
+    }
+}
+
+static void keepalive(esp_mqtt_client_handle_t c, int64_t now)
+{
+    int64_t period = (int64_t)c->keepalive_s * 1000000;
+
+    if (c->state != STATE_CONNECTED || period == 0) {
+        return;
+    }
+    if (c->ping_sent_us != 0 && now - c->ping_sent_us >= period) {
+        drop_connection(c, "no PINGRESP");
+    } else if (c->ping_sent_us == 0 && now - c->last_tx_us >= period) {
+        uint8_t ping[2] = { PKT_PINGREQ, 0 };
+        if (!send_all(c, ping, sizeof(ping))) {
+            drop_connection(c, "send failed");
+            return;
+        }
+        c->ping_sent_us = now;
+        expect_reply(c);
+    }
+}
+
+/* Next time the task has something to do without being woken */
+static int64_t next_deadline(esp_mqtt_client_handle_t c, int64_t now)
+{
+    int64_t next = now + MQTT_POLL_MAX_MS * 1000;
+
+    if (c->state == STATE_DISCONNECTED && c->reconnect_at_us < next) {
+        next = c->reconnect_at_us;
+    }
+    if (c->state == STATE_CONNECTED && c->keepalive_s > 0) {
+        int64_t from = c->ping_sent_us != 0 ? c->ping_sent_us : c->last_tx_us;
+        int64_t at = from + (int64_t)c->keepalive_s * 1000000;
+        if (at < next) {
+            next = at;
+        }
+    }
+    if (c->outbox != NULL && c->outbox->created_us + MQTT_OUTBOX_EXPIRE_US < next) {
+        next = c->outbox->created_us + MQTT_OUTBOX_EXPIRE_US;
+    }
+    return next;
+}
+
+static void mqtt_task(void *arg)
+{
+    esp_mqtt_client_handle_t c = arg;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, 0);
+        int64_t now = esp_timer_get_time();
+
+        if (c->fd >= 0 && !sim_wifi_link_up()) {
+            drop_connection(c, "network down");
+        }
+        if (c->state == STATE_DISCONNECTED && now >= c->reconnect_at_us) {
+            start_connect(c);
+        }
+        if (c->state == STATE_CONNECTED) {
+            flush_outbox(c);
+            keepalive(c, now);
+        }
+        expire_outbox(c, now);
+
+        bool waiting = c->state == STATE_WAIT_CONNACK || c->ping_sent_us != 0;
+        for (outbox_item_t *item = c->outbox; item != NULL && !waiting; item = item->next) {
+            waiting = item->sent;
+        }
+        int64_t reply_due = waiting ? c->reply_due_real_us : 0;
+
+        int64_t wait_us = next_deadline(c, now) - esp_timer_get_time();
+        TickType_t ticks = wait_us > 0 ? (TickType_t)((wait_us + 999) / 1000) : 0;
+        if (c->fd >= 0) {
+            if (sim_wait_fd(c->fd, ticks, reply_due)) {
+                receive(c);
+            }
+        } else {
+            ulTaskNotifyTake(pdTRUE, ticks);
+        }
+    }
+}
+
+/* ---- API ---- */
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    esp_mqtt_client_handle_t c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+        return NULL;
+    }
+
+    // mqtt://host[:port][/...]; the firmware's own URI is only used without --broker
+    const char *uri = g_sim.broker_uri != NULL ? g_sim.broker_uri : config->broker.address.uri;
+    const char *host = strstr(uri, "://");
+    host = host != NULL ? host + 3 : uri;
+    size_t host_len = strcspn(host, ":/");
+    snprintf(c->host, sizeof(c->host), "%.*s", (int)host_len, host);
+    if (host[host_len] == ':') {
+        snprintf(c->port, sizeof(c->port), "%.*s", (int)strcspn(host + host_len + 1, "/"), host + host_len + 1);
+    } else {
+        snprintf(c->port, sizeof(c->port), "1883");
+    }
+
+    if (config->credentials.client_id != NULL) {
+        snprintf(c->client_id, sizeof(c->client_id), "%s", config->credentials.client_id);
+    } else {
+        // esp-mqtt uses the chip id; the pid keeps simulated nodes apart
+        snprintf(c->client_id, sizeof(c->client_id), "ESP32_%06X", (unsigned)getpid() & 0xffffff);
+    }
+    c->username = config->credentials.username;
+    c->password = config->credentials.authentication.password;
+    c->will_topic = config->session.last_will.topic;
+    c->will_msg = config->session.last_will.msg != NULL ? config->session.last_will.msg : "";
+    c->will_len = config->session.last_will.msg_len > 0 ? config->session.last_will.msg_len
+                                                        : (int)strlen(c->will_msg);
+    c->will_qos = config->session.last_will.qos;
+    c->will_retain = config->session.last_will.retain;
+    c->keepalive_s = config->session.keepalive > 0 ? config->session.keepalive : 120;
+    c->fd = -1;
+    c->state = STATE_STOPPED;
+    s_client = c;
+    return c;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    client->handler = event_handler;
+    client->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    if (client == NULL || client->state != STATE_STOPPED) {
+        return client == NULL ? ESP_ERR_INVALID_ARG : ESP_FAIL;
+    }
+    client->state = STATE_DISCONNECTED;
+    client->reconnect_at_us = 0;
+    if (xTaskCreate(mqtt_task, "mqtt_task", MQTT_TASK_STACK_SIZE, client, MQTT_TASK_PRIORITY,
+                    &client->task) != pdPASS) {
+        client->state = STATE_STOPPED;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client)
+{
+    if (client == NULL || client->state != STATE_DISCONNECTED) {
+        return ESP_FAIL;
+    }
+    client->reconnect_at_us = 0;
+    xTaskNotifyGive(client->task);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                            int qos, int retain, bool store)
+{
+    if (client == NULL || topic == NULL || qos < 0 || qos > 1) {
+        return -1;
+    }
+    if (data == NULL) {
+        data = "";
+    }
+    if (len <= 0) {
+        len = (int)strlen(data);
+    }
+    // Like esp-mqtt, QoS 0 goes nowhere while disconnected unless the caller stores it
+    if (qos == 0 && !store && client->state != STATE_CONNECTED) {
+        return -1;
+    }
+
+    size_t topic_len = strlen(topic);
+    size_t remaining = 2 + topic_len + (qos > 0 ? 2 : 0) + (size_t)len;
+    uint8_t *body;
+    outbox_item_t *item = new_packet(PKT_PUBLISH | (uint8_t)(qos << 1) | (retain ? 1 : 0), remaining, &body);
+    if (item == NULL) {
+        return -1;
+    }
+    int msg_id = qos > 0 ? next_msg_id(client) : 0;
+    body += put_bytes(body, topic, topic_len);
+    if (qos > 0) {
+        body += put_u16(body, (uint16_t)msg_id);
+    }
+    memcpy(body, data, (size_t)len);
+    item->msg_id = msg_id;
+    item->qos = qos;
+    outbox_add(client, item);
+    if (client->task != NULL) {
+        xTaskNotifyGive(client->task);
+    }
+    return msg_id;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                            int qos, int retain)
+{
+    return esp_mqtt_client_enqueue(client, topic, data, len, qos, retain, false);
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    if (client == NULL || topic == NULL || client->state != STATE_CONNECTED) {
+        return -1;
+    }
+    size_t topic_len = strlen(topic);
+    uint8_t *body;
+    outbox_item_t *item = new_packet(PKT_SUBSCRIBE, 2 + 2 + topic_len + 1, &body);
+    if (item == NULL) {
+        return -1;
+    }
+    int msg_id = next_msg_id(client);
+    body += put_u16(body, (uint16_t)msg_id);
+    body += put_bytes(body, topic, topic_len);
+    *body = (uint8_t)qos;
+    item->msg_id = msg_id;
+    item->qos = qos;
+    item->subscribe = true;
+    outbox_add(client, item);
+    xTaskNotifyGive(client->task);
+    return msg_id;
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client)
+{
+    return client != NULL ? (int)client->outbox_bytes : 0;
+}
+
+/* ---- simulation side ---- */
+
+void sim_mqtt_link_changed(void)
+{
+    if (s_client != NULL && s_client->task != NULL) {
+        xTaskNotifyGive(s_client->task);
+    }
+}
+
+void sim_mqtt_write_json(telemetry_json_writer_t *w)
+{
+    telemetry_json_key(w, "broker");
+    if (g_sim.broker_uri != NULL) {
+        telemetry_json_string(w, g_sim.broker_uri);
+    } else {
+        telemetry_json_number(w, NAN);  // null
+    }
+    telemetry_json_key(w, "connects");
+    telemetry_json_number(w, s_stats.connects);
+    telemetry_json_key(w, "connect_failures");
+    telemetry_json_number(w, s_stats.connect_failures);
+    telemetry_json_key(w, "disconnects");
+    telemetry_json_number(w, s_stats.disconnects);
+    telemetry_json_key(w, "published");
+    telemetry_json_number(w, s_stats.published);
+    telemetry_json_key(w, "resent");
+    telemetry_json_number(w, s_stats.resent);
+    telemetry_json_key(w, "acked");
+    telemetry_json_number(w, s_stats.acked);
+    telemetry_json_key(w, "expired");
+    telemetry_json_number(w, s_stats.expired);
+    telemetry_json_key(w, "received");
+    telemetry_json_number(w, s_stats.received);
+    telemetry_json_key(w, "bytes_tx");
+    telemetry_json_number(w, (double)s_stats.bytes_tx);
+    telemetry_json_key(w, "bytes_rx");
+    telemetry_json_number(w, (double)s_stats.bytes_rx);
+    telemetry_json_key(w, "outbox_peak_bytes");
+    telemetry_json_number(w, (double)s_stats.outbox_peak);
+}
+
+/* The simulation speaks plain TCP, so there is nothing to verify */
+esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,261 @@
+/**
+ * @file sim_nvs.c
+ * @brief NVS as a fixed table of entries. With --state, every commit writes
+ *        the table to <state>/nvs.bin, which the next run starts from.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "nvs_flash.h"
+#include "sim.h"
+
+#define SIM_NVS_MAX_ENTRIES     32
+#define SIM_NVS_MAX_VALUE       4000
+#define SIM_NVS_MAX_HANDLES     8
+#define SIM_NVS_MAGIC           0x4e565331u     /* "NVS1" */
+
+typedef enum {
+    ENTRY_FREE,
+    ENTRY_U32,
+    ENTRY_STR,
+    ENTRY_BLOB,
+} entry_type_t;
+
+typedef struct {
+    uint32_t type;
+    char ns[NVS_KEY_NAME_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    uint32_t len;
+    uint8_t value[SIM_NVS_MAX_VALUE];
+} nvs_entry_t;
+
+typedef struct {
+    bool open;
+    bool writable;
+    char ns[NVS_KEY_NAME_MAX_SIZE];
+} nvs_open_t;
+
+static nvs_entry_t s_entries[SIM_NVS_MAX_ENTRIES];
+static nvs_open_t s_handles[SIM_NVS_MAX_HANDLES];
+static bool s_initialized = false;
+
+esp_err_t nvs_flash_init(void)
+{
+    s_initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    memset(s_entries, 0, sizeof(s_entries));
+    return ESP_OK;
+}
+
+static nvs_open_t *handle_of(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > SIM_NVS_MAX_HANDLES || !s_handles[handle - 1].open) {
+        return NULL;
+    }
+    return &s_handles[handle - 1];
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!s_initialized) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (namespace_name == NULL || strlen(namespace_name) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    // As in ESP-IDF, a namespace that was never written cannot be opened read-only
+    if (open_mode == NVS_READONLY) {
+        bool found = false;
+        for (int i = 0; i < SIM_NVS_MAX_ENTRIES && !found; i++) {
+            found = s_entries[i].type != ENTRY_FREE && strcmp(s_entries[i].ns, namespace_name) == 0;
+        }
+        if (!found) {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+    }
+    for (int i = 0; i < SIM_NVS_MAX_HANDLES; i++) {
+        if (!s_handles[i].open) {
+            s_handles[i].open = true;
+            s_handles[i].writable = open_mode == NVS_READWRITE;
+            snprintf(s_handles[i].ns, sizeof(s_handles[i].ns), "%s", namespace_name);
+            *out_handle = (nvs_handle_t)(i + 1);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    nvs_open_t *h = handle_of(handle);
+    if (h != NULL) {
+        h->open = false;
+    }
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    if (handle_of(handle) == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (g_sim.state_dir != NULL) {
+        sim_nvs_save(g_sim.state_dir);
+    }
+    return ESP_OK;
+}
+
+static nvs_entry_t *find(const nvs_open_t *h, const char *key)
+{
+    for (int i = 0; i < SIM_NVS_MAX_ENTRIES; i++) {
+        nvs_entry_t *e = &s_entries[i];
+        if (e->type != ENTRY_FREE && strcmp(e->ns, h->ns) == 0 && strcmp(e->key, key) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t set(nvs_handle_t handle, const char *key, entry_type_t type, const void *value, size_t len)
+{
+    nvs_open_t *h = handle_of(handle);
+
+    if (h == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!h->writable) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (key == NULL || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    if (len > SIM_NVS_MAX_VALUE) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    nvs_entry_t *e = find(h, key);
+    for (int i = 0; e == NULL && i < SIM_NVS_MAX_ENTRIES; i++) {
+        if (s_entries[i].type == ENTRY_FREE) {
+            e = &s_entries[i];
+            snprintf(e->ns, sizeof(e->ns), "%s", h->ns);
+            snprintf(e->key, sizeof(e->key), "%s", key);
+        }
+    }
+    if (e == NULL) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    e->type = type;
+    e->len = (uint32_t)len;
+    memcpy(e->value, value, len);
+    return ESP_OK;
+}
+
+static esp_err_t get(nvs_handle_t handle, const char *key, entry_type_t type, void *out, size_t *len)
+{
+    nvs_open_t *h = handle_of(handle);
+
+    if (h == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    nvs_entry_t *e = find(h, key);
+    if (e == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (e->type != type) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    if (out == NULL) {
+        *len = e->len;
+        return ESP_OK;
+    }
+    if (*len < e->len) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out, e->value, e->len);
+    *len = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    nvs_open_t *h = handle_of(handle);
+
+    if (h == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!h->writable) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    nvs_entry_t *e = find(h, key);
+    if (e == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    e->type = ENTRY_FREE;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return set(handle, key, ENTRY_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    size_t len = sizeof(*out_value);
+    return get(handle, key, ENTRY_U32, out_value, &len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return set(handle, key, ENTRY_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return get(handle, key, ENTRY_STR, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return set(handle, key, ENTRY_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return get(handle, key, ENTRY_BLOB, out_value, length);
+}
+
+void sim_nvs_load(const char *dir)
+{
+    char path[512];
+    uint32_t magic = 0;
+
+    snprintf(path, sizeof(path), "%s/nvs.bin", dir);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return;
+    }
+    if (fread(&magic, sizeof(magic), 1, f) != 1 || magic != SIM_NVS_MAGIC ||
+        fread(s_entries, sizeof(s_entries), 1, f) != 1) {
+        fprintf(stderr, "sim: %s is not an NVS image of this build, starting empty\n", path);
+        memset(s_entries, 0, sizeof(s_entries));
+    }
+    fclose(f);
+}
+
+void sim_nvs_save(const char *dir)
+{
+    char path[512];
+    const uint32_t magic = SIM_NVS_MAGIC;
+
+    snprintf(path, sizeof(path), "%s/nvs.bin", dir);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL || fwrite(&magic, sizeof(magic), 1, f) != 1 || fwrite(s_entries, sizeof(s_entries), 1, f) != 1) {
+        fprintf(stderr, "sim: cannot write %s\n", path);
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+}
@@ -0,0 +1,119 @@
+/**
+ * @file sim_room.c
+ * @brief The room the SHT3x sits in.
+ *
+ * Temperature and humidity relax towards an outdoor day (warmest and driest
+ * at 15:00). The humidifier relay adds moisture at a fixed rate, the fan
+ * relay pulls the temperature towards a cooler target. Both relays are
+ * wired active high in main.c. The state is integrated lazily in steps of
+ * at most a second, from the last update to whatever time is asked for.
+ */
+
+#include <math.h>
+#include "sim.h"
+
+#define ROOM_STEP_US            1000000
+#define ROOM_TAU_S              1800.0      /* leak towards the outdoor day */
+#define OUTDOOR_TEMP_MEAN       26.0
+#define OUTDOOR_TEMP_SWING      4.0
+#define OUTDOOR_HUM_MEAN        50.0
+#define OUTDOOR_HUM_SWING       12.0
+#define HUMIDIFIER_RATE         0.02        /* %RH per second */
+#define HUMIDITY_MAX            95.0
+#define FAN_TAU_S               600.0
+#define FAN_COOLING             3.0         /* below the outdoor temperature */
+#define NOISE_TEMP              0.05
+#define NOISE_HUM               0.2
+#define SPIKE_PER_MILLE         2           /* reads off by SPIKE_SIZE, for the median filter */
+#define SPIKE_SIZE              5.0
+
+static double s_temp;
+static double s_hum;
+static int64_t s_updated_us;
+static uint32_t s_rng;
+static double s_humidifier_on_s;
+static double s_fan_on_s;
+
+static uint32_t next_random(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return s_rng >> 8;
+}
+
+/* Uniform in [-1, 1) */
+static double noise(void)
+{
+    return (double)next_random() / (double)(1u << 23) - 1.0;
+}
+
+/* Phase of the outdoor day; the clock of every boot continues the previous one */
+static double day_phase(int64_t now_us)
+{
+    double s = (double)(g_sim_boot_offset_us + now_us) / 1e6;
+    return 2.0 * M_PI * (s / 86400.0 - 9.0 / 24.0);
+}
+
+void sim_room_init(uint32_t seed)
+{
+    double phase = day_phase(0);
+
+    s_rng = seed;
+    s_temp = OUTDOOR_TEMP_MEAN + OUTDOOR_TEMP_SWING * sin(phase);
+    s_hum = OUTDOOR_HUM_MEAN - OUTDOOR_HUM_SWING * sin(phase);
+    s_updated_us = 0;
+}
+
+void sim_room_advance(int64_t now_us)
+{
+    bool humidifier = sim_gpio_level(SIM_HUMIDIFIER_PIN);
+    bool fan = sim_gpio_level(SIM_FAN_PIN);
+
+    while (s_updated_us < now_us) {
+        int64_t step_us = now_us - s_updated_us < ROOM_STEP_US ? now_us - s_updated_us : ROOM_STEP_US;
+        double dt = (double)step_us / 1e6;
+        double phase = day_phase(s_updated_us);
+        double outdoor_temp = OUTDOOR_TEMP_MEAN + OUTDOOR_TEMP_SWING * sin(phase);
+        double outdoor_hum = OUTDOOR_HUM_MEAN - OUTDOOR_HUM_SWING * sin(phase);
+
+        s_temp += (outdoor_temp - s_temp) * (1.0 - exp(-dt / ROOM_TAU_S));
+        s_hum += (outdoor_hum - s_hum) * (1.0 - exp(-dt / ROOM_TAU_S));
+        if (fan) {
+            s_temp += (outdoor_temp - FAN_COOLING - s_temp) * (1.0 - exp(-dt / FAN_TAU_S));
+            s_fan_on_s += dt;
+        }
+        if (humidifier) {
+            s_hum = fmin(s_hum + HUMIDIFIER_RATE * dt, HUMIDITY_MAX);
+            s_humidifier_on_s += dt;
+        }
+        s_updated_us += step_us;
+    }
+}
+
+void sim_room_measure(int64_t now_us, float *temperature, float *humidity)
+{
+    sim_room_advance(now_us);
+
+    double t = s_temp + NOISE_TEMP * noise();
+    double h = s_hum + NOISE_HUM * noise();
+    if (next_random() % 1000 < SPIKE_PER_MILLE) {
+        t += SPIKE_SIZE;
+    }
+    *temperature = (float)t;
+    *humidity = (float)fmax(0.0, fmin(100.0, h));
+}
+
+void sim_room_write_json(telemetry_json_writer_t *w)
+{
+    telemetry_json_key(w, "temperature");
+    telemetry_json_number(w, round(s_temp * 100.0) / 100.0);
+    telemetry_json_key(w, "humidity");
+    telemetry_json_number(w, round(s_hum * 100.0) / 100.0);
+    telemetry_json_key(w, "humidifier_on_s");
+    telemetry_json_number(w, round(s_humidifier_on_s));
+    telemetry_json_key(w, "fan_on_s");
+    telemetry_json_number(w, round(s_fan_on_s));
+    telemetry_json_key(w, "humidifier_switches");
+    telemetry_json_number(w, sim_gpio_toggles(SIM_HUMIDIFIER_PIN));
+    telemetry_json_key(w, "fan_switches");
+    telemetry_json_number(w, sim_gpio_toggles(SIM_FAN_PIN));
+}
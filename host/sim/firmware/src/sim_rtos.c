@@ -0,0 +1,623 @@
+/**
+ * @file sim_rtos.c
+ * @brief FreeRTOS on a virtual clock: tasks are ucontext coroutines on one
+ *        host thread.
+ *
+ * The highest-priority ready task runs until it blocks, or until it makes a
+ * task of higher priority ready (queue send, semaphore give, notification),
+ * as on one core with preemption. Equal priorities take turns in the order
+ * they became ready.
+ *
+ * Clock: while a task runs, virtual time follows the host's monotonic
+ * clock, so what the firmware measures around its own code is real host
+ * time. Once every task is blocked the clock jumps to the earliest wake-up,
+ * which is what makes a simulated day take seconds. The jump is held back
+ * while a network reply is due (sim_wait_fd), so a local broker keeps up.
+ */
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "sim.h"
+
+#define SIM_MAX_TASKS       24
+/* Host stacks: glibc's printf alone needs more than most target stacks */
+#define SIM_STACK_SIZE      (64 * 1024)
+#define SIM_STACK_PAINT     0xa5
+/* Task control block charged to the heap with the stack, about what ESP-IDF uses */
+#define SIM_TCB_SIZE        352
+/* What the 1536-byte idle task stack of ESP-IDF typically keeps free */
+#define SIM_IDLE_STACK_FREE 1000
+#define NO_WAKE             INT64_MAX
+
+typedef enum {
+    TASK_READY,
+    TASK_BLOCKED,
+    TASK_DELETED,
+} task_state_t;
+
+struct sim_task {
+    ucontext_t ctx;
+    char name[16];
+    UBaseType_t number;
+    UBaseType_t priority;
+    TaskFunction_t fn;
+    void *arg;
+    task_state_t state;
+    const void *wait_obj;       /* woken by wake(wait_obj); NULL for a plain delay */
+    int64_t wake_us;            /* virtual deadline, NO_WAKE for none */
+    bool timed_out;
+    int wait_fd;                /* -1: not waiting for a socket */
+    bool fd_ready;
+    int64_t reply_due_real_us;
+    uint64_t ready_seq;
+    uint32_t notify;
+    uint32_t depth;             /* target stack size, charged to the heap */
+    uint8_t *stack;
+    uint64_t cpu_us;
+};
+
+struct sim_queue {
+    uint8_t *items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    char data_waiters;          /* addresses used as wait objects */
+    char space_waiters;
+};
+
+static struct sim_task s_tasks[SIM_MAX_TASKS];
+static UBaseType_t s_task_count = 0;
+static struct sim_task *s_current = NULL;
+static uint64_t s_ready_seq = 0;
+static ucontext_t s_boot_ctx;
+static ucontext_t s_idle_ctx;
+
+static int64_t s_virtual_us = 0;    /* virtual time at s_anchor_real_us */
+static int64_t s_anchor_real_us = 0;
+static int64_t s_switch_real_us = 0;
+static int64_t s_end_us = NO_WAKE;
+static uint64_t s_idle_real_us = 0;
+
+int64_t sim_real_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return s_virtual_us + (sim_real_us() - s_anchor_real_us);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+static void jump_to(int64_t us)
+{
+    int64_t real = sim_real_us();
+    if (us > s_virtual_us + (real - s_anchor_real_us)) {
+        s_virtual_us = us;
+        s_anchor_real_us = real;
+    }
+}
+
+static int64_t deadline_for(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? NO_WAKE : esp_timer_get_time() + (int64_t)ticks * 1000;
+}
+
+static void make_ready(struct sim_task *t)
+{
+    t->state = TASK_READY;
+    t->wait_obj = NULL;
+    t->wait_fd = -1;
+    t->ready_seq = ++s_ready_seq;
+}
+
+static struct sim_task *pick_ready(void)
+{
+    struct sim_task *best = NULL;
+
+    for (UBaseType_t i = 0; i < s_task_count; i++) {
+        struct sim_task *t = &s_tasks[i];
+        if (t->state == TASK_READY &&
+            (best == NULL || t->priority > best->priority ||
+             (t->priority == best->priority && t->ready_seq < best->ready_seq))) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+/* Charges the host time since the last switch to the running task, or to idle */
+static void charge_current(void)
+{
+    int64_t real = sim_real_us();
+
+    if (s_current != NULL) {
+        s_current->cpu_us += (uint64_t)(real - s_switch_real_us);
+    } else {
+        s_idle_real_us += (uint64_t)(real - s_switch_real_us);
+    }
+    s_switch_real_us = real;
+}
+
+/* Every task is blocked: wait for sockets, then move the clock to the next wake-up */
+static void idle_step(void)
+{
+    struct pollfd fds[SIM_MAX_TASKS];
+    struct sim_task *fd_task[SIM_MAX_TASKS];
+    int nfds = 0;
+    int64_t next_wake = NO_WAKE;
+    int64_t real = sim_real_us();
+    int64_t reply_due = 0;
+
+    for (UBaseType_t i = 0; i < s_task_count; i++) {
+        struct sim_task *t = &s_tasks[i];
+        if (t->state != TASK_BLOCKED) {
+            continue;
+        }
+        if (t->wake_us < next_wake) {
+            next_wake = t->wake_us;
+        }
+        if (t->wait_fd >= 0) {
+            fds[nfds] = (struct pollfd) { .fd = t->wait_fd, .events = POLLIN };
+            fd_task[nfds++] = t;
+            if (t->reply_due_real_us > reply_due) {
+                reply_due = t->reply_due_real_us;
+            }
+        }
+    }
+    if (next_wake >= s_end_us) {
+        next_wake = s_end_us;
+    }
+
+    // Poll in real time only while a reply is due, and never past the next wake-up
+    int timeout_ms = 0;
+    int64_t now = esp_timer_get_time();
+    if (reply_due > real) {
+        int64_t wait_us = reply_due - real;
+        if (next_wake != NO_WAKE && next_wake - now < wait_us) {
+            wait_us = next_wake - now > 0 ? next_wake - now : 0;
+        }
+        timeout_ms = (int)((wait_us + 999) / 1000);
+    } else if (next_wake == NO_WAKE) {
+        if (nfds == 0) {
+            fprintf(stderr, "sim: every task is blocked forever\n");
+            sim_finish(1);
+        }
+        timeout_ms = -1;
+    }
+
+    bool woken = false;
+    if (nfds > 0 && poll(fds, (nfds_t)nfds, timeout_ms) > 0) {
+        for (int i = 0; i < nfds; i++) {
+            if (fds[i].revents != 0) {
+                fd_task[i]->fd_ready = true;
+                make_ready(fd_task[i]);
+                woken = true;
+            }
+        }
+    } else if (nfds == 0 && timeout_ms > 0) {
+        struct timespec ts = { .tv_sec = timeout_ms / 1000, .tv_nsec = (long)(timeout_ms % 1000) * 1000000 };
+        nanosleep(&ts, NULL);
+    }
+
+    now = esp_timer_get_time();
+    if (!woken && reply_due <= sim_real_us() && next_wake != NO_WAKE && next_wake > now) {
+        jump_to(next_wake);
+        now = next_wake;
+    }
+    if (now >= s_end_us) {
+        sim_finish(0);
+    }
+    for (UBaseType_t i = 0; i < s_task_count; i++) {
+        struct sim_task *t = &s_tasks[i];
+        if (t->state == TASK_BLOCKED && t->wake_us <= now) {
+            t->timed_out = true;
+            make_ready(t);
+        }
+    }
+}
+
+/*
+ * The idle task: runs on its own stack whenever no task is ready, so the
+ * waiting and clock jumps above cost the firmware's stacks nothing.
+ */
+static void idle_loop(void)
+{
+    for (;;) {
+        struct sim_task *next = pick_ready();
+        if (next == NULL) {
+            idle_step();
+            continue;
+        }
+        charge_current();
+        s_current = next;
+        swapcontext(&s_idle_ctx, &next->ctx);
+    }
+}
+
+/* Runs the best ready task; returns once the caller is chosen again */
+static void schedule(void)
+{
+    struct sim_task *self = s_current;
+    struct sim_task *next = pick_ready();
+
+    if (next == self) {
+        return;
+    }
+    charge_current();
+    s_current = next;
+    swapcontext(&self->ctx, next != NULL ? &next->ctx : &s_idle_ctx);
+}
+
+/* Blocks the current task on obj; false once deadline passed */
+static bool block_until(const void *obj, int64_t deadline)
+{
+    struct sim_task *self = s_current;
+
+    if (deadline <= esp_timer_get_time()) {
+        return false;
+    }
+    self->state = TASK_BLOCKED;
+    self->wait_obj = obj;
+    self->wake_us = deadline;
+    self->timed_out = false;
+    schedule();
+    return !self->timed_out;
+}
+
+static void wake(const void *obj)
+{
+    for (UBaseType_t i = 0; i < s_task_count; i++) {
+        struct sim_task *t = &s_tasks[i];
+        if (t->state == TASK_BLOCKED && t->wait_obj == obj) {
+            make_ready(t);
+        }
+    }
+}
+
+/* Gives the core to a higher-priority task made ready by the caller */
+static void preempt(void)
+{
+    if (s_current == NULL) {
+        return;     // before sim_rtos_run(), or on the idle task
+    }
+    struct sim_task *next = pick_ready();
+    if (next != NULL && next->priority > s_current->priority) {
+        s_current->ready_seq = 0;   // first in line again among its priority
+        schedule();
+    }
+}
+
+void sim_sleep_us(int64_t us)
+{
+    int64_t deadline = esp_timer_get_time() + us;
+    while (block_until(NULL, deadline)) {
+    }
+}
+
+bool sim_wait_fd(int fd, TickType_t ticks, int64_t reply_due_real_us)
+{
+    struct sim_task *self = s_current;
+
+    if (self->notify > 0) {
+        return false;
+    }
+    self->wait_fd = fd;
+    self->fd_ready = false;
+    self->reply_due_real_us = reply_due_real_us;
+    block_until(&self->notify, deadline_for(ticks));
+    self->wait_fd = -1;
+    return self->fd_ready;
+}
+
+void sim_rtos_cpu(uint64_t *busy_us, uint64_t *idle_us)
+{
+    uint64_t busy = 0;
+    for (UBaseType_t i = 0; i < s_task_count; i++) {
+        busy += s_tasks[i].cpu_us;
+    }
+    *busy_us = busy;
+    *idle_us = s_idle_real_us;
+}
+
+static void task_entry(void)
+{
+    s_current->fn(s_current->arg);
+    vTaskDelete(NULL);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                       void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask)
+{
+    if (s_task_count >= SIM_MAX_TASKS || !sim_heap_charge(usStackDepth + SIM_TCB_SIZE)) {
+        return pdFAIL;
+    }
+    uint8_t *stack = mmap(NULL, SIM_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stack == MAP_FAILED) {
+        sim_heap_release(usStackDepth + SIM_TCB_SIZE);
+        return pdFAIL;
+    }
+    memset(stack, SIM_STACK_PAINT, SIM_STACK_SIZE);
+
+    struct sim_task *t = &s_tasks[s_task_count];
+    memset(t, 0, sizeof(*t));
+    snprintf(t->name, sizeof(t->name), "%s", pcName);
+    t->number = ++s_task_count;
+    t->priority = uxPriority;
+    t->fn = pvTaskCode;
+    t->arg = pvParameters;
+    t->depth = usStackDepth;
+    t->stack = stack;
+    t->wake_us = NO_WAKE;
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = stack;
+    t->ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+    t->ctx.uc_link = NULL;
+    makecontext(&t->ctx, task_entry, 0);
+    make_ready(t);
+
+    if (pxCreatedTask != NULL) {
+        *pxCreatedTask = t;
+    }
+    preempt();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTask)
+{
+    struct sim_task *t = xTask != NULL ? xTask : s_current;
+
+    // The stack stays mapped: the task may be standing on it
+    t->state = TASK_DELETED;
+    sim_heap_release(t->depth + SIM_TCB_SIZE);
+    if (t == s_current) {
+        schedule();
+    }
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+    if (xTicksToDelay == 0) {
+        taskYIELD();
+        return;
+    }
+    sim_sleep_us((int64_t)xTicksToDelay * 1000);
+}
+
+void vTaskDelayUntil(TickType_t *pxPreviousWakeTime, TickType_t xTimeIncrement)
+{
+    *pxPreviousWakeTime += xTimeIncrement;
+    int64_t deadline = (int64_t)*pxPreviousWakeTime * 1000;
+    while (block_until(NULL, deadline)) {
+    }
+}
+
+void taskYIELD(void)
+{
+    s_current->ready_seq = ++s_ready_seq;
+    schedule();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_current;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    struct sim_task *self = s_current;
+    int64_t deadline = deadline_for(xTicksToWait);
+
+    while (self->notify == 0) {
+        if (!block_until(&self->notify, deadline)) {
+            return 0;
+        }
+    }
+    uint32_t value = self->notify;
+    self->notify = xClearCountOnExit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+    xTaskToNotify->notify++;
+    wake(&xTaskToNotify->notify);
+    preempt();
+    return pdPASS;
+}
+
+/*
+ * Lowest free stack against the size the firmware asked for, from the
+ * bytes of the host stack below the deepest point the task reached. glibc
+ * needs more stack than newlib (printf of floats, libm), so tasks that
+ * format numbers show less free stack than on the device. Once the host
+ * used the whole target size the figure says nothing about the device:
+ * false, and the task is reported without a stack base.
+ */
+static bool stack_unused(const struct sim_task *t, uint32_t *unused)
+{
+    size_t n = 0;
+    while (n < SIM_STACK_SIZE && t->stack[n] == SIM_STACK_PAINT) {
+        n++;
+    }
+    size_t used = SIM_STACK_SIZE - n;
+    *unused = used < t->depth ? (uint32_t)(t->depth - used) : 0;
+    return used < t->depth;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *pxTaskStatusArray, UBaseType_t uxArraySize,
+                                 uint32_t *pulTotalRunTime)
+{
+    uint64_t busy = 0;
+    UBaseType_t n = 0;
+
+    for (UBaseType_t i = 0; i < s_task_count && n < uxArraySize; i++) {
+        struct sim_task *t = &s_tasks[i];
+        busy += t->cpu_us;
+        if (t->state == TASK_DELETED) {
+            continue;
+        }
+        uint32_t unused;
+        bool measured = stack_unused(t, &unused);
+        pxTaskStatusArray[n++] = (TaskStatus_t) {
+            .xHandle = t,
+            .pcTaskName = t->name,
+            .xTaskNumber = t->number,
+            .eCurrentState = t == s_current ? eRunning : t->state == TASK_READY ? eReady : eBlocked,
+            .uxCurrentPriority = t->priority,
+            .uxBasePriority = t->priority,
+            .ulRunTimeCounter = (uint32_t)t->cpu_us,
+            .pxStackBase = measured ? t->stack : NULL,
+            .usStackHighWaterMark = unused,
+        };
+    }
+
+    // As on the device, the idle task gets the time nobody else used
+    uint64_t total = (uint64_t)esp_timer_get_time();
+    if (n < uxArraySize) {
+        pxTaskStatusArray[n++] = (TaskStatus_t) {
+            .pcTaskName = "IDLE",
+            .xTaskNumber = SIM_MAX_TASKS + 1,
+            .eCurrentState = eReady,
+            .ulRunTimeCounter = (uint32_t)(total > busy ? total - busy : 0),
+            .pxStackBase = s_idle_ctx.uc_stack.ss_sp,
+            .usStackHighWaterMark = SIM_IDLE_STACK_FREE,
+        };
+    }
+    if (pulTotalRunTime != NULL) {
+        *pulTotalRunTime = (uint32_t)total;
+    }
+    return n;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    size_t bytes = (size_t)uxQueueLength * uxItemSize;
+    if (uxQueueLength == 0) {
+        return NULL;
+    }
+    // From the simulated heap, like the firmware's own allocations
+    struct sim_queue *q = calloc(1, sizeof(*q) + bytes);
+    if (q == NULL) {
+        return NULL;
+    }
+    q->items = (uint8_t *)(q + 1);
+    q->length = uxQueueLength;
+    q->item_size = uxItemSize;
+    return q;
+}
+
+QueueHandle_t sim_semaphore_create(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    QueueHandle_t q = xQueueCreate(max_count, 0);
+    if (q != NULL) {
+        q->count = initial_count;
+    }
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    free(xQueue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    int64_t deadline = deadline_for(xTicksToWait);
+
+    while (xQueue->count >= xQueue->length) {
+        if (!block_until(&xQueue->space_waiters, deadline)) {
+            return pdFALSE;
+        }
+    }
+    if (xQueue->item_size > 0) {
+        UBaseType_t tail = (xQueue->head + xQueue->count) % xQueue->length;
+        memcpy(&xQueue->items[tail * xQueue->item_size], pvItemToQueue, xQueue->item_size);
+    }
+    xQueue->count++;
+    wake(&xQueue->data_waiters);
+    preempt();
+    return pdTRUE;
+}
+
+static BaseType_t queue_take(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait, bool remove)
+{
+    int64_t deadline = deadline_for(xTicksToWait);
+
+    while (xQueue->count == 0) {
+        if (!block_until(&xQueue->data_waiters, deadline)) {
+            return pdFALSE;
+        }
+    }
+    if (xQueue->item_size > 0) {
+        memcpy(pvBuffer, &xQueue->items[xQueue->head * xQueue->item_size], xQueue->item_size);
+    }
+    if (remove) {
+        xQueue->head = (xQueue->head + 1) % xQueue->length;
+        xQueue->count--;
+        wake(&xQueue->space_waiters);
+        preempt();
+    }
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    return queue_take(xQueue, pvBuffer, xTicksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    return queue_take(xQueue, pvBuffer, xTicksToWait, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue)
+{
+    xQueue->count = 0;
+    xQueue->head = 0;
+    wake(&xQueue->space_waiters);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    return xQueue->count;
+}
+
+void sim_rtos_run(int64_t end_us)
+{
+    s_end_us = end_us;
+    s_anchor_real_us = sim_real_us();
+    s_switch_real_us = s_anchor_real_us;
+
+    void *stack = mmap(NULL, SIM_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stack == MAP_FAILED) {
+        fprintf(stderr, "sim: no stack for the idle task\n");
+        exit(1);
+    }
+    getcontext(&s_idle_ctx);
+    s_idle_ctx.uc_stack.ss_sp = stack;
+    s_idle_ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+    s_idle_ctx.uc_link = NULL;
+    makecontext(&s_idle_ctx, idle_loop, 0);
+    swapcontext(&s_boot_ctx, &s_idle_ctx);
+    // Tasks end the run with sim_finish(); nothing switches back here
+    abort();
+}
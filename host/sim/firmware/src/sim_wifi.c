@@ -0,0 +1,157 @@
+/**
+ * @file sim_wifi.c
+ * @brief Stands in for components/service_wifi: a station that associates
+ *        800 ms after start and drops out for the --outage windows.
+ *
+ * Events are delivered synchronously on the "wifi" task, which plays the
+ * part of the default event loop task.
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "service_wifi.h"
+#include "sim.h"
+
+#define SIM_MAX_HANDLERS        8
+#define ASSOCIATE_MS            800
+#define WIFI_TASK_PRIORITY      23
+#define WIFI_TASK_STACK_SIZE    3584
+#define LINK_RSSI               (-50)
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+static const char *TAG = "WIFI_SERVICE";
+
+static struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} s_handlers[SIM_MAX_HANDLERS];
+static int s_handler_count = 0;
+static volatile bool s_connected = false;
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+                                              esp_event_handler_t event_handler, void *event_handler_arg,
+                                              esp_event_handler_instance_t *instance)
+{
+    if (event_handler == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_handler_count >= SIM_MAX_HANDLERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_handlers[s_handler_count].base = event_base;
+    s_handlers[s_handler_count].id = event_id;
+    s_handlers[s_handler_count].handler = event_handler;
+    s_handlers[s_handler_count].arg = event_handler_arg;
+    if (instance != NULL) {
+        *instance = &s_handlers[s_handler_count];
+    }
+    s_handler_count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void *event_data,
+                         size_t event_data_size, TickType_t ticks_to_wait)
+{
+    for (int i = 0; i < s_handler_count; i++) {
+        if (s_handlers[i].base == event_base &&
+            (s_handlers[i].id == ESP_EVENT_ANY_ID || s_handlers[i].id == event_id)) {
+            s_handlers[i].handler(s_handlers[i].arg, event_base, event_id, (void *)event_data);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    if (!s_connected) {
+        return ESP_FAIL;
+    }
+    *ap_info = (wifi_ap_record_t) { .ssid = CONFIG_WIFI_SSID, .rssi = LINK_RSSI };
+    return ESP_OK;
+}
+
+bool wifi_service_is_connected(void)
+{
+    return s_connected;
+}
+
+bool sim_wifi_link_up(void)
+{
+    return s_connected;
+}
+
+/* Virtual time since the first boot, which is what --outage counts from */
+static int64_t run_time_us(void)
+{
+    return g_sim_boot_offset_us + esp_timer_get_time();
+}
+
+static void wait_until(int64_t run_us)
+{
+    int64_t left = run_us - run_time_us();
+    if (left > 0) {
+        vTaskDelay(pdMS_TO_TICKS((left + 999) / 1000));
+    }
+}
+
+static void set_link(bool up)
+{
+    s_connected = up;
+    if (up) {
+        ESP_LOGI(TAG, "Got IP:127.0.0.1");
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, NULL, 0, 0);
+        esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, NULL, 0, 0);
+    } else {
+        ESP_LOGI(TAG, "WiFi disconnected");
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, NULL, 0, 0);
+    }
+    sim_mqtt_link_changed();
+}
+
+static void wifi_task(void *arg)
+{
+    vTaskDelay(pdMS_TO_TICKS(ASSOCIATE_MS));
+
+    for (int i = 0; i < g_sim.outage_count; i++) {
+        int64_t start = (int64_t)g_sim.outages[i].at_s * 1000000;
+        int64_t end = start + (int64_t)g_sim.outages[i].for_s * 1000000;
+        if (end <= run_time_us()) {
+            continue;   // over before this boot
+        }
+        // A boot inside an outage stays offline until it ends
+        if (start > run_time_us()) {
+            if (!s_connected) {
+                set_link(true);
+            }
+            wait_until(start);
+            set_link(false);
+        }
+        wait_until(end);
+        vTaskDelay(pdMS_TO_TICKS(ASSOCIATE_MS));
+    }
+    if (!s_connected) {
+        set_link(true);
+    }
+    vTaskDelete(NULL);
+}
+
+void wifi_service_start(void)
+{
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, 0);
+    if (xTaskCreate(wifi_task, "wifi", WIFI_TASK_STACK_SIZE, NULL, WIFI_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the Wi-Fi task");
+    }
+}
@@ -0,0 +1,174 @@
+/**
+ * @file sim_climate_control.c
+ * @brief Runs the on-device control law against a simulated room.
+ *
+ * Room model, one step per second:
+ *   humidity relaxes towards the outdoor level through leakage and rises
+ *   while the humidifier runs; the mist only reaches the sensor after a
+ *   transport delay. The sensor is sampled every SAMPLE_PERIOD_S with a
+ *   little deterministic noise, exactly like sht3x_task feeds the loop.
+ *
+ * For each controller setting the run reports tracking error, overshoot,
+ * relay switch count and the shortest on/off periods, and fails (exit 1)
+ * if a minimum on/off time was ever violated or the loop never settled
+ * near its setpoint.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "control_loop.h"
+
+#define SIM_DURATION_S      (6 * 3600)
+#define SETTLE_S            (2 * 3600)     /* metrics ignore the first two hours */
+#define SAMPLE_PERIOD_S     2
+#define DEAD_TIME_S         20
+
+typedef struct {
+    float outdoor;          /* %RH the room leaks towards */
+    float leak_tau_s;       /* leakage time constant */
+    float humidifier_rate;  /* %RH per second while running */
+    float humidity;
+    bool pipeline[DEAD_TIME_S];
+} room_t;
+
+typedef struct {
+    const char *name;
+    control_params_t params;
+    float max_abs_error;    /* pass criterion after settling */
+} scenario_t;
+
+typedef struct {
+    double abs_error_sum;
+    uint32_t abs_error_n;
+    float overshoot;
+    uint32_t switches;
+    uint32_t shortest_on_s;
+    uint32_t shortest_off_s;
+    uint32_t violations;
+} result_t;
+
+static uint32_t rng_state = 12345;
+
+/* Uniform noise in [-amplitude, amplitude], reproducible across runs */
+static float noise(float amplitude)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return ((float)(rng_state >> 8) / (float)(1u << 24) * 2.0f - 1.0f) * amplitude;
+}
+
+static void room_step(room_t *room, bool humidifier_on, uint32_t t)
+{
+    bool effective = room->pipeline[t % DEAD_TIME_S];
+    room->pipeline[t % DEAD_TIME_S] = humidifier_on;
+
+    room->humidity += (room->outdoor - room->humidity) / room->leak_tau_s;
+    if (effective) {
+        room->humidity += room->humidifier_rate;
+    }
+    if (room->humidity > 100.0f) {
+        room->humidity = 100.0f;
+    }
+}
+
+static result_t run(const scenario_t *sc)
+{
+    room_t room = {
+        .outdoor = 35.0f,
+        .leak_tau_s = 900.0f,
+        .humidifier_rate = 0.04f,
+        .humidity = 40.0f,
+    };
+    control_loop_t loop;
+    result_t res = { .shortest_on_s = UINT32_MAX, .shortest_off_s = UINT32_MAX };
+    bool relay = false;
+    uint32_t last_switch_s = 0;
+
+    rng_state = 12345;
+    control_loop_init(&loop, CONTROL_ACTION_RAISE, &sc->params);
+
+    for (uint32_t t = 0; t < SIM_DURATION_S; t++) {
+        if (t % SAMPLE_PERIOD_S == 0) {
+            float measured = room.humidity + noise(0.3f);
+            bool want = control_loop_update(&loop, measured, (uint64_t)t * 1000);
+
+            if (want != relay) {
+                uint32_t held = t - last_switch_s;
+                if (t >= SETTLE_S) {
+                    if (relay) {
+                        res.shortest_on_s = held < res.shortest_on_s ? held : res.shortest_on_s;
+                        res.violations += held * 1000 < sc->params.min_on_ms;
+                    } else {
+                        res.shortest_off_s = held < res.shortest_off_s ? held : res.shortest_off_s;
+                        res.violations += held * 1000 < sc->params.min_off_ms;
+                    }
+                    res.switches++;
+                }
+                relay = want;
+                last_switch_s = t;
+            }
+        }
+
+        room_step(&room, relay, t);
+
+        if (t >= SETTLE_S) {
+            float error = room.humidity - sc->params.setpoint;
+            res.abs_error_sum += fabsf(error);
+            res.abs_error_n++;
+            if (error > res.overshoot) {
+                res.overshoot = error;
+            }
+        }
+    }
+    return res;
+}
+
+int main(void)
+{
+    const scenario_t scenarios[] = {
+        {
+            .name = "hysteresis 4%",
+            .params = { .mode = CONTROL_MODE_HYSTERESIS, .setpoint = 55.0f, .hysteresis = 4.0f,
+                        .min_on_ms = 30000, .min_off_ms = 30000 },
+            .max_abs_error = 3.0f,
+        },
+        {
+            .name = "hysteresis 1%",
+            .params = { .mode = CONTROL_MODE_HYSTERESIS, .setpoint = 55.0f, .hysteresis = 1.0f,
+                        .min_on_ms = 60000, .min_off_ms = 60000 },
+            .max_abs_error = 3.0f,
+        },
+        {
+            .name = "pid",
+            .params = { .mode = CONTROL_MODE_PID, .setpoint = 55.0f, .kp = 0.1f, .ki = 0.0005f,
+                        .window_ms = 120000, .min_on_ms = 30000, .min_off_ms = 30000 },
+            .max_abs_error = 1.5f,
+        },
+        {
+            .name = "pid, no min times",
+            .params = { .mode = CONTROL_MODE_PID, .setpoint = 55.0f, .kp = 0.1f, .ki = 0.0005f,
+                        .window_ms = 120000 },
+            .max_abs_error = 1.5f,
+        },
+    };
+    int failures = 0;
+
+    printf("%-20s %10s %10s %9s %9s %9s %s\n",
+           "controller", "mean|err|", "overshoot", "switches", "min on s", "min off s", "result");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        const scenario_t *sc = &scenarios[i];
+        result_t res = run(sc);
+        float mean = res.abs_error_n ? (float)(res.abs_error_sum / res.abs_error_n) : 0.0f;
+        bool ok = res.violations == 0 && mean <= sc->max_abs_error;
+
+        printf("%-20s %10.2f %10.2f %9lu %9lu %9lu %s\n", sc->name, mean, res.overshoot,
+               (unsigned long)res.switches,
+               (unsigned long)(res.shortest_on_s == UINT32_MAX ? 0 : res.shortest_on_s),
+               (unsigned long)(res.shortest_off_s == UINT32_MAX ? 0 : res.shortest_off_s),
+               ok ? "ok" : "FAIL");
+        failures += !ok;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file sim_relay_bank.c
+ * @brief Drives the relay bank through the recording mock backend and checks
+ *        the frames it writes.
+ *
+ * Covers the boot frame (all off, written before the outputs are enabled),
+ * active-low inversion, one frame per multi-channel apply, no write when
+ * nothing changes, an unchanged shadow after a failed write and the mask of
+ * a full 32-channel bank. Exits 1 on the first mismatch.
+ */
+
+#include <stdio.h>
+#include "relay_bank.h"
+#include "relay_bank_mock.h"
+
+static int failures;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);          \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static void check_init(void)
+{
+    relay_bank_mock_t mock;
+    relay_bank_backend_t backend;
+    relay_bank_t bank;
+
+    relay_bank_mock_init(&mock, &backend);
+    CHECK(relay_bank_init(&bank, &backend, 4, 0) == ESP_OK);
+    CHECK(mock.writes == 1 && mock.history[0] == 0);
+    CHECK(mock.enabled && mock.writes_at_enable == 1);
+    CHECK(relay_bank_get_states(&bank) == 0);
+
+    relay_bank_mock_init(&mock, &backend);
+    CHECK(relay_bank_init(&bank, &backend, 0, 0) == ESP_ERR_INVALID_ARG);
+    CHECK(relay_bank_init(&bank, &backend, RELAY_BANK_MAX_CHANNELS + 1, 0) == ESP_ERR_INVALID_ARG);
+    CHECK(mock.writes == 0 && !mock.enabled);
+
+    // A failed boot frame leaves the outputs disabled
+    relay_bank_mock_init(&mock, &backend);
+    mock.fail_with = ESP_FAIL;
+    CHECK(relay_bank_init(&bank, &backend, 4, 0) == ESP_FAIL);
+    CHECK(mock.writes == 0 && !mock.enabled);
+}
+
+static void check_active_low(void)
+{
+    relay_bank_mock_t mock;
+    relay_bank_backend_t backend;
+    relay_bank_t bank;
+
+    // Channels 1 and 3 are active-low; bits above the 4 channels are ignored
+    relay_bank_mock_init(&mock, &backend);
+    CHECK(relay_bank_init(&bank, &backend, 4, 0xFAu) == ESP_OK);
+    CHECK(mock.history[0] == 0xAu);
+    CHECK(mock.writes_at_enable == 1);
+
+    CHECK(relay_bank_apply(&bank, 0x3u, 0x3u) == ESP_OK);
+    CHECK(mock.levels == 0x9u);
+    CHECK(relay_bank_get_states(&bank) == 0x3u);
+}
+
+static void check_apply(void)
+{
+    relay_bank_mock_t mock;
+    relay_bank_backend_t backend;
+    relay_bank_t bank;
+
+    relay_bank_mock_init(&mock, &backend);
+    CHECK(relay_bank_init(&bank, &backend, 8, 0) == ESP_OK);
+
+    // Three channels in one apply: a single frame
+    CHECK(relay_bank_apply(&bank, 0x16u, 0x16u) == ESP_OK);
+    CHECK(mock.writes == 2 && mock.history[1] == 0x16u);
+
+    // Channels outside the mask keep their state
+    CHECK(relay_bank_apply(&bank, 0x3u, 0x1u) == ESP_OK);
+    CHECK(mock.writes == 3 && mock.levels == 0x15u);
+
+    // Target equals the shadow: no write
+    CHECK(relay_bank_apply(&bank, 0x15u, 0x15u) == ESP_OK);
+    CHECK(relay_bank_apply(&bank, 0u, 0xFFu) == ESP_OK);
+    CHECK(relay_bank_apply(&bank, 0x100u, 0x100u) == ESP_OK);
+    CHECK(mock.writes == 3);
+
+    // A failed write leaves the shadow unchanged, so the next apply retries
+    mock.fail_with = ESP_ERR_TIMEOUT;
+    CHECK(relay_bank_apply(&bank, 0x1u, 0x0u) == ESP_ERR_TIMEOUT);
+    CHECK(relay_bank_get_states(&bank) == 0x15u);
+    CHECK(mock.writes == 3 && mock.levels == 0x15u);
+    CHECK(relay_bank_apply(&bank, 0x1u, 0x0u) == ESP_OK);
+    CHECK(mock.writes == 4 && mock.levels == 0x14u);
+    CHECK(relay_bank_get_states(&bank) == 0x14u);
+}
+
+static void check_32_channels(void)
+{
+    relay_bank_mock_t mock;
+    relay_bank_backend_t backend;
+    relay_bank_t bank;
+
+    relay_bank_mock_init(&mock, &backend);
+    CHECK(relay_bank_init(&bank, &backend, 32, 0x80000001u) == ESP_OK);
+    CHECK(bank.channel_mask == UINT32_MAX);
+    CHECK(mock.history[0] == 0x80000001u);
+
+    CHECK(relay_bank_apply(&bank, UINT32_MAX, UINT32_MAX) == ESP_OK);
+    CHECK(relay_bank_get_states(&bank) == UINT32_MAX);
+    CHECK(mock.levels == 0x7FFFFFFEu);
+    CHECK(relay_bank_apply(&bank, 0x80000000u, 0) == ESP_OK);
+    CHECK(mock.levels == 0xFFFFFFFEu);
+    CHECK(mock.writes == 3);
+}
+
+int main(void)
+{
+    check_init();
+    check_active_low();
+    check_apply();
+    check_32_channels();
+
+    printf("%s\n", failures == 0 ? "ok" : "FAIL");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file sim_sample_filter.c
+ * @brief Replays a synthetic day of SHT3x samples through the sample filter
+ *        and the rollup aggregator.
+ *
+ * The room is mostly steady with sensor noise and occasional spikes, plus a
+ * few real changes (a slow afternoon warm-up and a humidifier burst). The
+ * run reports how many samples would be published with the default
+ * deadband settings and how far the last published value ever lagged the
+ * true value, and fails (exit 1) if the reduction is below 10x or a real
+ * change was missed by more than twice the deadband.
+ *
+ * The same raw samples go into one-minute rollups, which fail the run if a
+ * window loses samples, a spike does not show up in its window's max, or a
+ * window mean strays from the true value by more than the noise allows.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "sample_filter.h"
+#include "sample_rollup.h"
+
+#define PERIOD_MS       2000
+#define DURATION_MS     (24ull * 3600 * 1000)
+#define ROLLUP_MS       60000
+
+static uint32_t rng_state = 4242;
+
+static float noise(float amplitude)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return ((float)(rng_state >> 8) / (float)(1u << 24) * 2.0f - 1.0f) * amplitude;
+}
+
+/* True room state: 24 C / 50 %RH, +2 C over the afternoon, a 30 min humidifier burst */
+static void room(uint64_t t_ms, float *temp, float *hum)
+{
+    double h = (double)t_ms / 3600000.0;
+    *temp = 24.0f + (h > 12.0 && h < 18.0 ? (float)(2.0 * sin((h - 12.0) / 6.0 * M_PI)) : 0.0f);
+    *hum = 50.0f + (h > 8.0 && h < 8.5 ? (float)((h - 8.0) * 20.0) : (h >= 8.5 && h < 10.0 ? (float)(10.0 - (h - 8.5) * 6.67) : 0.0f));
+}
+
+int main(void)
+{
+    const sample_filter_config_t cfg = {
+        .median_len = 3, .ema_alpha = 0.3f,
+        .temp_deadband = 0.10f, .hum_deadband = 0.50f, .heartbeat_ms = 300000,
+    };
+    sample_filter_t filter;
+    uint32_t raw_count = 0, spikes = 0;
+    float published_temp = 0.0f, published_hum = 0.0f;
+    float worst_temp_lag = 0.0f, worst_hum_lag = 0.0f;
+
+    sample_rollup_t rollup;
+    telemetry_rollup_t window;
+    uint32_t rolled_up = 0, spikes_seen = 0, bad_windows = 0;
+    float worst_mean_error = 0.0f;
+    float window_true_temp = 0.0f;      /* true temperature summed over the open window */
+
+    sample_filter_init(&filter, &cfg);
+    sample_rollup_init(&rollup, ROLLUP_MS);
+
+    for (uint64_t t = 0; t < DURATION_MS; t += PERIOD_MS) {
+        float true_temp, true_hum;
+        room(t, &true_temp, &true_hum);
+
+        telemetry_sample_t raw = {
+            .timestamp_ms = t,
+            .temperature = true_temp + noise(0.05f),
+            .humidity = true_hum + noise(0.3f),
+        };
+        // Roughly one glitched read per hour
+        if (raw_count % 1800 == 900) {
+            raw.temperature += 5.0f;
+            spikes++;
+        }
+        raw_count++;
+
+        if (sample_rollup_add(&rollup, &raw, &window)) {
+            float true_mean = window_true_temp / (float)window.count;
+            if (window.temperature.max > true_mean + 4.0f) {
+                spikes_seen++;
+            } else {
+                // The mean of a spike window is expected to move; only check clean ones
+                float error = fabsf(window.temperature.mean - true_mean);
+                worst_mean_error = error > worst_mean_error ? error : worst_mean_error;
+            }
+            bad_windows += window.count != ROLLUP_MS / PERIOD_MS || window.temperature.min > window.temperature.mean ||
+                           window.temperature.max < window.temperature.mean || window.humidity.variance < 0.0f;
+            rolled_up += window.count;
+            window_true_temp = 0.0f;
+        }
+        window_true_temp += true_temp;
+
+        telemetry_sample_t out;
+        if (sample_filter_update(&filter, &raw, &out)) {
+            published_temp = out.temperature;
+            published_hum = out.humidity;
+        }
+        // Skip the first samples while the filter fills
+        if (raw_count > 10) {
+            float lag_t = fabsf(published_temp - true_temp);
+            float lag_h = fabsf(published_hum - true_hum);
+            worst_temp_lag = lag_t > worst_temp_lag ? lag_t : worst_temp_lag;
+            worst_hum_lag = lag_h > worst_hum_lag ? lag_h : worst_hum_lag;
+        }
+    }
+
+    float reduction = filter.passed ? (float)raw_count / (float)filter.passed : 0.0f;
+    printf("raw samples %lu (%lu spikes), published %lu, reduction %.1fx\n",
+           (unsigned long)raw_count, (unsigned long)spikes, (unsigned long)filter.passed, reduction);
+    printf("worst lag of published value: %.2f C, %.2f %%RH\n", worst_temp_lag, worst_hum_lag);
+
+    printf("rollups %lu windows of %lu samples, %lu/%lu spikes in max, worst mean error %.3f C\n",
+           (unsigned long)rollup.emitted, (unsigned long)(ROLLUP_MS / PERIOD_MS),
+           (unsigned long)spikes_seen, (unsigned long)spikes, worst_mean_error);
+
+    bool ok = rolled_up + rollup.temperature.count == raw_count && bad_windows == 0 &&
+              spikes_seen == spikes && worst_mean_error <= 0.03f &&
+              reduction >= 10.0f && worst_temp_lag <= 2 * cfg.temp_deadband + 0.1f &&
+              worst_hum_lag <= 2 * cfg.hum_deadband + 0.5f;
+    printf("%s\n", ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file sim_sensor_hub.c
+ * @brief Runs the sampling scheduler against simulated sensors on a virtual
+ *        clock, the way the firmware's sampling task drives it.
+ *
+ * Three sensors: one that measures on its own and is read in 1 ms (SHT3x in
+ * periodic mode), one with a 20 ms start signal and a 5 ms read (DHT), and
+ * one with a 15 ms conversion (an I2C sensor in single-shot mode). The DHT
+ * stops answering for an hour in the middle of the run.
+ *
+ * The run fails (exit 1) if a cycle takes longer than the slowest
+ * conversion plus the reads, i.e. the conversions did not overlap; if the
+ * healthy sensors miss a reading; or if the dead sensor is not reported
+ * failed, not reinitialized, polled at the full rate while dead, or not back
+ * within SENSOR_HUB_BACKOFF_MAX periods after it recovers.
+ */
+
+#include <stdio.h>
+#include "sensor_hub.h"
+
+#define PERIOD_MS           2000
+#define DURATION_MS         (4ull * 3600 * 1000)
+#define OUTAGE_START_MS     (1ull * 3600 * 1000)
+#define OUTAGE_END_MS       (2ull * 3600 * 1000)
+
+typedef struct {
+    const char *name;
+    uint32_t conversion_ms;     /* 0: no start step */
+    uint32_t read_ms;           /* time spent in fetch */
+    bool can_fail;
+    uint32_t starts;
+    uint32_t inits;
+    uint32_t starts_in_outage;
+} sim_sensor_t;
+
+static uint64_t clock_ms;
+
+static bool dead(const sim_sensor_t *s)
+{
+    return s->can_fail && clock_ms >= OUTAGE_START_MS && clock_ms < OUTAGE_END_MS;
+}
+
+static esp_err_t sim_init(void *ctx)
+{
+    ((sim_sensor_t *)ctx)->inits++;
+    return ESP_OK;
+}
+
+static esp_err_t sim_start(void *ctx, uint32_t *ready_ms)
+{
+    sim_sensor_t *s = ctx;
+    s->starts++;
+    s->starts_in_outage += dead(s);
+    *ready_ms = s->conversion_ms;
+    return ESP_OK;
+}
+
+static esp_err_t sim_fetch(void *ctx, telemetry_sample_t *sample)
+{
+    sim_sensor_t *s = ctx;
+    clock_ms += s->read_ms;
+    if (dead(s)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    sample->temperature = 24.0f;
+    sample->humidity = 50.0f;
+    return ESP_OK;
+}
+
+static sim_sensor_t sensors[] = {
+    { .name = "periodic", .conversion_ms = 0, .read_ms = 1 },
+    { .name = "dht", .conversion_ms = 20, .read_ms = 5, .can_fail = true },
+    { .name = "single_shot", .conversion_ms = 15, .read_ms = 1 },
+};
+#define SENSOR_COUNT    (sizeof(sensors) / sizeof(sensors[0]))
+
+static uint32_t readings[SENSOR_COUNT];
+static uint64_t last_reading_ms[SENSOR_COUNT];
+
+static void on_reading(uint8_t index, const sensor_driver_t *driver, esp_err_t err,
+                       const telemetry_sample_t *sample, void *ctx)
+{
+    if (err == ESP_OK) {
+        readings[index]++;
+        last_reading_ms[index] = sample->timestamp_ms;
+    }
+}
+
+int main(void)
+{
+    sensor_hub_t hub;
+    bool ok = true;
+    uint32_t cycles = 0, full_cycles = 0, worst_cycle_ms = 0, serial_ms = 0, bound_ms = 0;
+    bool reported_failed = false;
+
+    sensor_hub_init(&hub, PERIOD_MS);
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+        sensor_driver_t driver = {
+            .name = sensors[i].name,
+            .caps = SENSOR_CAP_TEMPERATURE | SENSOR_CAP_HUMIDITY,
+            .init = sim_init,
+            .start = sensors[i].conversion_ms > 0 ? sim_start : NULL,
+            .fetch = sim_fetch,
+            .ctx = &sensors[i],
+        };
+        sensor_hub_add(&hub, &driver, clock_ms, NULL);
+        serial_ms += sensors[i].conversion_ms + sensors[i].read_ms;
+        bound_ms = sensors[i].conversion_ms > bound_ms ? sensors[i].conversion_ms : bound_ms;
+    }
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+        bound_ms += sensors[i].read_ms;
+    }
+
+    while (clock_ms < DURATION_MS) {
+        uint64_t cycle_start = clock_ms, ready;
+        uint32_t started = sensor_hub_start(&hub, clock_ms);
+
+        while (sensor_hub_next_ready(&hub, &ready)) {
+            clock_ms = ready > clock_ms ? ready : clock_ms;
+            sensor_hub_collect(&hub, clock_ms, on_reading, NULL);
+        }
+        if (started > 0) {
+            cycles++;
+            if (started == SENSOR_COUNT) {
+                full_cycles++;
+                uint32_t cycle_ms = (uint32_t)(clock_ms - cycle_start);
+                worst_cycle_ms = cycle_ms > worst_cycle_ms ? cycle_ms : worst_cycle_ms;
+            }
+        }
+        reported_failed |= sensor_hub_state(&hub, 1) == SENSOR_STATE_FAILED;
+
+        uint64_t due = sensor_hub_next_due(&hub);
+        clock_ms = due > clock_ms ? due : clock_ms;
+    }
+
+    const sensor_health_t *dht = &hub.slots[1].health;
+    uint32_t outage_periods = (uint32_t)((OUTAGE_END_MS - OUTAGE_START_MS) / PERIOD_MS);
+    uint32_t expected = (uint32_t)(DURATION_MS / PERIOD_MS);
+    bool recovered = last_reading_ms[1] >= OUTAGE_END_MS;
+    // The backoff may delay the first reading after the outage by up to SENSOR_HUB_BACKOFF_MAX periods
+    uint32_t missed = (expected - outage_periods) - readings[1];
+
+    printf("%lu cycles, %lu with every sensor; worst %lu ms, serial reads would take %lu ms (bound %lu ms)\n",
+           (unsigned long)cycles, (unsigned long)full_cycles, (unsigned long)worst_cycle_ms,
+           (unsigned long)serial_ms, (unsigned long)bound_ms);
+    printf("readings: %lu/%lu/%lu of %lu\n", (unsigned long)readings[0], (unsigned long)readings[1],
+           (unsigned long)readings[2], (unsigned long)expected);
+    printf("dead sensor: %lu starts in %lu outage periods, %lu reinits, %lu failures, %lu readings missed after\n",
+           (unsigned long)sensors[1].starts_in_outage, (unsigned long)outage_periods,
+           (unsigned long)dht->reinits, (unsigned long)dht->failures, (unsigned long)missed);
+
+    ok &= worst_cycle_ms <= bound_ms && worst_cycle_ms < serial_ms;
+    ok &= readings[0] == expected && readings[2] == expected;
+    ok &= reported_failed && dht->reinits > 0 && sensors[1].inits == dht->reinits + 1;
+    ok &= sensors[1].starts_in_outage < outage_periods / 2;
+    ok &= recovered && missed <= SENSOR_HUB_BACKOFF_MAX;
+    ok &= sensor_hub_state(&hub, 1) == SENSOR_STATE_OK;
+
+    printf("%s\n", ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
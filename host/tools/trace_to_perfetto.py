@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Convert firmware trace dumps to Chrome trace / Perfetto JSON.
+
+Dumps arrive as one hex-encoded chunk per line, either from the console
+("TRACE <hex>" lines after publishing {"to": "uart"} on <prefix>/trace/dump)
+or from MQTT on <prefix>/trace/data. <prefix> is the node's topic prefix,
+<room> or <room>/<device> (see Device Identity in menuconfig):
+
+    mosquitto_sub -t room_01/trace/data -F %x > dump.txt
+    ./trace_to_perfetto.py dump.txt -o trace.json
+
+Record times are CPU cycles; the dump header carries the clock frequency
+used to convert them to microseconds.
+
+Open the result in https://ui.perfetto.dev or chrome://tracing. Every event
+kind gets its own track per core. Event names come from
+components/event_trace/include/trace_events.h, so the tool always matches
+the firmware it ships with.
+"""
+import argparse
+import json
+import re
+import struct
+import sys
+from pathlib import Path
+
+EVENTS_H = Path(__file__).resolve().parents[2] / "components/event_trace/include/trace_events.h"
+
+_CHUNK_HDR = struct.Struct("<2sBBHHI")
+_CHUNK_CLOCK = struct.Struct("<I")      # version 2: clock frequency [Hz] after the header
+_RECORD = struct.Struct("<IIIHBB")
+_EVENT_RE = re.compile(r'X\((\w+),\s*(SPAN|INSTANT),\s*"([^"]*)"\)')
+
+
+def load_events(path: Path):
+    """Return [(label, is_span)] indexed by event id"""
+    return [(label, kind == "SPAN") for _, kind, label in _EVENT_RE.findall(path.read_text())]
+
+
+def read_chunks(lines):
+    """Yield decoded chunks from lines whose last word is a hex dump chunk"""
+    for line in lines:
+        words = line.split()
+        if not words:
+            continue
+        try:
+            data = bytes.fromhex(words[-1])
+        except ValueError:
+            continue
+        if len(data) >= _CHUNK_HDR.size and data[:2] == b"TR":
+            yield data
+
+
+def parse_dump(chunks):
+    """Group chunks by dump and return (records, recorded, missing, clock_hz) of the last complete one"""
+    dumps = {}
+    for data in chunks:
+        magic, version, record_size, index, count, recorded = _CHUNK_HDR.unpack_from(data)
+        if version not in (1, 2) or record_size != _RECORD.size:
+            raise ValueError(f"unsupported trace dump version {version} / record size {record_size}")
+        header = _CHUNK_HDR.size
+        clock_hz = 1000000      # version 1 recorded esp_timer microseconds
+        if version >= 2:
+            clock_hz, = _CHUNK_CLOCK.unpack_from(data, header)
+            header += _CHUNK_CLOCK.size
+        if clock_hz == 0:
+            raise ValueError("trace dump without a clock frequency")
+        dump = dumps.setdefault(recorded, {"count": count, "chunks": {}, "clock_hz": clock_hz})
+        dump["chunks"][index] = data[header:]
+    if not dumps:
+        raise ValueError("no trace chunks found")
+
+    recorded = max(dumps)   # the latest dump has recorded the most events
+    dump = dumps[recorded]
+    missing = [i for i in range(dump["count"]) if i not in dump["chunks"]]
+    body = b"".join(dump["chunks"][i] for i in sorted(dump["chunks"]))
+    records = [_RECORD.unpack_from(body, off) for off in range(0, len(body) - _RECORD.size + 1, _RECORD.size)]
+    return records, recorded, missing, dump["clock_hz"]
+
+
+def to_trace(records, events, recorded, clock_hz=1000000):
+    trace = []
+    tracks = set()
+    wraps = {}
+    last = {}
+    ticks_per_us = clock_hz / 1e6
+    for timestamp, duration, arg, event, core, _ in records:
+        # 32-bit counter, one per core: a big step backwards is a wrap
+        if core in last and timestamp + (1 << 31) < last[core]:
+            wraps[core] = wraps.get(core, 0) + 1
+        last[core] = timestamp
+        ts = (timestamp + (wraps.get(core, 0) << 32)) / ticks_per_us
+        duration /= ticks_per_us
+
+        label, is_span = events[event] if event < len(events) else (f"event {event}", duration > 0)
+        tracks.add((core, event, label))
+        entry = {"name": label, "pid": core, "tid": event + 1, "ts": ts, "args": {"arg": arg}}
+        if is_span:
+            entry.update(ph="X", dur=duration)
+        else:
+            entry.update(ph="i", s="t")
+        trace.append(entry)
+
+    for core in sorted({core for core, _, _ in tracks}):
+        trace.append({"name": "process_name", "ph": "M", "pid": core, "args": {"name": f"core {core}"}})
+    for core, event, label in sorted(tracks):
+        trace.append({"name": "thread_name", "ph": "M", "pid": core, "tid": event + 1, "args": {"name": label}})
+
+    return {
+        "traceEvents": trace,
+        "displayTimeUnit": "ms",
+        "otherData": {"recorded": recorded, "dumped": len(records), "overwritten": recorded - len(records)},
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", type=argparse.FileType("r"), default=sys.stdin,
+                        help="dump text (default: stdin)")
+    parser.add_argument("-o", "--output", type=argparse.FileType("w"), default=sys.stdout,
+                        help="trace JSON (default: stdout)")
+    parser.add_argument("--events", type=Path, default=EVENTS_H, help="trace_events.h to take names from")
+    args = parser.parse_args()
+
+    events = load_events(args.events)
+    try:
+        records, recorded, missing, clock_hz = parse_dump(read_chunks(args.input))
+    except ValueError as e:
+        sys.exit(f"error: {e}")
+    if missing:
+        print(f"warning: chunks {missing} missing, their events are left out", file=sys.stderr)
+
+    json.dump(to_trace(records, events, recorded, clock_hz), args.output)
+    print(f"{len(records)} events ({recorded - len(records)} overwritten)", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
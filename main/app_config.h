@@ -7,35 +7,8 @@
 #define APP_CONFIG_H
 
 #include <stdint.h>
-
-/**
- * Command types for controlling devices via MQTT
- */
-typedef enum {
-    CMD_TYPE_UNKNOWN,
-    CMD_TYPE_FAN,
-    CMD_TYPE_HUMIDIFIER,
-} cmd_type_t;
-
-/**
- * Relay command types
- */
-typedef enum {
-    RELAY_CMD_OFF = 0,
-    RELAY_CMD_ON = 1,
-    RELAY_CMD_TOGGLE = 2
-} relay_cmd_t;
-
-/**
- * Application command structure
- */
-typedef struct {
-    cmd_type_t type;
-    union {
-        char fan_state[10];
-        char humidifier_state[10];
-    } value;
-} app_cmd_t;
+#include <stddef.h>
+#include "command_parser.h"
 
 /**
  * Health check parameters structure
@@ -44,6 +17,9 @@ typedef struct {
     uint32_t uptime_ms;
     size_t free_heap_bytes;
     int8_t wifi_rssi;
+    uint32_t backlog;
+    uint32_t first_sample_ms;
+    uint32_t first_publish_ms;
 } health_check_params_t;
 
 #endif // APP_CONFIG_H
\ No newline at end of file
@@ -8,11 +8,28 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include "command_parser.h"
 
+/**
+ * @brief Registers the controller's deferred log module. Call once before
+ *        the first command arrives.
+ * @return ESP_OK on success.
+ */
 esp_err_t app_controller_init(void);
-void app_controller_set_humid_task_handle(TaskHandle_t handle);
-void app_controller_set_fan_task_handle(TaskHandle_t handle);
-bool app_controller_send_command(const char *json_str);
-void app_controller_task(void *pvParameters);
 
-#endif // APP_CONTROLLER_H
\ No newline at end of file
+/**
+ * @brief Parses a command payload in place (no allocation) and hands it to
+ *        the actuator manager. Accepts a single command or a
+ *        {"commands": [...]} batch, which is applied in one pass.
+ * @param payload Command JSON, not necessarily NUL-terminated.
+ * @param len Payload length.
+ * @param batch Receives the parsed batch, stamped with its arrival time.
+ *        On error batch->ref still identifies the command, so the caller
+ *        can acknowledge the rejection.
+ * @return ESP_OK if the command was valid and queued, otherwise the parse
+ *         or queueing error.
+ */
+esp_err_t app_controller_send_command(const char *payload, size_t len, command_batch_t *batch);
+
+#endif // APP_CONTROLLER_H
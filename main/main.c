@@ -7,19 +7,37 @@
 #include "esp_system.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "nvs_flash.h"
-#include "cJSON.h"
+#include "nvs.h"
 
 #include "app_config.h"
 #include "app_controller.h"
-#include "dht11_driver.h"
+#include "actuator_manager.h"
+#include "climate_control.h"
+#include "rule_engine.h"
+#include "dht_sensor.h"
 #include "driver_relay.h"
-#include "service_wifi.h"
+#include "relay_bank_gpio.h"
+#include "relay_bank_595.h"
+#include "service_connectivity.h"
 #include "service_mqtt.h"
 #include "driver_sht3x.h"
-
-#define CONFIG_DHT11_PIN    4
-#define CONFIG_DHT11_CONNECTION_TIMEOUT 5
+#include "sht3x_sensor.h"
+#include "sensor_hub.h"
+#include "service_i2c_bus.h"
+#include "telemetry_codec.h"
+#include "sample_ring.h"
+#include "sample_log.h"
+#include "sample_filter.h"
+#include "sample_rollup.h"
+#include "metrics.h"
+#include "metrics_system.h"
+#include "event_trace.h"
+#include "deferred_log.h"
+#include "json_scan.h"
+#include "device_identity.h"
+#include "topic_router.h"
 
 #define CONFIG_HUMID_PIN    16
 #define CONFIG_HUMID_TYPE   RELAY_ACTIVE_HIGH
@@ -27,298 +45,983 @@
 #define CONFIG_FAN_PIN      18
 #define CONFIG_FAN_TYPE     RELAY_ACTIVE_HIGH
 
-#define CONFIG_SHT3X_PERIOD_MS 2000
 #define CONFIG_SDA_PIN      21
 #define CONFIG_SCL_PIN      22
+#define I2C_BUS_QUEUE_LEN   8
+
+#ifndef CONFIG_SHT3X_MUX_CHANNEL
+#define CONFIG_SHT3X_MUX_CHANNEL    I2C_BUS_NO_MUX
+#endif
+
+/* Topics under this node's prefix (device_identity.h), built once at boot */
+typedef enum {
+    TOPIC_SENSOR_PUB,
+    TOPIC_SENSOR_ROLLUP_PUB,
+    TOPIC_COMMAND_SUB,
+    TOPIC_COMMAND_ACK_PUB,
+    TOPIC_STATUS_SYSTEM_PUB,
+    TOPIC_STATUS_CONNECTION_PUB,
+    TOPIC_STATUS_DEVICE_PUB,
+    TOPIC_CONTROL_SUB,
+    TOPIC_STATUS_CONTROL_PUB,
+    TOPIC_RULES_SUB,
+    TOPIC_STATUS_RULES_PUB,
+    TOPIC_TRACE_DUMP_SUB,
+    TOPIC_TRACE_DATA_PUB,
+    TOPIC_LOG_LEVEL_SUB,
+    TOPIC_IDENTITY_SUB,
+    TOPIC_COUNT,
+} app_topic_t;
+
+static const char *const topic_suffixes[TOPIC_COUNT] = {
+    [TOPIC_SENSOR_PUB] = "sensors", // {"temperature": xx.x, "humidity": yy.y }
+    [TOPIC_SENSOR_ROLLUP_PUB] = "sensors/rollup", // {"start": .., "window_s": 60, "count": 30, "temperature": {"min", "max", "mean", "var"}, ...}
+    [TOPIC_COMMAND_SUB] = "commands", // {"type": "fan", "state": "on"/"off"} / {"type": "humidifier", "state": "on"/"off"}
+    [TOPIC_COMMAND_ACK_PUB] = "commands/ack", // {"id": .., "ts": .., "status": "ok", "device_us": .., "devices": [..]}
+    [TOPIC_STATUS_SYSTEM_PUB] = "status/system",
+    [TOPIC_STATUS_CONNECTION_PUB] = "status/connection",
+    [TOPIC_STATUS_DEVICE_PUB] = "status/devices",
+    [TOPIC_CONTROL_SUB] = "control/set", // {"loop": "humidity", "mode": "pid", "setpoint": 55}
+    [TOPIC_STATUS_CONTROL_PUB] = "status/control",
+    [TOPIC_RULES_SUB] = "rules/set", // {"rules": [{"if": "humidity < 40", "then": {"device": "humidifier", "state": "on"}, "for_s": 600}]}
+    [TOPIC_STATUS_RULES_PUB] = "status/rules",
+    [TOPIC_TRACE_DUMP_SUB] = "trace/dump", // {} or {"to": "uart"}
+    [TOPIC_TRACE_DATA_PUB] = "trace/data",
+    [TOPIC_LOG_LEVEL_SUB] = "log/level", // {"module": "MQTT_SERVICE", "level": "debug"}, "*" for all
+    [TOPIC_IDENTITY_SUB] = "identity/set", // {"room": "room_07", "device": "node_a"}
+};
+
+/* Longest suffix plus '/' and NUL */
+#define TOPIC_MAX_LEN               (DEVICE_IDENTITY_PREFIX_MAX_LEN + 20)
 
-#define TOPIC_SENSOR_PUB            "room_01/sensors" // {"temperature": xx.x, "humidity": yy.y }
-#define TOPIC_COMMAND_SUB           "room_01/commands" // {"type": "fan", "state": "on"/"off"} / {"type": "humidifier", "state": "on"/"off"}
-#define TOPIC_STATUS_SYSTEM_PUB     "room_01/status/system"
-#define TOPIC_STATUS_CONNECTION_PUB "room_01/status/connection"
-#define TOPIC_STATUS_DEVICE_PUB     "room_01/status/devices"
-#define TOPIC_ERROR_PUB             "room_01/errors"
-
-#define APP_TASK_STACK_SIZE             4096
-#define APP_TASK_PRIORITY               5
-#define SENSOR_TASK_STACK_SIZE          2048
-#define SENSOR_TASK_PRIORITY            4
-#define TASK_SHT3X_STACK_SIZE           3072    /* 3 KB */
+/* Broadcast to every node of the fleet */
+#define TOPIC_ALL_COMMAND_SUB       "all/commands"
+#define TOPIC_ALL_LOG_LEVEL_SUB     "all/log/level"
+
+#define TASK_SAMPLING_STACK_SIZE        3072    /* 3 KB */
 #define TASK_HEALTH_CHECK_STACK_SIZE    3072    /* 3 KB */
+#define TASK_SENSOR_PUB_STACK_SIZE      3072    /* 3 KB */
+
+/* A bool Kconfig option is undefined when off */
+#if CONFIG_SENSOR_PUBLISH_RAW
+#define SENSOR_PUBLISH_RAW  1
+#else
+#define SENSOR_PUBLISH_RAW  0
+#endif
+
+/* Must be a power of two and leave room for at least two full batches */
+#define SAMPLE_RING_CAPACITY            64
+#define SAMPLE_LOG_PARTITION            "samplelog"
+#define SENSOR_BATCH_MAX_SAMPLES        (CONFIG_SENSOR_BATCH_SIZE > CONFIG_SAMPLE_LOG_REPLAY_BATCH ? \
+                                         CONFIG_SENSOR_BATCH_SIZE : CONFIG_SAMPLE_LOG_REPLAY_BATCH)
+#define SENSOR_BATCH_JSON_LEN           (SENSOR_BATCH_MAX_SAMPLES * TELEMETRY_JSON_SAMPLE_MAX_LEN + 64)
+#define DEVICE_STATES_JSON_LEN          (ACTUATOR_MAX * TELEMETRY_JSON_DEVICE_ITEM_MAX_LEN + 48)
+#define DEVICE_STATES_BIN_LEN           (7 + ACTUATOR_MAX * (2 + TELEMETRY_BIN_NAME_MAX))
+#define COMMAND_ACK_JSON_LEN            (ACTUATOR_MAX * TELEMETRY_JSON_DEVICE_ITEM_MAX_LEN + COMMAND_ID_MAX_LEN + 112)
+/* Closed windows waiting for the publish task, which moves them to the sample log while MQTT is down */
+#define ROLLUP_QUEUE_LEN                4
+/* Health report plus metrics snapshot; task names dominate the size */
+#define SYSTEM_STATUS_JSON_LEN          2560
+#define CLIMATE_STATUS_JSON_LEN         (CLIMATE_MAX_LOOPS * CLIMATE_STATUS_JSON_LOOP_MAX_LEN + 16)
+
+_Static_assert(CONFIG_SENSOR_MEDIAN_WINDOW == 1 || CONFIG_SENSOR_MEDIAN_WINDOW == 3 ||
+               CONFIG_SENSOR_MEDIAN_WINDOW == 5, "sample_filter_init only takes a median of 1, 3 or 5");
 
-static TaskHandle_t humid_task_handle = NULL;
-static TaskHandle_t fan_task_handle = NULL;
+/* Relays of this node; adding one is a new row, names are used in commands.
+ * Row i is relay bank channel i: the i-th pin below, or output Qi of the 74HC595 chain. */
+static const actuator_def_t actuators[] = {
+    { .name = "humidifier", .type = CONFIG_HUMID_TYPE },
+    { .name = "fan",        .type = CONFIG_FAN_TYPE },
+};
+#define ACTUATOR_COUNT  (sizeof(actuators) / sizeof(actuators[0]))
+
+#if CONFIG_RELAY_BANK_74HC595
+static const relay_bank_595_config_t relay_chain = {
+    .data_pin = CONFIG_RELAY_595_DATA_PIN,
+    .clock_pin = CONFIG_RELAY_595_CLOCK_PIN,
+    .latch_pin = CONFIG_RELAY_595_LATCH_PIN,
+    .oe_pin = CONFIG_RELAY_595_OE_PIN,
+    .chips = CONFIG_RELAY_595_CHIPS,
+};
+static relay_bank_595_t relay_outputs;
+#else
+static const uint8_t actuator_pins[] = { CONFIG_HUMID_PIN, CONFIG_FAN_PIN };
+_Static_assert(sizeof(actuator_pins) == ACTUATOR_COUNT, "one pin per actuator");
+static relay_bank_gpio_t relay_outputs;
+#endif
+
+/* Local control loops, all off until a setpoint is pushed on TOPIC_CONTROL_SUB.
+ * The cloud keeps manual control of a relay while its loop is off. */
+static const climate_loop_def_t climate_loops[] = {
+    {
+        .name = "humidity", .actuator = "humidifier",
+        .variable = CLIMATE_HUMIDITY, .action = CONTROL_ACTION_RAISE,
+        .defaults = {
+            .mode = CONTROL_MODE_OFF, .setpoint = 60.0f, .hysteresis = 4.0f,
+            .kp = 0.1f, .ki = 0.0005f, .kd = 0.0f, .window_ms = 120000,
+            .min_on_ms = 30000, .min_off_ms = 30000,
+        },
+    },
+    {
+        .name = "temperature", .actuator = "fan",
+        .variable = CLIMATE_TEMPERATURE, .action = CONTROL_ACTION_LOWER,
+        .defaults = {
+            .mode = CONTROL_MODE_OFF, .setpoint = 28.0f, .hysteresis = 1.0f,
+            .kp = 0.5f, .ki = 0.002f, .kd = 0.0f, .window_ms = 120000,
+            .min_on_ms = 60000, .min_off_ms = 60000,
+        },
+    },
+};
+
+static TaskHandle_t sensor_pub_task_handle = NULL;
 static const char *TAG = "MAIN";
+/* Logs on the sensor and command paths, formatted by the log task */
+static deferred_log_module_t app_log = DEFERRED_LOG_MODULE_INIT("MAIN", DLOG_LEVEL_INFO);
+
+static device_identity_t identity;
+static char topics[TOPIC_COUNT][TOPIC_MAX_LEN];
+/* Inbound topics to handlers; filled in app_main before MQTT starts, read-only after */
+static topic_router_t router;
+
+static sample_filter_t sample_filter;
+static sample_rollup_t sample_rollup;
+static QueueHandle_t rollup_queue = NULL;
+
+/* Runtime metrics of the sensor path, published with the health check */
+static const uint32_t sensor_cycle_bounds_us[] = { 500, 1000, 2000, 5000, 10000, 50000 };
+/* First start to last fetch of a sampling cycle, all sensors together */
+static metrics_histogram_t sensor_cycle_time = METRICS_HISTOGRAM_INIT("sensor_cycle_us", sensor_cycle_bounds_us);
+static metrics_counter_t sensor_read_failures = METRICS_COUNTER_INIT("sensor_read_failures");
+static metrics_counter_t rollups_dropped = METRICS_COUNTER_INIT("rollups_dropped");
+/* Command arrival to relay write, the device's share of the round trip */
+static const uint32_t command_latency_bounds_us[] = { 500, 1000, 2000, 5000, 10000, 50000 };
+static metrics_histogram_t command_latency = METRICS_HISTOGRAM_INIT("cmd_apply_us", command_latency_bounds_us);
+
+static telemetry_sample_t sample_ring_storage[SAMPLE_RING_CAPACITY];
+static sample_ring_t sample_ring;
+static bool sample_log_ready = false;
+static uint32_t current_boot_id = 0;
 
-void publish_sensor_data(float temp, float hum)
+/* Every sensor of the node; the first one with a valid reading in a cycle feeds the sample path */
+static sensor_hub_t sensor_hub;
+static sht3x_sensor_t sht3x_sensor;
+#if CONFIG_SENSOR_DHT
+static dht_sensor_t dht_sensor;
+#endif
+static telemetry_sample_t cycle_samples[SENSOR_HUB_MAX_SENSORS];
+static bool cycle_valid[SENSOR_HUB_MAX_SENSORS];
+
+/* Boot milestones in ms since boot, 0 until reached; reported in the health check */
+static volatile uint32_t boot_first_sample_ms = 0;
+static volatile uint32_t boot_first_publish_ms = 0;
+
+static uint32_t uptime_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static uint32_t uptime_seconds(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+#if CONFIG_SENSOR_BATCH_SIZE == 1
+/**
+ * @brief Publish one sample taken by the sensor task in the single-sample format,
+ *        stamped at measurement time
+ * @return true if the message was queued for publishing
+ */
+static bool publish_sensor_sample(const telemetry_sample_t *sample)
+{
+    uint32_t t0 = event_trace_begin();
+    size_t len = 0;
+    uint32_t ts = (uint32_t)(sample->timestamp_ms / 1000);
+#if CONFIG_TELEMETRY_FORMAT_BINARY
+    uint8_t payload[TELEMETRY_BIN_MAX_LEN];
+    esp_err_t err = telemetry_encode_sensor_bin(payload, sizeof(payload), sample->temperature,
+                                                sample->humidity, ts, &len);
+#else
+    char payload[TELEMETRY_JSON_MAX_LEN];
+    esp_err_t err = telemetry_encode_sensor_json(payload, sizeof(payload), sample->temperature,
+                                                 sample->humidity, ts, &len);
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE("MQTT", "Failed to encode sensor payload: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    // A newer sample still supersedes this one while it waits for the link
+    bool sent = mqtt_service_enqueue(topics[TOPIC_SENSOR_PUB], payload, (int)len, 1,
+                                     MQTT_PRIORITY_LOW, MQTT_PUBLISH_LATEST) == ESP_OK;
+    event_trace_end(TRACE_SENSOR_PUBLISH, t0, 1);
+    return sent;
+}
+#endif
+
+/**
+ * @brief Publish several samples as one message
+ * - topic: <prefix>/sensors
+ * - payload: {"timestamp": now, "boot": id, "samples": [{...}, ...]}; the outer
+ *   timestamp is omitted when now_ms is TELEMETRY_TIME_UNKNOWN (backlog from an
+ *   earlier boot), "boot" names the boot whose clock the sample times are on
+ * - only called from sensor_publish_task, which owns the static payload buffer
+ * @return true if the message was queued for publishing
+ */
+static bool publish_sensor_batch(const telemetry_sample_t *samples, uint32_t count, uint64_t now_ms,
+                                 uint32_t boot_id)
 {
-    cJSON *root = cJSON_CreateObject();
-    if (root == NULL) {
-        ESP_LOGE("MQTT", "Failed to create JSON object");
+    static char payload[SENSOR_BATCH_JSON_LEN];
+    uint32_t t0 = event_trace_begin();
+    size_t len = 0;
+
+#if CONFIG_TELEMETRY_FORMAT_BINARY
+    esp_err_t err = telemetry_encode_sensor_batch_bin((uint8_t *)payload, sizeof(payload), samples,
+                                                      count, now_ms, boot_id, &len);
+#else
+    esp_err_t err = telemetry_encode_sensor_batch_json(payload, sizeof(payload), samples, count,
+                                                       now_ms, boot_id, &len);
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE("MQTT", "Failed to encode sensor batch: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    // Refused over budget: the caller keeps the samples in the offline store
+    bool sent = mqtt_service_enqueue(topics[TOPIC_SENSOR_PUB], payload, (int)len, 1, MQTT_PRIORITY_LOW, 0) == ESP_OK;
+    event_trace_end(TRACE_SENSOR_PUBLISH, t0, count);
+    return sent;
+}
+
+static bool publish_live_samples(const telemetry_sample_t *samples, uint32_t count)
+{
+#if CONFIG_SENSOR_BATCH_SIZE == 1
+    (void)count;
+    return publish_sensor_sample(&samples[0]);
+#else
+    return publish_sensor_batch(samples, count, (uint64_t)(esp_timer_get_time() / 1000), current_boot_id);
+#endif
+}
+
+/**
+ * @brief Publish the statistics of one closed window
+ * - topic: <prefix>/sensors/rollup
+ * - payload: {"timestamp": now, "boot": id, "start": .., "window_s": .., "count": ..,
+ *   "temperature": {"min": .., "max": .., "mean": .., "var": ..}, "humidity": {...}};
+ *   "timestamp" is omitted for a window from an earlier boot, as in a batch
+ * @return true if the message was queued for publishing
+ */
+static bool publish_sensor_rollup(const telemetry_rollup_t *rollup, uint64_t now_ms, uint32_t boot_id)
+{
+    size_t len = 0;
+#if CONFIG_TELEMETRY_FORMAT_BINARY
+    uint8_t payload[TELEMETRY_BIN_MAX_LEN];
+    esp_err_t err = telemetry_encode_rollup_bin(payload, sizeof(payload), rollup, now_ms, boot_id, &len);
+#else
+    char payload[TELEMETRY_JSON_ROLLUP_MAX_LEN];
+    esp_err_t err = telemetry_encode_rollup_json(payload, sizeof(payload), rollup, now_ms, boot_id, &len);
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE("MQTT", "Failed to encode sensor rollup: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    return mqtt_service_enqueue(topics[TOPIC_SENSOR_ROLLUP_PUB], payload, (int)len, 1, MQTT_PRIORITY_LOW, 0) == ESP_OK;
+}
+
+/**
+ * Keeps samples that could not be published in the flash log for later replay.
+ */
+static void store_offline(const telemetry_sample_t *samples, uint32_t count)
+{
+    if (!sample_log_ready) {
+        ESP_LOGW(TAG, "Offline, %lu samples lost (no sample log)", (unsigned long)count);
         return;
     }
-    
-    cJSON_AddNumberToObject(root, "temperature", temp);
-    cJSON_AddNumberToObject(root, "humidity", hum);
-    cJSON_AddNumberToObject(root, "timestamp", (double)(esp_timer_get_time() / 1000000));
+    for (uint32_t i = 0; i < count; i++) {
+        esp_err_t err = sample_log_append(&samples[i]);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to store sample offline: %s", esp_err_to_name(err));
+        }
+    }
+}
 
-    char *json_string = cJSON_PrintUnformatted(root);
-    if (json_string != NULL) {
-        mqtt_service_publish(TOPIC_SENSOR_PUB, json_string, 1);
-        free(json_string);
-    } else {
-        ESP_LOGE("MQTT", "Failed to print JSON");
+/* Current device time for records of this boot; earlier boots have no mapping to it */
+static uint64_t replay_now_ms(uint32_t boot_id)
+{
+    return boot_id == current_boot_id ? (uint64_t)(esp_timer_get_time() / 1000) : TELEMETRY_TIME_UNKNOWN;
+}
+
+/**
+ * Publishes the oldest rollups of the offline backlog, up to
+ * CONFIG_SAMPLE_LOG_REPLAY_BATCH of them in a row.
+ * @return false if a rollup could not be queued
+ */
+static bool replay_rollups(void)
+{
+    telemetry_rollup_t rollup;
+    uint32_t count = 0, boot_id = 0, replayed = 0;
+
+    while (replayed < CONFIG_SAMPLE_LOG_REPLAY_BATCH &&
+           sample_log_peek_rollup(&rollup, &count, &boot_id) == ESP_OK && count > 0) {
+        if (!publish_sensor_rollup(&rollup, replay_now_ms(boot_id), boot_id)) {
+            return false;
+        }
+        sample_log_consume();
+        replayed++;
+    }
+    if (replayed > 0) {
+        ESP_LOGI(TAG, "Replayed %lu rollups, backlog %lu", (unsigned long)replayed,
+                 (unsigned long)sample_log_pending());
     }
-    
-    cJSON_Delete(root);
+    return true;
 }
 
 /**
- * @brief Publish device status to MQTT
- * - topic: room_01/status/devices
+ * Publishes the oldest batch of the offline backlog, or the rollups stored
+ * before it, at most once per CONFIG_SAMPLE_LOG_REPLAY_INTERVAL_MS so live
+ * data keeps flowing.
+ */
+static void replay_backlog(void)
+{
+    static telemetry_sample_t replay[SAMPLE_LOG_PEEK_MAX];
+    uint32_t count = 0;
+    uint32_t boot_id = 0;
+
+    if (!replay_rollups() ||
+        sample_log_peek(replay, CONFIG_SAMPLE_LOG_REPLAY_BATCH, &count, &boot_id) != ESP_OK || count == 0) {
+        return;
+    }
+
+    if (publish_sensor_batch(replay, count, replay_now_ms(boot_id), boot_id)) {
+        sample_log_consume();
+        ESP_LOGI(TAG, "Replayed %lu samples, backlog %lu", (unsigned long)count,
+                 (unsigned long)sample_log_pending());
+    }
+}
+
+/**
+ * @brief Publish the state of all actuators to MQTT
+ * - topic: <prefix>/status/devices
  * - goal: Report the actual state of actuators after receiving a command
- * - payload: {"device": "fan", "state": "on", "timestamp": 1234}
+ * - payload: {"timestamp": 1234, "devices": [{"device": "fan", "state": "on"}, ...]}
  * - qos: 1
  * - retain: FALSE
- * - trigger: Immediately after relay_set_level successfully executes the command in each task |
+ * - trigger: Once per applied command batch that changed at least one relay (actuator task)
  */
-void publish_device_status(const char *device, const char *status)
+static void publish_device_states(uint32_t states)
 {
-    cJSON *root = cJSON_CreateObject();
-    if (root == NULL) {
-        ESP_LOGE("MQTT", "Failed to create JSON object for status message");
-        return;
-    }
+    static uint8_t payload[DEVICE_STATES_JSON_LEN > DEVICE_STATES_BIN_LEN ? DEVICE_STATES_JSON_LEN
+                                                                           : DEVICE_STATES_BIN_LEN];
+    telemetry_device_state_t devices[ACTUATOR_MAX];
+    size_t count = actuator_manager_count();
+    size_t len = 0;
 
-    cJSON_AddStringToObject(root, "device", device);
-    cJSON_AddStringToObject(root, "state", status);
-    cJSON_AddNumberToObject(root, "timestamp", (double)(esp_timer_get_time() / 1000000));
+    for (size_t i = 0; i < count; i++) {
+        devices[i].name = actuator_manager_name(i);
+        devices[i].on = (states >> i) & 1u;
+    }
 
-    char *json_string = cJSON_PrintUnformatted(root);
-    if (json_string != NULL) {
-        mqtt_service_publish(TOPIC_STATUS_DEVICE_PUB, json_string, 1);
-        free(json_string);
-    } else {
-        ESP_LOGE("MQTT", "Failed to print JSON for status message");
+#if CONFIG_TELEMETRY_FORMAT_BINARY
+    esp_err_t err = telemetry_encode_device_states_bin(payload, sizeof(payload), devices, count,
+                                                       uptime_seconds(), &len);
+#else
+    esp_err_t err = telemetry_encode_device_states_json((char *)payload, sizeof(payload), devices, count,
+                                                        uptime_seconds(), &len);
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE("MQTT", "Failed to encode status message: %s", esp_err_to_name(err));
+        return;
     }
 
-    cJSON_Delete(root);
+    mqtt_service_enqueue(topics[TOPIC_STATUS_DEVICE_PUB], payload, (int)len, 1, MQTT_PRIORITY_HIGH, MQTT_PUBLISH_LATEST);
 }
 
-/* dht11 task
-void dht11_task(void *pvParameters)
+/**
+ * @brief Acknowledge a command that carried an id, whatever became of it
+ * - topic: <prefix>/commands/ack
+ * - goal: Let the sender match the command and measure its round trip
+ * - payload: {"id": "c0ffee", "ts": 1712345678123, "status": "ok", "device_us": 850,
+ *            "devices": [{"device": "fan", "state": "on"}]}; status is the
+ *            esp_err_t name on failure, devices lists the addressed actuators
+ * - qos: 1
+ * - retain: FALSE
+ * - trigger: After the batch reached the relays (actuator task), or when it
+ *            was rejected (MQTT task). Always JSON: acks are rare and small.
+ */
+static void publish_command_ack(const command_batch_t *batch, esp_err_t err, uint32_t states)
 {
-    dht11_data_t data;
-    data.pin = CONFIG_DHT11_PIN;
+    // Runs on two tasks, so no static buffer
+    char payload[COMMAND_ACK_JSON_LEN];
+    telemetry_json_writer_t w;
+    uint32_t addressed = 0;
+    size_t len = 0;
 
-    TickType_t last_wake_time = xTaskGetTickCount();
-    const TickType_t period = pdMS_TO_TICKS(CONFIG_DHT11_CONNECTION_TIMEOUT * 1000);
-
-    dht11_init(data.pin);
-    
-    while (1) {
-        vTaskDelayUntil(&last_wake_time, period);
+    for (uint8_t i = 0; i < batch->count; i++) {
+        addressed |= 1u << batch->cmds[i].device;
+    }
 
-        esp_err_t err = dht11_read(&data);
-        if (err == ESP_OK) {
-            ESP_LOGI("DHT11", "Temperature: %.2f C, Humidity: %.2f %%", data.temperature, data.humidity);
-        } else {
-            ESP_LOGE("DHT11", "Failed to read data from DHT11 sensor: %s", esp_err_to_name(err));
+    telemetry_json_init(&w, payload, sizeof(payload));
+    telemetry_json_object_begin(&w);
+    telemetry_json_key(&w, "id");
+    telemetry_json_string(&w, batch->ref.id);
+    if (batch->ref.sent_ms != 0) {
+        telemetry_json_key(&w, "ts");
+        telemetry_json_number(&w, (double)batch->ref.sent_ms);
+    }
+    telemetry_json_key(&w, "status");
+    telemetry_json_string(&w, err == ESP_OK ? "ok" : esp_err_to_name(err));
+    telemetry_json_key(&w, "device_us");
+    telemetry_json_number(&w, (double)(esp_timer_get_time() - batch->ref.received_us));
+    telemetry_json_key(&w, "devices");
+    telemetry_json_array_begin(&w);
+    for (size_t i = 0; i < actuator_manager_count(); i++) {
+        if ((addressed >> i) & 1u) {
+            telemetry_json_object_begin(&w);
+            telemetry_json_key(&w, "device");
+            telemetry_json_string(&w, actuator_manager_name(i));
+            telemetry_json_key(&w, "state");
+            telemetry_json_string(&w, ((states >> i) & 1u) ? "on" : "off");
+            telemetry_json_object_end(&w);
         }
+    }
+    telemetry_json_array_end(&w);
+    telemetry_json_object_end(&w);
 
-        publish_sensor_data(data.temperature, data.humidity);
+    if (telemetry_json_finish(&w, &len) != ESP_OK) {
+        ESP_LOGE("MQTT", "Failed to encode command ack");
+        return;
+    }
+    if (mqtt_service_enqueue(topics[TOPIC_COMMAND_ACK_PUB], payload, (int)len, 1, MQTT_PRIORITY_HIGH, 0) != ESP_OK) {
+        ESP_LOGW("MQTT", "Dropped ack for command %s", batch->ref.id);
     }
 }
-*/
 
-void sht3x_task(void *pvParameters) {
-    float temperature = 0.0;
-    float humidity = 0.0;
+/* Actuator task: status report on change, ack for every command from the cloud */
+static void on_actuator_batch(const command_batch_t *batch, esp_err_t err, uint32_t states, uint32_t changed)
+{
+    if (changed != 0) {
+        publish_device_states(states);
+    }
+    if (batch->ref.id[0] != '\0') {
+        metrics_histogram_observe(&command_latency, (uint32_t)(esp_timer_get_time() - batch->ref.received_us));
+        publish_command_ack(batch, err, states);
+    }
+}
 
-    TickType_t last_wake_time = xTaskGetTickCount();
-    const TickType_t period = pdMS_TO_TICKS(CONFIG_SHT3X_PERIOD_MS);
+/**
+ * @brief Publish the parameters and outputs of the local control loops
+ * - topic: <prefix>/status/control
+ * - goal: Let the cloud supervise the on-device control
+ * - payload: {"loops": [{"loop": "humidity", "actuator": "humidifier", "mode": "pid", "setpoint": 55.00, ..., "output": "on", "duty": 0.42}]}
+ * - qos: 1
+ * - retain: FALSE
+ * - trigger: After every accepted configuration, and with every health check
+ */
+static void publish_control_status(void)
+{
+    static char payload[CLIMATE_STATUS_JSON_LEN];
+    size_t len = 0;
 
-    while (1) {
-        /* Wait for the next cycle */
-        vTaskDelayUntil(&last_wake_time, period);
+    esp_err_t err = climate_control_status_json(payload, sizeof(payload), &len);
+    if (err != ESP_OK) {
+        ESP_LOGE("MQTT", "Failed to encode control status: %s", esp_err_to_name(err));
+        return;
+    }
+    mqtt_service_enqueue(topics[TOPIC_STATUS_CONTROL_PUB], payload, (int)len, 1, MQTT_PRIORITY_MID, MQTT_PUBLISH_LATEST);
+}
 
-        // Gọi hàm đo single shot
-        esp_err_t res = sht3x_read_data(&temperature, &humidity);
+/**
+ * @brief Publish the rule engine counters
+ * - topic: <prefix>/status/rules
+ * - goal: Show how many rules are active and what evaluating them costs per sample
+ * - payload: {"rules": 2, "evaluations": 1800, "last_us": 4, "max_us": 11, "avg_us": 4.20}
+ * - qos: 1
+ * - retain: FALSE
+ * - trigger: After every accepted rules document, and with every health check
+ */
+static void publish_rules_status(void)
+{
+    char payload[RULE_ENGINE_STATUS_JSON_MAX_LEN];
+    size_t len = 0;
 
-        if (res == ESP_OK) {
-            ESP_LOGI(TAG, "Temp: %.2f °C, Hum: %.2f %%", temperature, humidity);
-        } else {
-            ESP_LOGE(TAG, "SHT3x read error: %s", esp_err_to_name(res));
+    esp_err_t err = rule_engine_status_json(payload, sizeof(payload), &len);
+    if (err != ESP_OK) {
+        ESP_LOGE("MQTT", "Failed to encode rules status: %s", esp_err_to_name(err));
+        return;
+    }
+    mqtt_service_enqueue(topics[TOPIC_STATUS_RULES_PUB], payload, (int)len, 1, MQTT_PRIORITY_MID, MQTT_PUBLISH_LATEST);
+}
+
+/* Filtering, rollups, local control and publishing of one raw sample */
+static void process_sample(const telemetry_sample_t *raw)
+{
+    telemetry_sample_t sample;
+
+    DLOG_D(app_log, "Temp: %.2f °C, Hum: %.2f %%", raw->temperature, raw->humidity);
+    if (boot_first_sample_ms == 0) {
+        boot_first_sample_ms = uptime_ms();
+        ESP_LOGI(TAG, "Boot: first sample after %lu ms", (unsigned long)boot_first_sample_ms);
+    }
+
+    // Rollups see every raw read, so min/max keep the spikes the filter removes
+    telemetry_rollup_t closed;
+    if (rollup_queue != NULL && sample_rollup_add(&sample_rollup, raw, &closed)) {
+        if (xQueueSend(rollup_queue, &closed, 0) != pdTRUE) {
+            metrics_counter_inc(&rollups_dropped);
+        } else if (sensor_pub_task_handle != NULL) {
+            xTaskNotifyGive(sensor_pub_task_handle);
         }
+    }
 
-        publish_sensor_data(temperature, humidity);
+    bool publish = sample_filter_update(&sample_filter, raw, &sample);
 
-        UBaseType_t high_water_mark = uxTaskGetStackHighWaterMark(NULL);
-        ESP_LOGI("SENSOR TASK", "Stack high water mark: %u bytes", high_water_mark);
+    // Local control first: relays react without any network round trip
+    climate_control_feed(&sample);
+    rule_engine_feed(&sample);
+
+    // Only samples that moved past the deadband (or heartbeats) are published
+    if (publish && SENSOR_PUBLISH_RAW) {
+        if (!sample_ring_push(&sample_ring, &sample)) {
+            ESP_LOGW(TAG, "Sample ring full, dropped %lu samples so far",
+                     (unsigned long)sample_ring_dropped(&sample_ring));
+        }
+        if (sample_ring_count(&sample_ring) >= CONFIG_SENSOR_BATCH_SIZE && sensor_pub_task_handle != NULL) {
+            xTaskNotifyGive(sensor_pub_task_handle);
+        }
     }
 }
 
-void humid_task(void *pvParameters)
+static void on_sensor_reading(uint8_t index, const sensor_driver_t *driver, esp_err_t err,
+                              const telemetry_sample_t *sample, void *ctx)
 {
-    relay_config_t relay_cfg;
-    relay_cfg.gpio_pin = CONFIG_HUMID_PIN;
-    relay_cfg.type = CONFIG_HUMID_TYPE;
-
-    esp_err_t err = relay_init(&relay_cfg);
     if (err != ESP_OK) {
-        ESP_LOGE("RELAY_TASK", "Failed to initialize relay: %s", esp_err_to_name(err));
-        vTaskDelete(NULL);
+        ESP_LOGE(TAG, "%s read error: %s", driver->name, esp_err_to_name(err));
+        return;
     }
+    cycle_samples[index] = *sample;
+    cycle_valid[index] = true;
+}
 
-    uint32_t received_state = 0;
-    relay_state_t last_state = RELAY_STATE_OFF;  // Track actual relay state
+static uint64_t clock_ms(void)
+{
+    return (uint64_t)(esp_timer_get_time() / 1000);
+}
 
+/* Blocks for at least ms; vTaskDelay counts tick interrupts, and the first one may come right away */
+static void sleep_ms(uint64_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms) + 1);
+}
+
+/**
+ * Samples every sensor of the hub. A cycle starts all sensors that are due,
+ * then collects each one as soon as its conversion is ready, so the waits
+ * overlap instead of adding up. The first sensor (in the order they were
+ * added) with a valid reading feeds the sample path; the others stand in
+ * while it fails.
+ */
+void sampling_task(void *pvParameters)
+{
     while (1) {
-        BaseType_t res = xTaskNotifyWait(0, ULONG_MAX, &received_state, portMAX_DELAY);
-
-        if (res == pdTRUE) {
-            ESP_LOGI("HUMID_TASK", "Received command set state: %lu", received_state);
-            
-            esp_err_t ret = relay_set_level(&relay_cfg, received_state);
-            if (ret != ESP_OK) {
-                ESP_LOGE("HUMID_TASK", "Failed to set relay: %s", esp_err_to_name(ret));
+        int64_t cycle_start = esp_timer_get_time();
+        uint64_t ready_ms;
+
+        memset(cycle_valid, 0, sizeof(cycle_valid));
+        if (sensor_hub_start(&sensor_hub, clock_ms()) > 0) {
+            while (sensor_hub_next_ready(&sensor_hub, &ready_ms)) {
+                uint64_t now = clock_ms();
+                if (ready_ms > now) {
+                    sleep_ms(ready_ms - now);
+                }
+                sensor_hub_collect(&sensor_hub, clock_ms(), on_sensor_reading, NULL);
+            }
+            metrics_histogram_observe(&sensor_cycle_time, (uint32_t)(esp_timer_get_time() - cycle_start));
+
+            uint8_t i = 0;
+            while (i < sensor_hub.count && !cycle_valid[i]) {
+                i++;
+            }
+            if (i < sensor_hub.count) {
+                process_sample(&cycle_samples[i]);
             } else {
-                // Get actual relay state
-                relay_state_t current_state;
-                ret = relay_get_state(&relay_cfg, &current_state);
-                if (ret == ESP_OK) {
-                    // Only publish if state changed
-                    if (current_state != last_state) {
-                        last_state = current_state;
-                        publish_device_status("humidifier", current_state == RELAY_STATE_ON ? "on" : "off");
-                        ESP_LOGI("HUMID_TASK", "Relay state updated to: %s", current_state == RELAY_STATE_ON ? "ON" : "OFF");
-                    }
-                } else {
-                    ESP_LOGE("HUMID_TASK", "Failed to get relay state: %s", esp_err_to_name(ret));
+                // A failed read has no new data: nothing is published or fed to control
+                metrics_counter_inc(&sensor_read_failures);
+            }
+        }
+
+        /* Wait for the next cycle; the first sample is taken right at boot */
+        uint64_t due = sensor_hub_next_due(&sensor_hub);
+        uint64_t now = clock_ms();
+        if (due > now) {
+            sleep_ms(due - now);
+        }
+    }
+}
+
+/**
+ * Drains the sample ring: publishes a batch as soon as CONFIG_SENSOR_BATCH_SIZE
+ * samples are queued, or whatever is pending once CONFIG_SENSOR_BATCH_MAX_AGE_MS
+ * has passed since the last flush. While MQTT is down the samples go to the
+ * flash log instead; after reconnecting the backlog is replayed at a limited
+ * rate alongside live data.
+ */
+void sensor_publish_task(void *pvParameters)
+{
+    static telemetry_sample_t batch[CONFIG_SENSOR_BATCH_SIZE];
+    const TickType_t max_age = pdMS_TO_TICKS(CONFIG_SENSOR_BATCH_MAX_AGE_MS);
+    const TickType_t replay_interval = pdMS_TO_TICKS(CONFIG_SAMPLE_LOG_REPLAY_INTERVAL_MS);
+    TickType_t last_flush = xTaskGetTickCount();
+    TickType_t last_replay = last_flush;
+
+    while (1) {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wait = (now - last_flush) < max_age ? max_age - (now - last_flush) : 0;
+        bool replaying = sample_log_ready && sample_log_pending() > 0 && mqtt_service_is_connected();
+        if (replaying) {
+            TickType_t replay_wait = (now - last_replay) < replay_interval
+                                   ? replay_interval - (now - last_replay) : 0;
+            if (replay_wait < wait) {
+                wait = replay_wait;
+            }
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        // Rollups go to the offline log like samples; without it they stay queued and the
+        // sensor task drops new ones once the queue is full
+        telemetry_rollup_t rollup;
+        while (rollup_queue != NULL && xQueuePeek(rollup_queue, &rollup, 0) == pdTRUE) {
+            if (!mqtt_service_is_connected() ||
+                !publish_sensor_rollup(&rollup, (uint64_t)(esp_timer_get_time() / 1000), current_boot_id)) {
+                if (!sample_log_ready || sample_log_append_rollup(&rollup) != ESP_OK) {
+                    break;
                 }
             }
+            xQueueReceive(rollup_queue, &rollup, 0);
         }
 
-        UBaseType_t high_water_mark = uxTaskGetStackHighWaterMark(NULL);
-        ESP_LOGI("HUMID_TASK", "Stack high water mark: %u bytes", high_water_mark);
+        bool expired = (xTaskGetTickCount() - last_flush) >= max_age;
+        uint32_t pending = sample_ring_count(&sample_ring);
+
+        while (pending >= CONFIG_SENSOR_BATCH_SIZE || (expired && pending > 0)) {
+            uint32_t n = sample_ring_pop(&sample_ring, batch, CONFIG_SENSOR_BATCH_SIZE);
+            if (!mqtt_service_is_connected() || !publish_live_samples(batch, n)) {
+                store_offline(batch, n);
+            } else if (boot_first_publish_ms == 0) {
+                boot_first_publish_ms = uptime_ms();
+                ESP_LOGI(TAG, "Boot: first publish after %lu ms", (unsigned long)boot_first_publish_ms);
+            }
+            last_flush = xTaskGetTickCount();
+            expired = false;
+            pending = sample_ring_count(&sample_ring);
+        }
+
+        if (expired) {
+            last_flush = xTaskGetTickCount();
+        }
+
+        if (replaying && (xTaskGetTickCount() - last_replay) >= replay_interval) {
+            replay_backlog();
+            last_replay = xTaskGetTickCount();
+        }
+    }
+}
+
+/**
+ * Returns an identifier that changes on every boot (persisted in NVS), so
+ * samples stored offline can be told apart from earlier boots.
+ */
+static uint32_t next_boot_id(void)
+{
+    nvs_handle_t nvs;
+    uint32_t boot_id = 0;
+
+    if (nvs_open("app", NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to open NVS for boot id");
+        return 0;
+    }
+    nvs_get_u32(nvs, "boot_id", &boot_id);
+    boot_id++;
+    nvs_set_u32(nvs, "boot_id", boot_id);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+    return boot_id;
+}
+
+static esp_err_t trace_to_mqtt(const uint8_t *chunk, size_t len, void *ctx)
+{
+    // Stops the dump once diagnostics are over budget instead of crowding out acks
+    return mqtt_service_enqueue(topics[TOPIC_TRACE_DATA_PUB], chunk, (int)len, 1, MQTT_PRIORITY_MID, 0);
+}
+
+/* One "TRACE <hex>" line per chunk on the console */
+static esp_err_t trace_to_uart(const uint8_t *chunk, size_t len, void *ctx)
+{
+    static const char hex[] = "0123456789abcdef";
+    static char line[2 * EVENT_TRACE_CHUNK_LEN + 1];
+
+    for (size_t i = 0; i < len; i++) {
+        line[2 * i] = hex[chunk[i] >> 4];
+        line[2 * i + 1] = hex[chunk[i] & 0x0f];
     }
+    line[2 * len] = '\0';
+    printf("TRACE %s\n", line);
+    return ESP_OK;
 }
 
-void fan_task(void *pvParameters)
+/**
+ * @brief Dump the trace ring
+ * - topic: <prefix>/trace/data, one binary chunk per message, or the console
+ *   with {"to": "uart"}
+ * - read back with host/tools/trace_to_perfetto.py
+ */
+static void dump_trace(const char *topic, size_t topic_len, const char *payload, size_t payload_len, void *ctx)
 {
-    relay_config_t relay_cfg;
-    relay_cfg.gpio_pin = CONFIG_FAN_PIN;
-    relay_cfg.type = CONFIG_FAN_TYPE;
+    json_scan_t scan;
+    json_tok_t key, val;
+    bool uart = false;
 
-    esp_err_t err = relay_init(&relay_cfg);
+    if (json_scan_object(&scan, payload, payload_len) == ESP_OK) {
+        while (json_scan_next_member(&scan, &key, &val) == ESP_OK) {
+            if (json_tok_equals(&key, "to")) {
+                uart = json_tok_equals(&val, "uart");
+            }
+        }
+    }
+
+    esp_err_t err = event_trace_dump(uart ? trace_to_uart : trace_to_mqtt, NULL);
     if (err != ESP_OK) {
-        ESP_LOGE("FAN_TASK", "Failed to initialize relay: %s", esp_err_to_name(err));
-        vTaskDelete(NULL);
+        ESP_LOGW(TAG, "Trace dump failed: %s", esp_err_to_name(err));
     }
+}
 
-    uint32_t received_state = 0;
-    relay_state_t last_state = RELAY_STATE_OFF;  // Track actual relay state
+/**
+ * @brief Change a log level at runtime
+ * - topic: <prefix>/log/level, or all/log/level for the whole fleet
+ * - payload: {"module": "MQTT_SERVICE", "level": "debug"}; level is one of
+ *   none/error/warn/info/debug/verbose, module "*" changes every module
+ * - deferred modules are matched first, any other name is taken as an
+ *   ESP_LOG tag (which cannot go above the compiled maximum level)
+ */
+static void set_log_level(const char *topic, size_t topic_len, const char *payload, size_t payload_len, void *ctx)
+{
+    static const char *const level_names[] = {
+        [DLOG_LEVEL_NONE] = "none",
+        [DLOG_LEVEL_ERROR] = "error",
+        [DLOG_LEVEL_WARN] = "warn",
+        [DLOG_LEVEL_INFO] = "info",
+        [DLOG_LEVEL_DEBUG] = "debug",
+        [DLOG_LEVEL_VERBOSE] = "verbose",
+    };
+    json_scan_t scan;
+    json_tok_t key, val, module = { 0 };
+    int level = -1;
 
-    while (1) {
-        BaseType_t res = xTaskNotifyWait(0, ULONG_MAX, &received_state, portMAX_DELAY);
-
-        if (res == pdTRUE) {
-            ESP_LOGI("FAN_TASK", "Received command set state: %lu", received_state);
-            
-            esp_err_t ret = relay_set_level(&relay_cfg, received_state);
-            if (ret != ESP_OK) {
-                ESP_LOGE("FAN_TASK", "Failed to set relay: %s", esp_err_to_name(ret));
-            } else {
-                // Get actual relay state
-                relay_state_t current_state;
-                ret = relay_get_state(&relay_cfg, &current_state);
-                if (ret == ESP_OK) {
-                    // Only publish if state changed
-                    if (current_state != last_state) {
-                        last_state = current_state;
-                        publish_device_status("fan", current_state == RELAY_STATE_ON ? "on" : "off");
-                        ESP_LOGI("FAN_TASK", "Relay state updated to: %s", current_state == RELAY_STATE_ON ? "ON" : "OFF");
-                    }
-                } else {
-                    ESP_LOGE("FAN_TASK", "Failed to get relay state: %s", esp_err_to_name(ret));
+    if (json_scan_object(&scan, payload, payload_len) != ESP_OK) {
+        ESP_LOGW(TAG, "Invalid log level request");
+        return;
+    }
+    while (json_scan_next_member(&scan, &key, &val) == ESP_OK) {
+        if (json_tok_equals(&key, "module") && val.type == JSON_TOK_STRING && !val.escaped) {
+            module = val;
+        } else if (json_tok_equals(&key, "level")) {
+            for (size_t i = 0; i < sizeof(level_names) / sizeof(level_names[0]); i++) {
+                if (val.type == JSON_TOK_STRING && json_tok_equals(&val, level_names[i])) {
+                    level = (int)i;
                 }
             }
-        } else {
-            ESP_LOGW("FAN_TASK", "xTaskNotifyWait failed");
         }
+    }
+    if (module.ptr == NULL || module.len == 0 || level < 0) {
+        ESP_LOGW(TAG, "Log level request needs a module and a known level");
+        return;
+    }
+
+    char tag[24];
+    if (module.len >= sizeof(tag)) {
+        ESP_LOGW(TAG, "Log module name too long");
+        return;
+    }
+    memcpy(tag, module.ptr, module.len);
+    tag[module.len] = '\0';
 
-        UBaseType_t high_water_mark = uxTaskGetStackHighWaterMark(NULL);
-        ESP_LOGI("FAN_TASK", "Stack high water mark: %u bytes", high_water_mark);
+    esp_err_t err = deferred_log_set_level(module.ptr, module.len, (dlog_level_t)level);
+    if (err == ESP_ERR_NOT_FOUND || strcmp(tag, "*") == 0) {
+        esp_log_level_set(tag, (esp_log_level_t)level);
     }
+    ESP_LOGI(TAG, "Log level of %s set to %s", tag, level_names[level]);
 }
 
-void on_mqtt_data_received(const char *topic, int topic_len, const char *payload, int payload_len)
+/* <prefix>/commands and all/commands */
+static void handle_command(const char *topic, size_t topic_len, const char *payload, size_t payload_len, void *ctx)
 {
-    ESP_LOGI("MQTT_DEBUG", "Received data on topic %.*s: %.*s", topic_len, topic, payload_len, payload);
-
-    // 1. Kiểm tra Topic trước để tiết kiệm bộ nhớ (không alloc nếu sai topic)
-    if (topic_len == strlen(TOPIC_COMMAND_SUB) && strncmp(topic, TOPIC_COMMAND_SUB, topic_len) == 0)
-    {
-        // 2. Chuyển payload thành chuỗi null-terminated an toàn
-        char *json_str = strndup(payload, payload_len);
-        if (json_str == NULL) {
-            ESP_LOGE("MQTT", "Failed to allocate memory for JSON string");
-            return;
+    // Parse straight from the MQTT buffer, no copy
+    command_batch_t batch;
+    esp_err_t err = app_controller_send_command(payload, payload_len, &batch);
+    if (err == ESP_OK) {
+        DLOG_I(app_log, "Command processed successfully");
+    } else {
+        ESP_LOGW("MQTT", "Failed to process command");
+        // Accepted commands are acknowledged by the actuator task once applied
+        if (batch.ref.id[0] != '\0') {
+            publish_command_ack(&batch, err, actuator_manager_get_states());
         }
-        bool result = app_controller_send_command(json_str);
-        if (result) {
-            ESP_LOGI("MQTT", "Command processed successfully");
-        } else {
-            ESP_LOGW("MQTT", "Failed to process command");
+    }
+}
+
+static void handle_control(const char *topic, size_t topic_len, const char *payload, size_t payload_len, void *ctx)
+{
+    esp_err_t err = climate_control_configure(payload, payload_len);
+    if (err == ESP_OK) {
+        publish_control_status();
+    } else {
+        ESP_LOGW("MQTT", "Rejected control settings: %s", esp_err_to_name(err));
+    }
+}
+
+static void handle_rules(const char *topic, size_t topic_len, const char *payload, size_t payload_len, void *ctx)
+{
+    esp_err_t err = rule_engine_configure(payload, payload_len);
+    if (err == ESP_OK) {
+        publish_rules_status();
+    } else {
+        ESP_LOGW("MQTT", "Rejected rules: %s", esp_err_to_name(err));
+    }
+}
+
+/* Copies an unescaped JSON string into buf; false if it is not one or does not fit */
+static bool copy_name(const json_tok_t *val, char *buf, size_t len)
+{
+    if (val->type != JSON_TOK_STRING || val->escaped || val->len >= len) {
+        return false;
+    }
+    memcpy(buf, val->ptr, val->len);
+    buf[val->len] = '\0';
+    return true;
+}
+
+/**
+ * @brief Move this node to another room or device name
+ * - topic: <prefix>/identity/set
+ * - payload: {"room": "room_07", "device": "node_a"}; device is optional,
+ *   "" or missing means one node per room
+ * - the identity is stored in NVS and the node restarts to rebuild its topics
+ */
+static void handle_identity(const char *topic, size_t topic_len, const char *payload, size_t payload_len, void *ctx)
+{
+    char room[DEVICE_IDENTITY_NAME_MAX_LEN + 1] = "";
+    char device[DEVICE_IDENTITY_NAME_MAX_LEN + 1] = "";
+    json_scan_t scan;
+    json_tok_t key, val;
+    bool ok = json_scan_object(&scan, payload, payload_len) == ESP_OK;
+
+    while (ok && json_scan_next_member(&scan, &key, &val) == ESP_OK) {
+        if (json_tok_equals(&key, "room")) {
+            ok = copy_name(&val, room, sizeof(room));
+        } else if (json_tok_equals(&key, "device")) {
+            ok = copy_name(&val, device, sizeof(device));
         }
-        free(json_str);
     }
+    esp_err_t err = ok ? device_identity_store(room, device) : ESP_ERR_INVALID_ARG;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Rejected identity: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "Identity set to %s/%s, restarting", room, device);
+    esp_restart();
 }
 
-void sensor_cycle_task(void *pvParameters)
+void on_mqtt_data_received(const char *topic, int topic_len, const char *payload, int payload_len)
 {
-    float fake_temp = 20.0, fake_hum = 60.0;
-    while (1) {
-        // Logic đọc DHT11 thật sẽ đặt ở đây
-        fake_temp += 0.5;
-        if (fake_temp > 35.0) fake_temp = 20.0;
-        
-        publish_sensor_data(fake_temp, fake_hum);
-        
-        // Dùng vTaskDelay thay vì busy wait
-        vTaskDelay(pdMS_TO_TICKS(5000));
+    esp_err_t err = topic_router_dispatch(&router, topic, (size_t)topic_len, payload, (size_t)payload_len);
+    if (err != ESP_OK) {
+        ESP_LOGW("MQTT", "No handler for %.*s", topic_len, topic);
     }
 }
 
-void print_all_tasks(void *pvParameters) {
-    while (1) {
-        char buffer[1024];
-        vTaskList(buffer);  // Liệt kê tất cả task + stack usage
-        ESP_LOGI(TAG, "Danh sách task:\n%s", buffer);
-        vTaskDelay(pdMS_TO_TICKS(10000));
+/* Routes a filter and subscribes to it; the subscription is renewed on every connect */
+static void route(const char *filter, topic_handler_t handler)
+{
+    ESP_ERROR_CHECK(topic_router_add(&router, filter, handler, NULL));
+    mqtt_service_subscribe(filter, 1);
+}
+
+/* Builds every topic of this node from its provisioned identity */
+static void init_topics(void)
+{
+    ESP_ERROR_CHECK(device_identity_load(&identity));
+    for (int i = 0; i < TOPIC_COUNT; i++) {
+        ESP_ERROR_CHECK(device_identity_topic(&identity, topic_suffixes[i], topics[i], sizeof(topics[i])));
     }
+    mqtt_service_set_status_topic(topics[TOPIC_STATUS_CONNECTION_PUB]);
 }
 
+/**
+ * @brief Publish the health check together with the metrics snapshot
+ * - topic: <prefix>/status/system
+ * - payload: the health fields plus "metrics": {"heap": {...}, "tasks": [...],
+ *   "counters": {...}, "gauges": {...}, "histograms": {...}}
+ * - with the binary format the health part stays binary and the snapshot
+ *   follows as its own JSON message {"uptime_ms": .., "metrics": {...}},
+ *   which is skipped while offline
+ * - queued as a snapshot: while offline only the newest report waits
+ * - only called from health_check_task, which owns the static payload buffer
+ */
 void publish_health_check_params(health_check_params_t *params)
 {
-    cJSON *root = cJSON_CreateObject();
-    if (root == NULL) {
-        ESP_LOGE("HEALTH_CHECK_MQTT", "Failed to create JSON object for health check");
+    static char payload[SYSTEM_STATUS_JSON_LEN];
+    const telemetry_health_t health = {
+        .uptime_ms = params->uptime_ms,
+        .free_heap = params->free_heap_bytes,
+        .wifi_rssi = params->wifi_rssi,
+        .backlog = params->backlog,
+        .first_sample_ms = params->first_sample_ms,
+        .first_publish_ms = params->first_publish_ms,
+    };
+    size_t len = 0;
+    esp_err_t err;
+    telemetry_json_writer_t w;
+
+#if CONFIG_TELEMETRY_FORMAT_BINARY
+    err = telemetry_encode_health_bin((uint8_t *)payload, sizeof(payload), &health, &len);
+    if (err != ESP_OK) {
+        ESP_LOGE("HEALTH_CHECK_MQTT", "Failed to encode health check: %s", esp_err_to_name(err));
+        return;
+    }
+    mqtt_service_enqueue(topics[TOPIC_STATUS_SYSTEM_PUB], payload, (int)len, 1, MQTT_PRIORITY_MID,
+                         MQTT_PUBLISH_LATEST);
+    // Same topic, so a queued snapshot would replace the health part; the next report has the counters
+    if (!mqtt_service_is_connected()) {
         return;
     }
 
-    cJSON_AddNumberToObject(root, "uptime_ms", params->uptime_ms);
-    cJSON_AddNumberToObject(root, "free_heap", params->free_heap_bytes);
-    cJSON_AddNumberToObject(root, "wifi_rssi", params->wifi_rssi);
-
-    char *json_string = cJSON_PrintUnformatted(root);
-    if (json_string != NULL) {
-        mqtt_service_publish(TOPIC_STATUS_SYSTEM_PUB, json_string, 1);
-        free(json_string);
-    } else {
-        ESP_LOGE("HEALTH_CHECK_MQTT", "Failed to print JSON for health check");
+    telemetry_json_init(&w, payload, sizeof(payload));
+    telemetry_json_object_begin(&w);
+    telemetry_json_key(&w, "uptime_ms");
+    telemetry_json_number(&w, (double)health.uptime_ms);
+#else
+    telemetry_json_init(&w, payload, sizeof(payload));
+    telemetry_json_object_begin(&w);
+    telemetry_json_health_members(&w, &health);
+#endif
+    telemetry_json_key(&w, "metrics");
+    telemetry_json_object_begin(&w);
+    metrics_system_write_json(&w);
+    metrics_write_json(&w);
+    sensor_hub_write_json(&sensor_hub, &w);
+    telemetry_json_object_end(&w);
+    telemetry_json_object_end(&w);
+    err = telemetry_json_finish(&w, &len);
+    if (err != ESP_OK) {
+        ESP_LOGE("HEALTH_CHECK_MQTT", "Failed to encode metrics snapshot: %s", esp_err_to_name(err));
+        return;
     }
 
-    cJSON_Delete(root);
+#if CONFIG_TELEMETRY_FORMAT_BINARY
+    mqtt_service_enqueue(topics[TOPIC_STATUS_SYSTEM_PUB], payload, (int)len, 1, MQTT_PRIORITY_MID, 0);
+#else
+    mqtt_service_enqueue(topics[TOPIC_STATUS_SYSTEM_PUB], payload, (int)len, 1, MQTT_PRIORITY_MID,
+                         MQTT_PUBLISH_LATEST);
+#endif
 }
 
 void health_check_task(void *pvParameters)
@@ -340,7 +1043,7 @@ void health_check_task(void *pvParameters)
 
         /* Get free_heap*/
         params.free_heap_bytes = esp_get_free_heap_size();
-        ESP_LOGI("HEALTH_CHECK", "Free heap (bytes): %u", params.free_heap_bytes);
+        ESP_LOGI("HEALTH_CHECK", "Free heap (bytes): %zu", params.free_heap_bytes);
         
         /* Get rssi */
         wifi_ap_record_t ap_info;
@@ -352,11 +1055,57 @@ void health_check_task(void *pvParameters)
             ESP_LOGI("HEALTH_CHECK", "WiFi RSSI (dBm): %d", params.wifi_rssi);
         }
 
+        /* Get offline backlog depth */
+        params.backlog = sample_log_ready ? sample_log_pending() : 0;
+        ESP_LOGI("HEALTH_CHECK", "Offline backlog (samples): %lu", (unsigned long)params.backlog);
+
+        /* I2C bus health */
+        i2c_bus_device_stats_t i2c_stats;
+        i2c_bus_device_t *sht3x_dev = sht3x_sensor.sht3x.dev;
+        if (sht3x_dev != NULL && i2c_bus_get_device_stats(sht3x_dev, &i2c_stats) == ESP_OK) {
+            ESP_LOGI("HEALTH_CHECK", "SHT3x 0x%02x: %lu transfers, %lu errors, latency avg %lu us max %lu us",
+                     i2c_bus_device_address(sht3x_dev), (unsigned long)i2c_stats.transactions,
+                     (unsigned long)i2c_stats.errors,
+                     (unsigned long)(i2c_stats.transactions ? i2c_stats.latency_total_us / i2c_stats.transactions : 0),
+                     (unsigned long)i2c_stats.latency_max_us);
+        }
+
+        /* Per-sensor health; the counters are only written by the sampling task */
+        for (uint8_t i = 0; i < sensor_hub.count; i++) {
+            const sensor_health_t *health = &sensor_hub.slots[i].health;
+            ESP_LOGI("HEALTH_CHECK", "Sensor %s: %s, %lu reads, %lu failures, %lu reinits, last error %s",
+                     sensor_hub.slots[i].driver.name, sensor_state_name(sensor_hub_state(&sensor_hub, i)),
+                     (unsigned long)health->reads, (unsigned long)health->failures,
+                     (unsigned long)health->reinits, esp_err_to_name(health->last_error));
+        }
+
+        /* Sample filter: how much the deadband saves */
+        ESP_LOGI("HEALTH_CHECK", "Samples: %lu published, %lu within deadband, %lu cycles without a reading",
+                 (unsigned long)sample_filter.passed, (unsigned long)sample_filter.suppressed,
+                 (unsigned long)sensor_read_failures.value);
+        if (rollup_queue != NULL) {
+            ESP_LOGI("HEALTH_CHECK", "Rollups: %lu windows, %lu dropped",
+                     (unsigned long)sample_rollup.emitted, (unsigned long)rollups_dropped.value);
+        }
+
+        /* Rule evaluation cost */
+        rule_engine_stats_t rule_stats;
+        rule_engine_get_stats(&rule_stats);
+        if (rule_stats.evaluations > 0) {
+            ESP_LOGI("HEALTH_CHECK", "Rules: %lu active, eval last %lu us max %lu us avg %lu us",
+                     (unsigned long)rule_stats.rules, (unsigned long)rule_stats.last_us,
+                     (unsigned long)rule_stats.max_us,
+                     (unsigned long)(rule_stats.total_us / rule_stats.evaluations));
+        }
+
+        /* Boot milestones */
+        params.first_sample_ms = boot_first_sample_ms;
+        params.first_publish_ms = boot_first_publish_ms;
+
         /* Publishing to topic */
         publish_health_check_params(&params);
-
-        UBaseType_t high_water_mark = uxTaskGetStackHighWaterMark(NULL);
-        ESP_LOGI("HEALTH_CHECK", "Stack high water mark: %u bytes", high_water_mark);
+        publish_control_status();
+        publish_rules_status();
     }
 }
 
@@ -370,46 +1119,115 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
-    // Start Wi-Fi Service
-    wifi_service_start();
-    
-    // Wait for Wi-Fi connection to establish
-    // TODO Change waiting method
-    // => NEED TO CHANGE INTO 
-    // if not connect => change to another state just sensor and save data to NVS 
-    // send data when have wifi
-    // vTaskDelay(pdMS_TO_TICKS(10000));
-    wifi_service_wait_for_connect();
-    
-    // Initialize App Controller
-    app_controller_init();
-
-    // Start MQTT Service
-    mqtt_service_start(on_mqtt_data_received);
-
-    vTaskDelay(pdMS_TO_TICKS(5000)); 
-    mqtt_service_subscribe(TOPIC_COMMAND_SUB, 1);
-    
-    // Create Relay - HUMID Task
-    xTaskCreate(humid_task, "HUMID TASK", 2048, NULL, 5, &humid_task_handle);
-    // Set relay task handle in app_controller
-    app_controller_set_humid_task_handle(humid_task_handle);
-    
-    // Create Relay - FAN Task
-    xTaskCreate(fan_task, "FAN TASK", 2048, NULL, 5, &fan_task_handle);
-    // Set fan task handle in app_controller
-    app_controller_set_fan_task_handle(fan_task_handle);
-
-    // Create Sensor Cycle Task
-    // xTaskCreate(sensor_cycle_task, "SENSOR", SENSOR_TASK_STACK_SIZE, NULL, SENSOR_TASK_PRIORITY, NULL);
-    
-    // Create DHT11 Task
-    // xTaskCreate(dht11_task, "DHT11 TASK", 2048, NULL, 5, NULL);
-
-    ESP_ERROR_CHECK(sht3x_init_i2c(CONFIG_SDA_PIN, CONFIG_SCL_PIN));
+    // Formats the deferred logs of every module started below
+    deferred_log_register(&app_log);
+    ESP_ERROR_CHECK(app_controller_init());
+    ESP_ERROR_CHECK(deferred_log_start());
+
+    // Topics are needed by every task that publishes
+    init_topics();
+
+    // Mount the offline sample log; without it the device still runs but
+    // loses samples taken while disconnected
+    current_boot_id = next_boot_id();
+    ret = sample_log_init(SAMPLE_LOG_PARTITION, current_boot_id);
+    if (ret == ESP_OK) {
+        sample_log_ready = true;
+    } else {
+        ESP_LOGW(TAG, "Offline sample log unavailable: %s", esp_err_to_name(ret));
+    }
+
+    // Relays: one bank and one actuator task for the whole table
+    relay_bank_backend_t relay_backend;
+#if CONFIG_RELAY_BANK_74HC595
+    ESP_ERROR_CHECK(relay_bank_595_init(&relay_outputs, &relay_chain, &relay_backend));
+#else
+    ESP_ERROR_CHECK(relay_bank_gpio_init(&relay_outputs, actuator_pins, ACTUATOR_COUNT, &relay_backend));
+#endif
+    ESP_ERROR_CHECK(actuator_manager_init(actuators, ACTUATOR_COUNT, &relay_backend, on_actuator_batch));
+    ESP_ERROR_CHECK(climate_control_init(climate_loops, sizeof(climate_loops) / sizeof(climate_loops[0])));
+    ESP_ERROR_CHECK(rule_engine_init());
+
+    ESP_ERROR_CHECK(sample_ring_init(&sample_ring, sample_ring_storage, SAMPLE_RING_CAPACITY));
+    xTaskCreate(sensor_publish_task, "SENSOR PUB TASK", TASK_SENSOR_PUB_STACK_SIZE, NULL, 3, &sensor_pub_task_handle);
+
+    const i2c_bus_config_t i2c_cfg = {
+        .port = I2C_NUM_0,
+        .sda_pin = CONFIG_SDA_PIN,
+        .scl_pin = CONFIG_SCL_PIN,
+        .mux_address = CONFIG_I2C_MUX_ADDRESS,
+        .queue_len = I2C_BUS_QUEUE_LEN,
+    };
+    ESP_ERROR_CHECK(i2c_bus_init(&i2c_cfg));
+
+    const sht3x_config_t sht3x_cfg = {
+        .address = CONFIG_SHT3X_ADDRESS,
+        .mux_channel = CONFIG_SHT3X_MUX_CHANNEL,
+        .clk_speed_hz = CONFIG_SHT3X_I2C_CLOCK_HZ,
+#if CONFIG_SHT3X_REPEATABILITY_LOW
+        .repeatability = SHT3X_REPEATABILITY_LOW,
+#elif CONFIG_SHT3X_REPEATABILITY_MEDIUM
+        .repeatability = SHT3X_REPEATABILITY_MEDIUM,
+#else
+        .repeatability = SHT3X_REPEATABILITY_HIGH,
+#endif
+        .rate = sht3x_rate_for_period(CONFIG_SHT3X_PERIOD_MS),
+    };
     ESP_LOGI(TAG, "I2C Initialized");
-    xTaskCreate(sht3x_task, "SHT3X TASK", TASK_SHT3X_STACK_SIZE, NULL, 3, NULL);
 
-    // xTaskCreate(print_all_tasks, "TASK_LIST", 2048, NULL, 1, NULL);
+    // Sensors that fail to start are still added; the hub retries them while sampling
+    sensor_driver_t sensor_driver;
+    ESP_ERROR_CHECK(sensor_hub_init(&sensor_hub, CONFIG_SHT3X_PERIOD_MS));
+    ESP_ERROR_CHECK(sht3x_sensor_driver(&sht3x_sensor, &sht3x_cfg, &sensor_driver));
+    ret = sensor_hub_add(&sensor_hub, &sensor_driver, clock_ms(), NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "SHT3x not ready: %s", esp_err_to_name(ret));
+    }
+#if CONFIG_SENSOR_DHT
+#if CONFIG_SENSOR_DHT_TYPE_DHT22
+    ESP_ERROR_CHECK(dht_sensor_driver(&dht_sensor, CONFIG_SENSOR_DHT_PIN, DHT_TYPE_DHT22, &sensor_driver));
+#else
+    ESP_ERROR_CHECK(dht_sensor_driver(&dht_sensor, CONFIG_SENSOR_DHT_PIN, DHT_TYPE_DHT11, &sensor_driver));
+#endif
+    ret = sensor_hub_add(&sensor_hub, &sensor_driver, clock_ms(), NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "DHT not ready: %s", esp_err_to_name(ret));
+    }
+#endif
+    const sample_filter_config_t filter_cfg = {
+        .median_len = CONFIG_SENSOR_MEDIAN_WINDOW,
+        .ema_alpha = CONFIG_SENSOR_EMA_ALPHA_PERCENT / 100.0f,
+        .temp_deadband = CONFIG_SENSOR_DEADBAND_TEMP_CENTI / 100.0f,
+        .hum_deadband = CONFIG_SENSOR_DEADBAND_HUM_CENTI / 100.0f,
+        .heartbeat_ms = CONFIG_SENSOR_HEARTBEAT_MS,
+    };
+    ESP_ERROR_CHECK(sample_filter_init(&sample_filter, &filter_cfg));
+    metrics_register_histogram(&sensor_cycle_time);
+    metrics_register_counter(&sensor_read_failures);
+    metrics_register_counter(&rollups_dropped);
+    metrics_register_histogram(&command_latency);
+#if CONFIG_SENSOR_ROLLUP_WINDOW_S > 0
+    ESP_ERROR_CHECK(sample_rollup_init(&sample_rollup, CONFIG_SENSOR_ROLLUP_WINDOW_S * 1000));
+    rollup_queue = xQueueCreate(ROLLUP_QUEUE_LEN, sizeof(telemetry_rollup_t));
+    if (rollup_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create rollup queue");
+    }
+#endif
+    xTaskCreate(sampling_task, "SAMPLING TASK", TASK_SAMPLING_STACK_SIZE, NULL, 3, NULL);
+
     xTaskCreate(health_check_task, "HEALTH_CHECK_TASK", TASK_HEALTH_CHECK_STACK_SIZE, NULL, 2, NULL);
+
+    // Bring the network up in the background. Sensing and relays already run;
+    // samples go to the offline log until the broker is reachable, and the
+    // subscription is issued on every MQTT connect.
+    topic_router_init(&router);
+    route(topics[TOPIC_COMMAND_SUB], handle_command);
+    route(TOPIC_ALL_COMMAND_SUB, handle_command);
+    route(topics[TOPIC_CONTROL_SUB], handle_control);
+    route(topics[TOPIC_RULES_SUB], handle_rules);
+    route(topics[TOPIC_TRACE_DUMP_SUB], dump_trace);
+    route(topics[TOPIC_LOG_LEVEL_SUB], set_log_level);
+    route(TOPIC_ALL_LOG_LEVEL_SUB, set_log_level);
+    route(topics[TOPIC_IDENTITY_SUB], handle_identity);
+    connectivity_start(on_mqtt_data_received);
 }
\ No newline at end of file
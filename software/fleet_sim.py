@@ -0,0 +1,728 @@
+#!/usr/bin/env python3
+"""Load test the backend with a simulated fleet, or with recorded traffic.
+
+    fleet_sim.py run --devices 2000 --procs 4 --duration 300 --backend http://127.0.0.1:8000
+    fleet_sim.py record -o traffic.jsonl --duration 3600
+    fleet_sim.py replay traffic.jsonl --speed 60 --copies 50 --backend http://127.0.0.1:8000
+
+run emulates nodes that speak the contract in the README "MQTT Topics"
+table: samples on <prefix>/sensors (single or batched), windows on
+sensors/rollup, the health report with metrics on status/system plus
+status/control and status/rules, "online" on status/connection with an
+"offline" will, and an ack (plus status/devices) for every command on
+<prefix>/commands or all/commands. Rates, bursts and connection flaps are
+set on the command line; every node is its own MQTT connection, so a flap
+really drops the TCP connection and the broker publishes the will.
+
+record stores what a broker carries, one JSON line per message; replay
+publishes it again with the original spacing divided by --speed, optionally
+as several copies under other room names.
+
+With --backend, the backend's ingest counters (main.py, /api/ingest) are
+reset at the start, printed while the load runs and written to --report with
+the fleet's own counters. --ws-clients N holds N dashboards open on /ws so
+the WebSocket fan-out is part of the load. Start the backend on the same
+broker, for example:
+
+    mosquitto -p 1883 &
+    MQTT_HOST=127.0.0.1 MQTT_PORT=1883 MQTT_TLS=0 NODE_PREFIX=+ DB_NAME=load.db uvicorn main:app --port 8000
+"""
+import argparse
+import base64
+import heapq
+import json
+import math
+import multiprocessing
+import os
+import random
+import resource
+import selectors
+import signal
+import socket
+import sys
+import threading
+import time
+import urllib.request
+import warnings
+from urllib.parse import urlparse
+
+from paho.mqtt import client as mqtt
+
+DEVICES = ("humidifier", "fan")
+STATES = {"on": "on", "off": "off", "1": "on", "0": "off", "true": "on", "false": "off"}
+# Seconds between retries when the broker refuses or drops a node
+RECONNECT_S = 5
+KEEPALIVE_S = 60
+
+
+def new_client(client_id: str):
+    # paho 2 warns about the 1.x callback signatures, which main.py uses as well
+    with warnings.catch_warnings():
+        warnings.simplefilter("ignore", DeprecationWarning)
+        return mqtt.Client(client_id=client_id, protocol=mqtt.MQTTv311)
+
+
+def parse_broker(text: str):
+    host, _, port = text.rpartition(":")
+    return (host or "127.0.0.1", int(port)) if port.isdigit() else (text, 1883)
+
+
+def raise_fd_limit():
+    """Every node holds a socket; lift the soft descriptor limit to the hard one"""
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    if soft < hard:
+        resource.setrlimit(resource.RLIMIT_NOFILE, (hard, hard))
+
+
+class Stats:
+    """One rollup window of a quantity: range plus Welford mean and variance"""
+
+    def __init__(self):
+        self.n = 0
+        self.mean = 0.0
+        self.m2 = 0.0
+        self.min = math.inf
+        self.max = -math.inf
+
+    def add(self, x: float):
+        self.n += 1
+        delta = x - self.mean
+        self.mean += delta / self.n
+        self.m2 += delta * (x - self.mean)
+        self.min = min(self.min, x)
+        self.max = max(self.max, x)
+
+    def to_dict(self):
+        return {"min": round(self.min, 2), "max": round(self.max, 2), "mean": round(self.mean, 2),
+                "var": round(self.m2 / self.n, 4)}
+
+
+# ================= FLEET =================
+class Node:
+    """One emulated ESP32: its own MQTT connection, sensor and relays"""
+
+    def __init__(self, fleet, prefix: str):
+        self.fleet = fleet
+        self.prefix = prefix
+        self.sock = None
+        self.events = selectors.EVENT_READ
+        self.connected = False
+        self.started = False
+        self.flapping = False
+        self.boot = time.monotonic()
+        self.first_publish_ms = 0
+        rng = fleet.rng
+        self.temperature = rng.uniform(22.0, 30.0)
+        self.humidity = rng.uniform(40.0, 70.0)
+        self.relays = {device: "off" for device in DEVICES}
+        self.batch = []
+        self.window_start = 0.0
+        self.window = (Stats(), Stats())
+
+        self.client = new_client("fleet-" + prefix.replace("/", "-"))
+        self.client.will_set(f"{prefix}/status/connection", "offline", qos=1, retain=True)
+        self.client.on_connect = self.on_connect
+        self.client.on_disconnect = self.on_disconnect
+        self.client.on_message = self.on_message
+
+    def uptime_s(self):
+        return time.monotonic() - self.boot
+
+    # ---- connection ----
+    def connect(self, _=None):
+        try:
+            if self.client.socket() is None and not self.started:
+                self.client.connect(self.fleet.host, self.fleet.port, KEEPALIVE_S)
+            else:
+                self.client.reconnect()
+        except OSError:
+            self.fleet.count("connect_failures")
+            self.fleet.schedule(RECONNECT_S, Node.connect, self)
+            return
+        self.flapping = False
+        self.sock = self.client.socket()
+        self.events = selectors.EVENT_READ
+        self.fleet.selector.register(self.sock, self.events, self)
+        self.watch_writes()
+
+    def drop(self):
+        """Forget the socket before paho closes it, so its descriptor can be reused"""
+        if self.sock is not None:
+            self.fleet.selector.unregister(self.sock)
+            self.sock = None
+
+    def on_connect(self, client, userdata, flags, rc):
+        if rc != 0:
+            self.fleet.count("connect_refused")
+            return
+        self.connected = True
+        self.fleet.count("connects")
+        client.subscribe([(f"{self.prefix}/commands", 1), ("all/commands", 1)])
+        self.publish("status/connection", "online", qos=1, retain=True)
+        if not self.started:
+            self.started = True
+            self.window_start = self.uptime_s()
+            rng = self.fleet.rng
+            self.fleet.schedule(rng.uniform(0, self.fleet.sample_interval()), Node.sample, self)
+            self.fleet.schedule(rng.uniform(0, self.fleet.args.health_interval), Node.health, self)
+            self.fleet.schedule(self.fleet.args.rollup_window, Node.rollup, self)
+            self.fleet.schedule_flap(self)
+
+    def on_disconnect(self, client, userdata, rc):
+        self.drop()
+        self.connected = False
+        if self.flapping or self.fleet.stopping:
+            return
+        self.fleet.count("disconnects")
+        self.fleet.schedule(RECONNECT_S, Node.connect, self)
+
+    def flap(self, _=None):
+        """Drop the TCP connection without DISCONNECT: the broker publishes the will"""
+        if self.connected:
+            self.fleet.count("flaps")
+            self.flapping = True
+            sock = self.sock
+            self.drop()
+            try:
+                sock.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+            self.client.loop_read()
+            self.fleet.schedule(self.fleet.args.flap_down, Node.connect, self)
+        self.fleet.schedule_flap(self)
+
+    def watch_writes(self):
+        """Ask for writability only while paho has bytes it could not send"""
+        if self.sock is None:
+            return
+        events = selectors.EVENT_READ | (selectors.EVENT_WRITE if self.client.want_write() else 0)
+        if events != self.events:
+            self.events = events
+            self.fleet.selector.modify(self.sock, events, self)
+
+    def publish(self, topic: str, payload, qos: int = 1, retain: bool = False):
+        if not self.connected:
+            self.fleet.count("skipped")
+            return
+        self.client.publish(f"{self.prefix}/{topic}", payload, qos=qos, retain=retain)
+        if not self.first_publish_ms:
+            self.first_publish_ms = int(self.uptime_s() * 1000)
+        self.fleet.published(topic)
+        self.watch_writes()
+
+    # ---- periodic traffic ----
+    def sample(self, _=None):
+        rng = self.fleet.rng
+        # Relays pull the room the way they would: humidifier up, fan down
+        self.humidity += rng.gauss(0, 0.05) + (0.02 if self.relays["humidifier"] == "on" else 0.0)
+        self.temperature += rng.gauss(0, 0.02) - (0.01 if self.relays["fan"] == "on" else 0.0)
+        self.humidity = min(95.0, max(10.0, self.humidity))
+        now = self.uptime_s()
+        sample = {"temperature": round(self.temperature, 2), "humidity": round(self.humidity, 2),
+                  "timestamp": round(now, 2)}
+        self.window[0].add(self.temperature)
+        self.window[1].add(self.humidity)
+        self.batch.append(sample)
+        if len(self.batch) >= self.fleet.args.batch:
+            if self.fleet.args.batch == 1:
+                sample["timestamp"] = int(now)
+                payload = sample
+            else:
+                payload = {"timestamp": round(now, 2), "samples": self.batch}
+            self.publish("sensors", json.dumps(payload))
+            self.batch = []
+        self.fleet.schedule(self.fleet.sample_interval(), Node.sample, self)
+
+    def rollup(self, _=None):
+        temp, hum = self.window
+        now = self.uptime_s()
+        if temp.n:
+            self.publish("sensors/rollup", json.dumps({
+                "timestamp": round(now, 2), "start": round(self.window_start, 2),
+                "window_s": self.fleet.args.rollup_window, "count": temp.n,
+                "temperature": temp.to_dict(), "humidity": hum.to_dict()}))
+        self.window_start = now
+        self.window = (Stats(), Stats())
+        self.fleet.schedule(self.fleet.args.rollup_window, Node.rollup, self)
+
+    def health(self, _=None):
+        rng = self.fleet.rng
+        uptime_ms = int(self.uptime_s() * 1000)
+        free_heap = rng.randint(150000, 180000)
+        self.publish("status/system", json.dumps({
+            "uptime_ms": uptime_ms, "free_heap": free_heap, "wifi_rssi": rng.randint(-80, -45),
+            "backlog": 0, "first_sample_ms": 35, "first_publish_ms": self.first_publish_ms,
+            "metrics": {
+                "heap": {"free": free_heap, "min_free": free_heap - 12000, "largest": free_heap // 2, "frag": 12},
+                "tasks": [{"name": "SHT3X TASK", "cpu": 0.4, "stack": 812},
+                          {"name": "mqtt_task", "cpu": 1.2, "stack": 1904}],
+                "counters": {"mqtt_published": self.fleet.totals["published"]},
+                "histograms": {"mqtt_publish_us": {"le": [1000, 10000], "n": [12, 1], "sum": 9876, "max": 2100}},
+            }}), qos=0)
+        self.publish("status/control", json.dumps({"loops": [{
+            "loop": "humidity", "actuator": "humidifier", "mode": "hysteresis", "setpoint": 55.0,
+            "hysteresis": 4.0, "kp": 0.1, "ki": 0.0005, "kd": 0, "window_s": 120, "min_on_s": 30,
+            "min_off_s": 30, "output": self.relays["humidifier"], "duty": 0.0}]}))
+        self.publish("status/rules", json.dumps({"rules": 0, "evaluations": 0, "last_us": 0, "max_us": 0,
+                                                 "avg_us": 0}))
+        self.fleet.schedule(self.fleet.args.health_interval, Node.health, self)
+
+    # ---- commands ----
+    def on_message(self, client, userdata, msg):
+        self.fleet.count("commands")
+        try:
+            command = json.loads(msg.payload)
+        except ValueError:
+            return
+        if not isinstance(command, dict):
+            return
+        items = command.get("commands")
+        if not isinstance(items, list):
+            items = [{"device": command.get("type"), "state": command.get("state")}]
+        self.fleet.schedule(self.fleet.args.ack_delay / 1000, Node.apply, self, (command, items))
+
+    def apply(self, arg):
+        """Apply a batch all or nothing, then ack it if it carried an id"""
+        command, items = arg
+        status = "ok"
+        applied = []
+        for item in items:
+            device = item.get("device") if isinstance(item, dict) else None
+            state = str(item.get("state")).lower() if isinstance(item, dict) else ""
+            if device not in self.relays:
+                status = "ESP_ERR_NOT_SUPPORTED"
+                break
+            if state == "toggle":
+                state = "off" if self.relays[device] == "on" else "on"
+            if state not in STATES:
+                status = "ESP_ERR_INVALID_ARG"
+                break
+            applied.append({"device": device, "state": STATES[state]})
+        changed = False
+        if status == "ok":
+            for item in applied:
+                changed |= self.relays[item["device"]] != item["state"]
+                self.relays[item["device"]] = item["state"]
+            if changed:
+                self.publish("status/devices", json.dumps({"timestamp": int(self.uptime_s()), "devices": applied}))
+        if command.get("id"):
+            self.fleet.count("acks")
+            self.publish("commands/ack", json.dumps({
+                "id": command["id"], "ts": command.get("ts"), "status": status,
+                "device_us": self.fleet.rng.randint(200, 1500),
+                "devices": applied if status == "ok" else []}))
+
+
+class Fleet:
+    """Nodes of one worker process, driven from a single selector loop"""
+
+    def __init__(self, args, worker: int):
+        self.args = args
+        self.host, self.port = parse_broker(args.broker)
+        self.rng = random.Random(args.seed * 1000 + worker)
+        self.selector = selectors.DefaultSelector()
+        self.events = []
+        self.seq = 0
+        self.start = time.monotonic()
+        self.stopping = False
+        self.totals = {"published": 0, "topics": {}}
+
+    def count(self, name: str):
+        self.totals[name] = self.totals.get(name, 0) + 1
+
+    def published(self, topic: str):
+        self.totals["published"] += 1
+        self.totals["topics"][topic] = self.totals["topics"].get(topic, 0) + 1
+
+    def schedule(self, delay_s: float, action, node, arg=None):
+        self.seq += 1
+        heapq.heappush(self.events, (time.monotonic() + delay_s, self.seq, action, node, arg))
+
+    def schedule_flap(self, node):
+        if self.args.flaps > 0:
+            self.schedule(self.rng.expovariate(self.args.flaps / 3600.0), Node.flap, node)
+
+    def sample_interval(self):
+        """--interval, divided by the burst factor while a burst is on"""
+        interval = self.args.interval
+        burst = self.args.burst
+        if burst and (time.monotonic() - self.start) % burst[0] < burst[1]:
+            interval /= burst[2]
+        return interval
+
+    def run(self, prefixes, stop, progress, slot):
+        nodes = [Node(self, prefix) for prefix in prefixes]
+        for i, node in enumerate(nodes):
+            self.schedule(self.args.ramp * i / max(1, len(nodes)), Node.connect, node)
+        end = self.start + self.args.duration
+        next_misc = self.start + 1.0
+        while not stop.is_set():
+            now = time.monotonic()
+            if now >= end:
+                break
+            timeout = min(0.1, end - now, max(0.0, self.events[0][0] - now) if self.events else 0.1)
+            for key, mask in self.selector.select(timeout):
+                node = key.data
+                if mask & selectors.EVENT_WRITE:
+                    node.client.loop_write()
+                if mask & selectors.EVENT_READ and node.sock is not None:
+                    node.client.loop_read(10)
+                node.watch_writes()
+            now = time.monotonic()
+            while self.events and self.events[0][0] <= now:
+                _, _, action, node, arg = heapq.heappop(self.events)
+                action(node, arg)
+            if now >= next_misc:
+                next_misc = now + 1.0
+                for node in nodes:
+                    if node.sock is not None:
+                        node.client.loop_misc()
+                progress[slot] = self.totals["published"]
+        self.stopping = True
+        for node in nodes:
+            if node.sock is not None:
+                node.client.disconnect()
+                node.client.loop_write()
+        progress[slot] = self.totals["published"]
+
+
+def node_prefixes(args):
+    per_room = max(1, args.nodes_per_room)
+    return [args.prefix.format(room=i // per_room + 1, node=i % per_room + 1, i=i) for i in range(args.devices)]
+
+
+def run_worker(args, worker, prefixes, stop, progress, results):
+    signal.signal(signal.SIGINT, signal.SIG_IGN)
+    raise_fd_limit()
+    fleet = Fleet(args, worker)
+    fleet.run(prefixes, stop, progress, worker)
+    results.put(fleet.totals)
+
+
+def merge_totals(parts):
+    merged = {"published": 0, "topics": {}}
+    for part in parts:
+        for key, value in part.items():
+            if key == "topics":
+                for topic, n in value.items():
+                    merged["topics"][topic] = merged["topics"].get(topic, 0) + n
+            else:
+                merged[key] = merged.get(key, 0) + value
+    return merged
+
+
+# ================= BACKEND =================
+class Backend:
+    """The backend's /api/ingest counters, plus WebSocket clients that keep fan-out busy"""
+
+    def __init__(self, url: str, ws_clients: int):
+        self.url = url.rstrip("/") if url else None
+        self.ws_clients = ws_clients
+        self.ws_bytes = 0
+        self.ws_lock = threading.Lock()
+
+    def request(self, path: str, method: str = "GET"):
+        req = urllib.request.Request(self.url + path, method=method, data=b"" if method == "POST" else None)
+        with urllib.request.urlopen(req, timeout=5) as resp:
+            return json.load(resp)
+
+    def start(self):
+        if not self.url:
+            return
+        self.request("/api/ingest/reset", "POST")
+        for _ in range(self.ws_clients):
+            threading.Thread(target=self.websocket, daemon=True).start()
+
+    def websocket(self):
+        """Minimal RFC 6455 client: upgrade, then read and count frames' bytes"""
+        url = urlparse(self.url)
+        sock = socket.create_connection((url.hostname, url.port or 80))
+        key = base64.b64encode(os.urandom(16)).decode()
+        sock.sendall((f"GET /ws HTTP/1.1\r\nHost: {url.netloc}\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                      f"Sec-WebSocket-Key: {key}\r\nSec-WebSocket-Version: 13\r\n\r\n").encode())
+        head = b""
+        while b"\r\n\r\n" not in head:
+            data = sock.recv(4096)
+            if not data:
+                return
+            head += data
+        if b" 101 " not in head.split(b"\r\n", 1)[0]:
+            print("backend refused the WebSocket upgrade", file=sys.stderr)
+            return
+        while True:
+            data = sock.recv(65536)
+            if not data:
+                return
+            with self.ws_lock:
+                self.ws_bytes += len(data)
+
+    def snapshot(self):
+        if not self.url:
+            return None
+        try:
+            return self.request("/api/ingest")
+        except OSError as e:
+            print(f"backend: {e}", file=sys.stderr)
+            return None
+
+
+def describe(elapsed_s: float, sent: int, last_sent: int, interval_s: float, ingest):
+    line = f"{elapsed_s:6.0f} s  fleet {sent:9d} msg {(sent - last_sent) / interval_s:8.0f}/s"
+    if ingest:
+        handle = ingest["handle"]
+        fanout = ingest["fanout"]
+        line += (f" | backend {ingest['messages']:9d} msg {ingest['rate_per_s']['10s']:8.0f}/s"
+                 f"  handle p95 {handle['p95_ms']} ms"
+                 f"  db p95 {ingest['db_write']['overall']['p95_ms']} ms"
+                 f"  fan-out p95 {fanout['lag']['p95_ms']} ms, {fanout['queued']} queued")
+    return line
+
+
+def monitor(backend, duration_s, interval_s, sent_fn, done_fn):
+    """Print a progress line every interval_s until done_fn() or the duration ends"""
+    started = time.monotonic()
+    last_sent = 0
+    next_at = started + interval_s
+    while not done_fn() and time.monotonic() - started < duration_s:
+        time.sleep(min(0.2, max(0.0, next_at - time.monotonic())))
+        if time.monotonic() >= next_at:
+            sent = sent_fn()
+            print(describe(time.monotonic() - started, sent, last_sent, interval_s, backend.snapshot()), flush=True)
+            last_sent = sent
+            next_at += interval_s
+
+
+def finish(args, backend, fleet_totals, elapsed_s):
+    """Let the backend catch up, then print and store the final figures"""
+    ingest = None
+    if backend.url:
+        time.sleep(args.settle)
+        ingest = backend.snapshot()
+    report = {"elapsed_s": round(elapsed_s, 1), "fleet": fleet_totals, "backend": ingest,
+              "ws_clients": backend.ws_clients, "ws_bytes": backend.ws_bytes}
+    sent = fleet_totals["published"]
+    print(f"published {sent} messages in {elapsed_s:.1f} s ({sent / max(elapsed_s, 1e-9):.0f}/s)")
+    if ingest:
+        print(f"backend ingested {ingest['messages']} messages, handle p50/p95/p99 "
+              f"{ingest['handle']['p50_ms']}/{ingest['handle']['p95_ms']}/{ingest['handle']['p99_ms']} ms, "
+              f"db write p95 {ingest['db_write']['overall']['p95_ms']} ms (max {ingest['db_write']['overall']['max_ms']}), "
+              f"fan-out lag p95 {ingest['fanout']['lag']['p95_ms']} ms (max {ingest['fanout']['lag']['max_ms']}), "
+              f"{ingest['fanout']['queued']} still queued")
+    if args.report:
+        with open(args.report, "w") as f:
+            json.dump(report, f, indent=2)
+            f.write("\n")
+
+
+# ================= COMMANDS =================
+def cmd_run(args):
+    prefixes = node_prefixes(args)
+    procs = max(1, min(args.procs, len(prefixes)))
+    backend = Backend(args.backend, args.ws_clients)
+    backend.start()
+
+    ctx = multiprocessing.get_context("fork")
+    stop = ctx.Event()
+    progress = ctx.Array("q", procs, lock=False)
+    results = ctx.Queue()
+    workers = [ctx.Process(target=run_worker, args=(args, w, prefixes[w::procs], stop, progress, results))
+               for w in range(procs)]
+    started = time.monotonic()
+    for worker in workers:
+        worker.start()
+    print(f"{len(prefixes)} nodes ({prefixes[0]} ...) on {args.broker}, {procs} process(es)", flush=True)
+    try:
+        monitor(backend, args.duration + 5, args.report_every, lambda: sum(progress),
+                lambda: not any(w.is_alive() for w in workers))
+    except KeyboardInterrupt:
+        stop.set()
+    parts = [results.get() for _ in workers]
+    for worker in workers:
+        worker.join()
+    finish(args, backend, merge_totals(parts), time.monotonic() - started)
+
+
+def cmd_record(args):
+    host, port = parse_broker(args.broker)
+    started = time.monotonic()
+    count = 0
+    out = open(args.output, "w")
+
+    def on_connect(client, userdata, flags, rc):
+        client.subscribe([(topic, 1) for topic in args.topics])
+
+    def on_message(client, userdata, msg):
+        nonlocal count
+        entry = {"t": round(time.monotonic() - started, 6), "topic": msg.topic, "qos": msg.qos,
+                 "retain": bool(msg.retain)}
+        try:
+            entry["payload"] = msg.payload.decode("utf-8")
+        except UnicodeDecodeError:
+            entry["payload_b64"] = base64.b64encode(msg.payload).decode()
+        out.write(json.dumps(entry) + "\n")
+        count += 1
+
+    client = new_client(f"fleet-record-{os.getpid()}")
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(host, port, KEEPALIVE_S)
+    client.loop_start()
+    try:
+        time.sleep(args.duration) if args.duration else threading.Event().wait()
+    except KeyboardInterrupt:
+        pass
+    client.disconnect()
+    client.loop_stop()
+    out.close()
+    print(f"recorded {count} messages in {time.monotonic() - started:.1f} s to {args.output}")
+
+
+def load_recording(path: str):
+    messages = []
+    with open(path) as f:
+        for line in f:
+            if not line.strip():
+                continue
+            entry = json.loads(line)
+            payload = (base64.b64decode(entry["payload_b64"]) if "payload_b64" in entry
+                       else entry["payload"].encode("utf-8"))
+            messages.append((float(entry["t"]), entry["topic"], payload, int(entry.get("qos", 1)),
+                             bool(entry.get("retain"))))
+    messages.sort(key=lambda m: m[0])
+    return messages
+
+
+def copy_topic(topic: str, copy: int):
+    """Copy k of a node's topic lives in room <room>_k; fleet-wide topics are sent once"""
+    if copy == 0:
+        return topic
+    room, sep, rest = topic.partition("/")
+    return None if room == "all" else f"{room}_{copy}{sep}{rest}"
+
+
+def cmd_replay(args):
+    host, port = parse_broker(args.broker)
+    messages = load_recording(args.file)
+    if not messages:
+        sys.exit(f"{args.file}: no messages")
+    backend = Backend(args.backend, args.ws_clients)
+    backend.start()
+
+    client = new_client(f"fleet-replay-{os.getpid()}")
+    client.max_inflight_messages_set(1000)
+    client.connect(host, port, KEEPALIVE_S)
+    client.loop_start()
+
+    sent = 0
+    stop = threading.Event()
+    done = threading.Event()
+
+    def publish_all():
+        nonlocal sent
+        base = messages[0][0]
+        started = time.monotonic()
+        for lap in range(args.loops):
+            offset = lap * (messages[-1][0] - base + 1.0)
+            for t, topic, payload, qos, retain in messages:
+                if stop.is_set():
+                    done.set()
+                    return
+                if args.speed > 0:
+                    delay = started + (t - base + offset) / args.speed - time.monotonic()
+                    if delay > 0:
+                        time.sleep(delay)
+                for copy in range(args.copies):
+                    copied = copy_topic(topic, copy)
+                    if copied is not None:
+                        client.publish(copied, payload, qos=qos, retain=retain and not args.no_retain)
+                        sent += 1
+        done.set()
+
+    started = time.monotonic()
+    publisher = threading.Thread(target=publish_all, daemon=True)
+    publisher.start()
+    span_s = (messages[-1][0] - messages[0][0]) * args.loops / args.speed if args.speed > 0 else math.inf
+    print(f"replaying {len(messages)} messages x{args.copies} copies x{args.loops} loops "
+          f"at {f'{args.speed:g}x' if args.speed else 'full'} speed to {args.broker}", flush=True)
+    try:
+        monitor(backend, span_s + 5, args.report_every, lambda: sent, done.is_set)
+    except KeyboardInterrupt:
+        stop.set()
+    done.wait()
+    client.disconnect()
+    client.loop_stop()
+    finish(args, backend, {"published": sent, "recorded": len(messages)}, time.monotonic() - started)
+
+
+def parse_burst(text: str):
+    try:
+        period, length, factor = (float(v) for v in text.split(":"))
+    except ValueError:
+        raise argparse.ArgumentTypeError("expected PERIOD:LENGTH:FACTOR")
+    if period <= 0 or not 0 < length <= period or factor <= 0:
+        raise argparse.ArgumentTypeError("need PERIOD > 0, 0 < LENGTH <= PERIOD, FACTOR > 0")
+    return period, length, factor
+
+
+def add_backend_args(parser):
+    parser.add_argument("--backend", help="backend URL whose /api/ingest to reset and report, e.g. http://127.0.0.1:8000")
+    parser.add_argument("--ws-clients", type=int, default=0, help="WebSocket clients to hold open on the backend")
+    parser.add_argument("--report-every", type=float, default=5.0, help="seconds between progress lines")
+    parser.add_argument("--settle", type=float, default=2.0, help="seconds the backend gets to catch up at the end")
+    parser.add_argument("--report", help="write the fleet and backend figures to this JSON file")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--broker", default="127.0.0.1:1883", help="HOST:PORT of a plain TCP broker")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    run = sub.add_parser("run", help="emulate a fleet of nodes")
+    run.add_argument("--devices", type=int, default=100)
+    run.add_argument("--prefix", default="room_{room:04d}",
+                     help="topic prefix of a node, formatted with room, node and i (default %(default)s)")
+    run.add_argument("--nodes-per-room", type=int, default=1,
+                     help="nodes sharing a room; use a {node} field in --prefix")
+    run.add_argument("--procs", type=int, default=1, help="worker processes, each with its own event loop")
+    run.add_argument("--duration", type=float, default=60.0, help="seconds to run")
+    run.add_argument("--ramp", type=float, default=10.0, help="seconds over which the nodes connect")
+    run.add_argument("--interval", type=float, default=2.0, help="seconds between samples of a node")
+    run.add_argument("--batch", type=int, default=1, help="samples per sensors message (1: single-sample format)")
+    run.add_argument("--burst", type=parse_burst,
+                     help="PERIOD:LENGTH:FACTOR, every PERIOD s sample FACTOR times faster for LENGTH s, fleet-wide")
+    run.add_argument("--health-interval", type=float, default=60.0, help="seconds between health reports")
+    run.add_argument("--rollup-window", type=float, default=60.0, help="seconds per rollup window")
+    run.add_argument("--flaps", type=float, default=0.0, help="connection drops per node per hour")
+    run.add_argument("--flap-down", type=float, default=10.0, help="seconds a dropped node stays offline")
+    run.add_argument("--ack-delay", type=float, default=5.0, help="ms from a command to its ack")
+    run.add_argument("--seed", type=int, default=1)
+    add_backend_args(run)
+
+    record = sub.add_parser("record", help="record broker traffic to a file")
+    record.add_argument("-o", "--output", required=True)
+    record.add_argument("--topics", nargs="+", default=["#"], help="topic filters to record (default #)")
+    record.add_argument("--duration", type=float, default=0.0, help="seconds to record (default: until Ctrl-C)")
+
+    replay = sub.add_parser("replay", help="publish recorded traffic again")
+    replay.add_argument("file")
+    replay.add_argument("--speed", type=float, default=1.0, help="time compression, 0 for as fast as possible")
+    replay.add_argument("--copies", type=int, default=1, help="copies of each node, in rooms <room>_1, <room>_2, ...")
+    replay.add_argument("--loops", type=int, default=1, help="times to play the recording")
+    replay.add_argument("--no-retain", action="store_true", help="publish retained messages as plain ones")
+    add_backend_args(replay)
+
+    args = parser.parse_args()
+    if args.command == "run":
+        if args.devices < 1 or args.interval <= 0 or args.batch < 1:
+            parser.error("need --devices >= 1, --interval > 0 and --batch >= 1")
+        cmd_run(args)
+    elif args.command == "record":
+        cmd_record(args)
+    else:
+        if args.copies < 1 or args.loops < 1 or args.speed < 0:
+            parser.error("need --copies >= 1, --loops >= 1 and --speed >= 0")
+        cmd_replay(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,8 +1,13 @@
+import functools
 import json
+import os
 import sqlite3
 import ssl
+import threading
+import time
 import uuid
-from datetime import datetime
+from collections import deque
+from datetime import datetime, timedelta
 from typing import Set
 from queue import Queue
 
@@ -12,16 +17,49 @@ from fastapi.templating import Jinja2Templates
 from fastapi.staticfiles import StaticFiles
 from paho.mqtt import client as mqtt
 
+from telemetry_codec import decode_payload
+
 # ================= CONFIG =================
-DB_NAME = "smarthome.db"
+# Environment variables override the defaults, e.g. to point a load test at
+# a local broker: MQTT_HOST=127.0.0.1 MQTT_PORT=1883 MQTT_TLS=0 NODE_PREFIX=+
+DB_NAME = os.environ.get("DB_NAME", "smarthome.db")
+
+MQTT_HOST = os.environ.get("MQTT_HOST", "6753deb1228e4cc3a9e2847294ddefda.s1.eu.hivemq.cloud")
+MQTT_PORT = int(os.environ.get("MQTT_PORT", "8883"))
+MQTT_TLS = os.environ.get("MQTT_TLS", "1") != "0"
+MQTT_USERNAME = os.environ.get("MQTT_USERNAME", "env-monitor")
+MQTT_PASSWORD = os.environ.get("MQTT_PASSWORD", "abcABC@123")
+
+# Topic prefix of the node this backend manages: its room, or room/device
+# when several nodes share a room (see "MQTT Topics" in the README).
+# "+" (or "+/+" for room/device nodes) takes in every node at once; commands
+# then go to all/commands and per-node settings cannot be pushed.
+NODE_PREFIX = os.environ.get("NODE_PREFIX", "room_01")
+NODE_WILDCARD = "+" in NODE_PREFIX
 
-MQTT_HOST = "6753deb1228e4cc3a9e2847294ddefda.s1.eu.hivemq.cloud"
-MQTT_PORT = 8883
-MQTT_USERNAME = "env-monitor"
-MQTT_PASSWORD = "abcABC@123"
+TOPIC_SENSOR = f"{NODE_PREFIX}/sensors"
+TOPIC_SENSOR_ROLLUP = f"{NODE_PREFIX}/sensors/rollup"
+TOPIC_COMMAND = "all/commands" if NODE_WILDCARD else f"{NODE_PREFIX}/commands"
+TOPIC_COMMAND_ACK = f"{NODE_PREFIX}/commands/ack"
+TOPIC_CONTROL_SET = f"{NODE_PREFIX}/control/set"
+TOPIC_CONTROL_STATUS = f"{NODE_PREFIX}/status/control"
+TOPIC_RULES_SET = f"{NODE_PREFIX}/rules/set"
+TOPIC_RULES_STATUS = f"{NODE_PREFIX}/status/rules"
+TOPIC_STATUS_CONNECTION = f"{NODE_PREFIX}/status/connection"
+TOPIC_STATUS_NETWORK = f"{NODE_PREFIX}/status/network"
+TOPIC_STATUS_DEVICES = f"{NODE_PREFIX}/status/devices"
+TOPIC_STATUS_SYSTEM = f"{NODE_PREFIX}/status/system"
 
-TOPIC_SENSOR = "room_01/sensors"
-TOPIC_COMMAND = "room_01/commands"
+# Upper bounds of the command -> ack latency buckets, the last bucket is open
+LATENCY_BUCKETS_MS = (50, 100, 200, 500, 1000, 2000, 5000, 10000)
+# A command still unacknowledged after this long counts as lost
+ACK_TIMEOUT_S = 30
+# Upper bounds of the ingest buckets: database writes, message handling and
+# WebSocket fan-out lag (queued -> sent to a client)
+DB_WRITE_BUCKETS_MS = (0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500)
+FANOUT_BUCKETS_MS = (5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000)
+# Ingest rate window, one bucket per second
+INGEST_WINDOW_S = 60
 # =========================================
 
 app = FastAPI()
@@ -30,6 +68,137 @@ templates = Jinja2Templates(directory="templates")
 mqtt_client: mqtt.Client | None = None
 websocket_clients: Set[WebSocket] = set()
 message_queue: Queue = Queue()
+# Last report of the on-device control loops; the device owns the loop, the backend only watches
+control_status: dict = {"loops": []}
+# Last rule engine counters reported by the device
+rules_status: dict = {}
+
+class LatencyHistogram:
+    """Fixed-bucket latency histogram; percentiles resolve to bucket bounds"""
+
+    def __init__(self, buckets_ms=LATENCY_BUCKETS_MS):
+        self.buckets_ms = buckets_ms
+        self.counts = [0] * (len(buckets_ms) + 1)
+        self.total = 0
+        self.sum_ms = 0.0
+        self.max_ms = 0.0
+
+    def observe(self, latency_ms: float):
+        i = 0
+        while i < len(self.buckets_ms) and latency_ms > self.buckets_ms[i]:
+            i += 1
+        self.counts[i] += 1
+        self.total += 1
+        self.sum_ms += latency_ms
+        self.max_ms = max(self.max_ms, latency_ms)
+
+    def percentile(self, p: float):
+        if self.total == 0:
+            return None
+        rank = p * self.total
+        seen = 0
+        for i, n in enumerate(self.counts):
+            seen += n
+            if seen >= rank:
+                return self.buckets_ms[i] if i < len(self.buckets_ms) else round(self.max_ms, 1)
+        return round(self.max_ms, 1)
+
+    def to_dict(self):
+        return {
+            "count": self.total,
+            "buckets": self.counts,
+            "mean_ms": round(self.sum_ms / self.total, 1) if self.total else None,
+            "max_ms": round(self.max_ms, 1),
+            "p50_ms": self.percentile(0.50),
+            "p95_ms": self.percentile(0.95),
+            "p99_ms": self.percentile(0.99),
+        }
+
+# Command round trips: histograms per device and overall, plus commands in flight
+latency_lock = threading.Lock()
+latency_overall = LatencyHistogram()
+latency_by_device: dict = {}
+pending_commands: dict = {}     # id -> (sent epoch ms, devices)
+ack_failures: dict = {}         # status -> count
+commands_lost = 0               # unacknowledged after ACK_TIMEOUT_S
+
+def expire_pending_commands(now_ms: float):
+    """Count commands that never got an ack as lost; call with latency_lock held"""
+    global commands_lost
+    expired = [cmd_id for cmd_id, (sent_ms, _) in pending_commands.items()
+               if now_ms - sent_ms > ACK_TIMEOUT_S * 1000]
+    for cmd_id in expired:
+        del pending_commands[cmd_id]
+    commands_lost += len(expired)
+
+class IngestStats:
+    """
+    What the backend keeps up with: messages taken in per topic, time spent
+    handling each one, database writes, WebSocket fan-out lag and backlog
+    dropped for want of a time reference. Sized with
+    software/fleet_sim.py; reset between load test runs.
+    """
+
+    def __init__(self):
+        self.started = time.monotonic()
+        self.topics = {}            # topic below the node prefix -> messages
+        self.total = 0
+        self.per_second = deque(maxlen=INGEST_WINDOW_S + 1)    # [second, messages]
+        self.handle = LatencyHistogram(DB_WRITE_BUCKETS_MS)
+        self.db_write = LatencyHistogram(DB_WRITE_BUCKETS_MS)
+        self.db_write_by_call = {}  # save_* function -> histogram
+        self.fanout = LatencyHistogram(FANOUT_BUCKETS_MS)
+        self.fanout_errors = 0
+        self.unplaced = {"samples": 0, "rollups": 0}    # backlog from a boot never heard live
+
+    def message(self, topic: str, handle_ms: float):
+        second = int(time.monotonic())
+        if self.per_second and self.per_second[-1][0] == second:
+            self.per_second[-1][1] += 1
+        else:
+            self.per_second.append([second, 1])
+        self.topics[topic] = self.topics.get(topic, 0) + 1
+        self.total += 1
+        self.handle.observe(handle_ms)
+
+    def rate(self, window_s: int):
+        """Messages per second over the last window_s complete seconds"""
+        now = int(time.monotonic())
+        window_s = max(1, min(window_s, now - int(self.started)))
+        return sum(n for second, n in self.per_second if now - window_s <= second < now) / window_s
+
+    def to_dict(self):
+        elapsed_s = time.monotonic() - self.started
+        return {
+            "elapsed_s": round(elapsed_s, 1),
+            "messages": self.total,
+            "topics": dict(self.topics),
+            "rate_per_s": {"10s": self.rate(10), f"{INGEST_WINDOW_S}s": self.rate(INGEST_WINDOW_S),
+                           "mean": round(self.total / elapsed_s, 1) if elapsed_s > 0 else 0.0},
+            "handle": self.handle.to_dict(),
+            "db_write": {"overall": self.db_write.to_dict(),
+                         "calls": {name: hist.to_dict() for name, hist in self.db_write_by_call.items()}},
+            "fanout": {"lag": self.fanout.to_dict(), "errors": self.fanout_errors},
+            "unplaced": dict(self.unplaced),
+        }
+
+ingest_lock = threading.Lock()
+ingest_stats = IngestStats()
+
+def timed_db_write(func):
+    """Count a save_* call's wall time, connect to commit, in ingest_stats"""
+    @functools.wraps(func)
+    def wrapper(*args, **kwargs):
+        started = time.perf_counter()
+        try:
+            return func(*args, **kwargs)
+        finally:
+            elapsed_ms = (time.perf_counter() - started) * 1000
+            with ingest_lock:
+                ingest_stats.db_write.observe(elapsed_ms)
+                ingest_stats.db_write_by_call.setdefault(
+                    func.__name__, LatencyHistogram(DB_WRITE_BUCKETS_MS)).observe(elapsed_ms)
+    return wrapper
 
 # ================= DATABASE =================
 def init_db():
@@ -64,22 +233,188 @@ def init_db():
             uptime_ms INTEGER,
             free_heap INTEGER,
             rssi REAL,
+            backlog INTEGER,
             ts TEXT
         )
     """)
+    c.execute("""
+        CREATE TABLE IF NOT EXISTS sensor_rollups (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            start_ts TEXT,
+            window_s REAL,
+            count INTEGER,
+            temp_min REAL,
+            temp_max REAL,
+            temp_mean REAL,
+            temp_var REAL,
+            hum_min REAL,
+            hum_max REAL,
+            hum_mean REAL,
+            hum_var REAL,
+            ts TEXT
+        )
+    """)
+    c.execute("""
+        CREATE TABLE IF NOT EXISTS command_acks (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            cmd_id TEXT,
+            device TEXT,
+            status TEXT,
+            latency_ms REAL,
+            device_us INTEGER,
+            ts TEXT
+        )
+    """)
+    c.execute("""
+        CREATE TABLE IF NOT EXISTS metrics_snapshots (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            uptime_ms INTEGER,
+            heap_free INTEGER,
+            heap_min_free INTEGER,
+            heap_largest INTEGER,
+            heap_frag REAL,
+            min_stack INTEGER,
+            snapshot TEXT,
+            ts TEXT
+        )
+    """)
+    c.execute("""
+        CREATE TABLE IF NOT EXISTS boot_anchors (
+            node TEXT,
+            boot INTEGER,
+            start REAL,
+            PRIMARY KEY (node, boot)
+        )
+    """)
+    # Databases created before the backlog column existed
+    try:
+        c.execute("ALTER TABLE system_status ADD COLUMN backlog INTEGER")
+    except sqlite3.OperationalError:
+        pass
     conn.commit()
     conn.close()
 
 def save_sensor(temp: float, hum: float):
+    save_sensors([(temp, hum, datetime.utcnow().isoformat())])
+
+@timed_db_write
+def save_sensors(rows):
+    """Insert (temperature, humidity, ts) rows in one transaction"""
     conn = sqlite3.connect(DB_NAME)
     c = conn.cursor()
-    c.execute(
+    c.executemany(
         "INSERT INTO sensors (temperature, humidity, ts) VALUES (?, ?, ?)",
-        (temp, hum, datetime.utcnow().isoformat())
+        rows
+    )
+    conn.commit()
+    conn.close()
+
+def load_boot_anchor(node: str, boot: int):
+    """Wall-clock time (epoch seconds) at which this boot's uptime was zero, None if never seen live"""
+    conn = sqlite3.connect(DB_NAME)
+    c = conn.cursor()
+    c.execute("SELECT start FROM boot_anchors WHERE node = ? AND boot = ?", (node, boot))
+    row = c.fetchone()
+    conn.close()
+    return row[0] if row else None
+
+@timed_db_write
+def save_boot_anchor(node: str, boot: int, start: float):
+    conn = sqlite3.connect(DB_NAME)
+    c = conn.cursor()
+    c.execute(
+        "INSERT INTO boot_anchors (node, boot, start) VALUES (?, ?, ?) "
+        "ON CONFLICT (node, boot) DO UPDATE SET start = excluded.start",
+        (node, boot, start)
+    )
+    conn.commit()
+    conn.close()
+
+@timed_db_write
+def save_rollup(row):
+    conn = sqlite3.connect(DB_NAME)
+    c = conn.cursor()
+    c.execute(
+        "INSERT INTO sensor_rollups (start_ts, window_s, count, temp_min, temp_max, temp_mean, temp_var, "
+        "hum_min, hum_max, hum_mean, hum_var, ts) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+        row
     )
     conn.commit()
     conn.close()
 
+def get_rollups(limit: int):
+    conn = sqlite3.connect(DB_NAME)
+    c = conn.cursor()
+    c.execute(
+        "SELECT start_ts, window_s, count, temp_min, temp_max, temp_mean, temp_var, "
+        "hum_min, hum_max, hum_mean, hum_var FROM sensor_rollups ORDER BY id DESC LIMIT ?",
+        (limit,)
+    )
+    rows = c.fetchall()
+    conn.close()
+    return [{
+        "start": row[0],
+        "window_s": row[1],
+        "count": row[2],
+        "temperature": {"min": row[3], "max": row[4], "mean": row[5], "var": row[6]},
+        "humidity": {"min": row[7], "max": row[8], "mean": row[9], "var": row[10]},
+    } for row in reversed(rows)]
+
+@timed_db_write
+def save_metrics_snapshot(uptime_ms: int, metrics: dict):
+    """Store one snapshot; headline figures get columns, the rest stays JSON"""
+    heap = metrics.get("heap") if isinstance(metrics.get("heap"), dict) else {}
+    stacks = [t.get("stack") for t in metrics.get("tasks") or []
+              if isinstance(t, dict) and isinstance(t.get("stack"), (int, float))]
+    conn = sqlite3.connect(DB_NAME)
+    c = conn.cursor()
+    c.execute(
+        "INSERT INTO metrics_snapshots (uptime_ms, heap_free, heap_min_free, heap_largest, heap_frag, "
+        "min_stack, snapshot, ts) VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+        (uptime_ms, heap.get("free"), heap.get("min_free"), heap.get("largest"), heap.get("frag"),
+         min(stacks) if stacks else None, json.dumps(metrics), datetime.utcnow().isoformat())
+    )
+    conn.commit()
+    conn.close()
+
+def get_metrics_snapshots(limit: int):
+    conn = sqlite3.connect(DB_NAME)
+    c = conn.cursor()
+    c.execute(
+        "SELECT uptime_ms, snapshot, ts FROM metrics_snapshots ORDER BY id DESC LIMIT ?",
+        (limit,)
+    )
+    rows = c.fetchall()
+    conn.close()
+    return [{"ts": row[2], "uptime_ms": row[0], **json.loads(row[1])} for row in reversed(rows)]
+
+@timed_db_write
+def save_command_acks(rows):
+    """Insert (cmd_id, device, status, latency_ms, device_us, ts) rows"""
+    conn = sqlite3.connect(DB_NAME)
+    c = conn.cursor()
+    c.executemany(
+        "INSERT INTO command_acks (cmd_id, device, status, latency_ms, device_us, ts) VALUES (?, ?, ?, ?, ?, ?)",
+        rows
+    )
+    conn.commit()
+    conn.close()
+
+def load_command_latency():
+    """Rebuild the latency histograms from stored acks after a restart"""
+    conn = sqlite3.connect(DB_NAME)
+    c = conn.cursor()
+    c.execute("SELECT cmd_id, device, latency_ms FROM command_acks WHERE status = 'ok' AND latency_ms IS NOT NULL")
+    rows = c.fetchall()
+    conn.close()
+    counted = set()
+    with latency_lock:
+        for cmd_id, device, latency_ms in rows:
+            latency_by_device.setdefault(device, LatencyHistogram()).observe(latency_ms)
+            if cmd_id not in counted:
+                latency_overall.observe(latency_ms)
+                counted.add(cmd_id)
+
 def get_latest_sensor():
     conn = sqlite3.connect(DB_NAME)
     c = conn.cursor()
@@ -92,6 +427,7 @@ def get_latest_sensor():
         return {}
     return {"temperature": f"{row[0]:.2f}", "humidity": f"{row[1]:.2f}"}
 
+@timed_db_write
 def save_device_status(device_type: str, state: str):
     conn = sqlite3.connect(DB_NAME)
     c = conn.cursor()
@@ -115,6 +451,7 @@ def get_device_status(device_type: str):
         return {"state": "unknown"}
     return {"state": row[0]}
 
+@timed_db_write
 def save_connection_status(status: str):
     conn = sqlite3.connect(DB_NAME)
     c = conn.cursor()
@@ -137,12 +474,13 @@ def get_connection_status():
         return {"status": "offline"}
     return {"status": row[0]}
 
-def save_system_status(uptime_ms: int, free_heap: int, rssi: float):
+@timed_db_write
+def save_system_status(uptime_ms: int, free_heap: int, rssi: float, backlog: int = 0):
     conn = sqlite3.connect(DB_NAME)
     c = conn.cursor()
     c.execute(
-        "INSERT INTO system_status (uptime_ms, free_heap, rssi, ts) VALUES (?, ?, ?, ?)",
-        (uptime_ms, free_heap, rssi, datetime.utcnow().isoformat())
+        "INSERT INTO system_status (uptime_ms, free_heap, rssi, backlog, ts) VALUES (?, ?, ?, ?, ?)",
+        (uptime_ms, free_heap, rssi, backlog, datetime.utcnow().isoformat())
     )
     conn.commit()
     conn.close()
@@ -151,41 +489,61 @@ def get_system_status():
     conn = sqlite3.connect(DB_NAME)
     c = conn.cursor()
     c.execute(
-        "SELECT uptime_ms, free_heap, rssi FROM system_status ORDER BY id DESC LIMIT 1"
+        "SELECT uptime_ms, free_heap, rssi, backlog FROM system_status ORDER BY id DESC LIMIT 1"
     )
     row = c.fetchone()
     conn.close()
     if not row:
-        return {"uptime_ms": 0, "free_heap": 0, "rssi": -100}
-    return {"uptime_ms": int(row[0] or 0), "free_heap": int(row[1] or 0), "rssi": float(row[2] or -100)}
+        return {"uptime_ms": 0, "free_heap": 0, "rssi": -100, "backlog": 0}
+    return {"uptime_ms": int(row[0] or 0), "free_heap": int(row[1] or 0), "rssi": float(row[2] or -100),
+            "backlog": int(row[3] or 0)}
 
 # ================= MQTT =================
+SUBSCRIPTIONS = (
+    (TOPIC_SENSOR, 1),
+    (TOPIC_SENSOR_ROLLUP, 1),
+    (TOPIC_STATUS_CONNECTION, 1),
+    (TOPIC_STATUS_NETWORK, 1),
+    (TOPIC_STATUS_DEVICES, 1),
+    (TOPIC_STATUS_SYSTEM, 0),
+    (TOPIC_CONTROL_STATUS, 1),
+    (TOPIC_RULES_STATUS, 1),
+    (TOPIC_COMMAND_ACK, 1),
+)
+
 def on_connect(client, userdata, flags, rc):
     if rc == 0:
         print("MQTT connected")
-        client.subscribe(TOPIC_SENSOR, qos=1)
-        client.subscribe("room_01/status/connection", qos=1)
-        client.subscribe("room_01/status/network", qos=1)
-        client.subscribe("room_01/status/devices", qos=1)
-        client.subscribe("room_01/status/system", qos=0)
+        for topic, qos in SUBSCRIPTIONS:
+            client.subscribe(topic, qos=qos)
     else:
         print("MQTT connect failed:", rc)
 
+def subscription_of(topic: str):
+    """The TOPIC_* a message arrived on; with a wildcard prefix, the filter it matched"""
+    for topic_filter, _ in SUBSCRIPTIONS:
+        if topic == topic_filter or (NODE_WILDCARD and mqtt.topic_matches_sub(topic_filter, topic)):
+            return topic_filter
+    return topic
+
 def on_message(client, userdata, msg):
-    # Decode payload to text, then try JSON; accept raw for connection topics
-    raw_text = ""
-    payload_obj = None
-    try:
-        raw_text = msg.payload.decode()
-    except Exception:
-        raw_text = ""
+    started = time.perf_counter()
+    topic = subscription_of(msg.topic)
+    handle_message(topic, msg.payload, msg.topic)
+    handle_ms = (time.perf_counter() - started) * 1000
+    with ingest_lock:
+        ingest_stats.message(topic[len(NODE_PREFIX) + 1:] if topic.startswith(NODE_PREFIX + "/") else topic,
+                             handle_ms)
 
-    try:
-        payload_obj = json.loads(raw_text)
-    except Exception:
-        payload_obj = None
+def handle_message(topic: str, payload: bytes, source_topic: str = None):
+    # Decode JSON or compact binary payloads; keep raw text for connection topics
+    payload_obj, raw_text = decode_payload(payload)
 
-    if msg.topic == TOPIC_SENSOR:
+    if topic == TOPIC_SENSOR:
+        if isinstance(payload_obj, dict) and isinstance(payload_obj.get("samples"), list):
+            # The node the message came from; with a wildcard prefix several share one subscription
+            handle_sensor_batch(payload_obj, (source_topic or topic).rsplit("/", 1)[0])
+            return
         if not isinstance(payload_obj, dict):
             print("Invalid JSON from MQTT (sensor)")
             return
@@ -203,7 +561,13 @@ def on_message(client, userdata, msg):
         else:
             print("Invalid sensor payload (missing fields)")
 
-    elif msg.topic in ("room_01/status/connection", "room_01/status/network"):
+    elif topic == TOPIC_SENSOR_ROLLUP:
+        if not isinstance(payload_obj, dict):
+            print("Invalid rollup payload")
+            return
+        handle_sensor_rollup(payload_obj, (source_topic or topic).rsplit("/", 2)[0])
+
+    elif topic in (TOPIC_STATUS_CONNECTION, TOPIC_STATUS_NETWORK):
         if isinstance(payload_obj, dict):
             status = payload_obj.get("status", "offline")
         else:
@@ -215,47 +579,254 @@ def on_message(client, userdata, msg):
         })
         print(f"Connection status: {status}")
 
-    elif msg.topic == "room_01/status/system":
+    elif topic == TOPIC_STATUS_SYSTEM:
         if not isinstance(payload_obj, dict):
             print("Invalid JSON from MQTT (system)")
             return
         uptime_ms = payload_obj.get("uptime_ms")
+        # Metrics snapshot: part of the JSON health report, or on its own next to a binary one
+        metrics = payload_obj.get("metrics")
+        if isinstance(metrics, dict):
+            save_metrics_snapshot(int(uptime_ms or 0), metrics)
+            broadcast_message({"type": "metrics", "uptime_ms": int(uptime_ms or 0), **metrics})
         free_heap = payload_obj.get("free_heap")
-        rssi = payload_obj.get("rssi")
+        rssi = payload_obj.get("rssi", payload_obj.get("wifi_rssi"))
         if rssi is None:
-            print("System payload missing rssi")
+            if not isinstance(metrics, dict):
+                print("System payload missing rssi")
             return
-        save_system_status(int(uptime_ms or 0), int(free_heap or 0), float(rssi))
+        backlog = int(payload_obj.get("backlog") or 0)
+        save_system_status(int(uptime_ms or 0), int(free_heap or 0), float(rssi), backlog)
         broadcast_message({
             "type": "system",
             "uptime_ms": int(uptime_ms or 0),
             "free_heap": int(free_heap or 0),
-            "rssi": float(rssi)
+            "rssi": float(rssi),
+            "backlog": backlog,
+            "first_sample_ms": payload_obj.get("first_sample_ms"),
+            "first_publish_ms": payload_obj.get("first_publish_ms")
         })
-        print(f"System status: rssi={rssi}, heap={free_heap}, uptime={uptime_ms}")
+        print(f"System status: rssi={rssi}, heap={free_heap}, uptime={uptime_ms}, backlog={backlog}")
 
-    elif msg.topic == "room_01/status/devices":
+    elif topic == TOPIC_STATUS_DEVICES:
         if not isinstance(payload_obj, dict):
             print("Invalid JSON from MQTT (devices)")
             return
-        device_type = payload_obj.get("device")
-        state = payload_obj.get("state")
-        if device_type and state:
-            save_device_status(device_type, state)
-            broadcast_message({
-                "type": "device",
-                "device": device_type,
-                "state": state,
-                "timestamp": payload_obj.get("timestamp")
-            })
-            print(f"Device {device_type} status: {state}")
-        else:
-            print("Invalid device payload (missing fields)")
+        # Combined report: {"timestamp": .., "devices": [{"device": .., "state": ..}, ...]}
+        reports = payload_obj.get("devices")
+        if not isinstance(reports, list):
+            reports = [payload_obj]
+        for report in reports:
+            if not isinstance(report, dict):
+                continue
+            device_type = report.get("device")
+            state = report.get("state")
+            if device_type and state:
+                save_device_status(device_type, state)
+                broadcast_message({
+                    "type": "device",
+                    "device": device_type,
+                    "state": state,
+                    "timestamp": report.get("timestamp", payload_obj.get("timestamp"))
+                })
+                print(f"Device {device_type} status: {state}")
+            else:
+                print("Invalid device payload (missing fields)")
+
+    elif topic == TOPIC_COMMAND_ACK:
+        if not isinstance(payload_obj, dict) or not payload_obj.get("id"):
+            print("Invalid command ack payload")
+            return
+        handle_command_ack(payload_obj)
+
+    elif topic == TOPIC_CONTROL_STATUS:
+        if not isinstance(payload_obj, dict) or not isinstance(payload_obj.get("loops"), list):
+            print("Invalid control status payload")
+            return
+        control_status["loops"] = payload_obj["loops"]
+        broadcast_message({"type": "control", "loops": payload_obj["loops"]})
+        for loop in payload_obj["loops"]:
+            print(f"Control {loop.get('loop')}: {loop.get('mode')} sp={loop.get('setpoint')} "
+                  f"out={loop.get('output')}")
+
+    elif topic == TOPIC_RULES_STATUS:
+        if not isinstance(payload_obj, dict):
+            print("Invalid rules status payload")
+            return
+        rules_status.clear()
+        rules_status.update(payload_obj)
+        broadcast_message({"type": "rules", **payload_obj})
+        print(f"Rules: {payload_obj.get('rules')} active, eval max {payload_obj.get('max_us')} us")
+
+def boot_start(node: str, boot, device_now, received_epoch: float):
+    """
+    Wall-clock time at which a boot's uptime was zero, None if unknown. A
+    message with both "boot" and "timestamp" records it; the earliest
+    estimate wins, as it had the least transit delay.
+    """
+    if boot is None:
+        return None
+    start = load_boot_anchor(node, int(boot))
+    if device_now is not None:
+        live_start = received_epoch - float(device_now)
+        if start is None or live_start < start:
+            save_boot_anchor(node, int(boot), live_start)
+            start = live_start
+    return start
+
+def handle_sensor_batch(payload_obj: dict, node: str = NODE_PREFIX):
+    """
+    Batched samples: {"timestamp": now, "boot": id, "samples": [{temperature, humidity, timestamp}, ...]}
+    Sample timestamps are device uptime; map them onto wall-clock time using
+    the batch's publish timestamp and the time we received it. A live batch
+    also records when its boot started (the earliest estimate wins, as it had
+    the least transit delay), so backlog from that boot, replayed after a
+    reboot without "timestamp", can still be placed. Backlog from a boot we
+    never heard live has no time reference and is dropped rather than stored
+    at a made-up time.
+    """
+    received_epoch = time.time()
+    received = datetime.utcfromtimestamp(received_epoch)
+    device_now = payload_obj.get("timestamp")
+    boot = payload_obj.get("boot")
+    start = boot_start(node, boot, device_now, received_epoch)
+    rows = []
+    latest = None
+    unplaced = 0
+    for sample in payload_obj["samples"]:
+        if not isinstance(sample, dict):
+            continue
+        temp = sample.get("temperature")
+        hum = sample.get("humidity")
+        if temp is None or hum is None:
+            continue
+        ts = received
+        sample_ts = sample.get("timestamp")
+        if device_now is not None and sample_ts is not None:
+            age = max(0.0, float(device_now) - float(sample_ts))
+            ts = received - timedelta(seconds=age)
+        elif device_now is None:
+            if start is None or sample_ts is None:
+                unplaced += 1
+                continue
+            ts = datetime.utcfromtimestamp(start + float(sample_ts))
+        rows.append((float(temp), float(hum), ts.isoformat()))
+        latest = sample
+
+    if unplaced:
+        with ingest_lock:
+            ingest_stats.unplaced["samples"] += unplaced
+        print(f"Dropped {unplaced} backlog samples from boot {boot} of {node} (no time reference)")
+    if not rows:
+        if not unplaced:
+            print("Invalid sensor batch (no valid samples)")
+        return
+
+    save_sensors(rows)
+    broadcast_message({
+        "type": "sensor",
+        "temperature": float(latest["temperature"]),
+        "humidity": float(latest["humidity"]),
+        "timestamp": latest.get("timestamp")
+    })
+    print(f"Saved sensor batch: {len(rows)} samples")
+
+def handle_command_ack(payload_obj: dict):
+    """
+    Acknowledgement of a command we sent:
+    {"id": .., "ts": <our send time, epoch ms>, "status": "ok" | <error>,
+     "device_us": .., "devices": [{"device": .., "state": ..}, ...]}
+    The round trip is measured on our clock only, from the echoed send time,
+    so it needs no clock sync with the device. Failed commands are counted
+    but kept out of the histograms.
+    """
+    received_ms = time.time() * 1000
+    cmd_id = str(payload_obj["id"])
+    status = str(payload_obj.get("status") or "unknown")
+    devices = [d for d in payload_obj.get("devices") or [] if isinstance(d, dict) and d.get("device")]
+    sent_ms = payload_obj.get("ts")
+    latency_ms = None
+    if isinstance(sent_ms, (int, float)) and 0 < sent_ms <= received_ms:
+        latency_ms = received_ms - float(sent_ms)
+
+    with latency_lock:
+        pending_commands.pop(cmd_id, None)
+        if status != "ok":
+            ack_failures[status] = ack_failures.get(status, 0) + 1
+        elif latency_ms is not None:
+            latency_overall.observe(latency_ms)
+            for device in devices:
+                latency_by_device.setdefault(device["device"], LatencyHistogram()).observe(latency_ms)
+
+    ts = datetime.utcnow().isoformat()
+    device_us = payload_obj.get("device_us")
+    save_command_acks([(cmd_id, device.get("device"), status, latency_ms, device_us, ts) for device in devices]
+                      or [(cmd_id, None, status, latency_ms, device_us, ts)])
+    broadcast_message({
+        "type": "ack",
+        "id": cmd_id,
+        "status": status,
+        "latency_ms": latency_ms,
+        "devices": devices
+    })
+    latency_text = f"{latency_ms:.0f} ms" if latency_ms is not None else "no timestamp"
+    print(f"Command {cmd_id} {status}: {latency_text} (device {device_us} us)")
+
+def handle_sensor_rollup(payload_obj: dict, node: str = NODE_PREFIX):
+    """
+    One window of statistics:
+    {"timestamp": now, "boot": id, "start": .., "window_s": .., "count": ..,
+     "temperature": {"min", "max", "mean", "var"}, "humidity": {...}}
+    The window start is device uptime, mapped onto wall-clock time like a batch;
+    a window replayed from an earlier boot comes without "timestamp".
+    """
+    received_epoch = time.time()
+    received = datetime.utcfromtimestamp(received_epoch)
+    temp = payload_obj.get("temperature")
+    hum = payload_obj.get("humidity")
+    if not isinstance(temp, dict) or not isinstance(hum, dict) or not payload_obj.get("count"):
+        print("Invalid rollup payload (missing fields)")
+        return
+
+    start = received
+    device_now = payload_obj.get("timestamp")
+    device_start = payload_obj.get("start")
+    boot = payload_obj.get("boot")
+    anchor = boot_start(node, boot, device_now, received_epoch)
+    if device_now is not None and device_start is not None:
+        start = received - timedelta(seconds=max(0.0, float(device_now) - float(device_start)))
+    elif device_now is None:
+        if anchor is None or device_start is None:
+            with ingest_lock:
+                ingest_stats.unplaced["rollups"] += 1
+            print(f"Dropped backlog rollup from boot {boot} of {node} (no time reference)")
+            return
+        start = datetime.utcfromtimestamp(anchor + float(device_start))
+
+    try:
+        row = (start.isoformat(), float(payload_obj.get("window_s") or 0), int(payload_obj["count"]),
+               float(temp["min"]), float(temp["max"]), float(temp["mean"]), float(temp["var"]),
+               float(hum["min"]), float(hum["max"]), float(hum["mean"]), float(hum["var"]),
+               received.isoformat())
+    except (KeyError, TypeError, ValueError):
+        print("Invalid rollup payload (bad statistics)")
+        return
+
+    save_rollup(row)
+    broadcast_message({
+        "type": "rollup",
+        "start": row[0],
+        "window_s": row[1],
+        "count": row[2],
+        "temperature": temp,
+        "humidity": hum
+    })
+    print(f"Saved rollup: {row[2]} samples, T={row[5]:.2f} H={row[9]:.2f}")
 
 # ================= BROADCAST TASK =================
 def broadcast_message(data: dict):
     """Queue message for broadcast to all connected WebSocket clients"""
-    message_queue.put(data)
+    message_queue.put((time.monotonic(), data))
 
 def start_mqtt():
     global mqtt_client
@@ -264,7 +835,8 @@ def start_mqtt():
         protocol=mqtt.MQTTv311
     )
     mqtt_client.username_pw_set(MQTT_USERNAME, MQTT_PASSWORD)
-    mqtt_client.tls_set_context(ssl.create_default_context())
+    if MQTT_TLS:
+        mqtt_client.tls_set_context(ssl.create_default_context())
 
     mqtt_client.on_connect = on_connect
     mqtt_client.on_message = on_message
@@ -278,14 +850,19 @@ async def broadcast_pending_messages():
     while True:
         try:
             if not message_queue.empty():
-                data = message_queue.get_nowait()
+                queued, data = message_queue.get_nowait()
                 clients_copy = list(websocket_clients)
                 for ws in clients_copy:
                     try:
                         await ws.send_json(data)
+                        lag_ms = (time.monotonic() - queued) * 1000
+                        with ingest_lock:
+                            ingest_stats.fanout.observe(lag_ms)
                     except Exception as e:
                         print(f"Error sending to client: {e}")
                         websocket_clients.discard(ws)
+                        with ingest_lock:
+                            ingest_stats.fanout_errors += 1
             await asyncio.sleep(0.01)
         except Exception as e:
             print(f"Error in broadcast task: {e}")
@@ -295,6 +872,7 @@ async def broadcast_pending_messages():
 @app.on_event("startup")
 async def startup():
     init_db()
+    load_command_latency()
     start_mqtt()
     # Start background broadcast task
     import asyncio
@@ -349,6 +927,16 @@ async def websocket_endpoint(websocket: WebSocket):
 async def api_status():
     return JSONResponse(get_latest_sensor())
 
+@app.get("/api/rollups")
+async def api_rollups(limit: int = 60):
+    """Most recent sensor rollups, oldest first"""
+    return JSONResponse(get_rollups(max(1, min(limit, 1440))))
+
+@app.get("/api/metrics")
+async def api_metrics(limit: int = 60):
+    """Most recent firmware metrics snapshots, oldest first"""
+    return JSONResponse(get_metrics_snapshots(max(1, min(limit, 1440))))
+
 @app.get("/api/device-status")
 async def api_device_status(device: str):
     return JSONResponse(get_device_status(device))
@@ -391,6 +979,13 @@ async def api_command(cmd: dict):
     else:
         raise HTTPException(400, "Unknown device type")
 
+    # Correlation id and our send time, echoed by the device in its ack
+    payload["id"] = uuid.uuid4().hex[:12]
+    payload["ts"] = int(time.time() * 1000)
+    with latency_lock:
+        expire_pending_commands(payload["ts"])
+        pending_commands[payload["id"]] = (payload["ts"], [device_type])
+
     mqtt_client.publish(
         TOPIC_COMMAND,
         json.dumps(payload),
@@ -398,3 +993,108 @@ async def api_command(cmd: dict):
     )
 
     return {"status": "ok", "sent": payload}
+
+@app.get("/api/command-latency")
+async def api_command_latency():
+    """
+    Command -> ack round trips since the database was created:
+    {"buckets_ms": [...], "overall": {count, buckets, mean_ms, max_ms, p50_ms, p95_ms, p99_ms},
+     "devices": {"fan": {...}}, "pending": n, "lost": n, "failed": {"ESP_ERR_TIMEOUT": n}}
+    buckets[i] counts round trips up to buckets_ms[i]; the last one is everything slower.
+    Commands unacknowledged for ACK_TIMEOUT_S count as lost (since the backend started).
+    """
+    with latency_lock:
+        expire_pending_commands(time.time() * 1000)
+        return JSONResponse({
+            "buckets_ms": list(LATENCY_BUCKETS_MS),
+            "overall": latency_overall.to_dict(),
+            "devices": {device: hist.to_dict() for device, hist in latency_by_device.items()},
+            "pending": len(pending_commands),
+            "lost": commands_lost,
+            "failed": dict(ack_failures),
+        })
+
+@app.get("/api/ingest")
+async def api_ingest():
+    """
+    Backend load since start or the last reset:
+    {"elapsed_s", "messages", "topics": {"sensors": n, ..}, "rate_per_s": {"10s", "60s", "mean"},
+     "handle": {..}, "db_write": {"overall": {..}, "calls": {"save_sensors": {..}}},
+     "fanout": {"lag": {..}, "errors": n, "queued": n, "clients": n},
+     "unplaced": {"samples": n, "rollups": n}, "buckets_ms": {..}}
+    Histograms have the shape of /api/command-latency. "handle" is the time
+    on_message took, database writes included; fan-out lag runs from queueing
+    a message to handing it to each WebSocket client. "unplaced" counts backlog
+    dropped because it came from a boot the backend never heard live.
+    """
+    with ingest_lock:
+        stats = ingest_stats.to_dict()
+    stats["fanout"]["queued"] = message_queue.qsize()
+    stats["fanout"]["clients"] = len(websocket_clients)
+    stats["buckets_ms"] = {"handle": list(DB_WRITE_BUCKETS_MS), "db_write": list(DB_WRITE_BUCKETS_MS),
+                           "fanout": list(FANOUT_BUCKETS_MS)}
+    return JSONResponse(stats)
+
+@app.post("/api/ingest/reset")
+async def api_ingest_reset():
+    """Start counting afresh, e.g. when a load test begins"""
+    global ingest_stats
+    with ingest_lock:
+        ingest_stats = IngestStats()
+    return {"status": "ok"}
+
+_CONTROL_FIELDS = ("mode", "setpoint", "hysteresis", "kp", "ki", "kd", "window_s", "min_on_s", "min_off_s")
+
+@app.get("/api/control")
+async def api_control():
+    return JSONResponse(control_status)
+
+@app.post("/api/control")
+async def api_control_set(settings: dict):
+    """
+    Push setpoints to the on-device control loops, e.g.
+    { "loop": "humidity", "mode": "pid", "setpoint": 55 }
+    Only the given fields change; the device validates and stores them.
+    """
+    if NODE_WILDCARD:
+        raise HTTPException(409, "NODE_PREFIX is a wildcard, settings need one node")
+    if "loop" not in settings:
+        raise HTTPException(400, "Missing loop")
+    if settings.get("mode") not in (None, "off", "hysteresis", "pid"):
+        raise HTTPException(400, "Unknown mode")
+
+    payload = {"loop": settings["loop"]}
+    payload.update({k: settings[k] for k in _CONTROL_FIELDS if k in settings})
+
+    mqtt_client.publish(
+        TOPIC_CONTROL_SET,
+        json.dumps(payload),
+        qos=1
+    )
+
+    return {"status": "ok", "sent": payload}
+
+@app.get("/api/rules")
+async def api_rules():
+    return JSONResponse(rules_status)
+
+@app.post("/api/rules")
+async def api_rules_set(document: dict):
+    """
+    Replace the rules evaluated on the device, e.g.
+    { "rules": [ { "if": "humidity < 40 and temperature > 26",
+                   "then": { "device": "humidifier", "state": "on" }, "for_s": 600 } ] }
+    The device compiles the document and rejects it as a whole if any rule is invalid.
+    """
+    if NODE_WILDCARD:
+        raise HTTPException(409, "NODE_PREFIX is a wildcard, rules need one node")
+    if not isinstance(document.get("rules"), list):
+        raise HTTPException(400, "Missing rules list")
+
+    mqtt_client.publish(
+        TOPIC_RULES_SET,
+        json.dumps({"rules": document["rules"]}),
+        qos=1
+    )
+
+    return {"status": "ok", "sent": len(document["rules"])}
@@ -0,0 +1,151 @@
+"""Decoder for the telemetry payloads published by the firmware.
+
+Payloads are either JSON text or the compact binary schema defined in
+components/telemetry_codec/include/telemetry_codec.h. Binary payloads start
+with a marker byte (0xA0 | version) that can never begin a JSON document.
+Both formats decode to the same dict shape.
+"""
+import json
+import struct
+
+BIN_MARKER_V1 = 0xA1
+
+BIN_SENSOR = 1
+BIN_DEVICE_STATUS = 2
+BIN_HEALTH = 3
+BIN_SENSOR_BATCH = 4
+BIN_SENSOR_BACKLOG = 5
+BIN_DEVICE_STATES = 6
+BIN_ROLLUP = 7
+BIN_ROLLUP_BACKLOG = 8
+
+_SENSOR_V1 = struct.Struct("<hHI")
+_DEVICE_V1 = struct.Struct("<IBB")
+_HEALTH_V1 = struct.Struct("<IIb")
+_HEALTH_BACKLOG_V1 = struct.Struct("<I")
+_HEALTH_BOOT_V1 = struct.Struct("<II")
+_BATCH_HDR_V1 = struct.Struct("<IB")
+_BATCH_ITEM_V1 = struct.Struct("<hHi")
+_BATCH_BOOT_V1 = struct.Struct("<I")
+_STATES_HDR_V1 = struct.Struct("<IB")
+_STATES_ITEM_V1 = struct.Struct("<BB")
+_ROLLUP_HDR_V1 = struct.Struct("<IiIH")
+_ROLLUP_TEMP_V1 = struct.Struct("<hhhI")
+_ROLLUP_HUM_V1 = struct.Struct("<HHHI")
+_ROLLUP_BOOT_V1 = struct.Struct("<I")
+
+
+def is_binary(payload: bytes) -> bool:
+    return len(payload) >= 2 and (payload[0] & 0xF0) == 0xA0
+
+
+def _decode_binary(payload: bytes):
+    if payload[0] != BIN_MARKER_V1:
+        raise ValueError(f"unsupported binary schema version {payload[0] & 0x0F}")
+
+    msg_type = payload[1]
+    body = payload[2:]
+
+    if msg_type == BIN_SENSOR:
+        temp, hum, ts = _SENSOR_V1.unpack_from(body)
+        return {"temperature": temp / 100.0, "humidity": hum / 100.0, "timestamp": ts}
+
+    if msg_type == BIN_DEVICE_STATUS:
+        ts, state, name_len = _DEVICE_V1.unpack_from(body)
+        name = body[_DEVICE_V1.size:_DEVICE_V1.size + name_len]
+        if len(name) != name_len:
+            raise ValueError("truncated device name")
+        return {"device": name.decode(), "state": "on" if state else "off", "timestamp": ts}
+
+    if msg_type == BIN_HEALTH:
+        uptime_ms, free_heap, rssi = _HEALTH_V1.unpack_from(body)
+        health = {"uptime_ms": uptime_ms, "free_heap": free_heap, "wifi_rssi": rssi}
+        offset = _HEALTH_V1.size
+        if len(body) >= offset + _HEALTH_BACKLOG_V1.size:
+            health["backlog"] = _HEALTH_BACKLOG_V1.unpack_from(body, offset)[0]
+            offset += _HEALTH_BACKLOG_V1.size
+        if len(body) >= offset + _HEALTH_BOOT_V1.size:
+            first_sample, first_publish = _HEALTH_BOOT_V1.unpack_from(body, offset)
+            health["first_sample_ms"] = first_sample
+            health["first_publish_ms"] = first_publish
+        return health
+
+    if msg_type in (BIN_SENSOR_BATCH, BIN_SENSOR_BACKLOG):
+        now, count = _BATCH_HDR_V1.unpack_from(body)
+        samples = []
+        for i in range(count):
+            temp, hum, offset_ms = _BATCH_ITEM_V1.unpack_from(
+                body, _BATCH_HDR_V1.size + i * _BATCH_ITEM_V1.size)
+            samples.append({
+                "temperature": temp / 100.0,
+                "humidity": hum / 100.0,
+                "timestamp": now + offset_ms / 1000.0,
+            })
+        batch = {"samples": samples}
+        offset = _BATCH_HDR_V1.size + count * _BATCH_ITEM_V1.size
+        if len(body) >= offset + _BATCH_BOOT_V1.size:
+            batch["boot"] = _BATCH_BOOT_V1.unpack_from(body, offset)[0]
+        if msg_type == BIN_SENSOR_BATCH:
+            # Backlog samples come from an earlier boot: no mapping to the current device clock
+            batch["timestamp"] = now
+        return batch
+
+    if msg_type == BIN_DEVICE_STATES:
+        ts, count = _STATES_HDR_V1.unpack_from(body)
+        offset = _STATES_HDR_V1.size
+        devices = []
+        for _ in range(count):
+            state, name_len = _STATES_ITEM_V1.unpack_from(body, offset)
+            offset += _STATES_ITEM_V1.size
+            name = body[offset:offset + name_len]
+            if len(name) != name_len:
+                raise ValueError("truncated device name")
+            offset += name_len
+            devices.append({"device": name.decode(), "state": "on" if state else "off"})
+        return {"timestamp": ts, "devices": devices}
+
+    if msg_type in (BIN_ROLLUP, BIN_ROLLUP_BACKLOG):
+        now, start_ms, window_ms, count = _ROLLUP_HDR_V1.unpack_from(body)
+        offset = _ROLLUP_HDR_V1.size
+        rollup = {
+            "start": now + start_ms / 1000.0,
+            "window_s": window_ms / 1000.0,
+            "count": count,
+        }
+        if msg_type == BIN_ROLLUP:
+            # A backlog window is on the clock of an earlier boot, like a sensor backlog
+            rollup["timestamp"] = now
+        for channel, layout in (("temperature", _ROLLUP_TEMP_V1), ("humidity", _ROLLUP_HUM_V1)):
+            lo, hi, mean, var = layout.unpack_from(body, offset)
+            offset += layout.size
+            rollup[channel] = {"min": lo / 100.0, "max": hi / 100.0,
+                               "mean": mean / 100.0, "var": var / 10000.0}
+        if len(body) >= offset + _ROLLUP_BOOT_V1.size:
+            rollup["boot"] = _ROLLUP_BOOT_V1.unpack_from(body, offset)[0]
+        return rollup
+
+    raise ValueError(f"unknown binary message type {msg_type}")
+
+
+def decode_payload(payload: bytes):
+    """Decode a telemetry payload.
+
+    Returns (obj, text): obj is the decoded dict/list or None if the payload
+    is neither valid JSON nor a known binary message; text is the payload
+    as text for plain-string topics such as the LWT status.
+    """
+    if is_binary(payload):
+        try:
+            return _decode_binary(payload), ""
+        except (ValueError, struct.error, UnicodeDecodeError):
+            return None, ""
+
+    try:
+        text = payload.decode()
+    except UnicodeDecodeError:
+        return None, ""
+
+    try:
+        return json.loads(text), text
+    except ValueError:
+        return None, text